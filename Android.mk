@@ -18,6 +18,7 @@ LOCAL_CORE_COMMON_SRC := \
 	talk/base/bandwidthsmoother.cc \
 	talk/base/base64.cc \
 	talk/base/basicpacketsocketfactory.cc \
+	talk/base/bufferpool.cc \
 	talk/base/bytebuffer.cc \
 	talk/base/checks.cc \
 	talk/base/common.cc \
@@ -66,8 +67,11 @@ LOCAL_CORE_COMMON_SRC := \
 	talk/base/socketpool.cc \
 	talk/base/socketstream.cc \
 	talk/base/ssladapter.cc \
+	talk/base/sslhandshakepool.cc \
 	talk/base/sslsocketfactory.cc \
 	talk/base/sslidentity.cc \
+	talk/base/sslidentitypool.cc \
+	talk/base/sslsessioncache.cc \
 	talk/base/sslstreamadapter.cc \
 	talk/base/sslstreamadapterhelper.cc \
 	talk/base/stream.cc \
@@ -79,6 +83,7 @@ LOCAL_CORE_COMMON_SRC := \
 	talk/base/taskrunner.cc \
 	talk/base/testclient.cc \
 	talk/base/thread.cc \
+	talk/base/timerwheel.cc \
 	talk/base/timeutils.cc \
 	talk/base/timing.cc \
 	talk/base/transformadapter.cc \
@@ -123,6 +128,7 @@ LOCAL_CORE_LINUX_SRC := \
 	talk/base/libdbusglibsymboltable.cc \
 	talk/base/linux.cc \
 	talk/base/linuxfdwalk.c \
+	talk/base/linuxnetworkmonitor.cc \
 
 LOCAL_CORE_POSIX_SRC := \
 	talk/base/latebindingsymboltable.cc \
@@ -170,6 +176,7 @@ LOCAL_P2P_SRC := \
 	talk/p2p/base/portallocatorsessionproxy.cc \
 	talk/p2p/base/portproxy.cc \
 	talk/p2p/base/pseudotcp.cc \
+	talk/p2p/base/pseudotcpcongestion.cc \
 	talk/p2p/base/relayport.cc \
 	talk/p2p/base/relayserver.cc \
 	talk/p2p/base/rawtransport.cc \
@@ -189,11 +196,13 @@ LOCAL_P2P_SRC := \
 	talk/p2p/base/transportdescriptionfactory.cc \
 	talk/p2p/base/turnport.cc \
 	talk/p2p/base/turnserver.cc \
+	talk/p2p/base/udpportmux.cc \
 	talk/p2p/client/basicportallocator.cc \
 	talk/p2p/client/connectivitychecker.cc \
 	talk/p2p/client/httpportallocator.cc \
 	talk/p2p/client/socketmonitor.cc \
 	talk/session/tunnel/pseudotcpchannel.cc \
+	talk/session/tunnel/tunnelmux.cc \
 	talk/session/tunnel/tunnelsessionclient.cc \
 	talk/session/tunnel/securetunnelsessionclient.cc \
 	talk/session/media/audiomonitor.cc \
@@ -206,6 +215,7 @@ LOCAL_P2P_SRC := \
 	talk/session/media/mediarecorder.cc \
 	talk/session/media/mediasession.cc \
 	talk/session/media/mediasessionclient.cc \
+	talk/session/media/pacedsender.cc \
 	talk/session/media/rtcpmuxfilter.cc \
 	talk/session/media/soundclip.cc \
 	talk/session/media/srtpfilter.cc \
@@ -195,6 +195,7 @@
         'talk/base/asynctcpsocket.h',
         'talk/base/asyncudpsocket.cc',
         'talk/base/asyncudpsocket.h',
+        'talk/base/atomicops.h',
         'talk/base/autodetectproxy.cc',
         'talk/base/autodetectproxy.h',
         'talk/base/base64.cc',
@@ -202,6 +203,8 @@
         'talk/base/basicdefs.h',
         'talk/base/basicpacketsocketfactory.cc',
         'talk/base/basicpacketsocketfactory.h',
+        'talk/base/bufferpool.cc',
+        'talk/base/bufferpool.h',
         'talk/base/bytebuffer.cc',
         'talk/base/bytebuffer.h',
         'talk/base/byteorder.h',
@@ -223,6 +226,7 @@
         'talk/base/firewallsocketserver.h',
         'talk/base/flags.cc',
         'talk/base/flags.h',
+        'talk/base/flathashmap.h',
         'talk/base/helpers.cc',
         'talk/base/helpers.h',
         'talk/base/host.cc',
@@ -289,6 +293,12 @@
         'talk/base/socketstream.h',
         'talk/base/ssladapter.cc',
         'talk/base/ssladapter.h',
+        'talk/base/sslhandshakepool.cc',
+        'talk/base/sslhandshakepool.h',
+        'talk/base/sslidentitypool.cc',
+        'talk/base/sslidentitypool.h',
+        'talk/base/sslsessioncache.cc',
+        'talk/base/sslsessioncache.h',
         'talk/base/sslsocketfactory.cc',
         'talk/base/sslsocketfactory.h',
         'talk/base/sslstreamadapter.cc',
@@ -307,6 +317,8 @@
         'talk/base/taskrunner.h',
         'talk/base/thread.cc',
         'talk/base/thread.h',
+        'talk/base/timerwheel.cc',
+        'talk/base/timerwheel.h',
         'talk/base/timeutils.cc',
         'talk/base/timeutils.h',
         'talk/base/timing.cc',
@@ -383,6 +395,8 @@
             'talk/base/latebindingsymboltable.h',
             'talk/base/linux.cc',
             'talk/base/linux.h',
+            'talk/base/linuxnetworkmonitor.cc',
+            'talk/base/linuxnetworkmonitor.h',
           ],
         }],
         ['OS=="mac"', {
@@ -472,6 +486,8 @@
         'talk/p2p/base/portproxy.h',
         'talk/p2p/base/pseudotcp.cc',
         'talk/p2p/base/pseudotcp.h',
+        'talk/p2p/base/pseudotcpcongestion.cc',
+        'talk/p2p/base/pseudotcpcongestion.h',
         'talk/p2p/base/rawtransport.cc',
         'talk/p2p/base/rawtransport.h',
         'talk/p2p/base/rawtransportchannel.cc',
@@ -509,6 +525,8 @@
         'talk/p2p/base/transportchannelproxy.h',
         'talk/p2p/base/transportdescriptionfactory.cc',
         'talk/p2p/base/transportdescriptionfactory.h',
+        'talk/p2p/base/udpportmux.cc',
+        'talk/p2p/base/udpportmux.h',
         'talk/p2p/client/basicportallocator.cc',
         'talk/p2p/client/basicportallocator.h',
         'talk/p2p/client/httpportallocator.cc',
@@ -519,6 +537,8 @@
         'talk/p2p/client/socketmonitor.h',
         'talk/session/tunnel/pseudotcpchannel.cc',
         'talk/session/tunnel/pseudotcpchannel.h',
+        'talk/session/tunnel/tunnelmux.cc',
+        'talk/session/tunnel/tunnelmux.h',
         'talk/session/tunnel/tunnelsessionclient.cc',
         'talk/session/tunnel/tunnelsessionclient.h',
       ],
@@ -625,6 +645,9 @@
         'talk/session/media/mediasessionclient.cc',
         'talk/session/media/mediasessionclient.h',
         'talk/session/media/mediasink.h',
+        'talk/session/media/pacedsender.cc',
+        'talk/session/media/pacedsender.h',
+        'talk/session/media/packetbufferpool.h',
         'talk/session/media/rtcpmuxfilter.cc',
         'talk/session/media/rtcpmuxfilter.h',
         'talk/session/media/soundclip.cc',
@@ -727,6 +750,9 @@
         'talk/session/media/mediasessionclient.cc',
         'talk/session/media/mediasessionclient.h',
         'talk/session/media/mediasink.h',
+        'talk/session/media/pacedsender.cc',
+        'talk/session/media/pacedsender.h',
+        'talk/session/media/packetbufferpool.h',
         'talk/session/media/rtcpmuxfilter.cc',
         'talk/session/media/rtcpmuxfilter.h',
         'talk/session/media/soundclip.cc',
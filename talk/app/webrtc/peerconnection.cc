@@ -230,6 +230,23 @@ bool CanAddLocalMediaStream(webrtc::StreamCollectionInterface* current_streams,
   return true;
 }
 
+// Returns the value of constraint |key|, mandatory before optional, or "" if
+// it isn't set.
+std::string GetConstraint(const webrtc::MediaConstraintsInterface* constraints,
+                          const std::string& key) {
+  if (!constraints)
+    return std::string();
+  const webrtc::MediaConstraintsInterface::Constraints* lists[] = {
+      &constraints->GetMandatory(), &constraints->GetOptional() };
+  for (size_t i = 0; i < ARRAY_SIZE(lists); ++i) {
+    for (size_t j = 0; j < lists[i]->size(); ++j) {
+      if ((*lists[i])[j].key == key)
+        return (*lists[i])[j].value;
+    }
+  }
+  return std::string();
+}
+
 }  // namespace
 
 namespace webrtc {
@@ -291,6 +308,12 @@ bool PeerConnection::DoInitialize(
   stream_handler_.reset(new MediaStreamHandlers(session_.get(),
                                                 session_.get()));
   stats_.set_session(session_.get());
+  // Only sessions that use DTLS need an identity, so don't have the factory
+  // start its pool for the others.
+  if (GetConstraint(constraints, MediaConstraintsInterface::kEnableDtlsSrtp) ==
+      MediaConstraintsInterface::kValueTrue) {
+    session_->set_identity_pool(factory_->identity_pool());
+  }
 
   // Initialize the WebRtcSession. It creates transport channels etc.
   if (!session_->Initialize(constraints))
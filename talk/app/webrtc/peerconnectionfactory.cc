@@ -46,6 +46,9 @@ using talk_base::scoped_refptr;
 
 namespace {
 
+// Number of DTLS identities kept ready for new peer connections.
+const size_t kIdentityPoolDepth = 1;
+
 typedef talk_base::TypedMessageData<bool> InitMessageData;
 
 struct CreatePeerConnectionParams : public talk_base::MessageData {
@@ -242,6 +245,7 @@ bool PeerConnectionFactory::Initialize_s() {
 
 // Terminate what we created on the signaling thread.
 void PeerConnectionFactory::Terminate_s() {
+  identity_pool_.reset(NULL);
   channel_manager_.reset(NULL);
   allocator_factory_ = NULL;
 }
@@ -349,6 +353,17 @@ cricket::ChannelManager* PeerConnectionFactory::channel_manager() {
   return channel_manager_.get();
 }
 
+talk_base::SSLIdentityPool* PeerConnectionFactory::identity_pool() {
+  ASSERT(signaling_thread_->IsCurrent());
+  // Created on first use, so that factories whose peer connections never use
+  // DTLS don't pay for the pool's thread and key generation.
+  if (!identity_pool_) {
+    identity_pool_.reset(new talk_base::SSLIdentityPool(
+        kWebRTCIdentityPrefix, talk_base::KT_RSA, kIdentityPoolDepth));
+  }
+  return identity_pool_.get();
+}
+
 talk_base::Thread* PeerConnectionFactory::signaling_thread() {
   return signaling_thread_;
 }
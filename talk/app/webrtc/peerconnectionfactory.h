@@ -32,6 +32,7 @@
 #include "talk/app/webrtc/mediastreaminterface.h"
 #include "talk/app/webrtc/peerconnectioninterface.h"
 #include "talk/base/scoped_ptr.h"
+#include "talk/base/sslidentitypool.h"
 #include "talk/base/thread.h"
 #include "talk/session/media/channelmanager.h"
 
@@ -73,6 +74,10 @@ class PeerConnectionFactory : public PeerConnectionFactoryInterface,
                        AudioSourceInterface* audio_source);
 
   virtual cricket::ChannelManager* channel_manager();
+  // Identities for the peer connections that use DTLS, generated ahead of
+  // time. Created when first asked for, on the signaling thread. May be
+  // reconfigured, for example to use ECDSA keys.
+  virtual talk_base::SSLIdentityPool* identity_pool();
   virtual talk_base::Thread* signaling_thread();
   virtual talk_base::Thread* worker_thread();
 
@@ -109,6 +114,7 @@ class PeerConnectionFactory : public PeerConnectionFactoryInterface,
   // External Audio device used for audio playback.
   talk_base::scoped_refptr<AudioDeviceModule> default_adm_;
   talk_base::scoped_ptr<cricket::ChannelManager> channel_manager_;
+  talk_base::scoped_ptr<talk_base::SSLIdentityPool> identity_pool_;
   // External Video decoder factory. This can be NULL if the client has not
   // injected any. In that case, video engine will use the internal SW decoder.
   talk_base::scoped_ptr<cricket::WebRtcVideoDecoderFactory>
@@ -37,6 +37,7 @@
 #include "talk/app/webrtc/peerconnectioninterface.h"
 #include "talk/base/helpers.h"
 #include "talk/base/logging.h"
+#include "talk/base/sslidentitypool.h"
 #include "talk/base/stringencode.h"
 #include "talk/media/base/videocapturer.h"
 #include "talk/session/media/channel.h"
@@ -411,6 +412,7 @@ WebRtcSession::WebRtcSession(cricket::ChannelManager* channel_manager,
                            cricket::NS_JINGLE_RTP, false),
       channel_manager_(channel_manager),
       session_desc_factory_(channel_manager, &transport_desc_factory_),
+      identity_pool_(NULL),
       mediastream_signaling_(mediastream_signaling),
       ice_observer_(NULL),
       ice_connection_state_(PeerConnectionInterface::kIceConnectionNew),
@@ -456,12 +458,17 @@ bool WebRtcSession::Initialize(const MediaConstraintsInterface* constraints) {
   std::string value;
   if (FindConstraint(constraints, MediaConstraintsInterface::kEnableDtlsSrtp,
       &value, NULL) && value == MediaConstraintsInterface::kValueTrue) {
-    LOG(LS_INFO) << "DTLS-SRTP enabled; generating identity";
-    std::string identity_name = kWebRTCIdentityPrefix +
-        talk_base::ToString(talk_base::CreateRandomId());
-    transport_desc_factory_.set_identity(talk_base::SSLIdentity::Generate(
-        identity_name));
+    if (identity_pool_) {
+      LOG(LS_INFO) << "DTLS-SRTP enabled; taking identity from pool";
+      dtls_identity_.reset(identity_pool_->Take());
+    } else {
+      LOG(LS_INFO) << "DTLS-SRTP enabled; generating identity";
+      std::string identity_name = kWebRTCIdentityPrefix +
+          talk_base::ToString(talk_base::CreateRandomId());
+      dtls_identity_.reset(talk_base::SSLIdentity::Generate(identity_name));
+    }
     LOG(LS_INFO) << "Finished generating identity";
+    transport_desc_factory_.set_identity(dtls_identity_.get());
     set_identity(transport_desc_factory_.identity());
     transport_desc_factory_.set_digest_algorithm(talk_base::DIGEST_SHA_256);
 
@@ -55,6 +55,11 @@ class VoiceChannel;
 
 }  // namespace cricket
 
+namespace talk_base {
+class SSLIdentity;
+class SSLIdentityPool;
+}  // namespace talk_base
+
 namespace webrtc {
 
 class IceRestartAnswerLatch;
@@ -67,6 +72,8 @@ extern const char kMlineMismatch[];
 extern const char kSdpWithoutCrypto[];
 extern const char kSessionError[];
 extern const char kUpdateStateFailed[];
+// Prefix of the names of the DTLS identities that sessions use.
+extern const char kWebRTCIdentityPrefix[];
 
 // ICE state callback interface.
 class IceObserver {
@@ -101,6 +108,13 @@ class WebRtcSession : public cricket::BaseSession,
                 MediaStreamSignaling* mediastream_signaling);
   virtual ~WebRtcSession();
 
+  // Takes the DTLS identity from |pool| rather than generating one, which
+  // saves Initialize() the time it takes to generate it. Must be called
+  // before Initialize().
+  void set_identity_pool(talk_base::SSLIdentityPool* pool) {
+    identity_pool_ = pool;
+  }
+
   bool Initialize(const MediaConstraintsInterface* constraints);
   // Deletes the voice, video and data channel and changes the session state
   // to STATE_RECEIVEDTERMINATE.
@@ -259,6 +273,8 @@ class WebRtcSession : public cricket::BaseSession,
   cricket::ChannelManager* channel_manager_;
   cricket::TransportDescriptionFactory transport_desc_factory_;
   cricket::MediaSessionDescriptionFactory session_desc_factory_;
+  talk_base::SSLIdentityPool* identity_pool_;
+  talk_base::scoped_ptr<talk_base::SSLIdentity> dtls_identity_;
   MediaStreamSignaling* mediastream_signaling_;
   IceObserver* ice_observer_;
   PeerConnectionInterface::IceConnectionState ice_connection_state_;
@@ -39,6 +39,7 @@
 #include "talk/base/logging.h"
 #include "talk/base/network.h"
 #include "talk/base/physicalsocketserver.h"
+#include "talk/base/sslidentitypool.h"
 #include "talk/base/sslstreamadapter.h"
 #include "talk/base/stringutils.h"
 #include "talk/base/thread.h"
@@ -81,6 +82,7 @@ using webrtc::kMlineMismatch;
 using webrtc::kSdpWithoutCrypto;
 using webrtc::kSessionError;
 using webrtc::kUpdateStateFailed;
+using webrtc::kWebRTCIdentityPrefix;
 
 static const SocketAddress kClientAddr1("11.11.11.11", 0);
 static const SocketAddress kClientAddr2("22.22.22.22", 0);
@@ -309,13 +311,14 @@ class WebRtcSessionTest : public testing::Test {
     network_manager_.AddInterface(addr);
   }
 
-  void Init() {
+  void Init(talk_base::SSLIdentityPool* identity_pool = NULL) {
     ASSERT_TRUE(session_.get() == NULL);
     session_.reset(new WebRtcSessionForTest(
         channel_manager_.get(), talk_base::Thread::Current(),
         talk_base::Thread::Current(), &allocator_,
         &observer_,
         &mediastream_signaling_));
+    session_->set_identity_pool(identity_pool);
 
     EXPECT_EQ(PeerConnectionInterface::kIceConnectionNew,
         observer_.ice_connection_state_);
@@ -333,13 +336,13 @@ class WebRtcSessionTest : public testing::Test {
     Init();
   }
 
-  void InitWithDtls() {
+  void InitWithDtls(talk_base::SSLIdentityPool* identity_pool = NULL) {
     constraints_.reset(new FakeConstraints());
     constraints_->AddOptional(
         webrtc::MediaConstraintsInterface::kEnableDtlsSrtp,
         webrtc::MediaConstraintsInterface::kValueTrue);
 
-    Init();
+    Init(identity_pool);
   }
 
   // Creates a local offer and applies it. Starts ice.
@@ -1008,6 +1011,40 @@ TEST_F(WebRtcSessionTest, CreateSetDtlsOffer) {
   SetLocalDescriptionWithoutError(offer);
 }
 
+static size_t ReadyIdentities(talk_base::SSLIdentityPool* pool) {
+  talk_base::SSLIdentityPoolStats stats;
+  pool->GetStats(&stats);
+  return stats.ready;
+}
+
+// Logs the time from creating a session with DTLS to having its first offer,
+// with the identity generated on the spot and with it taken from a pool.
+TEST_F(WebRtcSessionTest, TimeToFirstDtlsOffer) {
+  MAYBE_SKIP_TEST(talk_base::SSLStreamAdapter::HaveDtlsSrtp);
+  mediastream_signaling_.SendAudioVideoStream1();
+  talk_base::SSLIdentityPool pool(kWebRTCIdentityPrefix, talk_base::KT_RSA, 1);
+  for (int i = 0; i < 2; ++i) {
+    bool use_pool = (i == 1);
+    if (use_pool) {
+      EXPECT_EQ_WAIT(1U, ReadyIdentities(&pool), 10000);
+    }
+    uint32 start = talk_base::Time();
+    InitWithDtls(use_pool ? &pool : NULL);
+    talk_base::scoped_ptr<SessionDescriptionInterface> offer(
+        session_->CreateOffer(NULL));
+    uint32 elapsed = talk_base::TimeSince(start);
+    ASSERT_TRUE(offer.get() != NULL);
+    VerifyFingerprintStatus(offer->description(), true);
+    LOG(LS_INFO) << (use_pool ? "Identity from pool: " : "Identity generated: ")
+                 << "first offer after " << elapsed << " ms";
+    session_.reset();
+  }
+  talk_base::SSLIdentityPoolStats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(1U, stats.hits);
+  EXPECT_EQ(0U, stats.misses);
+}
+
 // Test that we can process an offer with a DTLS fingerprint
 // and that we return an answer with a fingerprint.
 TEST_F(WebRtcSessionTest, ReceiveDtlsOfferCreateAnswer) {
@@ -59,6 +59,14 @@ class AsyncPacketSocket : public sigslot::has_slots<> {
   virtual int Send(const void *pv, size_t cb) = 0;
   virtual int SendTo(const void *pv, size_t cb, const SocketAddress& addr) = 0;
 
+  // Send batching. Between BeginSendBatch() and EndSendBatch(), sockets that
+  // support it may queue datagrams passed to SendTo() and write them all with
+  // a single system call when the batch ends. Errors for queued datagrams are
+  // not reported to the caller. Calls may be nested; sockets that don't batch
+  // send immediately.
+  virtual void BeginSendBatch() {}
+  virtual void EndSendBatch() {}
+
   // Close the socket.
   virtual int Close() = 0;
 
@@ -48,6 +48,10 @@ static const size_t BUF_SIZE = MAX_PACKET_SIZE + PKT_LEN_SIZE;
 
 static const int LISTEN_BACKLOG = 5;
 
+// Once less than this much room is left at the end of the input buffer, the
+// partial packet in it is moved to the front before the next read.
+static const size_t MIN_RECV_SPACE = BUF_SIZE / 4;
+
 // Binds and connects |socket| and creates AsyncTCPSocket for
 // it. Takes ownership of |socket|. Returns NULL if bind() or
 // connect() fail (|socket| is destroyed in that case).
@@ -71,8 +75,10 @@ AsyncTCPSocket::AsyncTCPSocket(AsyncSocket* socket, bool listen)
     : socket_(socket),
       listen_(listen),
       insize_(BUF_SIZE),
+      inhead_(0),
       inpos_(0),
       outsize_(BUF_SIZE),
+      outhead_(0),
       outpos_(0) {
   inbuf_ = new char[insize_];
   outbuf_ = new char[outsize_];
@@ -114,17 +120,29 @@ int AsyncTCPSocket::Send(const void *pv, size_t cb) {
     return static_cast<int>(cb);
 
   PacketLength pkt_len = HostToNetwork16(static_cast<PacketLength>(cb));
-  memcpy(outbuf_, &pkt_len, PKT_LEN_SIZE);
-  memcpy(outbuf_ + PKT_LEN_SIZE, pv, cb);
-  outpos_ = PKT_LEN_SIZE + cb;
-
-  int res = Flush();
+  IoBuffer buffers[2];
+  buffers[0] = IoBuffer(&pkt_len, PKT_LEN_SIZE);
+  buffers[1] = IoBuffer(pv, cb);
+  int res = socket_->SendV(buffers, ARRAY_SIZE(buffers));
   if (res <= 0) {
     // drop packet if we made no progress
-    outpos_ = 0;
     return res;
   }
 
+  // Keep what the socket didn't take, to be flushed on the next write event.
+  size_t sent = static_cast<size_t>(res);
+  if (sent < PKT_LEN_SIZE) {
+    memcpy(outbuf_, reinterpret_cast<const char*>(&pkt_len) + sent,
+           PKT_LEN_SIZE - sent);
+    outpos_ = PKT_LEN_SIZE - sent;
+    sent = PKT_LEN_SIZE;
+  }
+  if (sent < PKT_LEN_SIZE + cb) {
+    size_t left = PKT_LEN_SIZE + cb - sent;
+    memcpy(outbuf_ + outpos_, static_cast<const char*>(pv) + cb - left, left);
+    outpos_ += left;
+  }
+
   // We claim to have sent the whole thing, even if we only sent partial
   return static_cast<int>(cb);
 }
@@ -178,6 +196,11 @@ void AsyncTCPSocket::SetError(int error) {
 }
 
 int AsyncTCPSocket::SendRaw(const void * pv, size_t cb) {
+  if (outhead_ > 0 && outpos_ + cb > outsize_) {
+    memmove(outbuf_, outbuf_ + outhead_, outpos_ - outhead_);
+    outpos_ -= outhead_;
+    outhead_ = 0;
+  }
   if (outpos_ + cb > outsize_) {
     socket_->SetError(EMSGSIZE);
     return -1;
@@ -189,42 +212,37 @@ int AsyncTCPSocket::SendRaw(const void * pv, size_t cb) {
   return Flush();
 }
 
-void AsyncTCPSocket::ProcessInput(char * data, size_t& len) {
+size_t AsyncTCPSocket::ProcessInput(char * data, size_t len) {
   SocketAddress remote_addr(GetRemoteAddress());
 
-  while (true) {
-    if (len < PKT_LEN_SIZE)
-      return;
-
+  size_t pos = 0;
+  while (len - pos >= PKT_LEN_SIZE) {
     PacketLength pkt_len;
-    memcpy(&pkt_len, data, PKT_LEN_SIZE);
+    memcpy(&pkt_len, data + pos, PKT_LEN_SIZE);
     pkt_len = NetworkToHost16(pkt_len);
 
-    if (len < PKT_LEN_SIZE + pkt_len)
-      return;
-
-    SignalReadPacket(this, data + PKT_LEN_SIZE, pkt_len, remote_addr);
+    if (len - pos < PKT_LEN_SIZE + pkt_len)
+      break;
 
-    len -= PKT_LEN_SIZE + pkt_len;
-    if (len > 0) {
-      memmove(data, data + PKT_LEN_SIZE + pkt_len, len);
-    }
+    SignalReadPacket(this, data + pos + PKT_LEN_SIZE, pkt_len, remote_addr);
+    pos += PKT_LEN_SIZE + pkt_len;
   }
+  return pos;
 }
 
 int AsyncTCPSocket::Flush() {
-  int res = socket_->Send(outbuf_, outpos_);
+  int res = socket_->Send(outbuf_ + outhead_, outpos_ - outhead_);
   if (res <= 0) {
     return res;
   }
-  if (static_cast<size_t>(res) <= outpos_) {
-    outpos_ -= res;
+  if (static_cast<size_t>(res) <= outpos_ - outhead_) {
+    outhead_ += res;
   } else {
     ASSERT(false);
     return -1;
   }
-  if (outpos_ > 0) {
-    memmove(outbuf_, outbuf_ + res, outpos_);
+  if (outhead_ == outpos_) {
+    outhead_ = outpos_ = 0;
   }
   return res;
 }
@@ -251,6 +269,21 @@ void AsyncTCPSocket::OnReadEvent(AsyncSocket* socket) {
     // Prime a read event in case data is waiting.
     new_socket->SignalReadEvent(new_socket);
   } else {
+    // Move the partial packet left from the last read to the front only if
+    // the rest of it won't fit behind it, or little room is left there.
+    size_t needed = PKT_LEN_SIZE;
+    if (inpos_ - inhead_ >= PKT_LEN_SIZE) {
+      PacketLength pkt_len;
+      memcpy(&pkt_len, inbuf_ + inhead_, PKT_LEN_SIZE);
+      needed += NetworkToHost16(pkt_len);
+    }
+    if (inhead_ > 0 && (inhead_ + needed > insize_ ||
+                        insize_ - inpos_ < MIN_RECV_SPACE)) {
+      memmove(inbuf_, inbuf_ + inhead_, inpos_ - inhead_);
+      inpos_ -= inhead_;
+      inhead_ = 0;
+    }
+
     int len = socket_->Recv(inbuf_ + inpos_, insize_ - inpos_);
     if (len < 0) {
       // TODO: Do something better like forwarding the error to the user.
@@ -262,12 +295,15 @@ void AsyncTCPSocket::OnReadEvent(AsyncSocket* socket) {
 
     inpos_ += len;
 
-    ProcessInput(inbuf_, inpos_);
+    inhead_ += ProcessInput(inbuf_ + inhead_, inpos_ - inhead_);
+    if (inhead_ == inpos_) {
+      inhead_ = inpos_ = 0;
+    }
 
-    if (inpos_ >= insize_) {
+    if (inpos_ - inhead_ >= insize_) {
       LOG(LS_ERROR) << "input buffer overflow";
       ASSERT(false);
-      inpos_ = 0;
+      inhead_ = inpos_ = 0;
     }
   }
 }
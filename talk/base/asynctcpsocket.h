@@ -37,6 +37,11 @@ namespace talk_base {
 // Simulates UDP semantics over TCP.  Send and Recv packet sizes
 // are preserved, and drops packets silently on Send, rather than
 // buffer them in user space.
+// Packets are written together with their length prefix in one gathered
+// send, and only what the socket doesn't take is copied aside. Received
+// packets are handed out straight from the input buffer; the remains of a
+// partial packet are moved to the front only when the space behind them
+// runs low.
 class AsyncTCPSocket : public AsyncPacketSocket {
  public:
   // Binds and connects |socket| and creates AsyncTCPSocket for
@@ -62,7 +67,9 @@ class AsyncTCPSocket : public AsyncPacketSocket {
 
  protected:
   int SendRaw(const void* pv, size_t cb);
-  virtual void ProcessInput(char* data, size_t& len);
+  // Signals the complete packets in |data| and returns the number of bytes
+  // they took up.
+  virtual size_t ProcessInput(char* data, size_t len);
 
  private:
   int Flush();
@@ -76,7 +83,9 @@ class AsyncTCPSocket : public AsyncPacketSocket {
   scoped_ptr<AsyncSocket> socket_;
   bool listen_;
   char* inbuf_, * outbuf_;
-  size_t insize_, inpos_, outsize_, outpos_;
+  // Unprocessed input is inbuf_[inhead_, inpos_), unsent output is
+  // outbuf_[outhead_, outpos_).
+  size_t insize_, inhead_, inpos_, outsize_, outhead_, outpos_;
 
   DISALLOW_EVIL_CONSTRUCTORS(AsyncTCPSocket);
 };
@@ -0,0 +1,205 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+#include <vector>
+
+#include "talk/base/asynctcpsocket.h"
+#include "talk/base/byteorder.h"
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/physicalsocketserver.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+
+namespace talk_base {
+
+static const int kTimeout = 5000;
+
+// Builds a packet of |size| bytes whose contents depend on |index|.
+static std::string MakePacket(size_t index, size_t size) {
+  std::string packet(size, 0);
+  for (size_t i = 0; i < size; ++i) {
+    packet[i] = static_cast<char>(index + i);
+  }
+  return packet;
+}
+
+class AsyncTCPSocketTest : public testing::Test, public sigslot::has_slots<> {
+ public:
+  AsyncTCPSocketTest()
+      : ss_(Thread::Current()->socketserver()),
+        received_count_(0),
+        received_bytes_(0) {
+  }
+
+  virtual void SetUp() {
+    listener_.reset(ss_->CreateAsyncSocket(AF_INET, SOCK_STREAM));
+    ASSERT_EQ(0, listener_->Bind(SocketAddress("127.0.0.1", 0)));
+    ASSERT_EQ(0, listener_->Listen(5));
+  }
+
+  // Connects a plain stream socket to |listener_| and returns both ends.
+  void Connect(AsyncSocket** client, AsyncSocket** server) {
+    *client = ss_->CreateAsyncSocket(AF_INET, SOCK_STREAM);
+    ASSERT_EQ(0, (*client)->Bind(SocketAddress("127.0.0.1", 0)));
+    (*client)->Connect(listener_->GetLocalAddress());
+    SocketAddress addr;
+    *server = NULL;
+    ASSERT_TRUE_WAIT((*server = listener_->Accept(&addr)) != NULL, kTimeout);
+    EXPECT_EQ_WAIT(Socket::CS_CONNECTED, (*client)->GetState(), kTimeout);
+  }
+
+  // Writes all of |data| to |socket|, |chunk| bytes at a time.
+  void WriteAll(AsyncSocket* socket, const std::string& data, size_t chunk) {
+    size_t pos = 0;
+    uint32 start = Time();
+    while (pos < data.size() && TimeSince(start) < kTimeout) {
+      int sent = socket->Send(data.data() + pos,
+                              std::min(chunk, data.size() - pos));
+      if (sent > 0) {
+        pos += sent;
+      } else {
+        Thread::Current()->ProcessMessages(1);
+      }
+    }
+    EXPECT_EQ(data.size(), pos);
+  }
+
+  void ListenForPackets(AsyncPacketSocket* socket) {
+    socket->SignalReadPacket.connect(this, &AsyncTCPSocketTest::OnReadPacket);
+  }
+
+  void OnReadPacket(AsyncPacketSocket* socket, const char* data, size_t len,
+                    const SocketAddress& remote_addr) {
+    received_.push_back(std::string(data, len));
+    ++received_count_;
+    received_bytes_ += len;
+  }
+
+ protected:
+  SocketServer* ss_;
+  scoped_ptr<AsyncSocket> listener_;
+  std::vector<std::string> received_;
+  size_t received_count_;
+  size_t received_bytes_;
+};
+
+// Sends a mix of small and maximum size packets, framed, in odd sized pieces,
+// so that packets and length prefixes straddle reads.
+TEST_F(AsyncTCPSocketTest, ReceivesPacketsSplitAcrossReads) {
+  AsyncSocket* client;
+  AsyncSocket* server;
+  Connect(&client, &server);
+  scoped_ptr<AsyncSocket> sender(client);
+  AsyncTCPSocket receiver(server, false);
+  ListenForPackets(&receiver);
+
+  std::vector<std::string> packets;
+  std::string stream;
+  for (size_t i = 0; i < 60; ++i) {
+    size_t size = (i % 5 == 0) ? 65535 - i : (i * 617) % 3000;
+    packets.push_back(MakePacket(i, size));
+    char len[2];
+    SetBE16(len, static_cast<uint16>(size));
+    stream.append(len, sizeof(len));
+    stream.append(packets.back());
+  }
+  WriteAll(sender.get(), stream, 1013);
+  ASSERT_EQ_WAIT(packets.size(), received_.size(), kTimeout);
+  for (size_t i = 0; i < packets.size(); ++i) {
+    EXPECT_TRUE(packets[i] == received_[i]) << "packet " << i;
+  }
+}
+
+// Checks that header and payload go out together and in order.
+TEST_F(AsyncTCPSocketTest, SendsFramedPackets) {
+  AsyncSocket* client;
+  AsyncSocket* server;
+  Connect(&client, &server);
+  AsyncTCPSocket sender(client, false);
+  scoped_ptr<AsyncSocket> receiver(server);
+
+  std::string expected;
+  for (size_t i = 0; i < 20; ++i) {
+    std::string packet = MakePacket(i, i * 100);
+    EXPECT_EQ(static_cast<int>(packet.size()),
+              sender.Send(packet.data(), packet.size()));
+    char len[2];
+    SetBE16(len, static_cast<uint16>(packet.size()));
+    expected.append(len, sizeof(len));
+    expected.append(packet);
+  }
+
+  std::string stream;
+  char buf[4096];
+  uint32 start = Time();
+  while (stream.size() < expected.size() && TimeSince(start) < kTimeout) {
+    int len = receiver->Recv(buf, sizeof(buf));
+    if (len > 0) {
+      stream.append(buf, len);
+    } else {
+      Thread::Current()->ProcessMessages(1);
+    }
+  }
+  EXPECT_TRUE(expected == stream);
+}
+
+// Logs how many framed packets per second go through a pair of
+// AsyncTCPSockets over loopback.
+TEST_F(AsyncTCPSocketTest, LoopbackThroughput) {
+  static const size_t kPacketSize = 200;
+  static const size_t kNumPackets = 200000;
+  static const size_t kBurst = 1000;
+  AsyncSocket* client;
+  AsyncSocket* server;
+  Connect(&client, &server);
+  AsyncTCPSocket sender(client, false);
+  AsyncTCPSocket receiver(server, false);
+  ListenForPackets(&receiver);
+
+  std::string packet = MakePacket(0, kPacketSize);
+  uint32 start = Time();
+  for (size_t sent = 0; sent < kNumPackets; sent += kBurst) {
+    for (size_t i = 0; i < kBurst; ++i) {
+      sender.Send(packet.data(), packet.size());
+    }
+    // Let the receiver catch up so the sender never has to drop.
+    EXPECT_EQ_WAIT(sent + kBurst, received_count_, kTimeout);
+    received_.clear();
+  }
+  uint32 elapsed = TimeSince(start);
+  size_t total = (kNumPackets + kBurst - 1) / kBurst * kBurst;
+  EXPECT_EQ(total * kPacketSize, received_bytes_);
+  LOG(LS_INFO) << total << " packets of " << kPacketSize << " bytes in "
+               << elapsed << " ms, "
+               << total * 1000 / std::max<uint32>(elapsed, 1)
+               << " packets/s";
+}
+
+}  // namespace talk_base
@@ -31,6 +31,10 @@
 namespace talk_base {
 
 static const int BUF_SIZE = 64 * 1024;
+static const int kMaxRecvBatch = 32;
+// Queued datagrams are flushed once this many are waiting.
+static const size_t kMaxSendBatch = 32;
+static const size_t kSendBufferReserve = kMaxSendBatch * 1500;
 
 AsyncUDPSocket* AsyncUDPSocket::Create(
     AsyncSocket* socket,
@@ -53,7 +57,10 @@ AsyncUDPSocket* AsyncUDPSocket::Create(SocketFactory* factory,
 }
 
 AsyncUDPSocket::AsyncUDPSocket(AsyncSocket* socket)
-    : socket_(socket) {
+    : socket_(socket),
+      recv_batch_(1),
+      send_batch_depth_(0),
+      destroyed_(NULL) {
   ASSERT(socket_);
   size_ = BUF_SIZE;
   buf_ = new char[size_];
@@ -63,6 +70,9 @@ AsyncUDPSocket::AsyncUDPSocket(AsyncSocket* socket)
 }
 
 AsyncUDPSocket::~AsyncUDPSocket() {
+  FlushSendQueue();
+  if (destroyed_)
+    *destroyed_ = true;
   delete [] buf_;
 }
 
@@ -75,15 +85,71 @@ SocketAddress AsyncUDPSocket::GetRemoteAddress() const {
 }
 
 int AsyncUDPSocket::Send(const void *pv, size_t cb) {
+  // Keep ordering with anything queued by SendTo.
+  FlushSendQueue();
   return socket_->Send(pv, cb);
 }
 
 int AsyncUDPSocket::SendTo(
     const void *pv, size_t cb, const SocketAddress& addr) {
-  return socket_->SendTo(pv, cb, addr);
+  if (send_batch_depth_ == 0)
+    return socket_->SendTo(pv, cb, addr);
+
+  if (send_buf_.capacity() == 0)
+    send_buf_.SetCapacity(kSendBufferReserve);
+  send_offsets_.push_back(send_buf_.length());
+  send_buf_.AppendData(pv, cb);
+  Datagram datagram;
+  datagram.size = cb;
+  datagram.addr = addr;
+  send_queue_.push_back(datagram);
+  if (send_queue_.size() >= kMaxSendBatch)
+    FlushSendQueue();
+  return static_cast<int>(cb);
+}
+
+void AsyncUDPSocket::BeginSendBatch() {
+  ++send_batch_depth_;
+}
+
+void AsyncUDPSocket::EndSendBatch() {
+  ASSERT(send_batch_depth_ > 0);
+  if (--send_batch_depth_ == 0)
+    FlushSendQueue();
+}
+
+void AsyncUDPSocket::FlushSendQueue() {
+  if (send_queue_.empty())
+    return;
+
+  // The buffer may have moved while the queue was filled.
+  for (size_t i = 0; i < send_queue_.size(); ++i)
+    send_queue_[i].data = send_buf_.data() + send_offsets_[i];
+
+  size_t sent = 0;
+  while (sent < send_queue_.size()) {
+    int n = socket_->SendToBatch(&send_queue_[sent],
+                                 send_queue_.size() - sent);
+    if (n < 0) {
+      if (socket_->IsBlocking()) {
+        // Drop the rest, as the kernel would if its buffer were full.
+        LOG(LS_VERBOSE) << "AsyncUDPSocket dropped "
+                        << send_queue_.size() - sent << " queued packets";
+        break;
+      }
+      // Skip the datagram that failed and carry on with the rest.
+      n = 1;
+    }
+    sent += n;
+  }
+
+  send_queue_.clear();
+  send_offsets_.clear();
+  send_buf_.SetLength(0);
 }
 
 int AsyncUDPSocket::Close() {
+  FlushSendQueue();
   return socket_->Close();
 }
 
@@ -92,10 +158,22 @@ AsyncUDPSocket::State AsyncUDPSocket::GetState() const {
 }
 
 int AsyncUDPSocket::GetOption(Socket::Option opt, int* value) {
+  if (opt == Socket::OPT_RECV_BATCH) {
+    *value = recv_batch_;
+    return 0;
+  }
   return socket_->GetOption(opt, value);
 }
 
 int AsyncUDPSocket::SetOption(Socket::Option opt, int value) {
+  if (opt == Socket::OPT_RECV_BATCH) {
+    if (value < 1 || value > kMaxRecvBatch)
+      return -1;
+    // The buffer is resized by the next read, since a handler may be
+    // changing this while the packet it was given still points into it.
+    recv_batch_ = value;
+    return 0;
+  }
   return socket_->SetOption(opt, value);
 }
 
@@ -110,6 +188,17 @@ void AsyncUDPSocket::SetError(int error) {
 void AsyncUDPSocket::OnReadEvent(AsyncSocket* socket) {
   ASSERT(socket_.get() == socket);
 
+  if (size_ != static_cast<size_t>(BUF_SIZE * recv_batch_)) {
+    delete [] buf_;
+    size_ = BUF_SIZE * recv_batch_;
+    buf_ = new char[size_];
+  }
+
+  if (recv_batch_ > 1) {
+    ReadBatch();
+    return;
+  }
+
   SocketAddress remote_addr;
   int len = socket_->RecvFrom(buf_, size_, &remote_addr);
   if (len < 0) {
@@ -128,4 +217,32 @@ void AsyncUDPSocket::OnReadEvent(AsyncSocket* socket) {
   SignalReadPacket(this, buf_, (size_t)len, remote_addr);
 }
 
+void AsyncUDPSocket::ReadBatch() {
+  Datagram datagrams[kMaxRecvBatch];
+  for (int i = 0; i < recv_batch_; ++i) {
+    datagrams[i].data = buf_ + i * BUF_SIZE;
+    datagrams[i].size = BUF_SIZE;
+  }
+  int count = socket_->RecvFromBatch(datagrams, recv_batch_);
+  if (count < 0) {
+    // See OnReadEvent.
+    SocketAddress local_addr = socket_->GetLocalAddress();
+    LOG(LS_INFO) << "AsyncUDPSocket[" << local_addr.ToString() << "] "
+                 << "receive failed with error " << socket_->GetError();
+    return;
+  }
+
+  bool destroyed = false;
+  destroyed_ = &destroyed;
+  BeginSendBatch();
+  for (int i = 0; i < count; ++i) {
+    SignalReadPacket(this, datagrams[i].data, datagrams[i].size,
+                     datagrams[i].addr);
+    if (destroyed)
+      return;
+  }
+  destroyed_ = NULL;
+  EndSendBatch();
+}
+
 }  // namespace talk_base
@@ -28,7 +28,10 @@
 #ifndef TALK_BASE_ASYNCUDPSOCKET_H_
 #define TALK_BASE_ASYNCUDPSOCKET_H_
 
+#include <vector>
+
 #include "talk/base/asyncpacketsocket.h"
+#include "talk/base/buffer.h"
 #include "talk/base/scoped_ptr.h"
 #include "talk/base/socketfactory.h"
 
@@ -36,6 +39,12 @@ namespace talk_base {
 
 // Provides the ability to receive packets asynchronously.  Sends are not
 // buffered since it is acceptable to drop packets under high load.
+//
+// Setting Socket::OPT_RECV_BATCH to N > 1 makes each read event drain up to
+// N datagrams with a single RecvFromBatch call (recvmmsg where available).
+// This costs N * 64KB of receive buffer, so it is meant for server sockets.
+// Replies sent on this socket while the batch is being signalled are
+// coalesced into one SendToBatch call.
 class AsyncUDPSocket : public AsyncPacketSocket {
  public:
   // Binds |socket| and creates AsyncUDPSocket for it. Takes ownership
@@ -54,6 +63,8 @@ class AsyncUDPSocket : public AsyncPacketSocket {
   virtual SocketAddress GetRemoteAddress() const;
   virtual int Send(const void *pv, size_t cb);
   virtual int SendTo(const void *pv, size_t cb, const SocketAddress& addr);
+  virtual void BeginSendBatch();
+  virtual void EndSendBatch();
   virtual int Close();
 
   virtual State GetState() const;
@@ -65,10 +76,20 @@ class AsyncUDPSocket : public AsyncPacketSocket {
  private:
   // Called when the underlying socket is ready to be read from.
   void OnReadEvent(AsyncSocket* socket);
+  void ReadBatch();
+  void FlushSendQueue();
 
   scoped_ptr<AsyncSocket> socket_;
   char* buf_;
   size_t size_;
+  int recv_batch_;
+  int send_batch_depth_;
+  Buffer send_buf_;
+  std::vector<Datagram> send_queue_;
+  std::vector<size_t> send_offsets_;
+  // Set while signalling a received batch, so that we notice if a handler
+  // deletes us.
+  bool* destroyed_;
 };
 
 }  // namespace talk_base
@@ -34,6 +34,9 @@
 #include "talk/base/common.h"
 #include "talk/base/logging.h"
 #include "talk/base/scoped_ptr.h"
+#ifdef WIN32
+#include "talk/base/win32.h"
+#endif
 
 namespace talk_base {
 
@@ -70,6 +73,26 @@ class FixedSizeLockFreeQueue {
         : "r" (ptr)
         : "cc", "memory");
   }
+#elif defined(WIN32)
+  typedef LONG Atomic32;
+
+  static inline void MemoryBarrier() {
+    ::MemoryBarrier();
+  }
+
+  static inline void AtomicIncrement(volatile Atomic32* ptr) {
+    ::InterlockedIncrement(ptr);
+  }
+#elif defined(__GNUC__)
+  typedef uint32 Atomic32;
+
+  static inline void MemoryBarrier() {
+    __sync_synchronize();
+  }
+
+  static inline void AtomicIncrement(volatile Atomic32* ptr) {
+    __sync_fetch_and_add(ptr, 1);
+  }
 #elif !defined(SKIP_ATOMIC_CHECK)
 #error "No atomic operations defined for the given architecture."
 #endif
@@ -118,6 +141,8 @@ class FixedSizeLockFreeQueue {
       return false;
     }
 
+    // Make sure the value is not read before the count that covers it.
+    MemoryBarrier();
     *value_out = data_[popped_count_ % capacity_];
     return true;
   }
@@ -127,6 +152,8 @@ class FixedSizeLockFreeQueue {
   // This method can be safely called at the same time as PushBack.
   bool PopFront(T* value_out) {
     if (PeekFront(value_out)) {
+      // Finish reading the value before the producer may overwrite it.
+      MemoryBarrier();
       AtomicIncrement(&popped_count_);
       return true;
     }
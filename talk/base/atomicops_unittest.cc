@@ -25,23 +25,11 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#if !defined(__arm__)
-// For testing purposes, define faked versions of the atomic operations
-#include "talk/base/basictypes.h"
-namespace talk_base {
-typedef uint32 Atomic32;
-static inline void MemoryBarrier() { }
-static inline void AtomicIncrement(volatile Atomic32* ptr) {
-  *ptr = *ptr + 1;
-}
-}
-#define SKIP_ATOMIC_CHECK
-#endif
-
 #include "talk/base/atomicops.h"
 #include "talk/base/gunit.h"
 #include "talk/base/helpers.h"
 #include "talk/base/logging.h"
+#include "talk/base/thread.h"
 
 TEST(FixedSizeLockFreeQueueTest, TestDefaultConstruct) {
   talk_base::FixedSizeLockFreeQueue<int> queue;
@@ -94,3 +82,39 @@ TEST(FixedSizeLockFreeQueueTest, TestResize) {
   int val;
   EXPECT_FALSE(queue.PopFront(&val));
 }
+
+// Pushes the integers [0, count) onto a queue from its own thread.
+class QueueProducer : public talk_base::Runnable {
+ public:
+  QueueProducer(talk_base::FixedSizeLockFreeQueue<int>* queue, int count)
+      : queue_(queue), count_(count) {}
+  virtual void Run(talk_base::Thread* thread) {
+    for (int i = 0; i < count_; ) {
+      if (queue_->PushBack(i)) {
+        ++i;
+      }
+    }
+  }
+
+ private:
+  talk_base::FixedSizeLockFreeQueue<int>* queue_;
+  int count_;
+};
+
+TEST(FixedSizeLockFreeQueueTest, TestConcurrentPushPop) {
+  const int kCount = 10000;
+  talk_base::FixedSizeLockFreeQueue<int> queue(64);
+  QueueProducer producer(&queue, kCount);
+  talk_base::Thread thread;
+  thread.Start(&producer);
+  int expected = 0;
+  while (expected < kCount) {
+    int val;
+    if (queue.PopFront(&val)) {
+      ASSERT_EQ(expected, val);
+      ++expected;
+    }
+  }
+  thread.Stop();
+  EXPECT_EQ(0u, queue.Size());
+}
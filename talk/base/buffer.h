@@ -30,6 +30,7 @@
 
 #include <cstring>
 
+#include "talk/base/bufferpool.h"
 #include "talk/base/scoped_ptr.h"
 
 namespace talk_base {
@@ -38,34 +39,52 @@ namespace talk_base {
 // Unlike std::string/vector, does not initialize data when expanding capacity.
 class Buffer {
  public:
+  // Where the buffer's storage comes from. ALLOC_POOLED buffers use
+  // BufferPool, which makes them cheap to create and destroy on the media
+  // path; their capacity is rounded up to the pool's block size.
+  enum Allocation { ALLOC_HEAP, ALLOC_POOLED };
+
   Buffer() {
-    Construct(NULL, 0, 0);
+    Construct(NULL, 0, 0, ALLOC_HEAP);
   }
   Buffer(const void* data, size_t length) {
-    Construct(data, length, length);
+    Construct(data, length, length, ALLOC_HEAP);
   }
   Buffer(const void* data, size_t length, size_t capacity) {
-    Construct(data, length, capacity);
+    Construct(data, length, capacity, ALLOC_HEAP);
+  }
+  Buffer(const void* data, size_t length, size_t capacity,
+         Allocation allocation) {
+    Construct(data, length, capacity, allocation);
   }
   Buffer(const Buffer& buf) {
-    Construct(buf.data(), buf.length(), buf.length());
+    Construct(buf.data(), buf.length(), buf.length(), buf.allocation());
+  }
+  ~Buffer() {
+    Release();
   }
 
-  const char* data() const { return data_.get(); }
-  char* data() { return data_.get(); }
+  const char* data() const { return data_; }
+  char* data() { return data_; }
   // TODO: should this be size(), like STL?
   size_t length() const { return length_; }
   size_t capacity() const { return capacity_; }
+  Allocation allocation() const {
+    return pooled_ ? ALLOC_POOLED : ALLOC_HEAP;
+  }
 
+  // Keeps this buffer's allocation.
   Buffer& operator=(const Buffer& buf) {
     if (&buf != this) {
-      Construct(buf.data(), buf.length(), buf.length());
+      Allocation allocation = this->allocation();
+      Release();
+      Construct(buf.data(), buf.length(), buf.length(), allocation);
     }
     return *this;
   }
   bool operator==(const Buffer& buf) const {
     return (length_ == buf.length() &&
-            memcmp(data_.get(), buf.data(), length_) == 0);
+            memcmp(data_, buf.data(), length_) == 0);
   }
   bool operator!=(const Buffer& buf) const {
     return !operator==(buf);
@@ -74,13 +93,13 @@ class Buffer {
   void SetData(const void* data, size_t length) {
     ASSERT(data != NULL || length == 0);
     SetLength(length);
-    memcpy(data_.get(), data, length);
+    memcpy(data_, data, length);
   }
   void AppendData(const void* data, size_t length) {
     ASSERT(data != NULL || length == 0);
     size_t old_length = length_;
     SetLength(length_ + length);
-    memcpy(data_.get() + old_length, data, length);
+    memcpy(data_ + old_length, data, length);
   }
   void SetLength(size_t length) {
     SetCapacity(length);
@@ -88,30 +107,53 @@ class Buffer {
   }
   void SetCapacity(size_t capacity) {
     if (capacity > capacity_) {
-      talk_base::scoped_array<char> data(new char[capacity]);
-      memcpy(data.get(), data_.get(), length_);
-      data_.swap(data);
+      char* data = Allocate(&capacity);
+      memcpy(data, data_, length_);
+      Release();
+      data_ = data;
       capacity_ = capacity;
     }
   }
 
+  // Hands the storage, along with its allocation, to |buf|.
   void TransferTo(Buffer* buf) {
     ASSERT(buf != NULL);
-    buf->data_.reset(data_.release());
+    buf->Release();
+    buf->data_ = data_;
+    buf->pooled_ = pooled_;
     buf->length_ = length_;
     buf->capacity_ = capacity_;
-    Construct(NULL, 0, 0);
+    Construct(NULL, 0, 0, allocation());
   }
 
  protected:
-  void Construct(const void* data, size_t length, size_t capacity) {
-    data_.reset(new char[capacity_ = capacity]);
+  void Construct(const void* data, size_t length, size_t capacity,
+                 Allocation allocation) {
+    pooled_ = (allocation == ALLOC_POOLED);
+    length_ = 0;
+    capacity_ = capacity;
+    data_ = Allocate(&capacity_);
     SetData(data, length);
   }
+  // Rounds |*capacity| up to what was actually allocated.
+  char* Allocate(size_t* capacity) const {
+    if (!pooled_) {
+      return new char[*capacity];
+    }
+    return (*capacity > 0) ? BufferPool::Allocate(capacity) : NULL;
+  }
+  void Release() {
+    if (pooled_) {
+      BufferPool::Free(data_);
+    } else {
+      delete [] data_;
+    }
+  }
 
-  scoped_array<char> data_;
+  char* data_;
   size_t length_;
   size_t capacity_;
+  bool pooled_;
 };
 
 }  // namespace talk_base
@@ -157,4 +157,39 @@ TEST(BufferTest, TestTransfer) {
   EXPECT_EQ(0, memcmp(buf2.data(), kTestData, sizeof(kTestData)));
 }
 
+TEST(BufferTest, TestConstructPooled) {
+  Buffer buf(kTestData, sizeof(kTestData), 100U, Buffer::ALLOC_POOLED);
+  EXPECT_EQ(Buffer::ALLOC_POOLED, buf.allocation());
+  EXPECT_EQ(sizeof(kTestData), buf.length());
+  EXPECT_EQ(128U, buf.capacity());  // rounded up to the pool's block size
+  EXPECT_EQ(Buffer(kTestData, sizeof(kTestData)), buf);
+  buf.SetCapacity(200U);
+  EXPECT_EQ(256U, buf.capacity());
+  EXPECT_EQ(Buffer(kTestData, sizeof(kTestData)), buf);
+}
+
+TEST(BufferTest, TestCopyPooled) {
+  Buffer buf1(kTestData, sizeof(kTestData), 256U, Buffer::ALLOC_POOLED);
+  Buffer buf2(buf1), buf3;
+  EXPECT_EQ(Buffer::ALLOC_POOLED, buf2.allocation());
+  EXPECT_EQ(buf1, buf2);
+  buf3 = buf1;  // keeps its own allocation
+  EXPECT_EQ(Buffer::ALLOC_HEAP, buf3.allocation());
+  EXPECT_EQ(buf1, buf3);
+}
+
+TEST(BufferTest, TestTransferPooled) {
+  Buffer buf1(kTestData, sizeof(kTestData), 256U, Buffer::ALLOC_POOLED);
+  Buffer buf2(kTestData, sizeof(kTestData));
+  buf1.TransferTo(&buf2);
+  EXPECT_EQ(Buffer::ALLOC_POOLED, buf1.allocation());
+  EXPECT_EQ(0U, buf1.capacity());
+  EXPECT_TRUE(buf1.data() == NULL);
+  EXPECT_EQ(Buffer::ALLOC_POOLED, buf2.allocation());
+  EXPECT_EQ(256U, buf2.capacity());
+  EXPECT_EQ(Buffer(kTestData, sizeof(kTestData)), buf2);
+  buf1.AppendData(kTestData, sizeof(kTestData));
+  EXPECT_EQ(buf1, buf2);
+}
+
 }  // namespace talk_base
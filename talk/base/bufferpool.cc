@@ -0,0 +1,267 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/base/bufferpool.h"
+
+#ifdef POSIX
+#include <pthread.h>
+#endif
+
+#include <vector>
+
+#include "talk/base/common.h"
+#include "talk/base/criticalsection.h"
+
+#ifdef WIN32
+#include "talk/base/win32.h"
+#endif
+
+namespace talk_base {
+
+const size_t BufferPool::kMinBlockSize;
+const size_t BufferPool::kMaxBlockSize;
+
+// 64 B to 64 KB.
+static const size_t kNumSizeClasses = 11;
+// Marks blocks too large for any size class.
+static const size_t kOversized = kNumSizeClasses;
+// Most memory a cache keeps in each size class, both in the blocks its own
+// thread freed and in those freed by other threads; blocks freed beyond
+// that go back to the heap.
+static const size_t kMaxCachedBytesPerClass = 1024 * 1024;
+
+struct ThreadCache;
+
+// Precedes every block. kHeaderSize keeps the block itself as aligned as the
+// memory that new[] returns.
+struct BlockHeader {
+  ThreadCache* owner;
+  size_t size_class;
+};
+static const size_t kHeaderSize = 16;
+
+struct ThreadCache {
+  ThreadCache() : hits(0), misses(0) {}
+
+  // Only touched by the owning thread.
+  std::vector<char*> free_blocks[kNumSizeClasses];
+  uint64 hits;
+  uint64 misses;
+  // Blocks freed by other threads, for the owner to pick up.
+  CriticalSection remote_crit;
+  std::vector<char*> remote_blocks[kNumSizeClasses];
+};
+
+static size_t BlockSize(size_t size_class) {
+  return BufferPool::kMinBlockSize << size_class;
+}
+
+static BlockHeader* GetHeader(char* block) {
+  return reinterpret_cast<BlockHeader*>(block - kHeaderSize);
+}
+
+static void OnThreadExit(void* cache);
+
+// Hands out the per-thread caches and keeps the totals that aren't owned by
+// any one thread. Caches are never deleted, since blocks from them may still
+// be in use anywhere; a cache whose thread has exited is given to the next
+// thread that needs one.
+class CacheRegistry {
+ public:
+  static CacheRegistry* Instance() {
+    LIBJINGLE_DEFINE_STATIC_LOCAL(CacheRegistry, registry, ());
+    return &registry;
+  }
+
+  CacheRegistry() : bytes_allocated_(0), peak_bytes_allocated_(0) {
+#ifdef POSIX
+    pthread_key_create(&key_, &OnThreadExit);
+#endif
+#ifdef WIN32
+    key_ = TlsAlloc();
+#endif
+  }
+
+  ThreadCache* CurrentCache() {
+#ifdef POSIX
+    ThreadCache* cache = static_cast<ThreadCache*>(pthread_getspecific(key_));
+#endif
+#ifdef WIN32
+    ThreadCache* cache = static_cast<ThreadCache*>(TlsGetValue(key_));
+#endif
+    if (!cache) {
+      cache = AdoptCache();
+#ifdef POSIX
+      pthread_setspecific(key_, cache);
+#endif
+#ifdef WIN32
+      TlsSetValue(key_, cache);
+#endif
+    }
+    return cache;
+  }
+
+  void ReleaseCache(ThreadCache* cache) {
+    CritScope cs(&crit_);
+    orphans_.push_back(cache);
+  }
+
+  void AddBytes(size_t bytes) {
+    CritScope cs(&crit_);
+    bytes_allocated_ += bytes;
+    if (bytes_allocated_ > peak_bytes_allocated_) {
+      peak_bytes_allocated_ = bytes_allocated_;
+    }
+  }
+
+  void RemoveBytes(size_t bytes) {
+    CritScope cs(&crit_);
+    bytes_allocated_ -= bytes;
+  }
+
+  void GetStats(BufferPoolStats* stats) {
+    CritScope cs(&crit_);
+    *stats = BufferPoolStats();
+    for (size_t i = 0; i < caches_.size(); ++i) {
+      stats->hits += caches_[i]->hits;
+      stats->misses += caches_[i]->misses;
+    }
+    stats->bytes_allocated = bytes_allocated_;
+    stats->peak_bytes_allocated = peak_bytes_allocated_;
+  }
+
+ private:
+  ThreadCache* AdoptCache() {
+    CritScope cs(&crit_);
+    if (!orphans_.empty()) {
+      ThreadCache* cache = orphans_.back();
+      orphans_.pop_back();
+      return cache;
+    }
+    caches_.push_back(new ThreadCache);
+    return caches_.back();
+  }
+
+#ifdef POSIX
+  pthread_key_t key_;
+#endif
+#ifdef WIN32
+  DWORD key_;
+#endif
+  CriticalSection crit_;
+  std::vector<ThreadCache*> caches_;
+  std::vector<ThreadCache*> orphans_;
+  size_t bytes_allocated_;
+  size_t peak_bytes_allocated_;
+};
+
+// Windows has no TLS destructors, so there caches stay with their threads.
+static void OnThreadExit(void* cache) {
+  CacheRegistry::Instance()->ReleaseCache(static_cast<ThreadCache*>(cache));
+}
+
+char* BufferPool::Allocate(size_t* size) {
+  CacheRegistry* registry = CacheRegistry::Instance();
+  ThreadCache* cache = registry->CurrentCache();
+  size_t size_class = 0;
+  while (size_class < kNumSizeClasses && BlockSize(size_class) < *size) {
+    ++size_class;
+  }
+
+  if (size_class == kOversized) {
+    char* block = new char[kHeaderSize + *size] + kHeaderSize;
+    GetHeader(block)->owner = NULL;
+    GetHeader(block)->size_class = kOversized;
+    ++cache->misses;
+    return block;
+  }
+
+  std::vector<char*>& free_blocks = cache->free_blocks[size_class];
+  if (free_blocks.empty()) {
+    // Both lists are capped, so the swap keeps |free_blocks| within bounds.
+    CritScope cs(&cache->remote_crit);
+    free_blocks.swap(cache->remote_blocks[size_class]);
+  }
+  *size = BlockSize(size_class);
+  if (!free_blocks.empty()) {
+    char* block = free_blocks.back();
+    free_blocks.pop_back();
+    ++cache->hits;
+    return block;
+  }
+
+  char* block = new char[kHeaderSize + *size] + kHeaderSize;
+  GetHeader(block)->owner = cache;
+  GetHeader(block)->size_class = size_class;
+  ++cache->misses;
+  registry->AddBytes(kHeaderSize + *size);
+  return block;
+}
+
+void BufferPool::Free(char* block) {
+  if (!block) {
+    return;
+  }
+  BlockHeader* header = GetHeader(block);
+  if (header->size_class == kOversized) {
+    delete [] reinterpret_cast<char*>(header);
+    return;
+  }
+
+  CacheRegistry* registry = CacheRegistry::Instance();
+  ThreadCache* owner = header->owner;
+  size_t size_class = header->size_class;
+  if (owner != registry->CurrentCache()) {
+    {
+      CritScope cs(&owner->remote_crit);
+      std::vector<char*>& remote_blocks = owner->remote_blocks[size_class];
+      if ((remote_blocks.size() + 1) * BlockSize(size_class) <=
+          kMaxCachedBytesPerClass) {
+        remote_blocks.push_back(block);
+        return;
+      }
+    }
+    registry->RemoveBytes(kHeaderSize + BlockSize(size_class));
+    delete [] reinterpret_cast<char*>(header);
+    return;
+  }
+
+  std::vector<char*>& free_blocks = owner->free_blocks[size_class];
+  if ((free_blocks.size() + 1) * BlockSize(size_class) >
+      kMaxCachedBytesPerClass) {
+    registry->RemoveBytes(kHeaderSize + BlockSize(size_class));
+    delete [] reinterpret_cast<char*>(header);
+    return;
+  }
+  free_blocks.push_back(block);
+}
+
+void BufferPool::GetStats(BufferPoolStats* stats) {
+  CacheRegistry::Instance()->GetStats(stats);
+}
+
+}  // namespace talk_base
@@ -0,0 +1,82 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_BASE_BUFFERPOOL_H_
+#define TALK_BASE_BUFFERPOOL_H_
+
+#include <stddef.h>
+
+#include "talk/base/basictypes.h"
+
+namespace talk_base {
+
+struct BufferPoolStats {
+  BufferPoolStats()
+      : hits(0), misses(0), bytes_allocated(0), peak_bytes_allocated(0) {
+  }
+
+  uint64 hits;  // Allocations served from a cache.
+  uint64 misses;  // Allocations that went to the heap.
+  // Heap memory held in pooled blocks, whether in use or cached, and its
+  // peak. Oversized blocks aren't included.
+  size_t bytes_allocated;
+  size_t peak_bytes_allocated;
+};
+
+// Allocator for packet-sized blocks of memory, used by Buffers that opt in
+// with Buffer::ALLOC_POOLED. Requests are rounded up to a power of two size
+// class between kMinBlockSize and kMaxBlockSize and served from a cache that
+// belongs to the calling thread, so that once a thread's traffic has warmed
+// its cache, allocating and freeing packets takes no locks and never touches
+// the heap. A block freed on a thread other than the one that allocated it
+// is handed back to the allocating thread's cache, which picks such blocks
+// up when it runs dry; this covers packets that are built on an encoder
+// thread and sent on a worker. Blocks larger than kMaxBlockSize come straight
+// from the heap and count as misses. When a thread exits, its cache is kept
+// for the next thread to come along. All methods are thread-safe.
+class BufferPool {
+ public:
+  static const size_t kMinBlockSize = 64;
+  static const size_t kMaxBlockSize = 64 * 1024;
+
+  // Returns a block of at least |*size| bytes, and sets |*size| to the size
+  // that is actually usable.
+  static char* Allocate(size_t* size);
+  // Returns |block| to the pool. |block| may be NULL.
+  static void Free(char* block);
+
+  // Totals over all threads. Counters owned by other threads that are busy
+  // at the time may be slightly behind.
+  static void GetStats(BufferPoolStats* stats);
+
+ private:
+  BufferPool();
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_BUFFERPOOL_H_
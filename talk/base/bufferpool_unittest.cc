@@ -0,0 +1,195 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+
+#include "talk/base/buffer.h"
+#include "talk/base/bufferpool.h"
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/thread.h"
+
+namespace talk_base {
+
+// The pool is process-wide, so each test works in a size class of its own and
+// checks how the stats change rather than their absolute values.
+
+class FreeBlockRunnable : public Runnable {
+ public:
+  explicit FreeBlockRunnable(char* block) : blocks_(1, block) {}
+  explicit FreeBlockRunnable(const std::vector<char*>& blocks)
+      : blocks_(blocks) {}
+  virtual void Run(Thread* thread) {
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+      BufferPool::Free(blocks_[i]);
+    }
+  }
+
+ private:
+  std::vector<char*> blocks_;
+};
+
+TEST(BufferPoolTest, RoundsUpToSizeClass) {
+  size_t size = 1;
+  char* block = BufferPool::Allocate(&size);
+  ASSERT_TRUE(block != NULL);
+  EXPECT_EQ(BufferPool::kMinBlockSize, size);
+  BufferPool::Free(block);
+
+  size = 300;
+  block = BufferPool::Allocate(&size);
+  EXPECT_EQ(512U, size);
+  BufferPool::Free(block);
+
+  size = BufferPool::kMaxBlockSize;
+  block = BufferPool::Allocate(&size);
+  EXPECT_EQ(BufferPool::kMaxBlockSize, size);
+  BufferPool::Free(block);
+
+  size = BufferPool::kMaxBlockSize + 1;
+  block = BufferPool::Allocate(&size);
+  EXPECT_EQ(BufferPool::kMaxBlockSize + 1, size);
+  BufferPool::Free(block);
+  BufferPool::Free(NULL);
+}
+
+TEST(BufferPoolTest, ReusesFreedBlocks) {
+  size_t size = 1000;
+  char* block = BufferPool::Allocate(&size);
+  BufferPool::Free(block);
+
+  BufferPoolStats before;
+  BufferPool::GetStats(&before);
+  size = 1000;
+  EXPECT_EQ(block, BufferPool::Allocate(&size));
+  BufferPoolStats after;
+  BufferPool::GetStats(&after);
+  EXPECT_EQ(before.hits + 1, after.hits);
+  EXPECT_EQ(before.misses, after.misses);
+  BufferPool::Free(block);
+}
+
+TEST(BufferPoolTest, ReturnsBlocksFreedOnOtherThreads) {
+  size_t size = 16 * 1024;
+  char* block = BufferPool::Allocate(&size);
+  FreeBlockRunnable runnable(block);
+  Thread thread;
+  thread.Start(&runnable);
+  thread.Stop();
+
+  BufferPoolStats before;
+  BufferPool::GetStats(&before);
+  size = 16 * 1024;
+  EXPECT_EQ(block, BufferPool::Allocate(&size));
+  BufferPoolStats after;
+  BufferPool::GetStats(&after);
+  EXPECT_EQ(before.hits + 1, after.hits);
+  EXPECT_EQ(before.misses, after.misses);
+  BufferPool::Free(block);
+}
+
+TEST(BufferPoolTest, TracksPeakBytesAndCapsCache) {
+  // More than the pool caches per size class.
+  const size_t kBlockSize = 32 * 1024;
+  const int kNumBlocks = 40;
+  BufferPoolStats before;
+  BufferPool::GetStats(&before);
+  std::vector<char*> blocks;
+  for (int i = 0; i < kNumBlocks; ++i) {
+    size_t size = kBlockSize;
+    blocks.push_back(BufferPool::Allocate(&size));
+  }
+  BufferPoolStats allocated;
+  BufferPool::GetStats(&allocated);
+  EXPECT_EQ(before.misses + kNumBlocks, allocated.misses);
+  EXPECT_LE(before.bytes_allocated + kNumBlocks * kBlockSize,
+            allocated.bytes_allocated);
+  EXPECT_LE(allocated.bytes_allocated, allocated.peak_bytes_allocated);
+
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    BufferPool::Free(blocks[i]);
+  }
+  BufferPoolStats freed;
+  BufferPool::GetStats(&freed);
+  EXPECT_LT(freed.bytes_allocated, allocated.bytes_allocated);
+  EXPECT_LT(before.bytes_allocated, freed.bytes_allocated);
+  EXPECT_EQ(allocated.peak_bytes_allocated, freed.peak_bytes_allocated);
+}
+
+TEST(BufferPoolTest, CapsBlocksFreedOnOtherThreads) {
+  // More than the pool caches per size class.
+  const size_t kBlockSize = 8 * 1024;
+  const int kNumBlocks = 160;
+  std::vector<char*> blocks;
+  for (int i = 0; i < kNumBlocks; ++i) {
+    size_t size = kBlockSize;
+    blocks.push_back(BufferPool::Allocate(&size));
+  }
+  BufferPoolStats allocated;
+  BufferPool::GetStats(&allocated);
+
+  FreeBlockRunnable runnable(blocks);
+  Thread thread;
+  thread.Start(&runnable);
+  thread.Stop();
+  BufferPoolStats freed;
+  BufferPool::GetStats(&freed);
+  EXPECT_LT(freed.bytes_allocated, allocated.bytes_allocated);
+
+  // What was kept comes back without touching the heap.
+  size_t size = kBlockSize;
+  BufferPool::Free(BufferPool::Allocate(&size));
+  BufferPoolStats after;
+  BufferPool::GetStats(&after);
+  EXPECT_EQ(freed.misses, after.misses);
+}
+
+TEST(BufferPoolTest, SteadyStateDoesNotAllocate) {
+  static const char kPayload[1200] = { 0 };
+  // Warm up the cache, the way the first packets of a call would. The loop
+  // below keeps two packets alive at a time.
+  {
+    Buffer warmup1(kPayload, sizeof(kPayload), 1500, Buffer::ALLOC_POOLED);
+    Buffer warmup2(kPayload, sizeof(kPayload), 1500, Buffer::ALLOC_POOLED);
+  }
+
+  BufferPoolStats before;
+  BufferPool::GetStats(&before);
+  Buffer queued;
+  for (int i = 0; i < 10000; ++i) {
+    Buffer packet(kPayload, sizeof(kPayload), 1500, Buffer::ALLOC_POOLED);
+    packet.TransferTo(&queued);
+  }
+  BufferPoolStats after;
+  BufferPool::GetStats(&after);
+  EXPECT_EQ(before.misses, after.misses);
+  EXPECT_EQ(before.bytes_allocated, after.bytes_allocated);
+  LOG(LS_INFO) << "Pool hits: " << after.hits - before.hits
+               << ", peak bytes: " << after.peak_bytes_allocated;
+}
+
+}  // namespace talk_base
@@ -27,6 +27,8 @@
 
 #include "talk/base/crc32.h"
 #include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/timeutils.h"
 
 #include <string>
 
@@ -49,4 +51,46 @@ TEST(Crc32Test, TestMultipleUpdates) {
   EXPECT_EQ(0x171A3F5FU, c);
 }
 
+// Bit-at-a-time CRC32, to check the table-driven version against.
+static uint32 ReferenceCrc32(const uint8* buf, size_t len) {
+  uint32 c = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; ++i) {
+    c ^= buf[i];
+    for (int j = 0; j < 8; ++j)
+      c = (c >> 1) ^ (0xEDB88320 & (0 - (c & 1)));
+  }
+  return c ^ 0xFFFFFFFF;
+}
+
+// Check every combination of alignment and length around the 8-byte steps.
+TEST(Crc32Test, TestOffsetsAndLengths) {
+  uint8 buf[64];
+  for (size_t i = 0; i < sizeof(buf); ++i)
+    buf[i] = static_cast<uint8>(i * 37 + 11);
+  for (size_t offset = 0; offset < 8; ++offset) {
+    for (size_t len = 0; len + offset <= sizeof(buf); ++len) {
+      EXPECT_EQ(ReferenceCrc32(buf + offset, len),
+                ComputeCrc32(buf + offset, len));
+    }
+  }
+}
+
+// Logs the throughput on STUN-sized and MTU-sized inputs.
+TEST(Crc32Test, TestPerformance) {
+  static const size_t kSizes[] = { 108, 1200 };
+  static const int kIterations = 100000;
+  uint8 buf[1200];
+  for (size_t i = 0; i < sizeof(buf); ++i)
+    buf[i] = static_cast<uint8>(i);
+  for (size_t i = 0; i < ARRAY_SIZE(kSizes); ++i) {
+    uint32 c = 0;
+    uint32 start = Time();
+    for (int j = 0; j < kIterations; ++j)
+      c = UpdateCrc32(c, buf, kSizes[i]);
+    uint32 elapsed = TimeSince(start);
+    LOG(LS_INFO) << kIterations << " CRC32s of " << kSizes[i] << " bytes in "
+                 << elapsed << " ms (crc " << c << ")";
+  }
+}
+
 }  // namespace talk_base
@@ -0,0 +1,234 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_BASE_FLATHASHMAP_H_
+#define TALK_BASE_FLATHASHMAP_H_
+
+#include <utility>
+#include <vector>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+
+namespace talk_base {
+
+// Hashes keys that provide a Hash() method, e.g. SocketAddress.
+template <class K>
+struct HashMethod {
+  size_t operator()(const K& key) const { return key.Hash(); }
+};
+
+// Hashes integral keys.
+template <class K>
+struct HashInt {
+  size_t operator()(K key) const { return static_cast<size_t>(key); }
+};
+
+// Hashes pointer keys.
+template <class K>
+struct HashPointer {
+  size_t operator()(K key) const { return reinterpret_cast<size_t>(key); }
+};
+
+// A hash map that stores its entries inline in a single array, using open
+// addressing with linear probing. Lookups touch one or two cache lines and
+// never allocate, which makes it suitable for per-packet lookups. Erase uses
+// backward-shift deletion, so there are no tombstones and lookup cost does
+// not degrade with churn.
+//
+// Keys and values must be default-constructible and assignable. Pointers to
+// values are invalidated by Insert and Erase, as are iterators; in particular,
+// the map cannot be modified while it is being iterated.
+template <class K, class V, class H = HashMethod<K> >
+class FlatHashMap {
+ public:
+  typedef std::pair<K, V> value_type;
+
+ private:
+  struct Slot {
+    Slot() : used(false) {}
+    value_type kv;
+    bool used;
+  };
+  typedef std::vector<Slot> SlotVector;
+
+ public:
+  class const_iterator {
+   public:
+    const_iterator() : slot_(NULL), end_(NULL) {}
+    const value_type& operator*() const { return slot_->kv; }
+    const value_type* operator->() const { return &slot_->kv; }
+    const_iterator& operator++() {
+      ++slot_;
+      SkipUnused();
+      return *this;
+    }
+    bool operator==(const const_iterator& it) const {
+      return slot_ == it.slot_;
+    }
+    bool operator!=(const const_iterator& it) const {
+      return slot_ != it.slot_;
+    }
+
+   private:
+    friend class FlatHashMap;
+    const_iterator(const Slot* slot, const Slot* end)
+        : slot_(slot), end_(end) {
+      SkipUnused();
+    }
+    void SkipUnused() {
+      while (slot_ != end_ && !slot_->used)
+        ++slot_;
+    }
+    const Slot* slot_;
+    const Slot* end_;
+  };
+
+  FlatHashMap() : size_(0) {}
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const_iterator begin() const {
+    return slots_.empty() ? const_iterator() :
+        const_iterator(&slots_[0], &slots_[0] + slots_.size());
+  }
+  const_iterator end() const {
+    return slots_.empty() ? const_iterator() :
+        const_iterator(&slots_[0] + slots_.size(), &slots_[0] + slots_.size());
+  }
+
+  // Returns a pointer to the value for |key|, or NULL if there is none.
+  V* Find(const K& key) {
+    size_t i = Lookup(key);
+    return (i != kNotFound) ? &slots_[i].kv.second : NULL;
+  }
+  const V* Find(const K& key) const {
+    size_t i = Lookup(key);
+    return (i != kNotFound) ? &slots_[i].kv.second : NULL;
+  }
+
+  // Adds |key| -> |value|. Returns false, leaving the map unchanged, if |key|
+  // is already present.
+  bool Insert(const K& key, const V& value) {
+    if (Lookup(key) != kNotFound)
+      return false;
+    // Keep the load factor at or below 1/2 so probe runs stay short.
+    if ((size_ + 1) * 2 > slots_.size())
+      Grow();
+    size_t i = Probe(key);
+    while (slots_[i].used)
+      i = (i + 1) & mask();
+    slots_[i].kv.first = key;
+    slots_[i].kv.second = value;
+    slots_[i].used = true;
+    ++size_;
+    return true;
+  }
+
+  // Removes |key|. Returns false if it was not present.
+  bool Erase(const K& key) {
+    size_t i = Lookup(key);
+    if (i == kNotFound)
+      return false;
+    // Shift back any following entries that would otherwise become
+    // unreachable from their home slot.
+    size_t j = i;
+    for (;;) {
+      j = (j + 1) & mask();
+      if (!slots_[j].used)
+        break;
+      size_t home = Probe(slots_[j].kv.first);
+      // Move |j| into the hole at |i| unless its home lies cyclically in
+      // (i, j], in which case it is still reachable.
+      bool reachable = (i <= j) ? (i < home && home <= j)
+                                : (i < home || home <= j);
+      if (!reachable) {
+        slots_[i].kv = slots_[j].kv;
+        i = j;
+      }
+    }
+    slots_[i].kv = value_type();
+    slots_[i].used = false;
+    --size_;
+    return true;
+  }
+
+  void Clear() {
+    SlotVector().swap(slots_);
+    size_ = 0;
+  }
+
+ private:
+  static const size_t kNotFound = static_cast<size_t>(-1);
+  static const size_t kMinSlots = 8;
+
+  size_t mask() const { return slots_.size() - 1; }
+
+  // Returns the home slot for |key|. The user hash is mixed first, since
+  // hashes like SocketAddress::Hash() leave the low bits poorly distributed.
+  size_t Probe(const K& key) const {
+    uint32 h = static_cast<uint32>(hasher_(key));
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h & mask();
+  }
+
+  size_t Lookup(const K& key) const {
+    if (slots_.empty())
+      return kNotFound;
+    for (size_t i = Probe(key); slots_[i].used; i = (i + 1) & mask()) {
+      if (slots_[i].kv.first == key)
+        return i;
+    }
+    return kNotFound;
+  }
+
+  void Grow() {
+    SlotVector old;
+    old.swap(slots_);
+    slots_.resize(old.empty() ? kMinSlots : old.size() * 2);
+    size_ = 0;
+    for (size_t i = 0; i < old.size(); ++i) {
+      if (old[i].used)
+        Insert(old[i].kv.first, old[i].kv.second);
+    }
+  }
+
+  SlotVector slots_;
+  size_t size_;
+  H hasher_;
+
+  DISALLOW_COPY_AND_ASSIGN(FlatHashMap);
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_FLATHASHMAP_H_
@@ -0,0 +1,132 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <map>
+#include <string>
+
+#include "talk/base/flathashmap.h"
+#include "talk/base/gunit.h"
+#include "talk/base/helpers.h"
+#include "talk/base/socketaddress.h"
+
+namespace talk_base {
+
+typedef FlatHashMap<int, int, HashInt<int> > IntMap;
+
+TEST(FlatHashMapTest, InsertFindErase) {
+  IntMap map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.Find(1) == NULL);
+  EXPECT_FALSE(map.Erase(1));
+
+  EXPECT_TRUE(map.Insert(1, 10));
+  EXPECT_TRUE(map.Insert(2, 20));
+  EXPECT_FALSE(map.Insert(1, 11));
+  EXPECT_EQ(2U, map.size());
+  ASSERT_TRUE(map.Find(1) != NULL);
+  EXPECT_EQ(10, *map.Find(1));
+  EXPECT_EQ(20, *map.Find(2));
+
+  *map.Find(2) = 21;
+  EXPECT_EQ(21, *map.Find(2));
+
+  EXPECT_TRUE(map.Erase(1));
+  EXPECT_TRUE(map.Find(1) == NULL);
+  EXPECT_EQ(21, *map.Find(2));
+  EXPECT_EQ(1U, map.size());
+
+  map.Clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.Find(2) == NULL);
+}
+
+TEST(FlatHashMapTest, Iterate) {
+  IntMap map;
+  EXPECT_TRUE(map.begin() == map.end());
+  for (int i = 0; i < 100; ++i) {
+    map.Insert(i, i * 2);
+  }
+  int count = 0, sum = 0;
+  for (IntMap::const_iterator it = map.begin(); it != map.end(); ++it) {
+    EXPECT_EQ(it->first * 2, it->second);
+    ++count;
+    sum += it->first;
+  }
+  EXPECT_EQ(100, count);
+  EXPECT_EQ(99 * 100 / 2, sum);
+}
+
+// Keys that collide on their home slot must stay reachable across erases,
+// which exercises the backward-shift deletion.
+TEST(FlatHashMapTest, CollidingKeys) {
+  IntMap map;
+  for (int i = 0; i < 64; ++i) {
+    map.Insert(i * 1024, i);
+  }
+  for (int i = 0; i < 64; i += 2) {
+    EXPECT_TRUE(map.Erase(i * 1024));
+  }
+  for (int i = 0; i < 64; ++i) {
+    if (i % 2) {
+      ASSERT_TRUE(map.Find(i * 1024) != NULL);
+      EXPECT_EQ(i, *map.Find(i * 1024));
+    } else {
+      EXPECT_TRUE(map.Find(i * 1024) == NULL);
+    }
+  }
+}
+
+// Runs a random mix of operations against std::map as a reference.
+TEST(FlatHashMapTest, MatchesStdMap) {
+  FlatHashMap<SocketAddress, int> map;
+  std::map<SocketAddress, int> ref;
+  for (int i = 0; i < 20000; ++i) {
+    SocketAddress addr(IPAddress(0x0A000000 | CreateRandomId() % 64),
+                       CreateRandomId() % 16);
+    switch (CreateRandomId() % 3) {
+      case 0:
+        EXPECT_EQ(ref.insert(std::make_pair(addr, i)).second,
+                  map.Insert(addr, i));
+        break;
+      case 1:
+        EXPECT_EQ(ref.erase(addr) != 0, map.Erase(addr));
+        break;
+      case 2: {
+        std::map<SocketAddress, int>::iterator it = ref.find(addr);
+        const int* value = map.Find(addr);
+        ASSERT_EQ(it != ref.end(), value != NULL);
+        if (value) {
+          EXPECT_EQ(it->second, *value);
+        }
+        break;
+      }
+    }
+    ASSERT_EQ(ref.size(), map.size());
+  }
+}
+
+}  // namespace talk_base
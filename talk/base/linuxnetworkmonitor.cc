@@ -0,0 +1,254 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if defined(LINUX) || defined(ANDROID)
+#include "talk/base/linuxnetworkmonitor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "talk/base/logging.h"
+
+namespace talk_base {
+
+// Large enough for the notifications of a handful of changes at once.
+static const int kReceiveBufferSize = 8192;
+
+LinuxNetworkMonitor::LinuxNetworkMonitor(PhysicalSocketServer* socket_server)
+    : socket_server_(socket_server),
+      fd_(-1) {
+}
+
+LinuxNetworkMonitor::~LinuxNetworkMonitor() {
+  Stop();
+}
+
+bool LinuxNetworkMonitor::Start() {
+  if (fd_ >= 0)
+    return true;
+
+  fd_ = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+  if (fd_ < 0) {
+    LOG_ERR(LS_ERROR) << "socket(NETLINK_ROUTE)";
+    return false;
+  }
+  fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+
+  sockaddr_nl addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+  if (bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    LOG_ERR(LS_ERROR) << "bind(NETLINK_ROUTE)";
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  socket_server_->Add(this);
+  return true;
+}
+
+void LinuxNetworkMonitor::Stop() {
+  if (fd_ < 0)
+    return;
+  socket_server_->Remove(this);
+  close(fd_);
+  fd_ = -1;
+  names_.clear();
+}
+
+uint32 LinuxNetworkMonitor::GetRequestedEvents() {
+  return DE_READ;
+}
+
+void LinuxNetworkMonitor::OnPreEvent(uint32 ff) {
+  // Nothing to do.
+}
+
+void LinuxNetworkMonitor::OnEvent(uint32 ff, int err) {
+  // Netlink messages are aligned to 4 bytes.
+  uint32 buffer[kReceiveBufferSize / sizeof(uint32)];
+  while (fd_ >= 0) {
+    sockaddr_nl from;
+    socklen_t from_len = sizeof(from);
+    int len = recvfrom(fd_, buffer, sizeof(buffer), 0,
+                       reinterpret_cast<sockaddr*>(&from), &from_len);
+    if (len < 0) {
+      if (errno == ENOBUFS) {
+        // The kernel's queue overflowed; keep reading what is left.
+        LOG(LS_WARNING) << "Netlink notifications were dropped";
+        SignalResyncNeeded();
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        LOG_ERR(LS_ERROR) << "recvfrom(NETLINK_ROUTE)";
+        // Stop listening to avoid a livelock on a socket stuck in error.
+        Stop();
+        SignalResyncNeeded();
+      }
+      return;
+    }
+    if (len == 0)
+      return;
+    // Only the kernel is trusted to report changes.
+    if (from.nl_pid != 0)
+      continue;
+    ParseMessages(reinterpret_cast<const char*>(buffer), len);
+  }
+}
+
+int LinuxNetworkMonitor::GetDescriptor() {
+  return fd_;
+}
+
+bool LinuxNetworkMonitor::IsDescriptorClosed() {
+  // Errors show up in recvfrom, which stops the monitor.
+  return false;
+}
+
+void LinuxNetworkMonitor::ParseMessages(const char* data, int len) {
+  for (const nlmsghdr* hdr = reinterpret_cast<const nlmsghdr*>(data);
+       NLMSG_OK(hdr, len); hdr = NLMSG_NEXT(hdr, len)) {
+    switch (hdr->nlmsg_type) {
+      case RTM_NEWADDR:
+      case RTM_DELADDR:
+        ParseAddressMessage(hdr);
+        break;
+      case RTM_NEWLINK:
+      case RTM_DELLINK:
+        ParseLinkMessage(hdr);
+        break;
+      case NLMSG_OVERRUN:
+        SignalResyncNeeded();
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void LinuxNetworkMonitor::ParseAddressMessage(const nlmsghdr* hdr) {
+  if (hdr->nlmsg_len < NLMSG_LENGTH(sizeof(ifaddrmsg)))
+    return;
+  const ifaddrmsg* msg = static_cast<const ifaddrmsg*>(NLMSG_DATA(hdr));
+  if (msg->ifa_family != AF_INET && msg->ifa_family != AF_INET6)
+    return;
+
+  InterfaceAddress address;
+  address.index = msg->ifa_index;
+  address.prefix_length = msg->ifa_prefixlen;
+  // For point-to-point links IFA_ADDRESS is the peer's address and
+  // IFA_LOCAL is ours; otherwise only IFA_ADDRESS may be present.
+  IPAddress local;
+  int len = IFA_PAYLOAD(hdr);
+  for (const rtattr* attr = IFA_RTA(msg); RTA_OK(attr, len);
+       attr = RTA_NEXT(attr, len)) {
+    IPAddress* ip = NULL;
+    if (attr->rta_type == IFA_ADDRESS) {
+      ip = &address.ip;
+    } else if (attr->rta_type == IFA_LOCAL) {
+      ip = &local;
+    } else if (attr->rta_type == IFA_LABEL) {
+      address.name = static_cast<const char*>(RTA_DATA(attr));
+      continue;
+    } else {
+      continue;
+    }
+    if (msg->ifa_family == AF_INET &&
+        RTA_PAYLOAD(attr) >= sizeof(in_addr)) {
+      *ip = IPAddress(*static_cast<const in_addr*>(RTA_DATA(attr)));
+    } else if (msg->ifa_family == AF_INET6 &&
+               RTA_PAYLOAD(attr) >= sizeof(in6_addr)) {
+      *ip = IPAddress(*static_cast<const in6_addr*>(RTA_DATA(attr)));
+    }
+  }
+  if (local.family() != AF_UNSPEC)
+    address.ip = local;
+  if (address.ip.family() == AF_UNSPEC)
+    return;
+  // IPv4 addresses are labeled with the name getifaddrs reports for them,
+  // which is the alias (eth0:1) if they have one. IPv6 ones aren't labeled.
+  if (address.name.empty())
+    address.name = InterfaceName(address.index);
+  if (address.name.empty())
+    return;
+
+  if (hdr->nlmsg_type == RTM_NEWADDR) {
+    // Tentative addresses can't be bound to until duplicate address
+    // detection completes, which is announced with another RTM_NEWADDR.
+    if (msg->ifa_flags & (IFA_F_TENTATIVE | IFA_F_DADFAILED))
+      return;
+    SignalAddressAdded(address);
+  } else {
+    SignalAddressRemoved(address);
+  }
+}
+
+void LinuxNetworkMonitor::ParseLinkMessage(const nlmsghdr* hdr) {
+  if (hdr->nlmsg_len < NLMSG_LENGTH(sizeof(ifinfomsg)))
+    return;
+  const ifinfomsg* msg = static_cast<const ifinfomsg*>(NLMSG_DATA(hdr));
+  std::string name;
+  int len = IFLA_PAYLOAD(hdr);
+  for (const rtattr* attr = IFLA_RTA(msg); RTA_OK(attr, len);
+       attr = RTA_NEXT(attr, len)) {
+    if (attr->rta_type == IFLA_IFNAME)
+      name = static_cast<const char*>(RTA_DATA(attr));
+  }
+
+  if (hdr->nlmsg_type == RTM_NEWLINK) {
+    if (!name.empty())
+      names_[msg->ifi_index] = name;
+    return;
+  }
+  if (name.empty())
+    name = InterfaceName(msg->ifi_index);
+  names_.erase(msg->ifi_index);
+  if (!name.empty())
+    SignalInterfaceRemoved(name);
+}
+
+std::string LinuxNetworkMonitor::InterfaceName(int index) {
+  InterfaceNameMap::iterator it = names_.find(index);
+  if (it != names_.end())
+    return it->second;
+  char name[IF_NAMESIZE];
+  if (!if_indextoname(index, name))
+    return std::string();
+  names_[index] = name;
+  return name;
+}
+
+}  // namespace talk_base
+
+#endif  // defined(LINUX) || defined(ANDROID)
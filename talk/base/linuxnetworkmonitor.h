@@ -0,0 +1,109 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_BASE_LINUXNETWORKMONITOR_H_
+#define TALK_BASE_LINUXNETWORKMONITOR_H_
+
+#if defined(LINUX) || defined(ANDROID)
+#include <map>
+#include <string>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/ipaddress.h"
+#include "talk/base/physicalsocketserver.h"
+#include "talk/base/sigslot.h"
+
+struct nlmsghdr;
+
+namespace talk_base {
+
+// An address added to or removed from an interface.
+struct InterfaceAddress {
+  InterfaceAddress() : index(0), prefix_length(0) {}
+  std::string name;
+  int index;
+  IPAddress ip;
+  int prefix_length;
+};
+
+// Listens on an rtnetlink socket for the kernel's interface and address
+// notifications, and signals them as they arrive. The socket is registered
+// with a PhysicalSocketServer, so the signals fire on the thread that runs
+// it. Only changes are reported; the current state has to be read once with
+// getifaddrs before starting.
+class LinuxNetworkMonitor : private Dispatcher {
+ public:
+  explicit LinuxNetworkMonitor(PhysicalSocketServer* socket_server);
+  virtual ~LinuxNetworkMonitor();
+
+  bool Start();
+  void Stop();
+  bool started() const { return fd_ >= 0; }
+
+  sigslot::signal1<const InterfaceAddress&> SignalAddressAdded;
+  sigslot::signal1<const InterfaceAddress&> SignalAddressRemoved;
+  // Fired with the interface name when an interface is removed.
+  sigslot::signal1<const std::string&> SignalInterfaceRemoved;
+  // Fired when the kernel dropped notifications because we did not read them
+  // in time. Whatever was missed can only be recovered with a full rescan.
+  sigslot::signal0<> SignalResyncNeeded;
+
+ protected:
+  // Separated from OnEvent for tests.
+  void ParseMessages(const char* data, int len);
+
+ private:
+  friend class LinuxNetworkMonitorTest;
+
+  // Dispatcher interface.
+  virtual uint32 GetRequestedEvents();
+  virtual void OnPreEvent(uint32 ff);
+  virtual void OnEvent(uint32 ff, int err);
+  virtual int GetDescriptor();
+  virtual bool IsDescriptorClosed();
+
+  void ParseAddressMessage(const nlmsghdr* hdr);
+  void ParseLinkMessage(const nlmsghdr* hdr);
+  std::string InterfaceName(int index);
+
+  typedef std::map<int, std::string> InterfaceNameMap;
+
+  PhysicalSocketServer* socket_server_;
+  int fd_;
+  // Interface names seen in link messages, keyed by index. IPv6 address
+  // messages carry only the index, and the name can no longer be looked up
+  // once the interface is gone.
+  InterfaceNameMap names_;
+
+  DISALLOW_EVIL_CONSTRUCTORS(LinuxNetworkMonitor);
+};
+
+}  // namespace talk_base
+
+#endif  // defined(LINUX) || defined(ANDROID)
+#endif  // TALK_BASE_LINUXNETWORKMONITOR_H_
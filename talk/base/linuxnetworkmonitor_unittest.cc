@@ -0,0 +1,214 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include <string>
+#include <vector>
+
+#include "talk/base/gunit.h"
+#include "talk/base/linuxnetworkmonitor.h"
+
+namespace talk_base {
+
+// An interface index that no real interface is expected to have.
+static const int kTestIndex = 4242;
+
+// Makes a route attribute carrying |len| bytes of |data|.
+static std::string MakeAttribute(int type, const void* data, size_t len) {
+  std::string attr(RTA_SPACE(len), '\0');
+  rtattr* rta = reinterpret_cast<rtattr*>(&attr[0]);
+  rta->rta_type = type;
+  rta->rta_len = RTA_LENGTH(len);
+  memcpy(RTA_DATA(rta), data, len);
+  return attr;
+}
+
+// Appends a netlink message with the given header and attributes.
+static void AppendMessage(std::string* buffer, int type,
+                          const void* body, size_t body_len,
+                          const std::string& attrs) {
+  size_t len = NLMSG_LENGTH(NLMSG_ALIGN(body_len) + attrs.size());
+  std::string message(NLMSG_ALIGN(len), '\0');
+  nlmsghdr* hdr = reinterpret_cast<nlmsghdr*>(&message[0]);
+  hdr->nlmsg_len = len;
+  hdr->nlmsg_type = type;
+  char* data = static_cast<char*>(NLMSG_DATA(hdr));
+  memcpy(data, body, body_len);
+  memcpy(data + NLMSG_ALIGN(body_len), attrs.data(), attrs.size());
+  buffer->append(message);
+}
+
+static void AppendLinkMessage(std::string* buffer, int type, int index,
+                              const std::string& name) {
+  ifinfomsg msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.ifi_family = AF_UNSPEC;
+  msg.ifi_index = index;
+  std::string attrs;
+  if (!name.empty())
+    attrs = MakeAttribute(IFLA_IFNAME, name.c_str(), name.size() + 1);
+  AppendMessage(buffer, type, &msg, sizeof(msg), attrs);
+}
+
+static void AppendAddressMessage(std::string* buffer, int type, int index,
+                                 const IPAddress& ip, int prefix_length,
+                                 int flags) {
+  ifaddrmsg msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.ifa_family = ip.family();
+  msg.ifa_prefixlen = prefix_length;
+  msg.ifa_flags = flags;
+  msg.ifa_index = index;
+  std::string attrs;
+  if (ip.family() == AF_INET) {
+    in_addr addr = ip.ipv4_address();
+    attrs = MakeAttribute(IFA_ADDRESS, &addr, sizeof(addr));
+  } else {
+    in6_addr addr = ip.ipv6_address();
+    attrs = MakeAttribute(IFA_ADDRESS, &addr, sizeof(addr));
+  }
+  AppendMessage(buffer, type, &msg, sizeof(msg), attrs);
+}
+
+class LinuxNetworkMonitorTest : public testing::Test,
+                                public sigslot::has_slots<> {
+ public:
+  LinuxNetworkMonitorTest() : monitor_(&ss_), resyncs_(0) {
+    monitor_.SignalAddressAdded.connect(
+        this, &LinuxNetworkMonitorTest::OnAddressAdded);
+    monitor_.SignalAddressRemoved.connect(
+        this, &LinuxNetworkMonitorTest::OnAddressRemoved);
+    monitor_.SignalInterfaceRemoved.connect(
+        this, &LinuxNetworkMonitorTest::OnInterfaceRemoved);
+    monitor_.SignalResyncNeeded.connect(
+        this, &LinuxNetworkMonitorTest::OnResyncNeeded);
+  }
+
+  void OnAddressAdded(const InterfaceAddress& address) {
+    added_.push_back(address);
+  }
+  void OnAddressRemoved(const InterfaceAddress& address) {
+    removed_.push_back(address);
+  }
+  void OnInterfaceRemoved(const std::string& name) {
+    removed_interfaces_.push_back(name);
+  }
+  void OnResyncNeeded() {
+    ++resyncs_;
+  }
+
+  void Parse(const std::string& buffer) {
+    monitor_.ParseMessages(buffer.data(), static_cast<int>(buffer.size()));
+  }
+
+ protected:
+  PhysicalSocketServer ss_;
+  LinuxNetworkMonitor monitor_;
+  std::vector<InterfaceAddress> added_;
+  std::vector<InterfaceAddress> removed_;
+  std::vector<std::string> removed_interfaces_;
+  int resyncs_;
+};
+
+// Test that address messages are reported with the name of their interface.
+TEST_F(LinuxNetworkMonitorTest, TestAddressMessages) {
+  IPAddress ipv4, ipv6;
+  EXPECT_TRUE(IPFromString("192.168.1.1", &ipv4));
+  EXPECT_TRUE(IPFromString("2401:fa00:4:1000:be30:5bff:fee5:c3", &ipv6));
+  std::string buffer;
+  AppendLinkMessage(&buffer, RTM_NEWLINK, kTestIndex, "test_eth0");
+  AppendAddressMessage(&buffer, RTM_NEWADDR, kTestIndex, ipv4, 24, 0);
+  // Not usable until duplicate address detection is done.
+  AppendAddressMessage(&buffer, RTM_NEWADDR, kTestIndex, ipv6, 64,
+                       IFA_F_TENTATIVE);
+  AppendAddressMessage(&buffer, RTM_NEWADDR, kTestIndex, ipv6, 64, 0);
+  AppendAddressMessage(&buffer, RTM_DELADDR, kTestIndex, ipv4, 24, 0);
+  Parse(buffer);
+
+  ASSERT_EQ(2U, added_.size());
+  EXPECT_EQ("test_eth0", added_[0].name);
+  EXPECT_EQ(kTestIndex, added_[0].index);
+  EXPECT_EQ(ipv4, added_[0].ip);
+  EXPECT_EQ(24, added_[0].prefix_length);
+  EXPECT_EQ("test_eth0", added_[1].name);
+  EXPECT_EQ(ipv6, added_[1].ip);
+  EXPECT_EQ(64, added_[1].prefix_length);
+  ASSERT_EQ(1U, removed_.size());
+  EXPECT_EQ(ipv4, removed_[0].ip);
+  EXPECT_TRUE(removed_interfaces_.empty());
+  EXPECT_EQ(0, resyncs_);
+}
+
+// Test that a removed interface is reported by the name it had, and that its
+// index is forgotten afterwards.
+TEST_F(LinuxNetworkMonitorTest, TestLinkMessages) {
+  IPAddress ip;
+  EXPECT_TRUE(IPFromString("192.168.1.1", &ip));
+  std::string buffer;
+  AppendLinkMessage(&buffer, RTM_NEWLINK, kTestIndex, "test_eth0");
+  AppendLinkMessage(&buffer, RTM_DELLINK, kTestIndex, "");
+  AppendAddressMessage(&buffer, RTM_NEWADDR, kTestIndex, ip, 24, 0);
+  Parse(buffer);
+
+  ASSERT_EQ(1U, removed_interfaces_.size());
+  EXPECT_EQ("test_eth0", removed_interfaces_[0]);
+  EXPECT_TRUE(added_.empty());
+}
+
+// Test that lost notifications ask for a full rescan.
+TEST_F(LinuxNetworkMonitorTest, TestOverrun) {
+  std::string buffer;
+  AppendMessage(&buffer, NLMSG_OVERRUN, NULL, 0, "");
+  Parse(buffer);
+  EXPECT_EQ(1, resyncs_);
+}
+
+// Test that a truncated message is ignored.
+TEST_F(LinuxNetworkMonitorTest, TestTruncatedMessage) {
+  IPAddress ip;
+  EXPECT_TRUE(IPFromString("192.168.1.1", &ip));
+  std::string buffer;
+  AppendLinkMessage(&buffer, RTM_NEWLINK, kTestIndex, "test_eth0");
+  AppendAddressMessage(&buffer, RTM_NEWADDR, kTestIndex, ip, 24, 0);
+  buffer.resize(buffer.size() - 4);
+  Parse(buffer);
+  EXPECT_TRUE(added_.empty());
+}
+
+TEST_F(LinuxNetworkMonitorTest, TestStartStop) {
+  EXPECT_FALSE(monitor_.started());
+  EXPECT_TRUE(monitor_.Start());
+  EXPECT_TRUE(monitor_.started());
+  EXPECT_TRUE(monitor_.Start());
+  monitor_.Stop();
+  EXPECT_FALSE(monitor_.started());
+}
+
+}  // namespace talk_base
@@ -105,6 +105,17 @@ size_t ComputeHmac(MessageDigest* digest, const void* key, size_t key_len,
 size_t ComputeHmac(const std::string& alg, const void* key, size_t key_len,
                    const void* input, size_t in_len,
                    void* output, size_t out_len);
+// A piece of a discontiguous input.
+struct DigestSegment {
+  const void* data;
+  size_t len;
+};
+// Like ComputeHmac above, but the input is the concatenation of
+// |num_segments| segments, which lets callers that need to patch a few bytes
+// of a large input (e.g. a STUN length field) avoid copying all of it.
+size_t ComputeHmac(MessageDigest* digest, const void* key, size_t key_len,
+                   const DigestSegment* segments, size_t num_segments,
+                   void* output, size_t out_len);
 // Computes the HMAC of |input| using the |digest| hash implementation and |key|
 // to key the HMAC, and returns it as a hex-encoded string.
 std::string ComputeHmac(MessageDigest* digest, const std::string& key,
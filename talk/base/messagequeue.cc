@@ -39,6 +39,17 @@ namespace talk_base {
 
 const uint32 kMaxMsgLatency = 150;  // 150 ms
 
+// Spare message nodes kept per queue for reuse.
+static const size_t kMaxFreeNodes = 256;
+static const size_t kNotDelayed = static_cast<size_t>(-1);
+
+// Delayed messages run in trigger order, and those with the same trigger
+// in the order they were posted.
+static inline bool RunsBefore(uint32 trigger1, uint32 num1,
+                              uint32 trigger2, uint32 num2) {
+  return trigger1 < trigger2 || (trigger1 == trigger2 && num1 < num2);
+}
+
 //------------------------------------------------------------------
 // MessageQueueManager
 
@@ -103,7 +114,8 @@ void MessageQueueManager::Clear(MessageHandler *handler) {
 
 MessageQueue::MessageQueue(SocketServer* ss)
     : ss_(ss), fStop_(false), fPeekKeep_(false), active_(false),
-      dmsgq_next_num_(0) {
+      ready_head_(NULL), ready_tail_(NULL), ready_size_(0),
+      dmsgq_next_num_(0), free_nodes_(NULL), free_size_(0) {
   if (!ss_) {
     // Currently, MessageQueue holds a socket server, and is the base class for
     // Thread.  It seems like it makes more sense for Thread to hold the socket
@@ -128,6 +140,11 @@ MessageQueue::~MessageQueue() {
   if (ss_) {
     ss_->SetMessageQueue(NULL);
   }
+  while (free_nodes_) {
+    MessageNode* node = free_nodes_;
+    free_nodes_ = node->next;
+    delete node;
+  }
 }
 
 void MessageQueue::set_socketserver(SocketServer* ss) {
@@ -189,18 +206,21 @@ bool MessageQueue::Get(Message *pmsg, int cmsWait, bool process_io) {
       // Check for delayed messages that have been triggered
       // Calc the next trigger too
 
-      while (!dmsgq_.empty()) {
-        if (TimeIsLater(msCurrent, dmsgq_.top().msTrigger_)) {
-          cmsDelayNext = TimeDiff(dmsgq_.top().msTrigger_, msCurrent);
+      while (!delayed_.empty()) {
+        MessageNode* node = delayed_[0];
+        if (TimeIsLater(msCurrent, node->trigger)) {
+          cmsDelayNext = TimeDiff(node->trigger, msCurrent);
           break;
         }
-        msgq_.push_back(dmsgq_.top().msg_);
-        dmsgq_.pop();
+        UnlinkDelayed(node);
+        node->ready_ns = TimeNanos();
+        PushReady(node);
       }
 
       // Check for posted events
-      while (!msgq_.empty()) {
-        *pmsg = msgq_.front();
+      while (ready_head_) {
+        MessageNode* node = ready_head_;
+        *pmsg = node->msg;
         if (pmsg->ts_sensitive) {
           long delay = TimeDiff(msCurrent, pmsg->ts_sensitive);
           if (delay > 0) {
@@ -208,7 +228,14 @@ bool MessageQueue::Get(Message *pmsg, int cmsWait, bool process_io) {
                               << (delay + kMaxMsgLatency) << "ms";
           }
         }
-        msgq_.pop_front();
+        uint32 latency_us = static_cast<uint32>(
+            (TimeNanos() - node->ready_ns) / kNumNanosecsPerMicrosec);
+        ++stats_.dispatched;
+        stats_.total_latency_us += latency_us;
+        stats_.max_latency_us = _max(stats_.max_latency_us, latency_us);
+        UnlinkReady(node);
+        UnlinkHandler(node);
+        FreeNode(node);
         if (MQID_DISPOSE == pmsg->message_id) {
           ASSERT(NULL == pmsg->phandler);
           delete pmsg->pdata;
@@ -262,14 +289,12 @@ void MessageQueue::Post(MessageHandler *phandler, uint32 id,
   // Add the message to the end of the queue
   // Signal for the multiplexer to return
   EnsureActive();
-  Message msg;
-  msg.phandler = phandler;
-  msg.message_id = id;
-  msg.pdata = pdata;
+  MessageNode* node = NewNode(phandler, id, pdata);
   if (time_sensitive) {
-    msg.ts_sensitive = Time() + kMaxMsgLatency;
+    node->msg.ts_sensitive = Time() + kMaxMsgLatency;
   }
-  msgq_.push_back(msg);
+  node->ready_ns = TimeNanos();
+  PushReady(node);
   ss_->WakeUp();
 }
 
@@ -285,12 +310,10 @@ void MessageQueue::DoDelayPost(int cmsDelay, uint32 tstamp,
   // Add to the priority queue. Gets sorted soonest first.
   // Signal for the multiplexer to return.
   EnsureActive();
-  Message msg;
-  msg.phandler = phandler;
-  msg.message_id = id;
-  msg.pdata = pdata;
-  DelayedMessage dmsg(cmsDelay, tstamp, dmsgq_next_num_, msg);
-  dmsgq_.push(dmsg);
+  MessageNode* node = NewNode(phandler, id, pdata);
+  node->trigger = tstamp;
+  node->num = dmsgq_next_num_;
+  PushDelayed(node);
   // If this message queue processes 1 message every millisecond for 50 days,
   // we will wrap this number.  Even then, only messages with identical times
   // will be misordered, and then only briefly.  This is probably ok.
@@ -301,11 +324,11 @@ void MessageQueue::DoDelayPost(int cmsDelay, uint32 tstamp,
 int MessageQueue::GetDelay() {
   CritScope cs(&crit_);
 
-  if (!msgq_.empty())
+  if (ready_head_)
     return 0;
 
-  if (!dmsgq_.empty()) {
-    int delay = TimeUntil(dmsgq_.top().msTrigger_);
+  if (!delayed_.empty()) {
+    int delay = TimeUntil(delayed_[0]->trigger);
     if (delay < 0)
       delay = 0;
     return delay;
@@ -329,38 +352,65 @@ void MessageQueue::Clear(MessageHandler *phandler, uint32 id,
     fPeekKeep_ = false;
   }
 
-  // Remove from ordered message queue
-
-  for (MessageList::iterator it = msgq_.begin(); it != msgq_.end();) {
-    if (it->Match(phandler, id)) {
-      if (removed) {
-        removed->push_back(*it);
-      } else {
-        delete it->pdata;
+  if (phandler) {
+    // Only this handler's messages can match, so walk its list.
+    MessageNode** head = handlers_.Find(phandler);
+    if (!head) {
+      return;
+    }
+    MessageNode* node = *head;
+    MessageNode* last = node->handler_prev;
+    for (;;) {
+      MessageNode* next = node->handler_next;
+      bool done = (node == last);
+      if (node->msg.Match(phandler, id)) {
+        if (node->heap_index != kNotDelayed) {
+          UnlinkDelayed(node);
+        } else {
+          UnlinkReady(node);
+        }
+        RemoveNode(node, removed);
       }
-      it = msgq_.erase(it);
-    } else {
-      ++it;
+      if (done) {
+        break;
+      }
+      node = next;
     }
+    return;
   }
 
-  // Remove from priority queue. Not directly iterable, so use this approach
-
-  PriorityQueue::container_type::iterator new_end = dmsgq_.container().begin();
-  for (PriorityQueue::container_type::iterator it = new_end;
-       it != dmsgq_.container().end(); ++it) {
-    if (it->msg_.Match(phandler, id)) {
-      if (removed) {
-        removed->push_back(it->msg_);
-      } else {
-        delete it->msg_.pdata;
-      }
+  // Any message may match; check the ready list, then the delayed heap.
+  for (MessageNode* node = ready_head_; node != NULL;) {
+    MessageNode* next = node->next;
+    if (node->msg.Match(phandler, id)) {
+      UnlinkReady(node);
+      RemoveNode(node, removed);
+    }
+    node = next;
+  }
+  // Removing from the heap reorders it, so compact it and then rebuild it.
+  size_t kept = 0;
+  for (size_t i = 0; i < delayed_.size(); ++i) {
+    MessageNode* node = delayed_[i];
+    if (node->msg.Match(phandler, id)) {
+      RemoveNode(node, removed);
     } else {
-      *new_end++ = *it;
+      delayed_[kept++] = node;
     }
   }
-  dmsgq_.container().erase(new_end, dmsgq_.container().end());
-  dmsgq_.reheap();
+  delayed_.resize(kept);
+  for (size_t i = kept / 2; i-- > 0;) {
+    SiftDown(i);
+  }
+  for (size_t i = 0; i < kept; ++i) {
+    delayed_[i]->heap_index = i;
+  }
+}
+
+void MessageQueue::GetStats(MessageQueueStats* stats) const {
+  CritScope cs(&crit_);
+  *stats = stats_;
+  stats->depth = ready_size_ + delayed_.size();
 }
 
 void MessageQueue::Dispatch(Message *pmsg) {
@@ -375,4 +425,169 @@ void MessageQueue::EnsureActive() {
   }
 }
 
+MessageQueue::MessageNode* MessageQueue::NewNode(MessageHandler* phandler,
+                                                 uint32 id,
+                                                 MessageData* pdata) {
+  ASSERT(crit_.CurrentThreadIsOwner());
+  MessageNode* node = free_nodes_;
+  if (node) {
+    free_nodes_ = node->next;
+    --free_size_;
+  } else {
+    node = new MessageNode;
+    ++stats_.allocations;
+  }
+  node->msg = Message();
+  node->msg.phandler = phandler;
+  node->msg.message_id = id;
+  node->msg.pdata = pdata;
+  node->trigger = 0;
+  node->num = 0;
+  node->heap_index = kNotDelayed;
+  node->ready_ns = 0;
+  node->prev = node->next = NULL;
+  LinkHandler(node);
+  ++stats_.posted;
+  stats_.max_depth = _max(stats_.max_depth,
+                          ready_size_ + delayed_.size() + 1);
+  return node;
+}
+
+// The caller must already have taken |node| off the ready list or heap.
+void MessageQueue::RemoveNode(MessageNode* node, MessageList* removed) {
+  if (removed) {
+    removed->push_back(node->msg);
+  } else {
+    delete node->msg.pdata;
+  }
+  UnlinkHandler(node);
+  FreeNode(node);
+}
+
+void MessageQueue::FreeNode(MessageNode* node) {
+  if (free_size_ < kMaxFreeNodes) {
+    node->next = free_nodes_;
+    free_nodes_ = node;
+    ++free_size_;
+  } else {
+    delete node;
+  }
+}
+
+void MessageQueue::PushReady(MessageNode* node) {
+  node->prev = ready_tail_;
+  node->next = NULL;
+  if (ready_tail_) {
+    ready_tail_->next = node;
+  } else {
+    ready_head_ = node;
+  }
+  ready_tail_ = node;
+  ++ready_size_;
+}
+
+void MessageQueue::UnlinkReady(MessageNode* node) {
+  if (node->prev) {
+    node->prev->next = node->next;
+  } else {
+    ready_head_ = node->next;
+  }
+  if (node->next) {
+    node->next->prev = node->prev;
+  } else {
+    ready_tail_ = node->prev;
+  }
+  node->prev = node->next = NULL;
+  --ready_size_;
+}
+
+void MessageQueue::PushDelayed(MessageNode* node) {
+  delayed_.push_back(node);
+  SiftUp(delayed_.size() - 1);
+}
+
+void MessageQueue::UnlinkDelayed(MessageNode* node) {
+  size_t index = node->heap_index;
+  ASSERT(index < delayed_.size() && delayed_[index] == node);
+  MessageNode* last = delayed_.back();
+  delayed_.pop_back();
+  node->heap_index = kNotDelayed;
+  if (last != node) {
+    delayed_[index] = last;
+    SiftUp(index);
+    SiftDown(last->heap_index);
+  }
+}
+
+void MessageQueue::SiftUp(size_t index) {
+  MessageNode* node = delayed_[index];
+  while (index > 0) {
+    size_t parent = (index - 1) / 2;
+    MessageNode* p = delayed_[parent];
+    if (!RunsBefore(node->trigger, node->num, p->trigger, p->num)) {
+      break;
+    }
+    delayed_[index] = p;
+    p->heap_index = index;
+    index = parent;
+  }
+  delayed_[index] = node;
+  node->heap_index = index;
+}
+
+void MessageQueue::SiftDown(size_t index) {
+  MessageNode* node = delayed_[index];
+  size_t size = delayed_.size();
+  for (;;) {
+    size_t child = 2 * index + 1;
+    if (child >= size) {
+      break;
+    }
+    MessageNode* c = delayed_[child];
+    if (child + 1 < size) {
+      MessageNode* right = delayed_[child + 1];
+      if (RunsBefore(right->trigger, right->num, c->trigger, c->num)) {
+        c = right;
+        ++child;
+      }
+    }
+    if (!RunsBefore(c->trigger, c->num, node->trigger, node->num)) {
+      break;
+    }
+    delayed_[index] = c;
+    c->heap_index = index;
+    index = child;
+  }
+  delayed_[index] = node;
+  node->heap_index = index;
+}
+
+void MessageQueue::LinkHandler(MessageNode* node) {
+  MessageNode** head = handlers_.Find(node->msg.phandler);
+  if (!head) {
+    node->handler_prev = node->handler_next = node;
+    handlers_.Insert(node->msg.phandler, node);
+    return;
+  }
+  // Append at the tail, which is the head's predecessor.
+  MessageNode* tail = (*head)->handler_prev;
+  node->handler_prev = tail;
+  node->handler_next = *head;
+  tail->handler_next = node;
+  (*head)->handler_prev = node;
+}
+
+void MessageQueue::UnlinkHandler(MessageNode* node) {
+  if (node->handler_next == node) {
+    handlers_.Erase(node->msg.phandler);
+    return;
+  }
+  node->handler_prev->handler_next = node->handler_next;
+  node->handler_next->handler_prev = node->handler_prev;
+  MessageNode** head = handlers_.Find(node->msg.phandler);
+  if (*head == node) {
+    *head = node->handler_next;
+  }
+}
+
 }  // namespace talk_base
@@ -31,12 +31,12 @@
 #include <algorithm>
 #include <cstring>
 #include <list>
-#include <queue>
 #include <vector>
 
 #include "talk/base/basictypes.h"
 #include "talk/base/constructormagic.h"
 #include "talk/base/criticalsection.h"
+#include "talk/base/flathashmap.h"
 #include "talk/base/messagehandler.h"
 #include "talk/base/scoped_ptr.h"
 #include "talk/base/scoped_ref_ptr.h"
@@ -151,23 +151,23 @@ struct Message {
 
 typedef std::list<Message> MessageList;
 
-// DelayedMessage goes into a priority queue, sorted by trigger time.  Messages
-// with the same trigger time are processed in num_ (FIFO) order.
-
-class DelayedMessage {
- public:
-  DelayedMessage(int delay, uint32 trigger, uint32 num, const Message& msg)
-  : cmsDelay_(delay), msTrigger_(trigger), num_(num), msg_(msg) { }
-
-  bool operator< (const DelayedMessage& dmsg) const {
-    return (dmsg.msTrigger_ < msTrigger_)
-           || ((dmsg.msTrigger_ == msTrigger_) && (dmsg.num_ < num_));
+// Counters describing the traffic through a MessageQueue. Rates, such as
+// allocations per second, are the difference between two samples divided by
+// the time between them.
+struct MessageQueueStats {
+  MessageQueueStats()
+      : depth(0), max_depth(0), posted(0), dispatched(0),
+        total_latency_us(0), max_latency_us(0), allocations(0) {
   }
-
-  int cmsDelay_;  // for debugging
-  uint32 msTrigger_;
-  uint32 num_;
-  Message msg_;
+  size_t depth;             // Messages currently waiting, ready or delayed.
+  size_t max_depth;         // Largest depth seen.
+  uint64 posted;            // Messages posted, delayed or not.
+  uint64 dispatched;        // Messages returned by Get.
+  // Time from a message becoming ready (being posted, or its delay
+  // expiring) until Get returned it.
+  uint64 total_latency_us;
+  uint32 max_latency_us;
+  uint64 allocations;       // Message nodes taken from the heap.
 };
 
 class MessageQueue {
@@ -215,10 +215,12 @@ class MessageQueue {
 
   bool empty() const { return size() == 0u; }
   size_t size() const {
-    CritScope cs(&crit_);  // msgq_.size() is not thread safe.
-    return msgq_.size() + dmsgq_.size() + (fPeekKeep_ ? 1u : 0u);
+    CritScope cs(&crit_);
+    return ready_size_ + delayed_.size() + (fPeekKeep_ ? 1u : 0u);
   }
 
+  void GetStats(MessageQueueStats* stats) const;
+
   // Internally posts a message which causes the doomed object to be deleted
   template<class T> void Dispose(T* doomed) {
     if (doomed) {
@@ -231,16 +233,41 @@ class MessageQueue {
   sigslot::signal0<> SignalQueueDestroyed;
 
  protected:
-  class PriorityQueue : public std::priority_queue<DelayedMessage> {
-   public:
-    container_type& container() { return c; }
-    void reheap() { make_heap(c.begin(), c.end(), comp); }
+  // A queued message. Each node is on either the ready list or the delayed
+  // heap, and also on a circular list of the messages pending for its
+  // handler, so that Clear only has to visit that handler's messages.
+  // Nodes are recycled through a free list instead of being deleted.
+  struct MessageNode {
+    Message msg;
+    uint32 trigger;       // When a delayed message becomes ready.
+    uint32 num;           // Orders delayed messages with equal triggers.
+    size_t heap_index;    // Position in |delayed_|, or kNotDelayed.
+    uint64 ready_ns;      // When the message became ready.
+    MessageNode* prev;    // Ready list.
+    MessageNode* next;    // Ready list or free list.
+    MessageNode* handler_prev;
+    MessageNode* handler_next;
   };
+  typedef FlatHashMap<MessageHandler*, MessageNode*,
+                      HashPointer<MessageHandler*> > HandlerMap;
 
   void EnsureActive();
   void DoDelayPost(int cmsDelay, uint32 tstamp, MessageHandler *phandler,
                    uint32 id, MessageData* pdata);
 
+  MessageNode* NewNode(MessageHandler* phandler, uint32 id,
+                       MessageData* pdata);
+  void RemoveNode(MessageNode* node, MessageList* removed);
+  void FreeNode(MessageNode* node);
+  void PushReady(MessageNode* node);
+  void UnlinkReady(MessageNode* node);
+  void PushDelayed(MessageNode* node);
+  void UnlinkDelayed(MessageNode* node);
+  void SiftUp(size_t index);
+  void SiftDown(size_t index);
+  void LinkHandler(MessageNode* node);
+  void UnlinkHandler(MessageNode* node);
+
   // The SocketServer is not owned by MessageQueue.
   SocketServer* ss_;
   // If a server isn't supplied in the constructor, use this one.
@@ -251,9 +278,18 @@ class MessageQueue {
   // A message queue is active if it has ever had a message posted to it.
   // This also corresponds to being in MessageQueueManager's global list.
   bool active_;
-  MessageList msgq_;
-  PriorityQueue dmsgq_;
+  // Messages ready for dispatch, in FIFO order.
+  MessageNode* ready_head_;
+  MessageNode* ready_tail_;
+  size_t ready_size_;
+  // Delayed messages, as a binary min-heap on (trigger, num).
+  std::vector<MessageNode*> delayed_;
   uint32 dmsgq_next_num_;
+  // First pending message for each handler with any.
+  HandlerMap handlers_;
+  MessageNode* free_nodes_;
+  size_t free_size_;
+  MessageQueueStats stats_;
   mutable CriticalSection crit_;
 
  private:
@@ -60,3 +60,102 @@ TEST(MessageQueue, DelayedPostsWithIdenticalTimesAreProcessedInFifoOrder) {
   MessageQueue q_nullss(&nullss);
   DelayedPostsWithIdenticalTimesAreProcessedInFifoOrder(&q_nullss);
 }
+
+class NullHandler : public MessageHandler {
+ public:
+  virtual void OnMessage(Message* msg) {}
+};
+
+TEST(MessageQueue, ClearRemovesOnlyMatchingMessages) {
+  NullSocketServer nullss;
+  MessageQueue q(&nullss);
+  NullHandler handler1, handler2;
+  TimeStamp now = Time();
+  q.Post(&handler1, 1);
+  q.PostAt(now - 2, &handler2, 2);
+  q.PostAt(now + 100000, &handler1, 3);
+  q.Post(&handler2, 4);
+  q.Post(&handler1, 5);
+  q.PostAt(now - 1, &handler1, 1);
+  EXPECT_EQ(6u, q.size());
+
+  MessageList removed;
+  q.Clear(&handler1, 1, &removed);
+  ASSERT_EQ(2u, removed.size());
+  EXPECT_EQ(&handler1, removed.front().phandler);
+  EXPECT_EQ(1u, removed.front().message_id);
+  EXPECT_EQ(4u, q.size());
+
+  q.Clear(&handler1, 3);
+  EXPECT_EQ(3u, q.size());
+
+  // Expired delayed messages queue up behind the ones already posted.
+  Message msg;
+  EXPECT_TRUE(q.Get(&msg, 0));
+  EXPECT_EQ(4u, msg.message_id);
+  EXPECT_TRUE(q.Get(&msg, 0));
+  EXPECT_EQ(5u, msg.message_id);
+  EXPECT_TRUE(q.Get(&msg, 0));
+  EXPECT_EQ(2u, msg.message_id);
+  EXPECT_FALSE(q.Get(&msg, 0));
+
+  // Clearing a handler with nothing queued is a no-op.
+  q.Clear(&handler2);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(MessageQueue, ClearAllKeepsDelayedOrder) {
+  NullSocketServer nullss;
+  MessageQueue q(&nullss);
+  NullHandler handler;
+  TimeStamp now = Time();
+  for (uint32 i = 0; i < 20; ++i) {
+    q.PostAt(now - 20 + i, (i % 3 == 0) ? NULL : &handler, i);
+  }
+  q.Clear(NULL);
+  EXPECT_TRUE(q.empty());
+
+  for (uint32 i = 0; i < 20; ++i) {
+    q.PostAt(now - 20 + i, (i % 3 == 0) ? NULL : &handler, i);
+  }
+  // Drop every third message by id, from whichever handler.
+  for (uint32 i = 0; i < 20; i += 3) {
+    q.Clear(NULL, i);
+  }
+  Message msg;
+  for (uint32 i = 0; i < 20; ++i) {
+    if (i % 3 == 0)
+      continue;
+    EXPECT_TRUE(q.Get(&msg, 0));
+    EXPECT_EQ(i, msg.message_id);
+  }
+  EXPECT_FALSE(q.Get(&msg, 0));
+}
+
+TEST(MessageQueue, MessageNodesAreRecycled) {
+  NullSocketServer nullss;
+  MessageQueue q(&nullss);
+  NullHandler handler;
+  Message msg;
+  q.Post(&handler, 1);
+  q.PostDelayed(0, &handler, 2);
+  EXPECT_TRUE(q.Get(&msg, 0));
+  EXPECT_TRUE(q.Get(&msg, 0));
+
+  MessageQueueStats stats;
+  q.GetStats(&stats);
+  uint64 allocations = stats.allocations;
+  EXPECT_EQ(2u, allocations);
+  for (int i = 0; i < 1000; ++i) {
+    q.Post(&handler, 1);
+    q.PostDelayed(0, &handler, 2);
+    EXPECT_TRUE(q.Get(&msg, 0));
+    EXPECT_TRUE(q.Get(&msg, 0));
+  }
+  q.GetStats(&stats);
+  EXPECT_EQ(allocations, stats.allocations);
+  EXPECT_EQ(2002u, stats.posted);
+  EXPECT_EQ(2002u, stats.dispatched);
+  EXPECT_EQ(0u, stats.depth);
+  EXPECT_EQ(2u, stats.max_depth);
+}
@@ -54,6 +54,10 @@
 #include <cstdio>
 
 #include "talk/base/host.h"
+#if defined(LINUX) || defined(ANDROID)
+#include "talk/base/linuxnetworkmonitor.h"
+#include "talk/base/physicalsocketserver.h"
+#endif  // defined(LINUX) || defined(ANDROID)
 #include "talk/base/logging.h"
 #include "talk/base/scoped_ptr.h"
 #include "talk/base/socket.h"  // includes something that makes windows happy
@@ -81,6 +85,16 @@ std::string MakeNetworkKey(const std::string& name, const IPAddress& prefix,
   return ost.str();
 }
 
+#if defined(LINUX) || defined(ANDROID)
+// Address events don't carry the IFF_LOOPBACK flag that getifaddrs has, so
+// go by the address: all of 127/8 and ::1 are loopback.
+bool IsLoopbackAddress(const IPAddress& ip) {
+  if (ip.family() == AF_INET)
+    return (ip.v4AddressAsHostOrderInteger() >> 24) == 127;
+  return IPIsLoopback(ip);
+}
+#endif  // defined(LINUX) || defined(ANDROID)
+
 bool CompareNetworks(const Network* a, const Network* b) {
   if (a->prefix_length() == b->prefix_length()) {
     if (a->name() == b->name()) {
@@ -173,9 +187,84 @@ void NetworkManagerBase::MergeNetworkList(const NetworkList& new_networks,
   networks_ = merged_list;
 }
 
+bool NetworkManagerBase::AddNetwork(Network* network) {
+  scoped_ptr<Network> owned(network);
+  std::string key = MakeNetworkKey(network->name(), network->prefix(),
+                                   network->prefix_length());
+  NetworkMap::iterator existing = networks_map_.find(key);
+  if (existing == networks_map_.end()) {
+    networks_map_[key] = owned.release();
+    networks_.push_back(network);
+    return true;
+  }
+
+  Network* net = existing->second;
+  bool listed = std::find(networks_.begin(), networks_.end(), net) !=
+      networks_.end();
+  std::vector<IPAddress> ips;
+  if (listed)
+    ips = net->GetIPs();
+  bool changed = false;
+  const std::vector<IPAddress>& addresses = network->GetIPs();
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    if (std::find(ips.begin(), ips.end(), addresses[i]) == ips.end()) {
+      ips.push_back(addresses[i]);
+      changed = true;
+    }
+  }
+  if (!changed)
+    return false;
+  net->SetIPs(ips, true);
+  if (!listed)
+    networks_.push_back(net);
+  return true;
+}
+
+bool NetworkManagerBase::RemoveNetworkIP(const std::string& name,
+                                         const IPAddress& prefix,
+                                         int prefix_length,
+                                         const IPAddress& ip) {
+  NetworkMap::iterator existing =
+      networks_map_.find(MakeNetworkKey(name, prefix, prefix_length));
+  if (existing == networks_map_.end())
+    return false;
+  Network* net = existing->second;
+  NetworkList::iterator listed =
+      std::find(networks_.begin(), networks_.end(), net);
+  if (listed == networks_.end())
+    return false;
+
+  std::vector<IPAddress> ips = net->GetIPs();
+  std::vector<IPAddress>::iterator it = std::find(ips.begin(), ips.end(), ip);
+  if (it == ips.end())
+    return false;
+  ips.erase(it);
+  net->SetIPs(ips, true);
+  if (ips.empty())
+    networks_.erase(listed);
+  return true;
+}
+
+bool NetworkManagerBase::RemoveInterface(const std::string& name) {
+  bool changed = false;
+  NetworkList::iterator it = networks_.begin();
+  while (it != networks_.end()) {
+    if ((*it)->name() == name) {
+      it = networks_.erase(it);
+      changed = true;
+    } else {
+      ++it;
+    }
+  }
+  return changed;
+}
+
 BasicNetworkManager::BasicNetworkManager()
     : thread_(NULL),
-      start_count_(0) {
+      sent_first_update_(false),
+      start_count_(0),
+      network_monitor_ss_(NULL),
+      signal_pending_(false) {
 }
 
 BasicNetworkManager::~BasicNetworkManager() {
@@ -433,6 +522,10 @@ void BasicNetworkManager::StartUpdating() {
     if (sent_first_update_)
       thread_->Post(this, kSignalNetworksMessage);
   } else {
+#if defined(LINUX) || defined(ANDROID)
+    if (network_monitor_ss_)
+      StartNetworkMonitor();
+#endif  // defined(LINUX) || defined(ANDROID)
     thread_->Post(this, kUpdateNetworksMessage);
   }
   ++start_count_;
@@ -447,6 +540,10 @@ void BasicNetworkManager::StopUpdating() {
   if (!start_count_) {
     thread_->Clear(this);
     sent_first_update_ = false;
+    signal_pending_ = false;
+#if defined(LINUX) || defined(ANDROID)
+    monitor_.reset();
+#endif  // defined(LINUX) || defined(ANDROID)
   }
 }
 
@@ -457,6 +554,7 @@ void BasicNetworkManager::OnMessage(Message* msg) {
       break;
     }
     case kSignalNetworksMessage:  {
+      signal_pending_ = false;
       SignalNetworksChanged();
       break;
     }
@@ -483,8 +581,87 @@ void BasicNetworkManager::DoUpdateNetworks() {
     }
   }
 
-  thread_->PostDelayed(kNetworksUpdateIntervalMs, this, kUpdateNetworksMessage);
+  // The monitor reports changes as they happen, so there's nothing to poll.
+  if (!monitoring()) {
+    thread_->PostDelayed(kNetworksUpdateIntervalMs, this,
+                         kUpdateNetworksMessage);
+  }
+}
+
+void BasicNetworkManager::ScheduleNetworksChanged() {
+  // The kernel reports a new interface as a burst of messages; let the
+  // sessions re-gather once for all of them.
+  if (!signal_pending_) {
+    signal_pending_ = true;
+    thread_->Post(this, kSignalNetworksMessage);
+  }
+}
+
+bool BasicNetworkManager::monitoring() const {
+#if defined(LINUX) || defined(ANDROID)
+  return monitor_ && monitor_->started();
+#else
+  return false;
+#endif  // defined(LINUX) || defined(ANDROID)
+}
+
+#if defined(LINUX) || defined(ANDROID)
+void BasicNetworkManager::StartNetworkMonitor() {
+  monitor_.reset(new LinuxNetworkMonitor(network_monitor_ss_));
+  monitor_->SignalAddressAdded.connect(
+      this, &BasicNetworkManager::OnAddressAdded);
+  monitor_->SignalAddressRemoved.connect(
+      this, &BasicNetworkManager::OnAddressRemoved);
+  monitor_->SignalInterfaceRemoved.connect(
+      this, &BasicNetworkManager::OnInterfaceRemoved);
+  monitor_->SignalResyncNeeded.connect(
+      this, &BasicNetworkManager::OnResyncNeeded);
+  if (!monitor_->Start()) {
+    LOG(LS_WARNING) << "Network monitor unavailable; polling for changes";
+    monitor_.reset();
+  }
+}
+
+void BasicNetworkManager::OnAddressAdded(const InterfaceAddress& address) {
+  if (address.ip.family() == AF_INET6 && !ipv6_enabled())
+    return;
+  IPAddress prefix = TruncateIP(address.ip, address.prefix_length);
+  scoped_ptr<Network> network(new Network(address.name, address.name,
+                                          prefix, address.prefix_length));
+  // Like getifaddrs, only give link-local IPv6 addresses a scope. The only
+  // private IPv6 addresses are link-local and loopback ones.
+  if (address.ip.family() == AF_INET6 && IPIsPrivate(address.ip))
+    network->set_scope_id(address.index);
+  network->AddIP(address.ip);
+  if (IsLoopbackAddress(address.ip) || IsIgnoredNetwork(*network))
+    return;
+  LOG(LS_INFO) << "Address added: " << network->ToString();
+  if (AddNetwork(network.release()))
+    ScheduleNetworksChanged();
+}
+
+void BasicNetworkManager::OnAddressRemoved(const InterfaceAddress& address) {
+  IPAddress prefix = TruncateIP(address.ip, address.prefix_length);
+  if (RemoveNetworkIP(address.name, prefix, address.prefix_length,
+                      address.ip)) {
+    LOG(LS_INFO) << "Address removed from " << address.name;
+    ScheduleNetworksChanged();
+  }
+}
+
+void BasicNetworkManager::OnInterfaceRemoved(const std::string& name) {
+  if (RemoveInterface(name)) {
+    LOG(LS_INFO) << "Interface removed: " << name;
+    ScheduleNetworksChanged();
+  }
+}
+
+void BasicNetworkManager::OnResyncNeeded() {
+  // DoUpdateNetworks resumes polling if the monitor has stopped.
+  thread_->Clear(this, kUpdateNetworksMessage);
+  thread_->Post(this, kUpdateNetworksMessage);
 }
+#endif  // defined(LINUX) || defined(ANDROID)
 
 void BasicNetworkManager::DumpNetworks(bool include_ignored) {
   NetworkList list;
@@ -36,6 +36,7 @@
 #include "talk/base/basictypes.h"
 #include "talk/base/ipaddress.h"
 #include "talk/base/messagehandler.h"
+#include "talk/base/scoped_ptr.h"
 #include "talk/base/sigslot.h"
 
 #if defined(POSIX)
@@ -46,7 +47,12 @@ namespace talk_base {
 
 class Network;
 class NetworkSession;
+class PhysicalSocketServer;
 class Thread;
+#if defined(LINUX) || defined(ANDROID)
+class LinuxNetworkMonitor;
+struct InterfaceAddress;
+#endif  // defined(LINUX) || defined(ANDROID)
 
 // Generic network manager interface. It provides list of local
 // networks.
@@ -100,6 +106,19 @@ class NetworkManagerBase : public NetworkManager {
   // any change in the network list.
   void MergeNetworkList(const NetworkList& list, bool* changed);
 
+  // Incremental counterparts of MergeNetworkList, for when the OS reports
+  // single changes. AddNetwork takes ownership of |network| and adds its
+  // addresses to the network with the same key, reusing the existing object.
+  // RemoveNetworkIP drops |ip| from a network, and the network itself from
+  // the list once it has no addresses left. RemoveInterface drops every
+  // network of the interface |name|. All of them return true if the list
+  // changed. Dropped networks are kept in the map, so that they get reused if
+  // they come back.
+  bool AddNetwork(Network* network);
+  bool RemoveNetworkIP(const std::string& name, const IPAddress& prefix,
+                       int prefix_length, const IPAddress& ip);
+  bool RemoveInterface(const std::string& name);
+
  private:
   friend class NetworkTest;
   void DoUpdateNetworks();
@@ -112,7 +131,8 @@ class NetworkManagerBase : public NetworkManager {
 // Basic implementation of the NetworkManager interface that gets list
 // of networks using OS APIs.
 class BasicNetworkManager : public NetworkManagerBase,
-                            public MessageHandler {
+                            public MessageHandler,
+                            public sigslot::has_slots<> {
  public:
   BasicNetworkManager();
   virtual ~BasicNetworkManager();
@@ -120,6 +140,18 @@ class BasicNetworkManager : public NetworkManagerBase,
   virtual void StartUpdating();
   virtual void StopUpdating();
 
+  // Follows interface and address changes as the kernel reports them,
+  // instead of polling the full list every few seconds. Only supported on
+  // Linux. |socket_server| must be the PhysicalSocketServer run by the
+  // thread that calls StartUpdating(). NULL, the default, polls; so does a
+  // monitor that can't start. Must be set before StartUpdating().
+  PhysicalSocketServer* network_monitor_socket_server() const {
+    return network_monitor_ss_;
+  }
+  void set_network_monitor_socket_server(PhysicalSocketServer* socket_server) {
+    network_monitor_ss_ = socket_server;
+  }
+
   // Logs the available networks.
   virtual void DumpNetworks(bool include_ignored);
 
@@ -145,10 +177,25 @@ class BasicNetworkManager : public NetworkManagerBase,
   friend class NetworkTest;
 
   void DoUpdateNetworks();
+  // Posts SignalNetworksChanged, once for a burst of changes.
+  void ScheduleNetworksChanged();
+  bool monitoring() const;
+
+#if defined(LINUX) || defined(ANDROID)
+  void StartNetworkMonitor();
+  void OnAddressAdded(const InterfaceAddress& address);
+  void OnAddressRemoved(const InterfaceAddress& address);
+  void OnInterfaceRemoved(const std::string& name);
+  void OnResyncNeeded();
+
+  scoped_ptr<LinuxNetworkMonitor> monitor_;
+#endif  // defined(LINUX) || defined(ANDROID)
 
   Thread* thread_;
   bool sent_first_update_;
   int start_count_;
+  PhysicalSocketServer* network_monitor_ss_;
+  bool signal_pending_;
 };
 
 // Represents a Unix-type network interface, with a name and single address.
@@ -37,6 +37,11 @@
 #endif
 #endif
 #include "talk/base/gunit.h"
+#if defined(LINUX) || defined(ANDROID)
+#include "talk/base/linuxnetworkmonitor.h"
+#endif
+#include "talk/base/physicalsocketserver.h"
+#include "talk/base/thread.h"
 
 namespace talk_base {
 
@@ -54,6 +59,38 @@ class NetworkTest : public testing::Test, public sigslot::has_slots<>  {
     network_manager.MergeNetworkList(list, changed);
   }
 
+  bool AddNetwork(NetworkManagerBase& network_manager, Network* network) {
+    return network_manager.AddNetwork(network);
+  }
+
+  bool RemoveNetworkIP(NetworkManagerBase& network_manager,
+                       const Network& network, const IPAddress& ip) {
+    return network_manager.RemoveNetworkIP(network.name(), network.prefix(),
+                                           network.prefix_length(), ip);
+  }
+
+  bool RemoveInterface(NetworkManagerBase& network_manager,
+                       const std::string& name) {
+    return network_manager.RemoveInterface(name);
+  }
+
+#if defined(LINUX) || defined(ANDROID)
+  void OnAddressChanged(BasicNetworkManager& network_manager,
+                        const std::string& name, const IPAddress& ip,
+                        int prefix_length, bool added) {
+    InterfaceAddress address;
+    address.name = name;
+    address.index = 1;
+    address.ip = ip;
+    address.prefix_length = prefix_length;
+    if (added) {
+      network_manager.OnAddressAdded(address);
+    } else {
+      network_manager.OnAddressRemoved(address);
+    }
+  }
+#endif  // defined(LINUX) || defined(ANDROID)
+
   bool IsIgnoredNetwork(const Network& network) {
     return BasicNetworkManager::IsIgnoredNetwork(network);
   }
@@ -494,6 +531,148 @@ TEST_F(NetworkTest, TestIPv6Toggle) {
   EXPECT_FALSE(ipv6_found);
 }
 
+// Test that addresses can be added to and removed from the network list one
+// at a time, and that the network objects are reused.
+TEST_F(NetworkTest, TestIncrementalNetworkUpdates) {
+  BasicNetworkManager manager;
+  IPAddress ip1, ip2;
+  EXPECT_TRUE(IPFromString("192.168.1.1", &ip1));
+  EXPECT_TRUE(IPFromString("192.168.1.2", &ip2));
+  Network* net = new Network("test_eth0", "Test Network Adapter 1",
+                             IPAddress(0xC0A80100U), 24);
+  net->AddIP(ip1);
+  EXPECT_TRUE(AddNetwork(manager, net));
+
+  // The same address again is not a change.
+  Network* dup = new Network("test_eth0", "Test Network Adapter 1",
+                             IPAddress(0xC0A80100U), 24);
+  dup->AddIP(ip1);
+  EXPECT_FALSE(AddNetwork(manager, dup));
+
+  // A second address on the same network is added to the existing object.
+  Network* second = new Network("test_eth0", "Test Network Adapter 1",
+                                IPAddress(0xC0A80100U), 24);
+  second->AddIP(ip2);
+  EXPECT_TRUE(AddNetwork(manager, second));
+  NetworkManager::NetworkList list;
+  manager.GetNetworks(&list);
+  ASSERT_EQ(1U, list.size());
+  EXPECT_EQ(net, list[0]);
+  EXPECT_EQ(2U, net->GetIPs().size());
+
+  EXPECT_TRUE(RemoveNetworkIP(manager, *net, ip1));
+  EXPECT_FALSE(RemoveNetworkIP(manager, *net, ip1));
+  manager.GetNetworks(&list);
+  ASSERT_EQ(1U, list.size());
+  EXPECT_EQ(ip2, net->ip());
+
+  // The network leaves the list with its last address...
+  EXPECT_TRUE(RemoveNetworkIP(manager, *net, ip2));
+  manager.GetNetworks(&list);
+  EXPECT_TRUE(list.empty());
+
+  // ...and the same object comes back with a new one.
+  Network* back = new Network("test_eth0", "Test Network Adapter 1",
+                              IPAddress(0xC0A80100U), 24);
+  back->AddIP(ip1);
+  EXPECT_TRUE(AddNetwork(manager, back));
+  manager.GetNetworks(&list);
+  ASSERT_EQ(1U, list.size());
+  EXPECT_EQ(net, list[0]);
+  ASSERT_EQ(1U, net->GetIPs().size());
+  EXPECT_EQ(ip1, net->ip());
+}
+
+// Test that removing an interface drops all of its networks.
+TEST_F(NetworkTest, TestRemoveInterface) {
+  BasicNetworkManager manager;
+  IPAddress ip;
+  Network* net1 = new Network("test_eth0", "Test Network Adapter 1",
+                              IPAddress(0xC0A80100U), 24);
+  EXPECT_TRUE(IPFromString("192.168.1.1", &ip));
+  net1->AddIP(ip);
+  Network* net2 = new Network("test_eth0", "Test Network Adapter 1",
+                              IPAddress(0x0A000000U), 8);
+  EXPECT_TRUE(IPFromString("10.0.0.1", &ip));
+  net2->AddIP(ip);
+  Network* net3 = new Network("test_eth1", "Test Network Adapter 2",
+                              IPAddress(0x0A000000U), 8);
+  EXPECT_TRUE(IPFromString("10.0.0.2", &ip));
+  net3->AddIP(ip);
+  EXPECT_TRUE(AddNetwork(manager, net1));
+  EXPECT_TRUE(AddNetwork(manager, net2));
+  EXPECT_TRUE(AddNetwork(manager, net3));
+
+  EXPECT_TRUE(RemoveInterface(manager, "test_eth0"));
+  EXPECT_FALSE(RemoveInterface(manager, "test_eth0"));
+  NetworkManager::NetworkList list;
+  manager.GetNetworks(&list);
+  ASSERT_EQ(1U, list.size());
+  EXPECT_EQ(net3, list[0]);
+}
+
+#if defined(LINUX) || defined(ANDROID)
+// Test that the networks are still listed when changes come from the network
+// monitor instead of polling.
+TEST_F(NetworkTest, TestUpdateNetworksWithMonitor) {
+  BasicNetworkManager manager;
+  PhysicalSocketServer socket_server;
+  SocketServerScope scope(&socket_server);
+  manager.set_network_monitor_socket_server(&socket_server);
+  manager.SignalNetworksChanged.connect(
+      static_cast<NetworkTest*>(this), &NetworkTest::OnNetworksChanged);
+  manager.StartUpdating();
+  Thread::Current()->ProcessMessages(0);
+  EXPECT_TRUE(callback_called_);
+  manager.StopUpdating();
+  EXPECT_FALSE(manager.started());
+}
+
+// Test that the network monitor's events update the network list, and that a
+// burst of them is signaled once.
+TEST_F(NetworkTest, TestNetworkMonitorEvents) {
+  BasicNetworkManager manager;
+  manager.SignalNetworksChanged.connect(
+      static_cast<NetworkTest*>(this), &NetworkTest::OnNetworksChanged);
+  manager.StartUpdating();
+  Thread::Current()->ProcessMessages(0);
+  EXPECT_TRUE(callback_called_);
+  callback_called_ = false;
+
+  IPAddress ip1, ip2, loopback;
+  EXPECT_TRUE(IPFromString("192.168.1.1", &ip1));
+  EXPECT_TRUE(IPFromString("192.168.1.2", &ip2));
+  EXPECT_TRUE(IPFromString("127.0.0.2", &loopback));
+  OnAddressChanged(manager, "test_eth0", ip1, 24, true);
+  OnAddressChanged(manager, "test_eth0", ip2, 24, true);
+  OnAddressChanged(manager, "test_lo", loopback, 8, true);
+  EXPECT_FALSE(callback_called_);
+  Thread::Current()->ProcessMessages(0);
+  EXPECT_TRUE(callback_called_);
+
+  NetworkManager::NetworkList list;
+  manager.GetNetworks(&list);
+  Network* net = NULL;
+  for (size_t i = 0; i < list.size(); ++i) {
+    EXPECT_NE("test_lo", list[i]->name());
+    if (list[i]->name() == "test_eth0")
+      net = list[i];
+  }
+  ASSERT_TRUE(net != NULL);
+  EXPECT_EQ(2U, net->GetIPs().size());
+
+  callback_called_ = false;
+  OnAddressChanged(manager, "test_eth0", ip1, 24, false);
+  OnAddressChanged(manager, "test_eth0", ip2, 24, false);
+  Thread::Current()->ProcessMessages(0);
+  EXPECT_TRUE(callback_called_);
+  manager.GetNetworks(&list);
+  for (size_t i = 0; i < list.size(); ++i)
+    EXPECT_NE("test_eth0", list[i]->name());
+  manager.StopUpdating();
+}
+#endif  // defined(LINUX) || defined(ANDROID)
+
 #if defined(POSIX)
 // Verify that we correctly handle interfaces with no address.
 TEST_F(NetworkTest, TestConvertIfAddrsNoAddress) {
@@ -39,6 +39,9 @@
 #include <openssl/bn.h>
 #include <openssl/rsa.h>
 #include <openssl/crypto.h>
+#ifndef OPENSSL_NO_EC
+#include <openssl/ec.h>
+#endif
 
 #include "talk/base/helpers.h"
 #include "talk/base/logging.h"
@@ -49,7 +52,7 @@ namespace talk_base {
 // We could have exposed a myriad of parameters for the crypto stuff,
 // but keeping it simple seems best.
 
-// Strength of generated keys. Those are RSA.
+// Strength of generated RSA keys. ECDSA keys are on the P-256 curve.
 static const int KEY_LENGTH = 1024;
 
 // Random bits for certificate serial number
@@ -58,9 +61,42 @@ static const int SERIAL_RAND_BITS = 64;
 // Certificate validity lifetime
 static const int CERTIFICATE_LIFETIME = 60*60*24*365;  // one year, arbitrarily
 
+// Generate an ECDSA key pair. Caller is responsible for freeing the returned
+// object.
+static EVP_PKEY* MakeECDSAKey() {
+#if defined(OPENSSL_NO_EC) || OPENSSL_VERSION_NUMBER < 0x10000000L
+  // Before 1.0.0, certificates couldn't be signed with EC keys through EVP.
+  LOG(LS_ERROR) << "ECDSA keys are not supported";
+  return NULL;
+#else
+  EVP_PKEY* pkey = EVP_PKEY_new();
+  EC_KEY* ec_key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+  if (!pkey || !ec_key) {
+    EVP_PKEY_free(pkey);
+    EC_KEY_free(ec_key);
+    return NULL;
+  }
+  // Refer to the curve by name in the certificate; peers may not accept
+  // explicit curve parameters.
+  EC_KEY_set_asn1_flag(ec_key, OPENSSL_EC_NAMED_CURVE);
+  if (!EC_KEY_generate_key(ec_key) ||
+      !EVP_PKEY_assign_EC_KEY(pkey, ec_key)) {
+    EVP_PKEY_free(pkey);
+    EC_KEY_free(ec_key);
+    return NULL;
+  }
+  // ownership of ec_key was assigned, don't free it.
+  LOG(LS_INFO) << "Returning key pair";
+  return pkey;
+#endif
+}
+
 // Generate a key pair. Caller is responsible for freeing the returned object.
-static EVP_PKEY* MakeKey() {
+static EVP_PKEY* MakeKey(KeyType key_type) {
   LOG(LS_INFO) << "Making key pair";
+  if (key_type == KT_ECDSA)
+    return MakeECDSAKey();
+
   EVP_PKEY* pkey = EVP_PKEY_new();
 #if OPENSSL_VERSION_NUMBER < 0x00908000l
   // Only RSA_generate_key is available. Use that.
@@ -160,8 +196,8 @@ static void LogSSLErrors(const std::string& prefix) {
   }
 }
 
-OpenSSLKeyPair* OpenSSLKeyPair::Generate() {
-  EVP_PKEY* pkey = MakeKey();
+OpenSSLKeyPair* OpenSSLKeyPair::Generate(KeyType key_type) {
+  EVP_PKEY* pkey = MakeKey(key_type);
   if (!pkey) {
     LogSSLErrors("Generating key pair");
     return NULL;
@@ -283,8 +319,9 @@ void OpenSSLCertificate::AddReference() const {
   CRYPTO_add(&x509_->references, 1, CRYPTO_LOCK_X509);
 }
 
-OpenSSLIdentity* OpenSSLIdentity::Generate(const std::string& common_name) {
-  OpenSSLKeyPair *key_pair = OpenSSLKeyPair::Generate();
+OpenSSLIdentity* OpenSSLIdentity::Generate(const std::string& common_name,
+                                           KeyType key_type) {
+  OpenSSLKeyPair *key_pair = OpenSSLKeyPair::Generate(key_type);
   if (key_pair) {
     OpenSSLCertificate *certificate =
         OpenSSLCertificate::Generate(key_pair, common_name);
@@ -45,7 +45,7 @@ namespace talk_base {
 // which is reference counted inside the OpenSSL library.
 class OpenSSLKeyPair {
  public:
-  static OpenSSLKeyPair* Generate();
+  static OpenSSLKeyPair* Generate(KeyType key_type);
 
   virtual ~OpenSSLKeyPair();
 
@@ -114,7 +114,8 @@ class OpenSSLCertificate : public SSLCertificate {
 // them consistently.
 class OpenSSLIdentity : public SSLIdentity {
  public:
-  static OpenSSLIdentity* Generate(const std::string& common_name);
+  static OpenSSLIdentity* Generate(const std::string& common_name,
+                                   KeyType key_type);
 
   virtual ~OpenSSLIdentity() { }
 
@@ -35,11 +35,15 @@
 
 #include <openssl/bio.h>
 #include <openssl/crypto.h>
+#ifndef OPENSSL_NO_EC
+#include <openssl/ec.h>
+#endif
 #include <openssl/err.h>
 #include <openssl/rand.h>
 #include <openssl/ssl.h>
 #include <openssl/x509v3.h>
 
+#include <algorithm>
 #include <vector>
 
 #include "talk/base/common.h"
@@ -48,8 +52,12 @@
 #include "talk/base/openssladapter.h"
 #include "talk/base/openssldigest.h"
 #include "talk/base/opensslidentity.h"
+#include "talk/base/sslhandshakepool.h"
+#include "talk/base/sslsessioncache.h"
+#include "talk/base/stringencode.h"
 #include "talk/base/stringutils.h"
 #include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
 
 namespace talk_base {
 
@@ -61,6 +69,10 @@ namespace talk_base {
 #define HAVE_DTLS
 #endif
 
+#if !defined(OPENSSL_NO_TLSEXT) && defined(SSL_CTRL_SET_TLSEXT_TICKET_KEYS)
+#define HAVE_SESSION_TICKETS
+#endif
+
 #ifdef HAVE_DTLS_SRTP
 // SRTP cipher suite table
 struct SrtpCipherMapEntry {
@@ -194,7 +206,16 @@ OpenSSLStreamAdapter::OpenSSLStreamAdapter(StreamInterface* stream)
       ssl_read_needs_write_(false), ssl_write_needs_read_(false),
       ssl_(NULL), ssl_ctx_(NULL),
       custom_verification_succeeded_(false),
-      ssl_mode_(SSL_MODE_TLS) {
+      ssl_mode_(SSL_MODE_TLS),
+      handshake_pool_(NULL),
+      handshake_thread_(NULL),
+      owner_thread_(NULL),
+      handshake_pending_(false),
+      handshake_rerun_(false),
+      handshake_counted_(false),
+      handshake_start_(0),
+      session_cache_(NULL),
+      session_offered_(false) {
 }
 
 OpenSSLStreamAdapter::~OpenSSLStreamAdapter() {
@@ -347,6 +368,26 @@ void OpenSSLStreamAdapter::SetMode(SSLMode mode) {
   ssl_mode_ = mode;
 }
 
+bool OpenSSLStreamAdapter::SetHandshakePool(SSLHandshakePool* pool) {
+  ASSERT(state_ == SSL_NONE);
+  if (state_ != SSL_NONE)
+    return false;
+
+  handshake_pool_ = pool;
+  handshake_thread_ = pool ? pool->AssignThread() : NULL;
+  owner_thread_ = Thread::Current();
+  return true;
+}
+
+bool OpenSSLStreamAdapter::SetSessionCache(SSLSessionCache* cache) {
+  ASSERT(state_ == SSL_NONE);
+  if (state_ != SSL_NONE)
+    return false;
+
+  session_cache_ = cache;
+  return true;
+}
+
 //
 // StreamInterface Implementation
 //
@@ -610,6 +651,12 @@ int OpenSSLStreamAdapter::BeginSSL() {
                << (!ssl_server_name_.empty() ? ssl_server_name_ :
                                                "with peer");
 
+  if (handshake_pool_) {
+    handshake_pool_->OnHandshakeStarted();
+    handshake_counted_ = true;
+    handshake_start_ = Time();
+  }
+
   BIO* bio = NULL;
 
   // First set up the context
@@ -635,6 +682,22 @@ int OpenSSLStreamAdapter::BeginSSL() {
   SSL_set_mode(ssl_, SSL_MODE_ENABLE_PARTIAL_WRITE |
                SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 
+  if (session_cache_) {
+    session_key_ = GetSessionKey();
+    std::string session;
+    if (role_ == SSL_CLIENT && session_cache_->Lookup(session_key_, &session)) {
+      const unsigned char* p =
+          reinterpret_cast<const unsigned char*>(session.data());
+      SSL_SESSION* ssl_session = d2i_SSL_SESSION(NULL, &p, session.size());
+      if (ssl_session) {
+        LOG(LS_INFO) << "Offering to resume the previous session";
+        SSL_set_session(ssl_, ssl_session);  // Takes its own reference.
+        SSL_SESSION_free(ssl_session);
+        session_offered_ = true;
+      }
+    }
+  }
+
   // Do the connect
   return ContinueSSL();
 }
@@ -646,18 +709,52 @@ int OpenSSLStreamAdapter::ContinueSSL() {
   // Clear the DTLS timer
   Thread::Current()->Clear(this, MSG_TIMEOUT);
 
+  if (handshake_thread_) {
+    // A step that is already running may have missed whatever made us get
+    // called, so it needs to be followed by another.
+    if (handshake_pending_) {
+      handshake_rerun_ = true;
+    } else {
+      handshake_pending_ = true;
+      handshake_rerun_ = false;
+      handshake_thread_->Post(this, MSG_HANDSHAKE_STEP);
+    }
+    return 0;
+  }
+
+  return FinishHandshakeStep(DoHandshakeStep());
+}
+
+int OpenSSLStreamAdapter::DoHandshakeStep() {
   int code = (role_ == SSL_CLIENT) ? SSL_connect(ssl_) : SSL_accept(ssl_);
-  int ssl_error;
-  switch (ssl_error = SSL_get_error(ssl_, code)) {
+  int ssl_error = SSL_get_error(ssl_, code);
+  if (ssl_error == SSL_ERROR_NONE &&
+      !SSLPostConnectionCheck(ssl_, ssl_server_name_.c_str(),
+                              peer_certificate_ ?
+                                  peer_certificate_->x509() : NULL,
+                              peer_certificate_digest_algorithm_)) {
+    return kPostConnectionCheckFailed;
+  }
+  return ssl_error;
+}
+
+int OpenSSLStreamAdapter::FinishHandshakeStep(int ssl_error) {
+  switch (ssl_error) {
     case SSL_ERROR_NONE:
       LOG(LS_INFO) << " -- success";
 
-      if (!SSLPostConnectionCheck(ssl_, ssl_server_name_.c_str(),
-                                  peer_certificate_ ?
-                                      peer_certificate_->x509() : NULL,
-                                  peer_certificate_digest_algorithm_)) {
-        LOG(LS_ERROR) << "TLS post connection check failed";
-        return -1;
+      if (handshake_counted_) {
+        handshake_pool_->OnHandshakeFinished(true, TimeSince(handshake_start_));
+        handshake_counted_ = false;
+      }
+
+      if (session_cache_) {
+        bool resumed = SSL_session_reused(ssl_) != 0;
+        LOG(LS_INFO) << (resumed ? " -- resumed session" : " -- new session");
+        session_cache_->OnHandshakeFinished(resumed);
+        // The server may have issued a new ticket even when resuming.
+        if (role_ == SSL_CLIENT)
+          StoreSession();
       }
 
       state_ = SSL_CONNECTED;
@@ -681,18 +778,39 @@ int OpenSSLStreamAdapter::ContinueSSL() {
       LOG(LS_INFO) << " -- error want write";
       break;
 
+    case kPostConnectionCheckFailed:
+      LOG(LS_ERROR) << "TLS post connection check failed";
+      return -1;
+
     case SSL_ERROR_ZERO_RETURN:
     default:
-      LOG(LS_INFO) << " -- error " << code;
+      LOG(LS_INFO) << " -- error " << ssl_error;
       return (ssl_error != 0) ? ssl_error : -1;
   }
 
   return 0;
 }
 
+void OpenSSLStreamAdapter::CancelHandshakeStep() {
+  if (!handshake_pending_)
+    return;
+
+  // Drop the step if it hasn't started yet. Messages to one thread are
+  // handled in order, so once the sync message has been, a running step has
+  // returned and posted its result, which we drop as well.
+  handshake_thread_->Clear(this, MSG_HANDSHAKE_STEP);
+  handshake_thread_->Send(this, MSG_HANDSHAKE_SYNC);
+  owner_thread_->Clear(this, MSG_HANDSHAKE_DONE);
+  handshake_pending_ = false;
+  handshake_rerun_ = false;
+}
+
 void OpenSSLStreamAdapter::Error(const char* context, int err, bool signal) {
   LOG(LS_WARNING) << "OpenSSLStreamAdapter::Error("
                   << context << ", " << err << ")";
+  // Don't offer a session that may be why the handshake failed again.
+  if (state_ == SSL_CONNECTING && session_offered_)
+    session_cache_->Remove(session_key_);
   state_ = SSL_ERROR;
   ssl_error_code_ = err;
   Cleanup();
@@ -708,6 +826,13 @@ void OpenSSLStreamAdapter::Cleanup() {
     ssl_error_code_ = 0;
   }
 
+  // The SSL object mustn't go away under a handshake step.
+  CancelHandshakeStep();
+  if (handshake_counted_) {
+    handshake_pool_->OnHandshakeFinished(false, 0);
+    handshake_counted_ = false;
+  }
+
   if (ssl_) {
     SSL_free(ssl_);
     ssl_ = NULL;
@@ -732,6 +857,25 @@ void OpenSSLStreamAdapter::OnMessage(Message* msg) {
     DTLSv1_handle_timeout(ssl_);
 #endif
     ContinueSSL();
+  } else if (MSG_HANDSHAKE_STEP == msg->message_id) {
+    // On handshake_thread_.
+    owner_thread_->Post(this, MSG_HANDSHAKE_DONE,
+                        new TypedMessageData<int>(DoHandshakeStep()));
+  } else if (MSG_HANDSHAKE_SYNC == msg->message_id) {
+    // Nothing to do; see CancelHandshakeStep().
+  } else if (MSG_HANDSHAKE_DONE == msg->message_id) {
+    scoped_ptr<TypedMessageData<int> > result(
+        static_cast<TypedMessageData<int>*>(msg->pdata));
+    ASSERT(handshake_pending_);
+    handshake_pending_ = false;
+    if (state_ != SSL_CONNECTING)
+      return;
+
+    int err = FinishHandshakeStep(result->data());
+    if (!err && state_ == SSL_CONNECTING && handshake_rerun_)
+      err = ContinueSSL();
+    if (err)
+      Error("ContinueSSL", err, true);
   } else {
     StreamInterface::OnMessage(msg);
   }
@@ -775,6 +919,31 @@ SSL_CTX* OpenSSLStreamAdapter::SetupSSLContext() {
     // we must specify which client cert to ask for
     SSL_CTX_add_client_CA(ctx, peer_certificate_->x509());
 
+  if (session_cache_ && role_ == SSL_SERVER && identity_) {
+    // Each stream has its own context, and so its own server-side session
+    // cache, which a reconnecting client would never find its session in.
+    // Instead the session travels with the client as a ticket, sealed under
+    // keys that every context for our identity shares. Sessions may only be
+    // resumed within the same session id context, so that is tied to our
+    // identity too.
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    size_t digest_len = 0;
+    if (OpenSSLCertificate::ComputeDigest(identity_->certificate().x509(),
+                                          DIGEST_SHA_256, digest,
+                                          sizeof(digest), &digest_len)) {
+      SSL_CTX_set_session_id_context(
+          ctx, digest, std::min<size_t>(digest_len, SSL_MAX_SID_CTX_LENGTH));
+#ifdef HAVE_SESSION_TICKETS
+      std::string keys = session_cache_->GetTicketKeys(
+          hex_encode(reinterpret_cast<char*>(digest), digest_len));
+      if (keys.size() == SSLSessionCache::kTicketKeysLength) {
+        SSL_CTX_set_tlsext_ticket_keys(ctx, const_cast<char*>(keys.data()),
+                                       keys.size());
+      }
+#endif
+    }
+  }
+
 #ifdef _DEBUG
   SSL_CTX_set_info_callback(ctx, OpenSSLAdapter::SSLInfoCallback);
 #endif
@@ -784,6 +953,18 @@ SSL_CTX* OpenSSLStreamAdapter::SetupSSLContext() {
   SSL_CTX_set_verify_depth(ctx, 4);
   SSL_CTX_set_cipher_list(ctx, "ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
 
+#ifndef OPENSSL_NO_ECDH
+  // The ECDHE suites, which are the only ones that an ECDSA identity can be
+  // used with, need a curve for the ephemeral keys.
+  if (role_ == SSL_SERVER) {
+    EC_KEY* ecdh = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+    if (ecdh) {
+      SSL_CTX_set_tmp_ecdh(ctx, ecdh);
+      EC_KEY_free(ecdh);
+    }
+  }
+#endif
+
 #ifdef HAVE_DTLS_SRTP
   if (!srtp_ciphers_.empty()) {
     if (SSL_CTX_set_tlsext_use_srtp(ctx, srtp_ciphers_.c_str())) {
@@ -796,6 +977,64 @@ SSL_CTX* OpenSSLStreamAdapter::SetupSSLContext() {
   return ctx;
 }
 
+std::string OpenSSLStreamAdapter::GetSessionKey() const {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  size_t digest_len;
+  std::string local_id;
+  if (identity_ &&
+      OpenSSLCertificate::ComputeDigest(identity_->certificate().x509(),
+                                        DIGEST_SHA_256, digest,
+                                        sizeof(digest), &digest_len)) {
+    local_id = hex_encode(reinterpret_cast<char*>(digest), digest_len);
+  }
+
+  std::string remote_id;
+  if (!ssl_server_name_.empty()) {
+    remote_id = ssl_server_name_;
+  } else if (peer_certificate_ &&
+             OpenSSLCertificate::ComputeDigest(peer_certificate_->x509(),
+                                               DIGEST_SHA_256, digest,
+                                               sizeof(digest), &digest_len)) {
+    remote_id = hex_encode(reinterpret_cast<char*>(digest), digest_len);
+  } else {
+    remote_id = peer_certificate_digest_algorithm_ + " " +
+        hex_encode(peer_certificate_digest_value_.data(),
+                   peer_certificate_digest_value_.length());
+  }
+
+  return SSLSessionCache::MakeKey(local_id, remote_id);
+}
+
+void OpenSSLStreamAdapter::StoreSession() {
+  SSL_SESSION* session = SSL_get_session(ssl_);
+  int len = session ? i2d_SSL_SESSION(session, NULL) : 0;
+  if (len <= 0)
+    return;
+
+  std::string data(len, '\0');
+  unsigned char* p = reinterpret_cast<unsigned char*>(&data[0]);
+  i2d_SSL_SESSION(session, &p);
+  session_cache_->Store(session_key_, data);
+}
+
+bool OpenSSLStreamAdapter::IsExpectedPeerCertificate(X509* cert) const {
+  if (peer_certificate_)
+    return X509_cmp(cert, peer_certificate_->x509()) == 0;
+
+  if (peer_certificate_digest_algorithm_.empty())
+    return false;
+
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  size_t digest_len;
+  if (!OpenSSLCertificate::ComputeDigest(cert,
+                                         peer_certificate_digest_algorithm_,
+                                         digest, sizeof(digest),
+                                         &digest_len)) {
+    return false;
+  }
+  return Buffer(digest, digest_len) == peer_certificate_digest_value_;
+}
+
 int OpenSSLStreamAdapter::SSLVerifyCallback(int ok, X509_STORE_CTX* store) {
 #if _DEBUG
   if (!ok) {
@@ -832,7 +1071,7 @@ int OpenSSLStreamAdapter::SSLVerifyCallback(int ok, X509_STORE_CTX* store) {
     // peer-to-peer mode: allow the certificate to be self-signed,
     // assuming it matches the cert that was specified.
     if (err == X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT &&
-        X509_cmp(cert, stream->peer_certificate_->x509()) == 0) {
+        stream->IsExpectedPeerCertificate(cert)) {
       LOG(LS_INFO) << "Accepted self-signed peer certificate authority";
       ok = 1;
     }
@@ -842,22 +1081,10 @@ int OpenSSLStreamAdapter::SSLVerifyCallback(int ok, X509_STORE_CTX* store) {
 
     // peer-to-peer mode: allow the certificate to be self-signed,
     // assuming it matches the digest that was specified.
-    if (err == X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT) {
-      unsigned char digest[EVP_MAX_MD_SIZE];
-      std::size_t digest_length;
-
-      if (OpenSSLCertificate::
-         ComputeDigest(cert,
-                       stream->peer_certificate_digest_algorithm_,
-                       digest, sizeof(digest),
-                       &digest_length)) {
-        Buffer computed_digest(digest, digest_length);
-        if (computed_digest == stream->peer_certificate_digest_value_) {
-          LOG(LS_INFO) <<
-              "Accepted self-signed peer certificate authority";
-          ok = 1;
-        }
-      }
+    if (err == X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT &&
+        stream->IsExpectedPeerCertificate(cert)) {
+      LOG(LS_INFO) << "Accepted self-signed peer certificate authority";
+      ok = 1;
     }
   } else if (!ok && OpenSSLAdapter::custom_verify_callback_) {
     // this applies only in traditional mode
@@ -898,6 +1125,19 @@ bool OpenSSLStreamAdapter::SSLPostConnectionCheck(SSL* ssl,
     ASSERT((peer_cert != NULL) || (!peer_digest.empty()));
     // no server name validation
     ok = true;
+
+    // A resumed session skips certificate verification; the peer's
+    // certificate is the one it presented when the session was negotiated.
+    // Client sessions are kept per peer, but a server can be handed a ticket
+    // that it issued to a different peer, so check it's the one we expect.
+    if (SSL_session_reused(ssl)) {
+      X509* cert = SSL_get_peer_certificate(ssl);
+      ok = cert && IsExpectedPeerCertificate(cert);
+      if (cert)
+        X509_free(cert);
+      if (!ok)
+        LOG(LS_WARNING) << "Resumed session has the wrong peer certificate";
+    }
   }
 
   if (!ok && ignore_bad_cert()) {
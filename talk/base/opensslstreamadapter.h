@@ -89,6 +89,8 @@ class OpenSSLStreamAdapter : public SSLStreamAdapter {
   virtual int StartSSLWithServer(const char* server_name);
   virtual int StartSSLWithPeer();
   virtual void SetMode(SSLMode mode);
+  virtual bool SetHandshakePool(SSLHandshakePool* pool);
+  virtual bool SetSessionCache(SSLSessionCache* cache);
 
   virtual StreamResult Read(void* data, size_t data_len,
                             size_t* read, int* error);
@@ -130,7 +132,15 @@ class OpenSSLStreamAdapter : public SSLStreamAdapter {
     SSL_CLOSED  // Clean close
   };
 
-  enum { MSG_TIMEOUT = MSG_MAX+1};
+  enum {
+    MSG_TIMEOUT = MSG_MAX+1,
+    MSG_HANDSHAKE_STEP,  // Runs a handshake step on handshake_thread_.
+    MSG_HANDSHAKE_DONE,  // Carries its result back to owner_thread_.
+    MSG_HANDSHAKE_SYNC   // See CancelHandshakeStep().
+  };
+
+  // Returned by DoHandshakeStep() when the post connection check fails.
+  enum { kPostConnectionCheckFailed = -1 };
 
   // The following three methods return 0 on success and a negative
   // error code on failure. The error code may be from OpenSSL or -1
@@ -145,6 +155,16 @@ class OpenSSLStreamAdapter : public SSLStreamAdapter {
   int BeginSSL();
   // Perform SSL negotiation steps.
   int ContinueSSL();
+  // The parts of ContinueSSL(). DoHandshakeStep() drives the handshake, and
+  // checks the peer once it has completed; it only uses the SSL object and
+  // the peer's expected identity, so it may run on handshake_thread_. It
+  // returns an SSL_ERROR_* code or kPostConnectionCheckFailed, which
+  // FinishHandshakeStep() acts upon on the stream's own thread.
+  int DoHandshakeStep();
+  int FinishHandshakeStep(int ssl_error);
+  // Makes sure that no handshake step is queued or running on
+  // handshake_thread_, waiting for a running one to return.
+  void CancelHandshakeStep();
 
   // Error handler helper. signal is given as true for errors in
   // asynchronous contexts (when an error method was not returned
@@ -163,6 +183,14 @@ class OpenSSLStreamAdapter : public SSLStreamAdapter {
 
   // SSL library configuration
   SSL_CTX* SetupSSLContext();
+  // The key that session_cache_ keeps our session under.
+  std::string GetSessionKey() const;
+  // Puts the session that was just negotiated in session_cache_.
+  void StoreSession();
+  // Whether |cert| is the certificate that the peer is expected to present,
+  // in peer-to-peer mode.
+  bool IsExpectedPeerCertificate(X509* cert) const;
+
   // SSL verification check
   bool SSLPostConnectionCheck(SSL* ssl, const char* server_name,
                               const X509* peer_cert,
@@ -206,6 +234,28 @@ class OpenSSLStreamAdapter : public SSLStreamAdapter {
 
   // Do DTLS or not
   SSLMode ssl_mode_;
+
+  // Set when the handshake is offloaded to handshake_pool_; NULL
+  // handshake_thread_ means that it runs inline. While handshake_pending_,
+  // a step is queued or running on handshake_thread_ and nothing else may
+  // touch ssl_; handshake_rerun_ records that the wrapped stream signalled
+  // in the meantime, so another step is due once it returns.
+  SSLHandshakePool* handshake_pool_;
+  Thread* handshake_thread_;
+  Thread* owner_thread_;
+  bool handshake_pending_;
+  bool handshake_rerun_;
+  // Whether handshake_pool_ counts our handshake as in progress, and when it
+  // started.
+  bool handshake_counted_;
+  uint32 handshake_start_;
+
+  // Where sessions are kept for resumption, if anywhere; session_offered_ is
+  // set when we are a client trying to resume the session under
+  // session_key_.
+  SSLSessionCache* session_cache_;
+  std::string session_key_;
+  bool session_offered_;
 };
 
 /////////////////////////////////////////////////////////////////////////////
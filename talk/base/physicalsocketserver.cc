@@ -40,6 +40,11 @@
 #include <signal.h>
 #endif
 
+#if defined(LINUX) || defined(ANDROID)
+#include <poll.h>
+#include <sys/epoll.h>
+#endif
+
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -105,6 +110,10 @@ static const int IP_HEADER_SIZE = 20u;
 static const int IPV6_HEADER_SIZE = 40u;
 static const int ICMP_HEADER_SIZE = 8u;
 static const int ICMP_PING_TIMEOUT_MILLIS = 10000u;
+// Upper bound on datagrams moved by one sendmmsg/recvmmsg call.
+static const size_t kMaxDatagramBatch = 64;
+// Most buffers gathered into one SendV call.
+static const size_t kMaxSendBuffers = 16;
 
 class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
  public:
@@ -141,7 +150,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     udp_ = (SOCK_DGRAM == type);
     UpdateLastError();
     if (udp_)
-      enabled_events_ = DE_READ | DE_WRITE;
+      SetEnabledEvents(DE_READ | DE_WRITE);
     return s_ != INVALID_SOCKET;
   }
 
@@ -224,12 +233,12 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
       state_ = CS_CONNECTED;
     } else if (IsBlockingError(error_)) {
       state_ = CS_CONNECTING;
-      enabled_events_ |= DE_CONNECT;
+      EnableEvents(DE_CONNECT);
     } else {
       return SOCKET_ERROR;
     }
 
-    enabled_events_ |= DE_READ | DE_WRITE;
+    EnableEvents(DE_READ | DE_WRITE);
     return 0;
   }
 
@@ -290,11 +299,38 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     // We have seen minidumps where this may be false.
     ASSERT(sent <= static_cast<int>(cb));
     if ((sent < 0) && IsBlockingError(error_)) {
-      enabled_events_ |= DE_WRITE;
+      EnableEvents(DE_WRITE);
     }
     return sent;
   }
 
+#ifdef POSIX
+  virtual int SendV(const IoBuffer* buffers, size_t count) {
+    if (count > kMaxSendBuffers)
+      count = kMaxSendBuffers;
+    iovec iovs[kMaxSendBuffers];
+    for (size_t i = 0; i < count; ++i) {
+      iovs[i].iov_base = const_cast<void*>(buffers[i].data);
+      iovs[i].iov_len = buffers[i].size;
+    }
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iovs;
+    msg.msg_iovlen = count;
+#ifdef LINUX
+    // Suppress SIGPIPE, as in Send.
+    int sent = ::sendmsg(s_, &msg, MSG_NOSIGNAL);
+#else
+    int sent = ::sendmsg(s_, &msg, 0);
+#endif
+    UpdateLastError();
+    if ((sent < 0) && IsBlockingError(error_)) {
+      EnableEvents(DE_WRITE);
+    }
+    return sent;
+  }
+#endif  // POSIX
+
   int SendTo(const void* buffer, size_t length, const SocketAddress& addr) {
     sockaddr_storage saddr;
     size_t len = addr.ToSockAddrStorage(&saddr);
@@ -311,7 +347,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     // We have seen minidumps where this may be false.
     ASSERT(sent <= static_cast<int>(length));
     if ((sent < 0) && IsBlockingError(error_)) {
-      enabled_events_ |= DE_WRITE;
+      EnableEvents(DE_WRITE);
     }
     return sent;
   }
@@ -326,14 +362,14 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
       LOG(LS_WARNING) << "EOF from socket; deferring close event";
       // Must turn this back on so that the select() loop will notice the close
       // event.
-      enabled_events_ |= DE_READ;
+      EnableEvents(DE_READ);
       error_ = EWOULDBLOCK;
       return SOCKET_ERROR;
     }
     UpdateLastError();
     bool success = (received >= 0) || IsBlockingError(error_);
     if (udp_ || success) {
-      enabled_events_ |= DE_READ;
+      EnableEvents(DE_READ);
     }
     if (!success) {
       LOG_F(LS_VERBOSE) << "Error = " << error_;
@@ -352,7 +388,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
       SocketAddressFromSockAddrStorage(addr_storage, out_addr);
     bool success = (received >= 0) || IsBlockingError(error_);
     if (udp_ || success) {
-      enabled_events_ |= DE_READ;
+      EnableEvents(DE_READ);
     }
     if (!success) {
       LOG_F(LS_VERBOSE) << "Error = " << error_;
@@ -360,12 +396,77 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     return received;
   }
 
+#if defined(LINUX) && !defined(ANDROID)
+  virtual int SendToBatch(const Datagram* datagrams, size_t count) {
+    if (count > kMaxDatagramBatch)
+      count = kMaxDatagramBatch;
+    mmsghdr msgs[kMaxDatagramBatch];
+    iovec iovs[kMaxDatagramBatch];
+    sockaddr_storage addrs[kMaxDatagramBatch];
+    memset(msgs, 0, sizeof(msgs[0]) * count);
+    for (size_t i = 0; i < count; ++i) {
+      iovs[i].iov_base = datagrams[i].data;
+      iovs[i].iov_len = datagrams[i].size;
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      if (!datagrams[i].addr.IsNil()) {
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = static_cast<socklen_t>(
+            datagrams[i].addr.ToSockAddrStorage(&addrs[i]));
+      }
+    }
+    // MSG_NOSIGNAL suppresses SIGPIPE, as in SendTo.
+    int sent = ::sendmmsg(s_, msgs, static_cast<unsigned int>(count),
+                          MSG_NOSIGNAL);
+    UpdateLastError();
+    if ((sent < 0) && IsBlockingError(error_)) {
+      EnableEvents(DE_WRITE);
+    }
+    return sent;
+  }
+
+  virtual int RecvFromBatch(Datagram* datagrams, size_t count) {
+    if (count > kMaxDatagramBatch)
+      count = kMaxDatagramBatch;
+    mmsghdr msgs[kMaxDatagramBatch];
+    iovec iovs[kMaxDatagramBatch];
+    sockaddr_storage addrs[kMaxDatagramBatch];
+    memset(msgs, 0, sizeof(msgs[0]) * count);
+    for (size_t i = 0; i < count; ++i) {
+      iovs[i].iov_base = datagrams[i].data;
+      iovs[i].iov_len = datagrams[i].size;
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
+    int received = ::recvmmsg(s_, msgs, static_cast<unsigned int>(count), 0,
+                              NULL);
+    UpdateLastError();
+    for (int i = 0; i < received; ++i) {
+      if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+        LOG_F(LS_WARNING) << "Datagram truncated to " << msgs[i].msg_len;
+      }
+      datagrams[i].size = msgs[i].msg_len;
+      SocketAddressFromSockAddrStorage(addrs[i], &datagrams[i].addr);
+    }
+    bool success = (received >= 0) || IsBlockingError(error_);
+    if (udp_ || success) {
+      EnableEvents(DE_READ);
+    }
+    if (!success) {
+      LOG_F(LS_VERBOSE) << "Error = " << error_;
+    }
+    return received;
+  }
+#endif  // LINUX && !ANDROID
+
   int Listen(int backlog) {
     int err = ::listen(s_, backlog);
     UpdateLastError();
     if (err == 0) {
       state_ = CS_CONNECTING;
-      enabled_events_ |= DE_ACCEPT;
+      EnableEvents(DE_ACCEPT);
 #ifdef _DEBUG
       dbg_addr_ = "Listening @ ";
       dbg_addr_.append(GetLocalAddress().ToString());
@@ -382,7 +483,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     UpdateLastError();
     if (s == INVALID_SOCKET)
       return NULL;
-    enabled_events_ |= DE_ACCEPT;
+    EnableEvents(DE_ACCEPT);
     if (out_addr != NULL)
       SocketAddressFromSockAddrStorage(addr_storage, out_addr);
     return ss_->WrapSocket(s);
@@ -395,7 +496,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     UpdateLastError();
     s_ = INVALID_SOCKET;
     state_ = CS_CLOSED;
-    enabled_events_ = 0;
+    SetEnabledEvents(0);
     if (resolver_) {
       resolver_->Destroy(false);
       resolver_ = NULL;
@@ -488,6 +589,20 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     error_ = LAST_SYSTEM_ERROR;
   }
 
+  // All changes to |enabled_events_| go through SetEnabledEvents so that
+  // dispatchers can tell the socket server when their interest set changes.
+  virtual void SetEnabledEvents(uint8 events) {
+    enabled_events_ = events;
+  }
+
+  void EnableEvents(uint8 events) {
+    SetEnabledEvents(enabled_events_ | events);
+  }
+
+  void DisableEvents(uint8 events) {
+    SetEnabledEvents(enabled_events_ & ~events);
+  }
+
   static int TranslateOption(Option opt, int* slevel, int* sopt) {
     switch (opt) {
       case OPT_DONTFRAGMENT:
@@ -515,6 +630,18 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
         *slevel = IPPROTO_TCP;
         *sopt = TCP_NODELAY;
         break;
+      case OPT_RECV_BATCH:
+        // Implemented by AsyncUDPSocket, not the OS.
+        return -1;
+      case OPT_REUSEPORT:
+#if defined(SO_REUSEPORT)
+        *slevel = SOL_SOCKET;
+        *sopt = SO_REUSEPORT;
+        break;
+#else
+        LOG(LS_WARNING) << "Socket::OPT_REUSEPORT not supported.";
+        return -1;
+#endif
       default:
         ASSERT(false);
         return -1;
@@ -866,24 +993,24 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
     // Make sure we deliver connect/accept first. Otherwise, consumers may see
     // something like a READ followed by a CONNECT, which would be odd.
     if ((ff & DE_CONNECT) != 0) {
-      enabled_events_ &= ~DE_CONNECT;
+      DisableEvents(DE_CONNECT);
       SignalConnectEvent(this);
     }
     if ((ff & DE_ACCEPT) != 0) {
-      enabled_events_ &= ~DE_ACCEPT;
+      DisableEvents(DE_ACCEPT);
       SignalReadEvent(this);
     }
     if ((ff & DE_READ) != 0) {
-      enabled_events_ &= ~DE_READ;
+      DisableEvents(DE_READ);
       SignalReadEvent(this);
     }
     if ((ff & DE_WRITE) != 0) {
-      enabled_events_ &= ~DE_WRITE;
+      DisableEvents(DE_WRITE);
       SignalWriteEvent(this);
     }
     if ((ff & DE_CLOSE) != 0) {
       // The socket is now dead to us, so stop checking it.
-      enabled_events_ = 0;
+      SetEnabledEvents(0);
       SignalCloseEvent(this, err);
     }
   }
@@ -895,11 +1022,20 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
     ss_->Remove(this);
     return PhysicalSocket::Close();
   }
+
+ protected:
+  virtual void SetEnabledEvents(uint8 events) {
+    if (events == enabled_events_)
+      return;
+    PhysicalSocket::SetEnabledEvents(events);
+    ss_->Update(this);
+  }
 };
 
 class FileDispatcher: public Dispatcher, public AsyncFile {
  public:
-  FileDispatcher(int fd, PhysicalSocketServer *ss) : ss_(ss), fd_(fd) {
+  FileDispatcher(int fd, PhysicalSocketServer *ss)
+      : ss_(ss), fd_(fd), flags_(0) {
     set_readable(true);
 
     ss_->Add(this);
@@ -943,6 +1079,7 @@ class FileDispatcher: public Dispatcher, public AsyncFile {
 
   virtual void set_readable(bool value) {
     flags_ = value ? (flags_ | DE_READ) : (flags_ & ~DE_READ);
+    ss_->Update(this);
   }
 
   virtual bool writable() {
@@ -951,6 +1088,7 @@ class FileDispatcher: public Dispatcher, public AsyncFile {
 
   virtual void set_writable(bool value) {
     flags_ = value ? (flags_ | DE_WRITE) : (flags_ & ~DE_WRITE);
+    ss_->Update(this);
   }
 
  private:
@@ -1102,7 +1240,7 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
     if (((ff & DE_CONNECT) != 0) && (id_ == cache_id)) {
       if (ff != DE_CONNECT)
         LOG(LS_VERBOSE) << "Signalled with DE_CONNECT: " << ff;
-      enabled_events_ &= ~DE_CONNECT;
+      DisableEvents(DE_CONNECT);
 #ifdef _DEBUG
       dbg_addr_ = "Connected @ ";
       dbg_addr_.append(GetRemoteAddress().ToString());
@@ -1110,15 +1248,15 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
       SignalConnectEvent(this);
     }
     if (((ff & DE_ACCEPT) != 0) && (id_ == cache_id)) {
-      enabled_events_ &= ~DE_ACCEPT;
+      DisableEvents(DE_ACCEPT);
       SignalReadEvent(this);
     }
     if ((ff & DE_READ) != 0) {
-      enabled_events_ &= ~DE_READ;
+      DisableEvents(DE_READ);
       SignalReadEvent(this);
     }
     if (((ff & DE_WRITE) != 0) && (id_ == cache_id)) {
-      enabled_events_ &= ~DE_WRITE;
+      DisableEvents(DE_WRITE);
       SignalWriteEvent(this);
     }
     if (((ff & DE_CLOSE) != 0) && (id_ == cache_id)) {
@@ -1175,6 +1313,35 @@ PhysicalSocketServer::PhysicalSocketServer()
     : fWait_(false),
       last_tick_tracked_(0),
       last_tick_dispatch_count_(0) {
+  Construct(false);
+}
+
+PhysicalSocketServer::PhysicalSocketServer(bool use_epoll)
+    : fWait_(false),
+      last_tick_tracked_(0),
+      last_tick_dispatch_count_(0) {
+  Construct(use_epoll);
+}
+
+void PhysicalSocketServer::Construct(bool use_epoll) {
+#ifdef POSIX
+  epoll_fd_ = -1;
+  epoll_serial_ = 0;
+  if (use_epoll) {
+#if defined(LINUX) || defined(ANDROID)
+    // The size argument is only a hint, and is ignored by modern kernels.
+    epoll_fd_ = epoll_create(FD_SETSIZE);
+    if (epoll_fd_ == -1) {
+      LOG_ERR(LS_WARNING) << "epoll_create failed, falling back to select";
+    } else {
+      fcntl(epoll_fd_, F_SETFD, FD_CLOEXEC);
+    }
+#else
+    LOG(LS_WARNING) << "epoll is not supported, falling back to select";
+#endif
+  }
+#endif
+  // The epoll descriptor has to exist before the first dispatcher is added.
   signal_wakeup_ = new Signaler(this, &fWait_);
 #ifdef WIN32
   socket_ev_ = WSACreateEvent();
@@ -1190,6 +1357,10 @@ PhysicalSocketServer::~PhysicalSocketServer() {
 #endif
   delete signal_wakeup_;
   ASSERT(dispatchers_.empty());
+#ifdef POSIX
+  if (epoll_fd_ != -1)
+    close(epoll_fd_);
+#endif
 }
 
 void PhysicalSocketServer::WakeUp() {
@@ -1243,6 +1414,10 @@ void PhysicalSocketServer::Add(Dispatcher *pdispatcher) {
   if (pos != dispatchers_.end())
     return;
   dispatchers_.push_back(pdispatcher);
+#ifdef POSIX
+  if (epoll_fd_ != -1)
+    AddEpoll(pdispatcher);
+#endif
 }
 
 void PhysicalSocketServer::Remove(Dispatcher *pdispatcher) {
@@ -1259,10 +1434,70 @@ void PhysicalSocketServer::Remove(Dispatcher *pdispatcher) {
       --**it;
     }
   }
+#ifdef POSIX
+  if (epoll_fd_ != -1)
+    RemoveEpoll(pdispatcher);
+#endif
 }
 
 #ifdef POSIX
+// Translates readiness of a dispatcher's descriptor into DE_* flags and
+// delivers them. Shared by the select and epoll loops.
+static void ProcessEvents(Dispatcher* pdispatcher, bool readable,
+                          bool writable) {
+  int fd = pdispatcher->GetDescriptor();
+  uint32 ff = 0;
+  int errcode = 0;
+
+  // Reap any error code, which can be signaled through reads or writes.
+  // TODO: Should we set errcode if getsockopt fails?
+  if (readable || writable) {
+    socklen_t len = sizeof(errcode);
+    ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &errcode, &len);
+  }
+
+  // Check readable descriptors. If we're waiting on an accept, signal
+  // that. Otherwise we're waiting for data, check to see if we're
+  // readable or really closed.
+  // TODO: Only peek at TCP descriptors.
+  if (readable) {
+    if (pdispatcher->GetRequestedEvents() & DE_ACCEPT) {
+      ff |= DE_ACCEPT;
+    } else if (errcode || pdispatcher->IsDescriptorClosed()) {
+      ff |= DE_CLOSE;
+    } else {
+      ff |= DE_READ;
+    }
+  }
+
+  // Check writable descriptors. If we're waiting on a connect, detect
+  // success versus failure by the reaped error code.
+  if (writable) {
+    if (pdispatcher->GetRequestedEvents() & DE_CONNECT) {
+      if (!errcode) {
+        ff |= DE_CONNECT;
+      } else {
+        ff |= DE_CLOSE;
+      }
+    } else {
+      ff |= DE_WRITE;
+    }
+  }
+
+  // Tell the descriptor about the event.
+  if (ff != 0) {
+    pdispatcher->OnPreEvent(ff);
+    pdispatcher->OnEvent(ff, errcode);
+  }
+}
+
 bool PhysicalSocketServer::Wait(int cmsWait, bool process_io) {
+  if (epoll_fd_ != -1)
+    return WaitEpoll(cmsWait, process_io);
+  return WaitSelect(cmsWait, process_io);
+}
+
+bool PhysicalSocketServer::WaitSelect(int cmsWait, bool process_io) {
   // Calculate timing information
 
   struct timeval *ptvWait = NULL;
@@ -1341,51 +1576,11 @@ bool PhysicalSocketServer::Wait(int cmsWait, bool process_io) {
       for (size_t i = 0; i < dispatchers_.size(); ++i) {
         Dispatcher *pdispatcher = dispatchers_[i];
         int fd = pdispatcher->GetDescriptor();
-        uint32 ff = 0;
-        int errcode = 0;
-
-        // Reap any error code, which can be signaled through reads or writes.
-        // TODO: Should we set errcode if getsockopt fails?
-        if (FD_ISSET(fd, &fdsRead) || FD_ISSET(fd, &fdsWrite)) {
-          socklen_t len = sizeof(errcode);
-          ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &errcode, &len);
-        }
-
-        // Check readable descriptors. If we're waiting on an accept, signal
-        // that. Otherwise we're waiting for data, check to see if we're
-        // readable or really closed.
-        // TODO: Only peek at TCP descriptors.
-        if (FD_ISSET(fd, &fdsRead)) {
-          FD_CLR(fd, &fdsRead);
-          if (pdispatcher->GetRequestedEvents() & DE_ACCEPT) {
-            ff |= DE_ACCEPT;
-          } else if (errcode || pdispatcher->IsDescriptorClosed()) {
-            ff |= DE_CLOSE;
-          } else {
-            ff |= DE_READ;
-          }
-        }
-
-        // Check writable descriptors. If we're waiting on a connect, detect
-        // success versus failure by the reaped error code.
-        if (FD_ISSET(fd, &fdsWrite)) {
-          FD_CLR(fd, &fdsWrite);
-          if (pdispatcher->GetRequestedEvents() & DE_CONNECT) {
-            if (!errcode) {
-              ff |= DE_CONNECT;
-            } else {
-              ff |= DE_CLOSE;
-            }
-          } else {
-            ff |= DE_WRITE;
-          }
-        }
-
-        // Tell the descriptor about the event.
-        if (ff != 0) {
-          pdispatcher->OnPreEvent(ff);
-          pdispatcher->OnEvent(ff, errcode);
-        }
+        bool readable = FD_ISSET(fd, &fdsRead);
+        bool writable = FD_ISSET(fd, &fdsWrite);
+        FD_CLR(fd, &fdsRead);
+        FD_CLR(fd, &fdsWrite);
+        ProcessEvents(pdispatcher, readable, writable);
       }
     }
 
@@ -1413,6 +1608,221 @@ bool PhysicalSocketServer::Wait(int cmsWait, bool process_io) {
   return true;
 }
 
+void PhysicalSocketServer::Update(Dispatcher* pdispatcher) {
+  if (epoll_fd_ == -1)
+    return;
+
+  CritScope cs(&crit_);
+  int fd = pdispatcher->GetDescriptor();
+  if (fd < 0 || static_cast<size_t>(fd) >= epoll_entries_.size())
+    return;
+  EpollEntry& entry = epoll_entries_[fd];
+  if (entry.dispatcher != pdispatcher || entry.dirty)
+    return;
+  // Dispatchers typically disable an event before signalling it and re-enable
+  // it from the handler, so defer the epoll_ctl until it's really needed.
+  entry.dirty = true;
+  epoll_dirty_.push_back(fd);
+}
+
+#if defined(LINUX) || defined(ANDROID)
+static const int kMaxEpollEvents = 128;
+
+void PhysicalSocketServer::AddEpoll(Dispatcher* pdispatcher) {
+  int fd = pdispatcher->GetDescriptor();
+  if (fd < 0)
+    return;
+  if (static_cast<size_t>(fd) >= epoll_entries_.size())
+    epoll_entries_.resize(fd + 1);
+  EpollEntry& entry = epoll_entries_[fd];
+  if (entry.dispatcher != NULL) {
+    // The previous owner closed the descriptor before removing itself.
+    LOG(LS_WARNING) << "Descriptor " << fd << " reused while still in use";
+  }
+  entry.dispatcher = pdispatcher;
+  entry.events = 0;
+  entry.serial = ++epoll_serial_;
+  entry.dirty = false;
+  UpdateEpoll(fd, &entry);
+}
+
+void PhysicalSocketServer::RemoveEpoll(Dispatcher* pdispatcher) {
+  int fd = pdispatcher->GetDescriptor();
+  if (fd < 0 || static_cast<size_t>(fd) >= epoll_entries_.size() ||
+      epoll_entries_[fd].dispatcher != pdispatcher) {
+    // The descriptor changed after the dispatcher was added. This should be
+    // rare, so just search for it.
+    fd = -1;
+    for (size_t i = 0; i < epoll_entries_.size(); ++i) {
+      if (epoll_entries_[i].dispatcher == pdispatcher) {
+        fd = static_cast<int>(i);
+        break;
+      }
+    }
+    if (fd == -1)
+      return;
+  }
+  EpollEntry& entry = epoll_entries_[fd];
+  if (entry.events != 0) {
+    // The descriptor may already have been closed, in which case the kernel
+    // has removed it for us.
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, &event) == -1 &&
+        errno != ENOENT && errno != EBADF) {
+      LOG_ERR(LS_WARNING) << "epoll_ctl(DEL) failed for " << fd;
+    }
+  }
+  entry.dispatcher = NULL;
+  entry.events = 0;
+  entry.dirty = false;
+}
+
+// Brings the epoll registration for |fd| in line with the events requested
+// by its dispatcher. Descriptors with nothing requested are taken out of the
+// set entirely, since epoll always reports EPOLLHUP and EPOLLERR and a dead
+// socket would otherwise wake us up continuously.
+void PhysicalSocketServer::UpdateEpoll(int fd, EpollEntry* entry) {
+  uint32 ff = entry->dispatcher->GetRequestedEvents();
+  uint32 events = 0;
+  if (ff & (DE_READ | DE_ACCEPT))
+    events |= EPOLLIN;
+  if (ff & (DE_WRITE | DE_CONNECT))
+    events |= EPOLLOUT;
+  if (events == entry->events)
+    return;
+
+  epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = events;
+  event.data.u64 = (static_cast<uint64>(entry->serial) << 32) |
+      static_cast<uint32>(fd);
+  int op = EPOLL_CTL_MOD;
+  if (entry->events == 0) {
+    op = EPOLL_CTL_ADD;
+  } else if (events == 0) {
+    op = EPOLL_CTL_DEL;
+  }
+  int err = epoll_ctl(epoll_fd_, op, fd, &event);
+  if (err == -1 && op == EPOLL_CTL_ADD && errno == EEXIST) {
+    // Left behind by a previous owner of a duplicated descriptor.
+    err = epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+  } else if (err == -1 && op == EPOLL_CTL_MOD && errno == ENOENT) {
+    err = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+  } else if (err == -1 && op == EPOLL_CTL_DEL && errno == ENOENT) {
+    err = 0;
+  }
+  if (err == -1) {
+    LOG_ERR(LS_ERROR) << "epoll_ctl failed for " << fd;
+    return;
+  }
+  entry->events = events;
+}
+
+void PhysicalSocketServer::FlushEpollUpdates() {
+  for (size_t i = 0; i < epoll_dirty_.size(); ++i) {
+    int fd = epoll_dirty_[i];
+    EpollEntry& entry = epoll_entries_[fd];
+    if (!entry.dirty)
+      continue;
+    entry.dirty = false;
+    if (entry.dispatcher)
+      UpdateEpoll(fd, &entry);
+  }
+  epoll_dirty_.clear();
+}
+
+bool PhysicalSocketServer::WaitEpoll(int cmsWait, bool process_io) {
+  uint32 msStop = 0;
+  int cmsNext = cmsWait;
+  if (cmsWait != kForever)
+    msStop = TimeAfter(cmsWait);
+
+  epoll_event events[kMaxEpollEvents];
+  fWait_ = true;
+
+  while (fWait_) {
+    int n;
+    if (process_io) {
+      {
+        CritScope cr(&crit_);
+        FlushEpollUpdates();
+      }
+      n = epoll_wait(epoll_fd_, events, kMaxEpollEvents, cmsNext);
+    } else {
+      // Only the wakeup signaler is of interest; wait on it alone rather
+      // than temporarily rewriting the epoll set.
+      pollfd fds;
+      fds.fd = signal_wakeup_->GetDescriptor();
+      fds.events = POLLIN;
+      fds.revents = 0;
+      n = poll(&fds, 1, cmsNext);
+      if (n > 0) {
+        CritScope cr(&crit_);
+        ProcessEvents(signal_wakeup_, true, false);
+      }
+    }
+
+    if (n < 0) {
+      if (errno != EINTR) {
+        LOG_E(LS_ERROR, EN, errno) << "epoll_wait";
+        return false;
+      }
+      // Else ignore the error and keep going, as in WaitSelect.
+    } else if (n == 0) {
+      // If timeout, return success
+      return true;
+    } else if (process_io) {
+      CritScope cr(&crit_);
+      for (int i = 0; i < n; ++i) {
+        int fd = static_cast<int>(events[i].data.u64 & 0xFFFFFFFF);
+        uint32 serial = static_cast<uint32>(events[i].data.u64 >> 32);
+        // Handlers may add or remove dispatchers, so look the entry up again
+        // for every event, and drop events for slots that changed owner.
+        if (static_cast<size_t>(fd) >= epoll_entries_.size())
+          continue;
+        Dispatcher* pdispatcher = epoll_entries_[fd].dispatcher;
+        if (!pdispatcher || epoll_entries_[fd].serial != serial)
+          continue;
+        // Like select, only report errors and hangups through events that
+        // were actually asked for.
+        uint32 ff = pdispatcher->GetRequestedEvents();
+        uint32 ev = events[i].events;
+        bool readable = (ev & (EPOLLIN | EPOLLERR | EPOLLHUP)) &&
+            (ff & (DE_READ | DE_ACCEPT));
+        bool writable = (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP)) &&
+            (ff & (DE_WRITE | DE_CONNECT));
+        ProcessEvents(pdispatcher, readable, writable);
+      }
+    }
+
+    if (cmsWait != kForever) {
+      cmsNext = TimeUntil(msStop);
+      if (cmsNext < 0)
+        cmsNext = 0;
+    }
+  }
+
+  return true;
+}
+#else
+void PhysicalSocketServer::AddEpoll(Dispatcher* pdispatcher) {
+}
+
+void PhysicalSocketServer::RemoveEpoll(Dispatcher* pdispatcher) {
+}
+
+void PhysicalSocketServer::UpdateEpoll(int fd, EpollEntry* entry) {
+}
+
+void PhysicalSocketServer::FlushEpollUpdates() {
+}
+
+bool PhysicalSocketServer::WaitEpoll(int cmsWait, bool process_io) {
+  return WaitSelect(cmsWait, process_io);
+}
+#endif  // LINUX || ANDROID
+
 static void GlobalSignalHandler(int signum) {
   PosixSignalHandler::Instance()->OnPosixSignalReceived(signum);
 }
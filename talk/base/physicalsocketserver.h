@@ -75,6 +75,11 @@ class Dispatcher {
 class PhysicalSocketServer : public SocketServer {
  public:
   PhysicalSocketServer();
+  // If |use_epoll| is true, Wait() uses epoll(7) instead of select(2), which
+  // removes the FD_SETSIZE limit and makes each wakeup cost proportional to
+  // the number of ready descriptors rather than the number registered. Falls
+  // back to select() where epoll is unavailable.
+  explicit PhysicalSocketServer(bool use_epoll);
   virtual ~PhysicalSocketServer();
 
   // SocketFactory:
@@ -95,6 +100,14 @@ class PhysicalSocketServer : public SocketServer {
   void Remove(Dispatcher* dispatcher);
 
 #ifdef POSIX
+  // Must be called by a registered dispatcher whenever the value returned by
+  // its GetRequestedEvents() changes. Changes are coalesced and applied on the
+  // next pass through Wait().
+  void Update(Dispatcher* dispatcher);
+
+  // Returns true if this socket server is waiting with epoll.
+  bool using_epoll() const { return epoll_fd_ != -1; }
+
   AsyncFile* CreateFile(int fd);
 
   // Sets the function to be executed in response to the specified POSIX signal.
@@ -117,10 +130,37 @@ class PhysicalSocketServer : public SocketServer {
   typedef std::vector<Dispatcher*> DispatcherList;
   typedef std::vector<size_t*> IteratorList;
 
+  void Construct(bool use_epoll);
+
 #ifdef POSIX
+  // Epoll registration state for one descriptor. |serial| changes every time
+  // the slot is handed to a new dispatcher, so that events that were already
+  // returned by epoll_wait for a removed dispatcher are not delivered to a new
+  // one that happens to get the same descriptor.
+  struct EpollEntry {
+    EpollEntry() : dispatcher(NULL), events(0), serial(0), dirty(false) {}
+    Dispatcher* dispatcher;
+    uint32 events;
+    uint32 serial;
+    bool dirty;
+  };
+  typedef std::vector<EpollEntry> EpollEntryList;
+
   static bool InstallSignal(int signum, void (*handler)(int));
 
+  bool WaitSelect(int cms, bool process_io);
+  bool WaitEpoll(int cms, bool process_io);
+  void AddEpoll(Dispatcher* dispatcher);
+  void RemoveEpoll(Dispatcher* dispatcher);
+  void UpdateEpoll(int fd, EpollEntry* entry);
+  void FlushEpollUpdates();
+
   scoped_ptr<PosixSignalDispatcher> signal_dispatcher_;
+  int epoll_fd_;
+  // Indexed by descriptor.
+  EpollEntryList epoll_entries_;
+  std::vector<int> epoll_dirty_;
+  uint32 epoll_serial_;
 #endif
   DispatcherList dispatchers_;
   IteratorList iterators_;
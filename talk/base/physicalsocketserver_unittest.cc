@@ -28,12 +28,14 @@
 #include <signal.h>
 #include <stdarg.h>
 
+#include "talk/base/asyncudpsocket.h"
 #include "talk/base/gunit.h"
 #include "talk/base/logging.h"
 #include "talk/base/physicalsocketserver.h"
 #include "talk/base/scoped_ptr.h"
 #include "talk/base/socket_unittest.h"
 #include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
 
 namespace talk_base {
 
@@ -164,6 +166,286 @@ TEST_F(PhysicalSocketTest, TestGetSetOptionsIPv6) {
   SocketTest::TestGetSetOptionsIPv6();
 }
 
+#if defined(LINUX) || defined(ANDROID)
+
+// Runs the generic socket tests against a socket server that waits with epoll.
+class EpollSocketTest : public SocketTest {
+ protected:
+  EpollSocketTest()
+      : epoll_ss_(new PhysicalSocketServer(true)),
+        scope_(epoll_ss_.get()) {
+  }
+
+  scoped_ptr<PhysicalSocketServer> epoll_ss_;
+  SocketServerScope scope_;
+};
+
+TEST_F(EpollSocketTest, UsesEpoll) {
+  EXPECT_TRUE(epoll_ss_->using_epoll());
+}
+
+TEST_F(EpollSocketTest, TestConnectIPv4) {
+  SocketTest::TestConnectIPv4();
+}
+
+TEST_F(EpollSocketTest, TestConnectIPv6) {
+  SocketTest::TestConnectIPv6();
+}
+
+TEST_F(EpollSocketTest, TestConnectFailIPv4) {
+  SocketTest::TestConnectFailIPv4();
+}
+
+TEST_F(EpollSocketTest, TestConnectWithClosedSocketIPv4) {
+  SocketTest::TestConnectWithClosedSocketIPv4();
+}
+
+TEST_F(EpollSocketTest, TestServerCloseDuringConnectIPv4) {
+  SocketTest::TestServerCloseDuringConnectIPv4();
+}
+
+TEST_F(EpollSocketTest, TestClientCloseDuringConnectIPv4) {
+  SocketTest::TestClientCloseDuringConnectIPv4();
+}
+
+TEST_F(EpollSocketTest, TestServerCloseIPv4) {
+  SocketTest::TestServerCloseIPv4();
+}
+
+TEST_F(EpollSocketTest, TestCloseInClosedCallbackIPv4) {
+  SocketTest::TestCloseInClosedCallbackIPv4();
+}
+
+TEST_F(EpollSocketTest, TestSocketServerWaitIPv4) {
+  SocketTest::TestSocketServerWaitIPv4();
+}
+
+TEST_F(EpollSocketTest, TestTcpIPv4) {
+  SocketTest::TestTcpIPv4();
+}
+
+TEST_F(EpollSocketTest, TestTcpIPv6) {
+  SocketTest::TestTcpIPv6();
+}
+
+TEST_F(EpollSocketTest, TestUdpIPv4) {
+  SocketTest::TestUdpIPv4();
+}
+
+TEST_F(EpollSocketTest, TestUdpIPv6) {
+  SocketTest::TestUdpIPv6();
+}
+
+#endif  // LINUX || ANDROID
+
+class ReadCounter : public sigslot::has_slots<> {
+ public:
+  ReadCounter() : count_(0) {}
+  int count() const { return count_; }
+  void OnReadEvent(AsyncSocket* socket) {
+    char buf[64];
+    while (socket->Recv(buf, sizeof(buf)) > 0)
+      ++count_;
+  }
+
+ private:
+  int count_;
+};
+
+// Measures the cost of a single Wait() wakeup with |idle_sockets| other
+// sockets registered with the socket server, and logs it.
+static void MeasureWakeupCost(bool use_epoll, int idle_sockets) {
+  const int kIterations = 2000;
+  PhysicalSocketServer ss(use_epoll);
+  SocketAddress any(IPAddress(INADDR_LOOPBACK), 0);
+
+  std::vector<AsyncSocket*> idle;
+  for (int i = 0; i < idle_sockets; ++i) {
+    AsyncSocket* socket = ss.CreateAsyncSocket(AF_INET, SOCK_DGRAM);
+    ASSERT_TRUE(socket != NULL);
+    EXPECT_EQ(0, socket->Bind(any));
+    idle.push_back(socket);
+  }
+  scoped_ptr<AsyncSocket> receiver(ss.CreateAsyncSocket(AF_INET, SOCK_DGRAM));
+  scoped_ptr<AsyncSocket> sender(ss.CreateAsyncSocket(AF_INET, SOCK_DGRAM));
+  EXPECT_EQ(0, receiver->Bind(any));
+  EXPECT_EQ(0, sender->Bind(any));
+  ReadCounter counter;
+  receiver->SignalReadEvent.connect(&counter, &ReadCounter::OnReadEvent);
+
+  char data[16] = {0};
+  uint64 start = TimeNanos();
+  for (int i = 0; i < kIterations; ++i) {
+    sender->SendTo(data, sizeof(data), receiver->GetLocalAddress());
+    while (counter.count() <= i)
+      ss.Wait(0, true);
+  }
+  uint64 elapsed = TimeNanos() - start;
+  EXPECT_EQ(kIterations, counter.count());
+
+  LOG(LS_INFO) << (use_epoll ? "epoll" : "select") << " with "
+               << idle_sockets << " idle sockets: "
+               << elapsed / kIterations / kNumNanosecsPerMicrosec
+               << " us per wakeup";
+
+  receiver.reset();
+  sender.reset();
+  for (size_t i = 0; i < idle.size(); ++i)
+    delete idle[i];
+}
+
+// Compares the wakeup cost of select and epoll as the socket count grows.
+// The select loop is limited to FD_SETSIZE descriptors, so stay below that.
+TEST(PhysicalSocketServerTest, WakeupCostVsSocketCount) {
+  const int kSocketCounts[] = { 10, 100, 500 };
+  for (size_t i = 0; i < ARRAY_SIZE(kSocketCounts); ++i) {
+    MeasureWakeupCost(false, kSocketCounts[i]);
+#if defined(LINUX) || defined(ANDROID)
+    MeasureWakeupCost(true, kSocketCounts[i]);
+#endif
+  }
+}
+
+TEST(PhysicalSocketServerTest, SendAndRecvBatch) {
+  PhysicalSocketServer ss;
+  SocketAddress any(IPAddress(INADDR_LOOPBACK), 0);
+  scoped_ptr<AsyncSocket> sender(ss.CreateAsyncSocket(AF_INET, SOCK_DGRAM));
+  scoped_ptr<AsyncSocket> receiver(ss.CreateAsyncSocket(AF_INET, SOCK_DGRAM));
+  ASSERT_EQ(0, sender->Bind(any));
+  ASSERT_EQ(0, receiver->Bind(any));
+
+  const int kCount = 10;
+  char payload[kCount][kCount];
+  Datagram out[kCount];
+  for (int i = 0; i < kCount; ++i) {
+    memset(payload[i], 'a' + i, sizeof(payload[i]));
+    out[i].data = payload[i];
+    out[i].size = i + 1;
+    out[i].addr = receiver->GetLocalAddress();
+  }
+  EXPECT_EQ(kCount, sender->SendToBatch(out, kCount));
+
+  char buffers[kCount + 1][64];
+  Datagram in[kCount + 1];
+  for (int i = 0; i < kCount + 1; ++i) {
+    in[i].data = buffers[i];
+    in[i].size = sizeof(buffers[i]);
+  }
+  EXPECT_EQ(kCount, receiver->RecvFromBatch(in, kCount + 1));
+  for (int i = 0; i < kCount; ++i) {
+    EXPECT_EQ(static_cast<size_t>(i + 1), in[i].size);
+    EXPECT_EQ(0, memcmp(payload[i], in[i].data, in[i].size));
+    EXPECT_EQ(sender->GetLocalAddress(), in[i].addr);
+  }
+
+  // Nothing left to read.
+  EXPECT_EQ(-1, receiver->RecvFromBatch(in, kCount + 1));
+  EXPECT_TRUE(receiver->IsBlocking());
+}
+
+class PacketCounter : public sigslot::has_slots<> {
+ public:
+  PacketCounter() : count_(0), echo_(false) {}
+  int count() const { return count_; }
+  void set_echo(bool echo) { echo_ = echo; }
+  void OnReadPacket(AsyncPacketSocket* socket, const char* data, size_t size,
+                    const SocketAddress& remote_addr) {
+    ++count_;
+    if (echo_)
+      socket->SendTo(data, size, remote_addr);
+  }
+
+ private:
+  int count_;
+  bool echo_;
+};
+
+// Checks that AsyncUDPSocket delivers every datagram with batching enabled on
+// both the send and receive side, including replies sent from the handler.
+TEST(PhysicalSocketServerTest, AsyncUDPSocketBatching) {
+  SocketServer* ss = Thread::Current()->socketserver();
+  SocketAddress any(IPAddress(INADDR_LOOPBACK), 0);
+  scoped_ptr<AsyncUDPSocket> client(AsyncUDPSocket::Create(ss, any));
+  scoped_ptr<AsyncUDPSocket> server(AsyncUDPSocket::Create(ss, any));
+  ASSERT_TRUE(client.get() != NULL);
+  ASSERT_TRUE(server.get() != NULL);
+
+  int batch = 0;
+  EXPECT_EQ(0, server->GetOption(Socket::OPT_RECV_BATCH, &batch));
+  EXPECT_EQ(1, batch);
+  EXPECT_EQ(-1, server->SetOption(Socket::OPT_RECV_BATCH, 0));
+  EXPECT_EQ(0, server->SetOption(Socket::OPT_RECV_BATCH, 8));
+  EXPECT_EQ(0, server->GetOption(Socket::OPT_RECV_BATCH, &batch));
+  EXPECT_EQ(8, batch);
+
+  PacketCounter client_counter, server_counter;
+  server_counter.set_echo(true);
+  client->SignalReadPacket.connect(&client_counter,
+                                   &PacketCounter::OnReadPacket);
+  server->SignalReadPacket.connect(&server_counter,
+                                   &PacketCounter::OnReadPacket);
+
+  const int kPackets = 50;
+  char data[100] = {0};
+  client->BeginSendBatch();
+  for (int i = 0; i < kPackets; ++i) {
+    EXPECT_EQ(static_cast<int>(sizeof(data)),
+              client->SendTo(data, sizeof(data), server->GetLocalAddress()));
+  }
+  client->EndSendBatch();
+
+  EXPECT_EQ_WAIT(kPackets, server_counter.count(), 1000);
+  EXPECT_EQ_WAIT(kPackets, client_counter.count(), 1000);
+}
+
+// Changes the receive batch size from within every handler call, then checks
+// the packet it was given.
+class BatchResizer : public sigslot::has_slots<> {
+ public:
+  explicit BatchResizer(const std::string& expected)
+      : expected_(expected), count_(0), mismatches_(0) {}
+  int count() const { return count_; }
+  int mismatches() const { return mismatches_; }
+  void OnReadPacket(AsyncPacketSocket* socket, const char* data, size_t size,
+                    const SocketAddress& remote_addr) {
+    socket->SetOption(Socket::OPT_RECV_BATCH, (count_ % 2) ? 2 : 4);
+    ++count_;
+    if (std::string(data, size) != expected_)
+      ++mismatches_;
+  }
+
+ private:
+  std::string expected_;
+  int count_;
+  int mismatches_;
+};
+
+// Checks that a handler can change OPT_RECV_BATCH without invalidating the
+// packets of the batch that is being delivered.
+TEST(PhysicalSocketServerTest, AsyncUDPSocketSetBatchWhileReading) {
+  SocketServer* ss = Thread::Current()->socketserver();
+  SocketAddress any(IPAddress(INADDR_LOOPBACK), 0);
+  scoped_ptr<AsyncUDPSocket> client(AsyncUDPSocket::Create(ss, any));
+  scoped_ptr<AsyncUDPSocket> server(AsyncUDPSocket::Create(ss, any));
+  ASSERT_TRUE(client.get() != NULL);
+  ASSERT_TRUE(server.get() != NULL);
+  EXPECT_EQ(0, server->SetOption(Socket::OPT_RECV_BATCH, 8));
+
+  const std::string kData("batched datagram");
+  BatchResizer resizer(kData);
+  server->SignalReadPacket.connect(&resizer, &BatchResizer::OnReadPacket);
+
+  const int kPackets = 20;
+  client->BeginSendBatch();
+  for (int i = 0; i < kPackets; ++i) {
+    client->SendTo(kData.data(), kData.size(), server->GetLocalAddress());
+  }
+  client->EndSendBatch();
+
+  EXPECT_EQ_WAIT(kPackets, resizer.count(), 1000);
+  EXPECT_EQ(0, resizer.mismatches());
+}
+
 #ifdef POSIX
 
 class PosixSignalDeliveryTest : public testing::Test {
@@ -29,6 +29,7 @@
 #define TALK_BASE_SOCKET_H__
 
 #include <errno.h>
+#include <string.h>
 
 #ifdef POSIX
 #include <sys/types.h>
@@ -140,6 +141,24 @@ inline bool IsBlockingError(int e) {
   return (e == EWOULDBLOCK) || (e == EAGAIN) || (e == EINPROGRESS);
 }
 
+// One entry of a batched send or receive. For receives, |data| and |size|
+// describe the buffer to fill; on return |size| holds the length of the
+// datagram and |addr| its source.
+struct Datagram {
+  Datagram() : data(NULL), size(0) {}
+  char* data;
+  size_t size;
+  SocketAddress addr;
+};
+
+// One piece of a gathered send; see Socket::SendV.
+struct IoBuffer {
+  IoBuffer() : data(NULL), size(0) {}
+  IoBuffer(const void* data, size_t size) : data(data), size(size) {}
+  const void* data;
+  size_t size;
+};
+
 // General interface for the socket implementations of various networks.  The
 // methods match those of normal UNIX sockets very closely.
 class Socket {
@@ -160,6 +179,59 @@ class Socket {
   virtual int SendTo(const void *pv, size_t cb, const SocketAddress& addr) = 0;
   virtual int Recv(void *pv, size_t cb) = 0;
   virtual int RecvFrom(void *pv, size_t cb, SocketAddress *paddr) = 0;
+
+  // Send or receive up to |count| datagrams in one call where the platform
+  // supports it (sendmmsg/recvmmsg). Return the number of datagrams
+  // transferred, or -1 if none were. The defaults loop over SendTo/RecvFrom.
+  virtual int SendToBatch(const Datagram* datagrams, size_t count) {
+    size_t i = 0;
+    for (; i < count; ++i) {
+      if (SendTo(datagrams[i].data, datagrams[i].size, datagrams[i].addr) < 0)
+        break;
+    }
+    return (i == 0 && count != 0) ? -1 : static_cast<int>(i);
+  }
+  virtual int RecvFromBatch(Datagram* datagrams, size_t count) {
+    size_t i = 0;
+    for (; i < count; ++i) {
+      int len = RecvFrom(datagrams[i].data, datagrams[i].size,
+                         &datagrams[i].addr);
+      if (len < 0)
+        break;
+      datagrams[i].size = len;
+    }
+    return (i == 0 && count != 0) ? -1 : static_cast<int>(i);
+  }
+  // Sends |count| buffers back to back, as a single Send of their
+  // concatenation would, but without copying them together first where the
+  // platform supports it (sendmsg). Returns the number of bytes sent, which
+  // may stop short of the total on a stream socket. The default copies the
+  // buffers together, on the stack unless they're larger than a packet
+  // usually is, and calls Send once, so that sockets layered on top of
+  // others (SSL, proxies) still see one write.
+  virtual int SendV(const IoBuffer* buffers, size_t count) {
+    if (count == 1)
+      return Send(buffers[0].data, buffers[0].size);
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i)
+      total += buffers[i].size;
+    if (total == 0)
+      return Send(NULL, 0);
+    char stack_buffer[2048];
+    char* joined = stack_buffer;
+    if (total > sizeof(stack_buffer))
+      joined = new char[total];
+    size_t pos = 0;
+    for (size_t i = 0; i < count; ++i) {
+      if (buffers[i].size > 0)
+        memcpy(joined + pos, buffers[i].data, buffers[i].size);
+      pos += buffers[i].size;
+    }
+    int result = Send(joined, total);
+    if (joined != stack_buffer)
+      delete [] joined;
+    return result;
+  }
   virtual int Listen(int backlog) = 0;
   virtual Socket *Accept(SocketAddress *paddr) = 0;
   virtual int Close() = 0;
@@ -184,7 +256,9 @@ class Socket {
     OPT_RCVBUF,      // receive buffer size
     OPT_SNDBUF,      // send buffer size
     OPT_NODELAY,     // whether Nagle algorithm is enabled
-    OPT_IPV6_V6ONLY  // Whether the socket is IPv6 only.
+    OPT_IPV6_V6ONLY, // Whether the socket is IPv6 only.
+    OPT_RECV_BATCH,  // datagrams read per read event (AsyncUDPSocket only)
+    OPT_REUSEPORT    // share the bound port with other sockets (before Bind)
   };
   virtual int GetOption(Option opt, int* value) = 0;
   virtual int SetOption(Option opt, int value) = 0;
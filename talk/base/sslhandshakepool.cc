@@ -0,0 +1,121 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "talk/base/sslhandshakepool.h"
+
+#include <algorithm>
+
+#include "talk/base/common.h"
+#include "talk/base/thread.h"
+
+namespace talk_base {
+
+const size_t SSLHandshakePool::kLatencyWindow;
+
+// Nearest-rank percentile of the sorted, non-empty |samples|.
+static int Percentile(const std::vector<int>& samples, int percent) {
+  size_t rank = (samples.size() * percent + 99) / 100;
+  return samples[std::max<size_t>(rank, 1) - 1];
+}
+
+SSLHandshakePool::SSLHandshakePool(size_t num_threads)
+    : next_thread_(0),
+      handshakes_(0),
+      failures_(0),
+      in_progress_(0),
+      peak_in_progress_(0),
+      next_latency_(0) {
+  for (size_t i = 0; i < num_threads; ++i) {
+    Thread* thread = new Thread();
+    thread->SetName("SSLHandshakePool", this);
+    thread->Start();
+    threads_.push_back(thread);
+  }
+}
+
+SSLHandshakePool::~SSLHandshakePool() {
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    threads_[i]->Stop();
+    delete threads_[i];
+  }
+}
+
+Thread* SSLHandshakePool::AssignThread() {
+  if (threads_.empty()) {
+    return NULL;
+  }
+  CritScope cs(&crit_);
+  Thread* thread = threads_[next_thread_];
+  next_thread_ = (next_thread_ + 1) % threads_.size();
+  return thread;
+}
+
+void SSLHandshakePool::OnHandshakeStarted() {
+  CritScope cs(&crit_);
+  ++in_progress_;
+  peak_in_progress_ = std::max(peak_in_progress_, in_progress_);
+}
+
+void SSLHandshakePool::OnHandshakeFinished(bool success, int elapsed_ms) {
+  CritScope cs(&crit_);
+  ASSERT(in_progress_ > 0);
+  --in_progress_;
+  if (!success) {
+    ++failures_;
+    return;
+  }
+  ++handshakes_;
+  if (latencies_.size() < kLatencyWindow) {
+    latencies_.push_back(elapsed_ms);
+  } else {
+    latencies_[next_latency_] = elapsed_ms;
+    next_latency_ = (next_latency_ + 1) % kLatencyWindow;
+  }
+}
+
+void SSLHandshakePool::GetStats(SSLHandshakeStats* stats) {
+  std::vector<int> sorted;
+  {
+    CritScope cs(&crit_);
+    stats->handshakes = handshakes_;
+    stats->failures = failures_;
+    stats->in_progress = in_progress_;
+    stats->peak_in_progress = peak_in_progress_;
+    sorted = latencies_;
+  }
+  if (sorted.empty()) {
+    stats->latency_p50_ms = stats->latency_p90_ms = stats->latency_p99_ms =
+        stats->latency_max_ms = 0;
+    return;
+  }
+  std::sort(sorted.begin(), sorted.end());
+  stats->latency_p50_ms = Percentile(sorted, 50);
+  stats->latency_p90_ms = Percentile(sorted, 90);
+  stats->latency_p99_ms = Percentile(sorted, 99);
+  stats->latency_max_ms = sorted.back();
+}
+
+}  // namespace talk_base
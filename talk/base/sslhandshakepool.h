@@ -0,0 +1,108 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TALK_BASE_SSLHANDSHAKEPOOL_H_
+#define TALK_BASE_SSLHANDSHAKEPOOL_H_
+
+#include <vector>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/criticalsection.h"
+
+namespace talk_base {
+
+class Thread;
+
+struct SSLHandshakeStats {
+  SSLHandshakeStats()
+      : handshakes(0), failures(0), in_progress(0), peak_in_progress(0),
+        latency_p50_ms(0), latency_p90_ms(0), latency_p99_ms(0),
+        latency_max_ms(0) {
+  }
+
+  uint64 handshakes;  // Handshakes that completed.
+  uint64 failures;  // Handshakes that failed or were abandoned.
+  int in_progress;  // Handshakes started but not yet finished.
+  int peak_in_progress;
+  // Time from the start of a handshake to its completion, over the most
+  // recent SSLHandshakePool::kLatencyWindow completed handshakes.
+  int latency_p50_ms;
+  int latency_p90_ms;
+  int latency_p99_ms;
+  int latency_max_ms;
+};
+
+// A set of threads that SSL streams can run their handshakes on, so that the
+// asymmetric crypto in a burst of handshakes (key exchange, signatures and
+// certificate verification) doesn't hold up the threads the streams belong
+// to. Each stream is given one of the threads for the whole of its handshake,
+// so that steps for one SSL object never run at the same time, and the
+// threads are handed out in turn. A pool with no threads runs nothing itself;
+// streams that use it do their handshakes inline, as they would without a
+// pool, but still report to it, which gives a baseline for the latency
+// statistics. The pool must outlive every stream that uses it. All methods
+// are thread-safe.
+class SSLHandshakePool {
+ public:
+  static const size_t kLatencyWindow = 1000;
+
+  // Creates the pool and starts |num_threads| threads.
+  explicit SSLHandshakePool(size_t num_threads);
+  ~SSLHandshakePool();
+
+  size_t num_threads() const { return threads_.size(); }
+
+  // Returns the thread that the next stream should run its handshake on, or
+  // NULL if the pool has no threads.
+  Thread* AssignThread();
+
+  // Called by streams when they start a handshake, and when it completes
+  // (|success| true, after |elapsed_ms|) or fails.
+  void OnHandshakeStarted();
+  void OnHandshakeFinished(bool success, int elapsed_ms);
+
+  void GetStats(SSLHandshakeStats* stats);
+
+ private:
+  std::vector<Thread*> threads_;
+  CriticalSection crit_;
+  size_t next_thread_;
+  uint64 handshakes_;
+  uint64 failures_;
+  int in_progress_;
+  int peak_in_progress_;
+  // A ring of the most recent latencies, next_latency_ being the oldest once
+  // it is full.
+  std::vector<int> latencies_;
+  size_t next_latency_;
+
+  DISALLOW_COPY_AND_ASSIGN(SSLHandshakePool);
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_SSLHANDSHAKEPOOL_H_
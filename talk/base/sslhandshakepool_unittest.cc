@@ -0,0 +1,130 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "talk/base/gunit.h"
+#include "talk/base/sslhandshakepool.h"
+#include "talk/base/thread.h"
+
+namespace talk_base {
+
+class RecordThreadHandler : public MessageHandler {
+ public:
+  RecordThreadHandler() : thread_(NULL) {}
+  virtual void OnMessage(Message* msg) {
+    thread_ = Thread::Current();
+  }
+  Thread* thread() const { return thread_; }
+
+ private:
+  Thread* thread_;
+};
+
+TEST(SSLHandshakePoolTest, AssignsThreadsInTurn) {
+  SSLHandshakePool pool(3);
+  EXPECT_EQ(3U, pool.num_threads());
+  Thread* first = pool.AssignThread();
+  Thread* second = pool.AssignThread();
+  Thread* third = pool.AssignThread();
+  ASSERT_TRUE(first != NULL);
+  EXPECT_NE(first, second);
+  EXPECT_NE(second, third);
+  EXPECT_NE(first, third);
+  EXPECT_NE(Thread::Current(), first);
+  EXPECT_EQ(first, pool.AssignThread());
+}
+
+TEST(SSLHandshakePoolTest, RunsMessagesOnPoolThreads) {
+  SSLHandshakePool pool(2);
+  Thread* thread = pool.AssignThread();
+  RecordThreadHandler handler;
+  thread->Send(&handler);
+  EXPECT_EQ(thread, handler.thread());
+}
+
+TEST(SSLHandshakePoolTest, NoThreadsMeansInline) {
+  SSLHandshakePool pool(0);
+  EXPECT_EQ(0U, pool.num_threads());
+  EXPECT_TRUE(pool.AssignThread() == NULL);
+}
+
+TEST(SSLHandshakePoolTest, CountsConcurrentHandshakes) {
+  SSLHandshakePool pool(0);
+  pool.OnHandshakeStarted();
+  pool.OnHandshakeStarted();
+  pool.OnHandshakeStarted();
+  pool.OnHandshakeFinished(true, 10);
+  pool.OnHandshakeFinished(false, 0);
+  pool.OnHandshakeStarted();
+
+  SSLHandshakeStats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(1U, stats.handshakes);
+  EXPECT_EQ(1U, stats.failures);
+  EXPECT_EQ(2, stats.in_progress);
+  EXPECT_EQ(3, stats.peak_in_progress);
+  // Failures don't count towards the latencies.
+  EXPECT_EQ(10, stats.latency_p50_ms);
+  EXPECT_EQ(10, stats.latency_max_ms);
+}
+
+TEST(SSLHandshakePoolTest, ComputesLatencyPercentiles) {
+  SSLHandshakePool pool(0);
+  SSLHandshakeStats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(0, stats.latency_p50_ms);
+  EXPECT_EQ(0, stats.latency_max_ms);
+
+  // Report 1..100 ms in a scrambled order.
+  for (int i = 0; i < 100; ++i) {
+    pool.OnHandshakeStarted();
+    pool.OnHandshakeFinished(true, (i * 37) % 100 + 1);
+  }
+  pool.GetStats(&stats);
+  EXPECT_EQ(100U, stats.handshakes);
+  EXPECT_EQ(50, stats.latency_p50_ms);
+  EXPECT_EQ(90, stats.latency_p90_ms);
+  EXPECT_EQ(99, stats.latency_p99_ms);
+  EXPECT_EQ(100, stats.latency_max_ms);
+}
+
+TEST(SSLHandshakePoolTest, KeepsRecentLatencies) {
+  SSLHandshakePool pool(0);
+  for (size_t i = 0; i < SSLHandshakePool::kLatencyWindow; ++i) {
+    pool.OnHandshakeStarted();
+    pool.OnHandshakeFinished(true, 1000);
+  }
+  for (size_t i = 0; i < SSLHandshakePool::kLatencyWindow; ++i) {
+    pool.OnHandshakeStarted();
+    pool.OnHandshakeFinished(true, 5);
+  }
+  SSLHandshakeStats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(2 * SSLHandshakePool::kLatencyWindow, stats.handshakes);
+  EXPECT_EQ(5, stats.latency_p99_ms);
+  EXPECT_EQ(5, stats.latency_max_ms);
+}
+
+}  // namespace talk_base
@@ -34,6 +34,7 @@
 
 #include <string>
 
+#include "talk/base/logging.h"
 #include "talk/base/sslconfig.h"
 
 #if SSL_USE_SCHANNEL
@@ -57,7 +58,8 @@ SSLCertificate* SSLCertificate::FromPEMString(const std::string& pem_string,
   return NULL;
 }
 
-SSLIdentity* SSLIdentity::Generate(const std::string& common_name) {
+SSLIdentity* SSLIdentity::Generate(const std::string& common_name,
+                                   KeyType key_type) {
   return NULL;
 }
 
@@ -68,8 +70,9 @@ SSLCertificate* SSLCertificate::FromPEMString(const std::string& pem_string,
   return OpenSSLCertificate::FromPEMString(pem_string, pem_length);
 }
 
-SSLIdentity* SSLIdentity::Generate(const std::string& common_name) {
-  return OpenSSLIdentity::Generate(common_name);
+SSLIdentity* SSLIdentity::Generate(const std::string& common_name,
+                                   KeyType key_type) {
+  return OpenSSLIdentity::Generate(common_name, key_type);
 }
 
 #elif SSL_USE_NSS  // !SSL_USE_OPENSSL && !SSL_USE_SCHANNEL
@@ -79,7 +82,12 @@ SSLCertificate* SSLCertificate::FromPEMString(const std::string& pem_string,
   return NSSCertificate::FromPEMString(pem_string, pem_length);
 }
 
-SSLIdentity* SSLIdentity::Generate(const std::string& common_name) {
+SSLIdentity* SSLIdentity::Generate(const std::string& common_name,
+                                   KeyType key_type) {
+  if (key_type != KT_RSA) {
+    LOG(LS_ERROR) << "Only RSA identities are supported with NSS";
+    return NULL;
+  }
   return NSSIdentity::Generate(common_name);
 }
 
@@ -89,4 +97,8 @@ SSLIdentity* SSLIdentity::Generate(const std::string& common_name) {
 
 #endif  // SSL_USE_SCHANNEL
 
+SSLIdentity* SSLIdentity::Generate(const std::string& common_name) {
+  return Generate(common_name, KT_RSA);
+}
+
 }  // namespace talk_base
@@ -69,6 +69,12 @@ class SSLCertificate {
                              std::size_t *length) const = 0;
 };
 
+// The kinds of keypair that an identity can be generated with. KT_RSA is a
+// 1024-bit RSA key. KT_ECDSA is an ECDSA key on the NIST P-256 curve, which
+// is generated in a small fraction of the time and makes for cheaper
+// handshakes, but which older peers may not support.
+enum KeyType { KT_RSA, KT_ECDSA };
+
 // Our identity in an SSL negotiation: a keypair and certificate (both
 // with the same public key).
 // This too is pretty much immutable once created.
@@ -77,8 +83,12 @@ class SSLIdentity {
   // Generates an identity (keypair and self-signed certificate). If
   // common_name is non-empty, it will be used for the certificate's
   // subject and issuer name, otherwise a random string will be used.
-  // Returns NULL on failure.
+  // Returns NULL on failure, or if the SSL implementation doesn't support
+  // key_type.
   // Caller is responsible for freeing the returned object.
+  static SSLIdentity* Generate(const std::string& common_name,
+                               KeyType key_type);
+  // As above, with an RSA key.
   static SSLIdentity* Generate(const std::string& common_name);
 
   virtual ~SSLIdentity() {}
@@ -151,3 +151,26 @@ TEST_F(SSLIdentityTest, DigestSHA384) {
 TEST_F(SSLIdentityTest, DigestSHA512) {
   TestDigest(talk_base::DIGEST_SHA_512, 64);
 }
+
+#if SSL_USE_NSS
+TEST_F(SSLIdentityTest, DISABLED_GenerateECDSA) {
+#else
+TEST_F(SSLIdentityTest, GenerateECDSA) {
+#endif
+  talk_base::scoped_ptr<talk_base::SSLIdentity> identity(
+      talk_base::SSLIdentity::Generate("ecdsa", talk_base::KT_ECDSA));
+  ASSERT_TRUE(identity);
+
+  unsigned char digest[32];
+  size_t digest_len;
+  EXPECT_TRUE(identity->certificate().ComputeDigest(talk_base::DIGEST_SHA_256,
+                                                    digest, sizeof(digest),
+                                                    &digest_len));
+  EXPECT_EQ(sizeof(digest), digest_len);
+
+  // The certificate must survive a round trip through PEM.
+  talk_base::scoped_ptr<talk_base::SSLCertificate> cert(
+      talk_base::SSLCertificate::FromPEMString(
+          identity->certificate().ToPEMString(), NULL));
+  EXPECT_TRUE(cert);
+}
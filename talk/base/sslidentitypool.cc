@@ -0,0 +1,135 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "talk/base/sslidentitypool.h"
+
+#include "talk/base/helpers.h"
+#include "talk/base/logging.h"
+#include "talk/base/stringencode.h"
+
+namespace talk_base {
+
+SSLIdentityPool::SSLIdentityPool(const std::string& name_prefix,
+                                 KeyType key_type, size_t depth)
+    : name_prefix_(name_prefix),
+      key_type_(key_type),
+      depth_(depth),
+      hits_(0),
+      misses_(0) {
+  thread_.SetName("SSLIdentityPool", this);
+  thread_.Start();
+  thread_.Post(this);
+}
+
+SSLIdentityPool::~SSLIdentityPool() {
+  // Waits for an identity that is being generated.
+  thread_.Stop();
+  for (size_t i = 0; i < ready_.size(); ++i) {
+    delete ready_[i];
+  }
+}
+
+void SSLIdentityPool::Configure(KeyType key_type, size_t depth) {
+  {
+    CritScope cs(&crit_);
+    if (key_type != key_type_) {
+      for (size_t i = 0; i < ready_.size(); ++i) {
+        delete ready_[i];
+      }
+      ready_.clear();
+    }
+    while (ready_.size() > depth) {
+      delete ready_.back();
+      ready_.pop_back();
+    }
+    key_type_ = key_type;
+    depth_ = depth;
+  }
+  thread_.Post(this);
+}
+
+SSLIdentity* SSLIdentityPool::Take() {
+  SSLIdentity* identity = NULL;
+  KeyType key_type;
+  {
+    CritScope cs(&crit_);
+    if (!ready_.empty()) {
+      identity = ready_.front();
+      ready_.pop_front();
+      ++hits_;
+    } else {
+      ++misses_;
+    }
+    key_type = key_type_;
+  }
+  thread_.Post(this);
+  if (!identity) {
+    LOG(LS_INFO) << "No identity ready; generating one";
+    identity = Generate(key_type);
+  }
+  return identity;
+}
+
+void SSLIdentityPool::GetStats(SSLIdentityPoolStats* stats) {
+  CritScope cs(&crit_);
+  stats->hits = hits_;
+  stats->misses = misses_;
+  stats->ready = ready_.size();
+}
+
+void SSLIdentityPool::OnMessage(Message* msg) {
+  KeyType key_type;
+  {
+    CritScope cs(&crit_);
+    if (ready_.size() >= depth_)
+      return;
+    key_type = key_type_;
+  }
+
+  SSLIdentity* identity = Generate(key_type);
+  if (!identity) {
+    LOG(LS_ERROR) << "Failed to generate identity; pool not refilled";
+    return;
+  }
+
+  CritScope cs(&crit_);
+  // The pool may have been reconfigured in the meantime.
+  if (key_type != key_type_ || ready_.size() >= depth_) {
+    delete identity;
+  } else {
+    ready_.push_back(identity);
+  }
+  if (ready_.size() < depth_) {
+    thread_.Post(this);
+  }
+}
+
+SSLIdentity* SSLIdentityPool::Generate(KeyType key_type) {
+  return SSLIdentity::Generate(name_prefix_ + ToString(CreateRandomId()),
+                               key_type);
+}
+
+}  // namespace talk_base
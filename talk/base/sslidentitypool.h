@@ -0,0 +1,95 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TALK_BASE_SSLIDENTITYPOOL_H_
+#define TALK_BASE_SSLIDENTITYPOOL_H_
+
+#include <deque>
+#include <string>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/criticalsection.h"
+#include "talk/base/messagehandler.h"
+#include "talk/base/sslidentity.h"
+#include "talk/base/thread.h"
+
+namespace talk_base {
+
+struct SSLIdentityPoolStats {
+  SSLIdentityPoolStats() : hits(0), misses(0), ready(0) {}
+
+  uint64 hits;  // Identities that were ready when asked for.
+  uint64 misses;  // Identities that had to be generated on the spot.
+  size_t ready;
+};
+
+// Generating an identity takes tens to hundreds of milliseconds for an RSA
+// key, which is time that a new session would otherwise spend blocked before
+// it can make its first offer. SSLIdentityPool generates identities ahead of
+// time on a thread of its own, keeping up to |depth| of them ready, and hands
+// them out as they are asked for. Every identity is handed out once, and
+// each is replaced in the background as soon as it has been taken. All
+// methods are thread-safe.
+class SSLIdentityPool : public MessageHandler {
+ public:
+  // Identities are named |name_prefix| followed by a random number.
+  SSLIdentityPool(const std::string& name_prefix, KeyType key_type,
+                  size_t depth);
+  virtual ~SSLIdentityPool();
+
+  // Changes the kind and the number of identities kept ready. Ready
+  // identities of another key type are discarded.
+  void Configure(KeyType key_type, size_t depth);
+
+  // Returns a new identity of the configured key type, generating it on the
+  // calling thread if none is ready, or NULL if generation fails.
+  // Caller is responsible for freeing the returned object.
+  SSLIdentity* Take();
+
+  void GetStats(SSLIdentityPoolStats* stats);
+
+ private:
+  // Generates one identity on thread_, and posts another message if more are
+  // needed.
+  virtual void OnMessage(Message* msg);
+  SSLIdentity* Generate(KeyType key_type);
+
+  Thread thread_;
+  CriticalSection crit_;
+  const std::string name_prefix_;
+  KeyType key_type_;
+  size_t depth_;
+  std::deque<SSLIdentity*> ready_;
+  uint64 hits_;
+  uint64 misses_;
+
+  DISALLOW_COPY_AND_ASSIGN(SSLIdentityPool);
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_SSLIDENTITYPOOL_H_
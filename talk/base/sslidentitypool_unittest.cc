@@ -0,0 +1,125 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/ssladapter.h"
+#include "talk/base/sslidentitypool.h"
+#include "talk/base/timeutils.h"
+
+using talk_base::SSLIdentity;
+using talk_base::SSLIdentityPool;
+using talk_base::SSLIdentityPoolStats;
+
+static const int kGenerateTimeout = 10000;
+
+class SSLIdentityPoolTest : public testing::Test {
+ public:
+  static void SetUpTestCase() {
+    talk_base::InitializeSSL();
+  }
+
+  static size_t Ready(SSLIdentityPool* pool) {
+    SSLIdentityPoolStats stats;
+    pool->GetStats(&stats);
+    return stats.ready;
+  }
+};
+
+TEST_F(SSLIdentityPoolTest, FillsToDepth) {
+  SSLIdentityPool pool("test", talk_base::KT_RSA, 2);
+  EXPECT_EQ_WAIT(2U, Ready(&pool), kGenerateTimeout);
+
+  talk_base::scoped_ptr<SSLIdentity> identity(pool.Take());
+  EXPECT_TRUE(identity);
+  SSLIdentityPoolStats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(1U, stats.hits);
+  EXPECT_EQ(0U, stats.misses);
+
+  // The identity that was taken is replaced.
+  EXPECT_EQ_WAIT(2U, Ready(&pool), kGenerateTimeout);
+}
+
+TEST_F(SSLIdentityPoolTest, GeneratesWhenEmpty) {
+  SSLIdentityPool pool("test", talk_base::KT_RSA, 0);
+  talk_base::scoped_ptr<SSLIdentity> identity(pool.Take());
+  EXPECT_TRUE(identity);
+  SSLIdentityPoolStats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(0U, stats.hits);
+  EXPECT_EQ(1U, stats.misses);
+  EXPECT_EQ(0U, stats.ready);
+}
+
+TEST_F(SSLIdentityPoolTest, HandsOutDistinctIdentities) {
+  SSLIdentityPool pool("test", talk_base::KT_RSA, 2);
+  EXPECT_EQ_WAIT(2U, Ready(&pool), kGenerateTimeout);
+  talk_base::scoped_ptr<SSLIdentity> identity1(pool.Take());
+  talk_base::scoped_ptr<SSLIdentity> identity2(pool.Take());
+  ASSERT_TRUE(identity1);
+  ASSERT_TRUE(identity2);
+  EXPECT_NE(identity1->certificate().ToPEMString(),
+            identity2->certificate().ToPEMString());
+}
+
+TEST_F(SSLIdentityPoolTest, Reconfigure) {
+  SSLIdentityPool pool("test", talk_base::KT_RSA, 3);
+  EXPECT_EQ_WAIT(3U, Ready(&pool), kGenerateTimeout);
+  pool.Configure(talk_base::KT_RSA, 1);
+  EXPECT_EQ(1U, Ready(&pool));
+
+  // Changing the key type throws away what is ready.
+  pool.Configure(talk_base::KT_ECDSA, 2);
+  EXPECT_EQ_WAIT(2U, Ready(&pool), kGenerateTimeout);
+  talk_base::scoped_ptr<SSLIdentity> identity(pool.Take());
+  EXPECT_TRUE(identity);
+}
+
+// Logs how long it takes to get an identity of each key type, with and
+// without identities kept ready.
+TEST_F(SSLIdentityPoolTest, TakePerformance) {
+  static const int kNumIdentities = 5;
+  static const talk_base::KeyType kKeyTypes[] = {
+    talk_base::KT_RSA, talk_base::KT_ECDSA
+  };
+  for (size_t i = 0; i < ARRAY_SIZE(kKeyTypes); ++i) {
+    for (int depth = 0; depth <= kNumIdentities; depth += kNumIdentities) {
+      SSLIdentityPool pool("test", kKeyTypes[i], depth);
+      EXPECT_EQ_WAIT(static_cast<size_t>(depth), Ready(&pool),
+                     kGenerateTimeout);
+      uint32 start = talk_base::Time();
+      for (int j = 0; j < kNumIdentities; ++j) {
+        delete pool.Take();
+      }
+      uint32 elapsed = talk_base::TimeSince(start);
+      LOG(LS_INFO) << (kKeyTypes[i] == talk_base::KT_RSA ? "RSA" : "ECDSA")
+                   << " with " << depth << " ready: " << kNumIdentities
+                   << " identities in " << elapsed << " ms";
+    }
+  }
+}
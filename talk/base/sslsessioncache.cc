@@ -0,0 +1,130 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/base/sslsessioncache.h"
+
+#include "talk/base/common.h"
+#include "talk/base/helpers.h"
+#include "talk/base/logging.h"
+
+namespace talk_base {
+
+const size_t SSLSessionCache::kTicketKeysLength;
+
+SSLSessionCache::SSLSessionCache(size_t max_sessions)
+    : max_sessions_(max_sessions),
+      full_handshakes_(0),
+      resumed_handshakes_(0) {
+}
+
+SSLSessionCache::~SSLSessionCache() {
+}
+
+std::string SSLSessionCache::MakeKey(const std::string& local_id,
+                                     const std::string& remote_id) {
+  return local_id + "/" + remote_id;
+}
+
+void SSLSessionCache::Store(const std::string& key,
+                            const std::string& session) {
+  CritScope cs(&crit_);
+  SessionMap::iterator it = index_.find(key);
+  if (it != index_.end())
+    sessions_.erase(it->second);
+  sessions_.push_front(std::make_pair(key, session));
+  index_[key] = sessions_.begin();
+
+  while (sessions_.size() > max_sessions_) {
+    index_.erase(sessions_.back().first);
+    sessions_.pop_back();
+  }
+}
+
+bool SSLSessionCache::Lookup(const std::string& key, std::string* session) {
+  CritScope cs(&crit_);
+  SessionMap::iterator it = index_.find(key);
+  if (it == index_.end())
+    return false;
+
+  sessions_.splice(sessions_.begin(), sessions_, it->second);
+  *session = it->second->second;
+  return true;
+}
+
+void SSLSessionCache::Remove(const std::string& key) {
+  CritScope cs(&crit_);
+  SessionMap::iterator it = index_.find(key);
+  if (it == index_.end())
+    return;
+
+  sessions_.erase(it->second);
+  index_.erase(it);
+}
+
+std::string SSLSessionCache::GetTicketKeys(const std::string& local_id) {
+  CritScope cs(&crit_);
+  SessionMap::iterator it = ticket_index_.find(local_id);
+  if (it != ticket_index_.end()) {
+    ticket_keys_.splice(ticket_keys_.begin(), ticket_keys_, it->second);
+    return it->second->second;
+  }
+
+  std::string keys;
+  std::string table;
+  for (int i = 0; i < 256; ++i)
+    table.push_back(static_cast<char>(i));
+  if (!CreateRandomString(kTicketKeysLength, table, &keys)) {
+    LOG(LS_ERROR) << "Failed to create session ticket keys";
+    return std::string();
+  }
+
+  ticket_keys_.push_front(std::make_pair(local_id, keys));
+  ticket_index_[local_id] = ticket_keys_.begin();
+  while (ticket_keys_.size() > max_sessions_) {
+    ticket_index_.erase(ticket_keys_.back().first);
+    ticket_keys_.pop_back();
+  }
+  return keys;
+}
+
+void SSLSessionCache::OnHandshakeFinished(bool resumed) {
+  CritScope cs(&crit_);
+  if (resumed) {
+    ++resumed_handshakes_;
+  } else {
+    ++full_handshakes_;
+  }
+}
+
+void SSLSessionCache::GetStats(SSLSessionCacheStats* stats) {
+  CritScope cs(&crit_);
+  stats->full_handshakes = full_handshakes_;
+  stats->resumed_handshakes = resumed_handshakes_;
+  stats->sessions = sessions_.size();
+}
+
+}  // namespace talk_base
@@ -0,0 +1,121 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_BASE_SSLSESSIONCACHE_H_
+#define TALK_BASE_SSLSESSIONCACHE_H_
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/criticalsection.h"
+
+namespace talk_base {
+
+struct SSLSessionCacheStats {
+  SSLSessionCacheStats()
+      : full_handshakes(0), resumed_handshakes(0), sessions(0) {
+  }
+
+  uint64 full_handshakes;  // Completed handshakes that negotiated new keys.
+  uint64 resumed_handshakes;  // Completed abbreviated handshakes.
+  size_t sessions;  // Sessions currently cached.
+};
+
+// Remembers SSL sessions between streams, so that a peer that reconnects
+// (after an ICE restart or a network change, say) can resume its previous
+// session with an abbreviated handshake, saving a round trip and the
+// public key operations of a full one.
+//
+// Client streams store their session when their handshake completes and
+// offer it again on the next handshake with the same peer. Sessions are
+// kept under a key that names both our own identity and the peer's, so a
+// session is only offered to the peer it was negotiated with. Server
+// streams don't store sessions; instead they issue session tickets, which
+// the client hands back to resume, under ticket keys that the cache shares
+// between all server streams with the same identity.
+//
+// Sessions are opaque to the cache; each SSLStreamAdapter implementation
+// stores them in its own serialized form. The least recently used session
+// is dropped once there are more than |max_sessions|. The cache must outlive
+// every stream that uses it. All methods are thread-safe.
+class SSLSessionCache {
+ public:
+  // Length of the ticket keys returned by GetTicketKeys(): a 16 byte key
+  // name, then 16 bytes each of HMAC and AES key.
+  static const size_t kTicketKeysLength = 48;
+
+  explicit SSLSessionCache(size_t max_sessions);
+  ~SSLSessionCache();
+
+  // Returns the key to cache a session under, given fingerprints (or any
+  // other unique names) of the local and remote identities.
+  static std::string MakeKey(const std::string& local_id,
+                             const std::string& remote_id);
+
+  // Adds or replaces the session under |key|.
+  void Store(const std::string& key, const std::string& session);
+  // Copies the session under |key| to |session|, if there is one.
+  bool Lookup(const std::string& key, std::string* session);
+  // Drops the session under |key|, for instance because the peer refused
+  // to resume it.
+  void Remove(const std::string& key);
+
+  // Returns the session ticket keys for |local_id|, creating them on first
+  // use. Like sessions, the keys of at most |max_sessions| identities are
+  // kept, least recently used dropped first; a dropped identity gets new
+  // keys, which only costs its clients a full handshake.
+  std::string GetTicketKeys(const std::string& local_id);
+
+  // Called by streams when a handshake completes.
+  void OnHandshakeFinished(bool resumed);
+
+  void GetStats(SSLSessionCacheStats* stats);
+
+ private:
+  // Most recently used first.
+  typedef std::list<std::pair<std::string, std::string> > SessionList;
+  typedef std::map<std::string, SessionList::iterator> SessionMap;
+
+  CriticalSection crit_;
+  size_t max_sessions_;
+  SessionList sessions_;
+  SessionMap index_;
+  SessionList ticket_keys_;
+  SessionMap ticket_index_;
+  uint64 full_handshakes_;
+  uint64 resumed_handshakes_;
+
+  DISALLOW_COPY_AND_ASSIGN(SSLSessionCache);
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_SSLSESSIONCACHE_H_
@@ -0,0 +1,112 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+
+#include "talk/base/gunit.h"
+#include "talk/base/sslsessioncache.h"
+
+namespace talk_base {
+
+TEST(SSLSessionCacheTest, StoresAndLooksUpSessions) {
+  SSLSessionCache cache(10);
+  std::string key = SSLSessionCache::MakeKey("local", "remote");
+  std::string session;
+  EXPECT_FALSE(cache.Lookup(key, &session));
+
+  cache.Store(key, "session 1");
+  ASSERT_TRUE(cache.Lookup(key, &session));
+  EXPECT_EQ("session 1", session);
+
+  cache.Store(key, "session 2");
+  ASSERT_TRUE(cache.Lookup(key, &session));
+  EXPECT_EQ("session 2", session);
+
+  cache.Remove(key);
+  EXPECT_FALSE(cache.Lookup(key, &session));
+}
+
+TEST(SSLSessionCacheTest, KeysNameBothIdentities) {
+  SSLSessionCache cache(10);
+  cache.Store(SSLSessionCache::MakeKey("local", "remote"), "session");
+  std::string session;
+  EXPECT_FALSE(cache.Lookup(SSLSessionCache::MakeKey("local", "other"),
+                            &session));
+  EXPECT_FALSE(cache.Lookup(SSLSessionCache::MakeKey("other", "remote"),
+                            &session));
+}
+
+TEST(SSLSessionCacheTest, DropsLeastRecentlyUsed) {
+  SSLSessionCache cache(2);
+  cache.Store("a", "session a");
+  cache.Store("b", "session b");
+  std::string session;
+  EXPECT_TRUE(cache.Lookup("a", &session));  // Now "b" is the oldest.
+  cache.Store("c", "session c");
+
+  EXPECT_TRUE(cache.Lookup("a", &session));
+  EXPECT_FALSE(cache.Lookup("b", &session));
+  EXPECT_TRUE(cache.Lookup("c", &session));
+
+  SSLSessionCacheStats stats;
+  cache.GetStats(&stats);
+  EXPECT_EQ(2U, stats.sessions);
+}
+
+TEST(SSLSessionCacheTest, SharesTicketKeysPerIdentity) {
+  SSLSessionCache cache(10);
+  std::string keys = cache.GetTicketKeys("local");
+  EXPECT_EQ(SSLSessionCache::kTicketKeysLength, keys.size());
+  EXPECT_EQ(keys, cache.GetTicketKeys("local"));
+  EXPECT_NE(keys, cache.GetTicketKeys("other"));
+}
+
+TEST(SSLSessionCacheTest, DropsLeastRecentlyUsedTicketKeys) {
+  SSLSessionCache cache(2);
+  std::string keys_a = cache.GetTicketKeys("a");
+  std::string keys_b = cache.GetTicketKeys("b");
+  cache.GetTicketKeys("a");  // Now "b" is the oldest.
+  cache.GetTicketKeys("c");
+
+  EXPECT_EQ(keys_a, cache.GetTicketKeys("a"));
+  EXPECT_NE(keys_b, cache.GetTicketKeys("b"));
+}
+
+TEST(SSLSessionCacheTest, CountsHandshakes) {
+  SSLSessionCache cache(10);
+  cache.OnHandshakeFinished(false);
+  cache.OnHandshakeFinished(true);
+  cache.OnHandshakeFinished(true);
+
+  SSLSessionCacheStats stats;
+  cache.GetStats(&stats);
+  EXPECT_EQ(1U, stats.full_handshakes);
+  EXPECT_EQ(2U, stats.resumed_handshakes);
+  EXPECT_EQ(0U, stats.sessions);
+}
+
+}  // namespace talk_base
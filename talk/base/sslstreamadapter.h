@@ -36,6 +36,9 @@
 
 namespace talk_base {
 
+class SSLHandshakePool;
+class SSLSessionCache;
+
 // SSLStreamAdapter : A StreamInterfaceAdapter that does SSL/TLS.
 // After SSL has been started, the stream will only open on successful
 // SSL verification of certificates, and the communication is
@@ -138,6 +141,25 @@ class SSLStreamAdapter : public StreamAdapterInterface {
                                         const unsigned char* digest_val,
                                         size_t digest_len) = 0;
 
+  // Run the handshake on one of |pool|'s threads rather than on this
+  // stream's thread, and report its progress to |pool|. Must be called
+  // before StartSSLWithServer or StartSSLWithPeer, on the thread that the
+  // stream is used on. While the handshake runs, the wrapped stream is read
+  // and written from the pool's thread, so it must allow that. Returns false
+  // if the implementation doesn't support offloading handshakes.
+  virtual bool SetHandshakePool(SSLHandshakePool* pool) {
+    return false;  // Default is unsupported
+  }
+
+  // Keep the session in |cache| once the handshake completes, and resume it
+  // with an abbreviated handshake when this stream's identity next connects
+  // to the same peer. Must be called before StartSSLWithServer or
+  // StartSSLWithPeer. Returns false if the implementation doesn't support
+  // session resumption.
+  virtual bool SetSessionCache(SSLSessionCache* cache) {
+    return false;  // Default is unsupported
+  }
+
   // Key Exporter interface from RFC 5705
   // Arguments are:
   // label               -- the exporter label.
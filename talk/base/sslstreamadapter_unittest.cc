@@ -35,7 +35,9 @@
 #include "talk/base/helpers.h"
 #include "talk/base/ssladapter.h"
 #include "talk/base/sslconfig.h"
+#include "talk/base/sslhandshakepool.h"
 #include "talk/base/sslidentity.h"
+#include "talk/base/sslsessioncache.h"
 #include "talk/base/sslstreamadapter.h"
 #include "talk/base/stream.h"
 
@@ -186,6 +188,41 @@ class SSLStreamAdapterTestBase : public testing::Test,
     }
   }
 
+  // Replaces both streams with new ones, as when the peers reconnect. They
+  // keep their identities, unless |server_identity| gives the server a new
+  // one.
+  void ResetStreams(talk_base::SSLIdentity* server_identity = NULL) {
+    talk_base::SSLIdentity* client_identity = client_identity_->GetReference();
+    if (!server_identity)
+      server_identity = server_identity_->GetReference();
+    client_ssl_.reset();
+    server_ssl_.reset();
+
+    // Throw away anything still in flight.
+    char buf[1024];
+    while (client_buffer_.Read(buf, sizeof(buf), NULL, NULL) ==
+           talk_base::SR_SUCCESS) {
+    }
+    while (server_buffer_.Read(buf, sizeof(buf), NULL, NULL) ==
+           talk_base::SR_SUCCESS) {
+    }
+
+    client_stream_ =
+        new SSLDummyStream(this, "c2s", &client_buffer_, &server_buffer_);
+    server_stream_ =
+        new SSLDummyStream(this, "s2c", &server_buffer_, &client_buffer_);
+    client_ssl_.reset(talk_base::SSLStreamAdapter::Create(client_stream_));
+    server_ssl_.reset(talk_base::SSLStreamAdapter::Create(server_stream_));
+    client_ssl_->SignalEvent.connect(this, &SSLStreamAdapterTestBase::OnEvent);
+    server_ssl_->SignalEvent.connect(this, &SSLStreamAdapterTestBase::OnEvent);
+
+    client_identity_ = client_identity;
+    server_identity_ = server_identity;
+    client_ssl_->SetIdentity(client_identity_);
+    server_ssl_->SetIdentity(server_identity_);
+    identities_set_ = false;
+  }
+
   void SetPeerIdentitiesByCertificate(bool correct) {
     LOG(LS_INFO) << "Setting peer identities by certificate";
 
@@ -711,6 +748,79 @@ TEST_F(SSLStreamAdapterTestDTLS, TestDTLSConnectWithSmallMtu) {
   TestHandshake();
 };
 
+// Test a handshake that runs on a handshake pool, and that the pool
+// accounts for both sides of it.
+TEST_F(SSLStreamAdapterTestDTLS, TestDTLSConnectWithHandshakePool) {
+  MAYBE_SKIP_TEST(HaveDtls);
+  talk_base::SSLHandshakePool pool(2);
+  if (!client_ssl_->SetHandshakePool(&pool) ||
+      !server_ssl_->SetHandshakePool(&pool)) {
+    LOG(LS_INFO) << "Handshake pool not supported... skipping";
+    return;
+  }
+  TestHandshake();
+  TestTransfer(100);
+
+  talk_base::SSLHandshakeStats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(2U, stats.handshakes);
+  EXPECT_EQ(0U, stats.failures);
+  EXPECT_EQ(0, stats.in_progress);
+  EXPECT_EQ(2, stats.peak_in_progress);
+};
+
+// Test that peers which reconnect resume their session, and that the cache
+// counts full and abbreviated handshakes on both sides.
+TEST_F(SSLStreamAdapterTestDTLS, TestDTLSSessionResumption) {
+  MAYBE_SKIP_TEST(HaveDtls);
+  talk_base::SSLSessionCache cache(10);
+  if (!client_ssl_->SetSessionCache(&cache) ||
+      !server_ssl_->SetSessionCache(&cache)) {
+    LOG(LS_INFO) << "Session resumption not supported... skipping";
+    return;
+  }
+  TestHandshake();
+
+  talk_base::SSLSessionCacheStats stats;
+  cache.GetStats(&stats);
+  EXPECT_EQ(2U, stats.full_handshakes);
+  EXPECT_EQ(0U, stats.resumed_handshakes);
+  EXPECT_EQ(1U, stats.sessions);
+
+  ResetStreams();
+  ASSERT_TRUE(client_ssl_->SetSessionCache(&cache));
+  ASSERT_TRUE(server_ssl_->SetSessionCache(&cache));
+  TestHandshake();
+  TestTransfer(100);
+
+  cache.GetStats(&stats);
+  EXPECT_EQ(2U, stats.full_handshakes);
+  EXPECT_EQ(2U, stats.resumed_handshakes);
+};
+
+// Test that a session isn't resumed with a peer other than the one it was
+// negotiated with.
+TEST_F(SSLStreamAdapterTestDTLS, TestDTLSSessionNotResumedWithOtherPeer) {
+  MAYBE_SKIP_TEST(HaveDtls);
+  talk_base::SSLSessionCache cache(10);
+  if (!client_ssl_->SetSessionCache(&cache) ||
+      !server_ssl_->SetSessionCache(&cache)) {
+    LOG(LS_INFO) << "Session resumption not supported... skipping";
+    return;
+  }
+  TestHandshake();
+
+  ResetStreams(talk_base::SSLIdentity::Generate("server2"));
+  ASSERT_TRUE(client_ssl_->SetSessionCache(&cache));
+  ASSERT_TRUE(server_ssl_->SetSessionCache(&cache));
+  TestHandshake();
+
+  talk_base::SSLSessionCacheStats stats;
+  cache.GetStats(&stats);
+  EXPECT_EQ(4U, stats.full_handshakes);
+  EXPECT_EQ(0U, stats.resumed_handshakes);
+};
+
 // Test transfer -- trivial
 TEST_F(SSLStreamAdapterTestDTLS, TestDTLSTransfer) {
   MAYBE_SKIP_TEST(HaveDtls);
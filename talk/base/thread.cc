@@ -40,6 +40,7 @@
 #include "talk/base/common.h"
 #include "talk/base/logging.h"
 #include "talk/base/stringutils.h"
+#include "talk/base/timerwheel.h"
 #include "talk/base/timeutils.h"
 
 #if !__has_feature(objc_arc) && (defined(OSX) || defined(IOS))
@@ -49,6 +50,10 @@
 
 namespace talk_base {
 
+// Granularity and level 0 span (2.56 s) of each thread's timer wheel.
+static const int kTimerWheelTickMs = 10;
+static const int kTimerWheelSlots = 256;
+
 ThreadManager* ThreadManager::Instance() {
   LIBJINGLE_DEFINE_STATIC_LOCAL(ThreadManager, thread_manager, ());
   return &thread_manager;
@@ -160,6 +165,8 @@ Thread::Thread(SocketServer* ss)
 
 Thread::~Thread() {
   Stop();
+  // Cancels any timers still on the wheel.
+  timer_wheel_.reset();
   if (active_)
     Clear(NULL);
 }
@@ -490,6 +497,15 @@ void Thread::Clear(MessageHandler *phandler, uint32 id,
   MessageQueue::Clear(phandler, id, removed);
 }
 
+TimerWheel* Thread::timer_wheel() {
+  ASSERT(IsCurrent());
+  if (!timer_wheel_) {
+    timer_wheel_.reset(new TimerWheel(this, kTimerWheelTickMs,
+                                      kTimerWheelSlots));
+  }
+  return timer_wheel_.get();
+}
+
 bool Thread::ProcessMessages(int cmsLoop) {
   uint32 msEnd = (kForever == cmsLoop) ? 0 : TimeAfter(cmsLoop);
   int cmsNext = cmsLoop;
@@ -46,6 +46,7 @@
 namespace talk_base {
 
 class Thread;
+class TimerWheel;
 
 class ThreadManager {
  public:
@@ -172,6 +173,10 @@ class Thread : public MessageQueue {
   //  2) Stop() is called (returns false)
   bool ProcessMessages(int cms);
 
+  // A wheel for the coarse-grained timers of objects living on this thread,
+  // created on first use. Must only be used on this thread.
+  TimerWheel* timer_wheel();
+
   // Returns true if this is a thread that we created using the standard
   // constructor, false if it was created by a call to
   // ThreadManager::WrapCurrentThread().  The main thread of an application
@@ -215,6 +220,7 @@ class Thread : public MessageQueue {
   bool WrapCurrentWithThreadManager(ThreadManager* thread_manager);
 
   std::list<_SendMessage> sendlist_;
+  scoped_ptr<TimerWheel> timer_wheel_;
   std::string name_;
   ThreadPriority priority_;
   bool started_;
@@ -0,0 +1,244 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/base/timerwheel.h"
+
+#include "talk/base/common.h"
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+
+namespace talk_base {
+
+enum {
+  MSG_TICK,
+};
+
+TimerWheel::Timer::Timer()
+    : prev_(NULL), next_(NULL), wheel_(NULL), due_tick_(0), handler_(NULL),
+      id_(0) {
+}
+
+TimerWheel::Timer::~Timer() {
+  if (wheel_)
+    wheel_->Cancel(this);
+}
+
+void TimerWheel::Timer::Unlink() {
+  prev_->next_ = next_;
+  next_->prev_ = prev_;
+  prev_ = next_ = NULL;
+}
+
+TimerWheel::TimerWheel(Thread* thread, int tick_ms, int num_slots)
+    : thread_(thread),
+      tick_ms_(tick_ms),
+      num_slots_(num_slots),
+      num_levels_(1),
+      current_tick_(0),
+      current_tick_time_(Time()),
+      size_(0),
+      tick_posted_(false),
+      posted_tick_(0) {
+  ASSERT(tick_ms > 0 && num_slots > 1);
+  // Enough levels to hold any 32-bit tick distance.
+  for (uint64 span = num_slots_; span <= 0xFFFFFFFFU; span *= num_slots_) {
+    ++num_levels_;
+  }
+  int total = num_levels_ * num_slots_;
+  slots_.reset(new Timer[total]);
+  for (int i = 0; i < total; ++i) {
+    slots_[i].prev_ = slots_[i].next_ = &slots_[i];
+  }
+}
+
+TimerWheel::~TimerWheel() {
+  for (int i = 0; i < num_levels_ * num_slots_; ++i) {
+    Timer* head = &slots_[i];
+    while (head->next_ != head) {
+      Cancel(head->next_);
+    }
+  }
+  thread_->Clear(this);
+}
+
+void TimerWheel::Schedule(Timer* timer, int delay_ms, MessageHandler* handler,
+                          uint32 id) {
+  ASSERT(thread_->IsCurrent());
+  ASSERT(delay_ms >= 0);
+  Cancel(timer);
+  if (size_ == 0) {
+    // Nothing has been ticking; restart the clock from now.
+    current_tick_time_ = Time();
+  }
+
+  // Round up, counting from the last tick, so that the timer never fires
+  // early. The earliest slot is the next one to be run.
+  int32 since = TimeSince(current_tick_time_);
+  uint32 ticks = (since + delay_ms + tick_ms_ - 1) / tick_ms_;
+  if (ticks == 0)
+    ticks = 1;
+
+  timer->wheel_ = this;
+  timer->due_tick_ = current_tick_ + ticks;
+  timer->handler_ = handler;
+  timer->id_ = id;
+  Insert(timer);
+  ++size_;
+  if (tick_posted_ &&
+      static_cast<int32>(timer->due_tick_ - posted_tick_) < 0) {
+    // Due before the posted wakeup; move the wakeup forward.
+    thread_->Clear(this);
+    tick_posted_ = false;
+  }
+  PostTick();
+}
+
+void TimerWheel::Cancel(Timer* timer) {
+  if (timer->wheel_ != this)
+    return;
+  timer->Unlink();
+  timer->wheel_ = NULL;
+  --size_;
+}
+
+void TimerWheel::OnMessage(Message* msg) {
+  ASSERT(msg->message_id == MSG_TICK);
+  tick_posted_ = false;
+  Advance();
+  PostTick();
+}
+
+void TimerWheel::Insert(Timer* timer) {
+  // File the timer on the lowest level whose revolution covers its
+  // distance, in the slot holding its due tick.
+  uint32 distance = timer->due_tick_ - current_tick_;
+  uint64 unit = 1;
+  int level = 0;
+  while (level + 1 < num_levels_ && distance >= unit * num_slots_) {
+    unit *= num_slots_;
+    ++level;
+  }
+  int slot = static_cast<int>((timer->due_tick_ / unit) % num_slots_);
+  Timer* head = &slots_[level * num_slots_ + slot];
+  timer->prev_ = head->prev_;
+  timer->next_ = head;
+  head->prev_->next_ = timer;
+  head->prev_ = timer;
+}
+
+void TimerWheel::Advance() {
+  int32 elapsed = TimeSince(current_tick_time_) / tick_ms_;
+  if (elapsed <= 0)
+    return;
+  uint32 end = current_tick_ + elapsed;
+  current_tick_time_ += elapsed * tick_ms_;
+  // Every tick has to be visited for the cascades to stay correct, but an
+  // empty wheel can skip straight to the end.
+  while (current_tick_ != end && size_ > 0) {
+    uint32 tick = ++current_tick_;
+    uint64 unit = num_slots_;
+    for (int level = 1; level < num_levels_ && tick % unit == 0; ++level) {
+      Cascade(level, tick);
+      unit *= num_slots_;
+    }
+    RunSlot(&slots_[tick % num_slots_], tick);
+  }
+  current_tick_ = end;
+}
+
+void TimerWheel::Cascade(int level, uint32 tick) {
+  uint64 unit = 1;
+  for (int i = 0; i < level; ++i) {
+    unit *= num_slots_;
+  }
+  int slot = static_cast<int>((tick / unit) % num_slots_);
+  Timer* head = &slots_[level * num_slots_ + slot];
+  if (head->next_ == head)
+    return;
+  // Detach the list first, since Insert may file timers back into it.
+  Timer* timer = head->next_;
+  head->prev_->next_ = NULL;
+  head->next_ = head->prev_ = head;
+  while (timer) {
+    Timer* next = timer->next_;
+    Insert(timer);
+    timer = next;
+  }
+}
+
+void TimerWheel::RunSlot(Timer* head, uint32 tick) {
+  // Move the slot's timers onto a private list first, so that handlers can
+  // freely schedule and cancel timers, including the ones we have yet to
+  // look at, while we run.
+  if (head->next_ == head)
+    return;
+  Timer pending;
+  pending.next_ = head->next_;
+  pending.prev_ = head->prev_;
+  pending.next_->prev_ = &pending;
+  pending.prev_->next_ = &pending;
+  head->next_ = head->prev_ = head;
+
+  while (pending.next_ != &pending) {
+    Timer* timer = pending.next_;
+    timer->Unlink();
+    if (static_cast<int32>(timer->due_tick_ - tick) > 0) {
+      // Not due yet; file it again.
+      Insert(timer);
+      continue;
+    }
+    timer->wheel_ = NULL;
+    --size_;
+    Message msg;
+    msg.phandler = timer->handler_;
+    msg.message_id = timer->id_;
+    timer->handler_->OnMessage(&msg);
+  }
+}
+
+uint32 TimerWheel::NextWakeTick() const {
+  // The next occupied level 0 slot, or the next cascade, whichever is first.
+  uint32 tick = current_tick_ + 1;
+  for (; tick % num_slots_ != 0; ++tick) {
+    const Timer* head = &slots_[tick % num_slots_];
+    if (head->next_ != head)
+      break;
+  }
+  return tick;
+}
+
+void TimerWheel::PostTick() {
+  if (tick_posted_ || size_ == 0)
+    return;
+  posted_tick_ = NextWakeTick();
+  int delay = (posted_tick_ - current_tick_) * tick_ms_ -
+      TimeSince(current_tick_time_);
+  thread_->PostDelayed(delay > 0 ? delay : 0, this, MSG_TICK);
+  tick_posted_ = true;
+}
+
+}  // namespace talk_base
@@ -0,0 +1,121 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_BASE_TIMERWHEEL_H_
+#define TALK_BASE_TIMERWHEEL_H_
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/messagehandler.h"
+#include "talk/base/scoped_ptr.h"
+
+namespace talk_base {
+
+class Thread;
+
+// Schedules large numbers of coarse-grained timers with O(1) insert and
+// cancel, for objects that would otherwise each keep a PostDelayed message
+// in the thread's queue. The wheel is hierarchical: level 0 has |num_slots|
+// slots of |tick_ms| each, and every further level has |num_slots| slots
+// that each span a whole revolution of the level below. Timers are filed
+// by how far away they are, and move down a level each time the level
+// below wraps around to their slot, so no timer is looked at more than
+// once per level. Timers fire up to one tick late, never early.
+//
+// The wheel keeps at most one message posted to its thread, timed for the
+// next slot that has timers or needs to be cascaded, so an idle wheel
+// costs nothing. Expiry is delivered by calling the handler's OnMessage
+// with the given id and no data, so existing MessageHandlers can switch
+// over from PostDelayed without changes. Everything must happen on the
+// wheel's thread.
+class TimerWheel : public MessageHandler {
+ public:
+  // A timer slot; embed one in each object that needs a timer.
+  class Timer {
+   public:
+    Timer();
+    ~Timer();  // Cancels the timer.
+
+    bool active() const { return wheel_ != NULL; }
+
+   private:
+    friend class TimerWheel;
+    void Unlink();
+
+    Timer* prev_;
+    Timer* next_;
+    TimerWheel* wheel_;
+    uint32 due_tick_;
+    MessageHandler* handler_;
+    uint32 id_;
+
+    DISALLOW_COPY_AND_ASSIGN(Timer);
+  };
+
+  TimerWheel(Thread* thread, int tick_ms, int num_slots);
+  virtual ~TimerWheel();
+
+  int tick_ms() const { return tick_ms_; }
+  // The number of pending timers.
+  size_t size() const { return size_; }
+
+  // Arms |timer| to call handler->OnMessage() with |id| after |delay_ms|.
+  // If |timer| is already active, it is rescheduled.
+  void Schedule(Timer* timer, int delay_ms, MessageHandler* handler,
+                uint32 id = 0);
+  // Disarms |timer|; does nothing if it is not active.
+  void Cancel(Timer* timer);
+
+ private:
+  virtual void OnMessage(Message* msg);
+  void Insert(Timer* timer);
+  void Advance();
+  void Cascade(int level, uint32 tick);
+  void RunSlot(Timer* head, uint32 tick);
+  uint32 NextWakeTick() const;
+  void PostTick();
+
+  Thread* thread_;
+  int tick_ms_;
+  int num_slots_;
+  int num_levels_;
+  // Sentinel list heads, |num_slots_| per level.
+  scoped_array<Timer> slots_;
+  // The tick up to which all slots have been run, and its time.
+  uint32 current_tick_;
+  uint32 current_tick_time_;
+  size_t size_;
+  // Whether a wakeup is posted, and for which tick.
+  bool tick_posted_;
+  uint32 posted_tick_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_TIMERWHEEL_H_
@@ -0,0 +1,192 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+
+#include "talk/base/gunit.h"
+#include "talk/base/thread.h"
+#include "talk/base/timerwheel.h"
+#include "talk/base/timeutils.h"
+
+namespace talk_base {
+
+static const int kTickMs = 10;
+static const int kNumSlots = 8;
+
+// Records when each of its timers fired.
+class TimerRecorder : public MessageHandler {
+ public:
+  explicit TimerRecorder(TimerWheel* wheel) : wheel_(wheel), start_(Time()) {}
+
+  void Schedule(TimerWheel::Timer* timer, int delay_ms, uint32 id) {
+    wheel_->Schedule(timer, delay_ms, this, id);
+  }
+  virtual void OnMessage(Message* msg) {
+    ids_.push_back(msg->message_id);
+    times_.push_back(TimeSince(start_));
+  }
+
+  const std::vector<uint32>& ids() const { return ids_; }
+  const std::vector<int>& times() const { return times_; }
+
+ private:
+  TimerWheel* wheel_;
+  uint32 start_;
+  std::vector<uint32> ids_;
+  std::vector<int> times_;
+};
+
+TEST(TimerWheelTest, FiresInOrderAndNotEarly) {
+  TimerWheel wheel(Thread::Current(), kTickMs, kNumSlots);
+  TimerRecorder recorder(&wheel);
+  TimerWheel::Timer t1, t2, t3;
+  recorder.Schedule(&t3, 50, 3);
+  recorder.Schedule(&t1, 0, 1);
+  recorder.Schedule(&t2, 25, 2);
+  EXPECT_EQ(3U, wheel.size());
+  EXPECT_TRUE(t1.active());
+
+  EXPECT_EQ_WAIT(3U, recorder.ids().size(), 1000);
+  EXPECT_EQ(0U, wheel.size());
+  EXPECT_FALSE(t1.active());
+  EXPECT_EQ(1U, recorder.ids()[0]);
+  EXPECT_EQ(2U, recorder.ids()[1]);
+  EXPECT_EQ(3U, recorder.ids()[2]);
+  EXPECT_GE(recorder.times()[1], 25);
+  EXPECT_GE(recorder.times()[2], 50);
+}
+
+TEST(TimerWheelTest, CancelAndReschedule) {
+  TimerWheel wheel(Thread::Current(), kTickMs, kNumSlots);
+  TimerRecorder recorder(&wheel);
+  TimerWheel::Timer t1, t2;
+  recorder.Schedule(&t1, 20, 1);
+  recorder.Schedule(&t2, 20, 2);
+  wheel.Cancel(&t1);
+  EXPECT_FALSE(t1.active());
+  EXPECT_EQ(1U, wheel.size());
+  // Rescheduling replaces the earlier deadline.
+  recorder.Schedule(&t2, 60, 2);
+  EXPECT_EQ(1U, wheel.size());
+
+  EXPECT_EQ_WAIT(1U, recorder.ids().size(), 1000);
+  EXPECT_EQ(2U, recorder.ids()[0]);
+  EXPECT_GE(recorder.times()[0], 60);
+  Thread::Current()->ProcessMessages(50);
+  EXPECT_EQ(1U, recorder.ids().size());
+}
+
+// A timer that is destroyed while pending must be removed from the wheel.
+TEST(TimerWheelTest, DestroyedTimerIsCancelled) {
+  TimerWheel wheel(Thread::Current(), kTickMs, kNumSlots);
+  TimerRecorder recorder(&wheel);
+  {
+    TimerWheel::Timer t1;
+    recorder.Schedule(&t1, 10, 1);
+    EXPECT_EQ(1U, wheel.size());
+  }
+  EXPECT_EQ(0U, wheel.size());
+  Thread::Current()->ProcessMessages(50);
+  EXPECT_TRUE(recorder.ids().empty());
+}
+
+// Delays longer than one revolution of the wheel must not fire early.
+TEST(TimerWheelTest, LongDelay) {
+  TimerWheel wheel(Thread::Current(), kTickMs, kNumSlots);
+  TimerRecorder recorder(&wheel);
+  TimerWheel::Timer t1, t2;
+  const int kLong = kTickMs * kNumSlots * 3 + 5;
+  recorder.Schedule(&t1, kLong, 1);
+  recorder.Schedule(&t2, kTickMs, 2);
+  EXPECT_EQ_WAIT(2U, recorder.ids().size(), 2000);
+  EXPECT_EQ(2U, recorder.ids()[0]);
+  EXPECT_EQ(1U, recorder.ids()[1]);
+  EXPECT_GE(recorder.times()[1], kLong);
+}
+
+// Timers spread over several levels of the wheel all fire, in order of
+// their deadlines and never early.
+TEST(TimerWheelTest, ManyLevels) {
+  TimerWheel wheel(Thread::Current(), kTickMs, kNumSlots);
+  TimerRecorder recorder(&wheel);
+  const int kNumTimers = 64;
+  // Level 1 starts at kNumSlots ticks, level 2 at kNumSlots^2.
+  const int kMaxDelay = kTickMs * kNumSlots * kNumSlots * 2;
+  TimerWheel::Timer timers[kNumTimers];
+  int delays[kNumTimers];
+  for (int i = 0; i < kNumTimers; ++i) {
+    delays[i] = (i * 7919) % kMaxDelay;
+    recorder.Schedule(&timers[i], delays[i], i);
+  }
+  EXPECT_EQ_WAIT(static_cast<size_t>(kNumTimers), recorder.ids().size(),
+                 kMaxDelay + 2000);
+  EXPECT_EQ(0U, wheel.size());
+  int last_delay = -1;
+  for (int i = 0; i < kNumTimers; ++i) {
+    int delay = delays[recorder.ids()[i]];
+    EXPECT_GE(recorder.times()[i], delay);
+    // Timers in the same tick may fire in either order.
+    EXPECT_GE(delay / kTickMs + 1, last_delay / kTickMs);
+    last_delay = delay;
+  }
+}
+
+// Handlers may reschedule their own timer and delete other pending timers.
+class SelfRescheduler : public MessageHandler {
+ public:
+  SelfRescheduler(TimerWheel* wheel, TimerWheel::Timer* victim)
+      : wheel_(wheel), victim_(victim), count_(0) {
+    wheel_->Schedule(&timer_, 0, this);
+  }
+  virtual void OnMessage(Message* msg) {
+    delete victim_;
+    victim_ = NULL;
+    if (++count_ < 3)
+      wheel_->Schedule(&timer_, 0, this);
+  }
+  int count() const { return count_; }
+
+ private:
+  TimerWheel* wheel_;
+  TimerWheel::Timer timer_;
+  TimerWheel::Timer* victim_;
+  int count_;
+};
+
+TEST(TimerWheelTest, ReentrantHandlers) {
+  TimerWheel wheel(Thread::Current(), kTickMs, kNumSlots);
+  TimerRecorder recorder(&wheel);
+  TimerWheel::Timer* victim = new TimerWheel::Timer;
+  SelfRescheduler rescheduler(&wheel, victim);
+  // Due on the same tick, but behind the rescheduler, which deletes it.
+  recorder.Schedule(victim, 0, 1);
+  EXPECT_EQ_WAIT(3, rescheduler.count(), 1000);
+  EXPECT_EQ(0U, wheel.size());
+  EXPECT_TRUE(recorder.ids().empty());
+}
+
+}  // namespace talk_base
@@ -620,6 +620,12 @@ int Win32Socket::TranslateOption(Option opt, int* slevel, int* sopt) {
       *slevel = IPPROTO_TCP;
       *sopt = TCP_NODELAY;
       break;
+    case OPT_RECV_BATCH:
+      // Implemented by AsyncUDPSocket, not the OS.
+      return -1;
+    case OPT_REUSEPORT:
+      // SO_REUSEADDR on Windows does not load-balance; don't pretend.
+      return -1;
     default:
       ASSERT(false);
       return -1;
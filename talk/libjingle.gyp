@@ -169,6 +169,7 @@
         'base/bandwidthsmoother.cc',
         'base/base64.cc',
         'base/basicpacketsocketfactory.cc',
+        'base/bufferpool.cc',
         'base/bytebuffer.cc',
         'base/checks.cc',
         'base/common.cc',
@@ -221,8 +222,11 @@
         'base/socketpool.cc',
         'base/socketstream.cc',
         'base/ssladapter.cc',
+        'base/sslhandshakepool.cc',
         'base/sslsocketfactory.cc',
         'base/sslidentity.cc',
+        'base/sslidentitypool.cc',
+        'base/sslsessioncache.cc',
         'base/sslstreamadapter.cc',
         'base/sslstreamadapterhelper.cc',
         'base/stream.cc',
@@ -234,6 +238,7 @@
         'base/taskrunner.cc',
         'base/testclient.cc',
         'base/thread.cc',
+        'base/timerwheel.cc',
         'base/timeutils.cc',
         'base/timing.cc',
         'base/transformadapter.cc',
@@ -302,6 +307,7 @@
         ['OS=="linux" or OS=="android"', {
           'sources': [
             'base/linux.cc',
+            'base/linuxnetworkmonitor.cc',
           ],
         }],
         ['OS=="linux"', {
@@ -577,6 +583,7 @@
         'p2p/base/portallocatorsessionproxy.cc',
         'p2p/base/portproxy.cc',
         'p2p/base/pseudotcp.cc',
+        'p2p/base/pseudotcpcongestion.cc',
         'p2p/base/relayport.cc',
         'p2p/base/relayserver.cc',
         'p2p/base/rawtransport.cc',
@@ -597,11 +604,13 @@
         'p2p/base/transportdescriptionfactory.h',
         'p2p/base/turnport.cc',
         'p2p/base/turnserver.cc',
+        'p2p/base/udpportmux.cc',
         'p2p/client/basicportallocator.cc',
         'p2p/client/connectivitychecker.cc',
         'p2p/client/httpportallocator.cc',
         'p2p/client/socketmonitor.cc',
         'session/tunnel/pseudotcpchannel.cc',
+        'session/tunnel/tunnelmux.cc',
         'session/tunnel/tunnelsessionclient.cc',
         'session/tunnel/securetunnelsessionclient.cc',
         'session/media/audiomonitor.cc',
@@ -614,6 +623,7 @@
         'session/media/mediarecorder.cc',
         'session/media/mediasession.cc',
         'session/media/mediasessionclient.cc',
+        'session/media/pacedsender.cc',
         'session/media/rtcpmuxfilter.cc',
         'session/media/rtcpmuxfilter.cc',
         'session/media/soundclip.cc',
@@ -72,12 +72,14 @@
       ],
       'sources': [
         'base/asynchttprequest_unittest.cc',
+        'base/asynctcpsocket_unittest.cc',
         'base/atomicops_unittest.cc',
         'base/autodetectproxy_unittest.cc',
         'base/bandwidthsmoother_unittest.cc',
         'base/base64_unittest.cc',
         'base/basictypes_unittest.cc',
         'base/buffer_unittest.cc',
+        'base/bufferpool_unittest.cc',
         'base/bytebuffer_unittest.cc',
         'base/byteorder_unittest.cc',
         'base/cpumonitor_unittest.cc',
@@ -85,6 +87,7 @@
         'base/event_unittest.cc',
         'base/filelock_unittest.cc',
         'base/fileutils_unittest.cc',
+        'base/flathashmap_unittest.cc',
         'base/helpers_unittest.cc',
         'base/host_unittest.cc',
         'base/httpbase_unittest.cc',
@@ -114,6 +117,8 @@
         'base/sigslot_unittest.cc',
         'base/socket_unittest.cc',
         'base/socketaddress_unittest.cc',
+        'base/sslhandshakepool_unittest.cc',
+        'base/sslsessioncache_unittest.cc',
         'base/stream_unittest.cc',
         'base/stringencode_unittest.cc',
         'base/stringutils_unittest.cc',
@@ -122,6 +127,7 @@
         'base/task_unittest.cc',
         'base/testclient_unittest.cc',
         'base/thread_unittest.cc',
+        'base/timerwheel_unittest.cc',
         'base/timeutils_unittest.cc',
         'base/urlencode_unittest.cc',
         'base/versionparsing_unittest.cc',
@@ -155,6 +161,7 @@
             # TODO(ronghuawu): Reenable this test.
             # 'base/linux_unittest.cc',
             'base/linuxfdwalk_unittest.cc',
+            'base/linuxnetworkmonitor_unittest.cc',
           ],
         }],
         ['OS=="win"', {
@@ -179,6 +186,7 @@
         ['os_posix==1', {
           'sources': [
             'base/sslidentity_unittest.cc',
+            'base/sslidentitypool_unittest.cc',
             'base/sslstreamadapter_unittest.cc',
           ],
         }],
@@ -270,6 +278,7 @@
         'p2p/base/port_unittest.cc',
         'p2p/base/portallocatorsessionproxy_unittest.cc',
         'p2p/base/pseudotcp_unittest.cc',
+        'p2p/base/pseudotcpcongestion_unittest.cc',
         'p2p/base/relayport_unittest.cc',
         'p2p/base/relayserver_unittest.cc',
         'p2p/base/session_unittest.cc',
@@ -279,6 +288,7 @@
         'p2p/base/stunserver_unittest.cc',
         'p2p/base/transport_unittest.cc',
         'p2p/base/transportdescriptionfactory_unittest.cc',
+        'p2p/base/udpportmux_unittest.cc',
         'p2p/client/connectivitychecker_unittest.cc',
         'p2p/client/portallocator_unittest.cc',
         'session/media/channel_unittest.cc',
@@ -288,9 +298,11 @@
         'session/media/mediamessages_unittest.cc',
         'session/media/mediasession_unittest.cc',
         'session/media/mediasessionclient_unittest.cc',
+        'session/media/pacedsender_unittest.cc',
         'session/media/rtcpmuxfilter_unittest.cc',
         'session/media/srtpfilter_unittest.cc',
         'session/media/ssrcmuxfilter_unittest.cc',
+        'session/tunnel/tunnelmux_unittest.cc',
       ],
       'conditions': [
         ['OS=="win"', {
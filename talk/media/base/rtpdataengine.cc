@@ -173,15 +173,13 @@ bool RtpDataMediaChannel::AddSendStream(const StreamParams& stream) {
     return false;
   }
 
-  StreamParams found_stream;
-  if (GetStreamBySsrc(send_streams_, stream.first_ssrc(), &found_stream)) {
+  if (!send_streams_.AddStream(stream)) {
     LOG(LS_WARNING) << "Not adding data send stream '" << stream.id
                     << "' with ssrc=" << stream.first_ssrc()
                     << " because stream already exists.";
     return false;
   }
 
-  send_streams_.push_back(stream);
   // TODO(pthatcher): This should be per-stream, not per-ssrc.
   // And we should probably allow more than one per stream.
   rtp_clock_by_send_ssrc_[stream.first_ssrc()] = new RtpClock(
@@ -194,12 +192,10 @@ bool RtpDataMediaChannel::AddSendStream(const StreamParams& stream) {
 }
 
 bool RtpDataMediaChannel::RemoveSendStream(uint32 ssrc) {
-  StreamParams found_stream;
-  if (!GetStreamBySsrc(send_streams_, ssrc, &found_stream)) {
+  if (!send_streams_.RemoveStreamBySsrc(ssrc)) {
     return false;
   }
 
-  RemoveStreamBySsrc(&send_streams_, ssrc);
   delete rtp_clock_by_send_ssrc_[ssrc];
   rtp_clock_by_send_ssrc_.erase(ssrc);
   return true;
@@ -210,22 +206,20 @@ bool RtpDataMediaChannel::AddRecvStream(const StreamParams& stream) {
     return false;
   }
 
-  StreamParams found_stream;
-  if (GetStreamBySsrc(recv_streams_, stream.first_ssrc(), &found_stream)) {
+  if (!recv_streams_.AddStream(stream)) {
     LOG(LS_WARNING) << "Not adding data recv stream '" << stream.id
                     << "' with ssrc=" << stream.first_ssrc()
                     << " because stream already exists.";
     return false;
   }
 
-  recv_streams_.push_back(stream);
   LOG(LS_INFO) << "Added data recv stream '" << stream.id
                << "' with ssrc=" << stream.first_ssrc();
   return true;
 }
 
 bool RtpDataMediaChannel::RemoveRecvStream(uint32 ssrc) {
-  RemoveStreamBySsrc(&recv_streams_, ssrc);
+  recv_streams_.RemoveStreamBySsrc(ssrc);
   return true;
 }
 
@@ -265,15 +259,15 @@ void RtpDataMediaChannel::OnPacketReceived(talk_base::Buffer* packet) {
     return;
   }
 
-  StreamParams found_stream;
-  if (!GetStreamBySsrc(recv_streams_, header.ssrc, &found_stream)) {
+  const StreamParams* found_stream = recv_streams_.GetStreamBySsrc(header.ssrc);
+  if (!found_stream) {
     LOG(LS_WARNING) << "Received packet for unknown ssrc: " << header.ssrc;
     return;
   }
 
   // Uncomment this for easy debugging.
   // LOG(LS_INFO) << "Received packet"
-  //              << " groupid=" << found_stream.groupid
+  //              << " groupid=" << found_stream->groupid
   //              << ", ssrc=" << header.ssrc
   //              << ", seqnum=" << header.seq_num
   //              << ", timestamp=" << header.timestamp
@@ -303,8 +297,7 @@ bool RtpDataMediaChannel::SendData(
     return false;
   }
 
-  StreamParams found_stream;
-  if (!GetStreamBySsrc(send_streams_, params.ssrc, &found_stream)) {
+  if (!send_streams_.HasSsrc(params.ssrc)) {
     LOG(LS_WARNING) << "Not sending data because ssrc is unknown: "
                     << params.ssrc;
     return false;
@@ -342,8 +335,8 @@ bool RtpDataMediaChannel::SendData(
   rtp_clock_by_send_ssrc_[header.ssrc]->Tick(
       now, &header.seq_num, &header.timestamp);
 
-  talk_base::Buffer packet;
-  packet.SetCapacity(packet_len);
+  talk_base::Buffer packet(NULL, 0, packet_len,
+                           talk_base::Buffer::ALLOC_POOLED);
   packet.SetLength(kMinRtpPacketLen);
   if (!SetRtpHeader(packet.data(), packet.length(), header)) {
     return false;
@@ -353,7 +346,7 @@ bool RtpDataMediaChannel::SendData(
 
   // Uncomment this for easy debugging.
   // LOG(LS_INFO) << "Sent packet: "
-  //              << " stream=" << found_stream.id
+  //              << " ssrc=" << header.ssrc
   //              << ", seqnum=" << header.seq_num
   //              << ", timestamp=" << header.timestamp
   //              << ", len=" << data_len;
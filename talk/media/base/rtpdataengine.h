@@ -130,8 +130,8 @@ class RtpDataMediaChannel : public DataMediaChannel {
   talk_base::Timing* timing_;
   std::vector<DataCodec> send_codecs_;
   std::vector<DataCodec> recv_codecs_;
-  std::vector<StreamParams> send_streams_;
-  std::vector<StreamParams> recv_streams_;
+  StreamParamsIndex send_streams_;
+  StreamParamsIndex recv_streams_;
   std::map<uint32, RtpClock*> rtp_clock_by_send_ssrc_;
   talk_base::scoped_ptr<talk_base::RateLimiter> send_limiter_;
 };
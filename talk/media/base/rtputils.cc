@@ -170,6 +170,68 @@ bool GetRtcpSsrc(const void* data, size_t len, uint32* value) {
   return true;
 }
 
+ParsedPacket::ParsedPacket()
+    : rtcp(false),
+      marker(false),
+      header_len(0),
+      extension_offset(0),
+      rtcp_type(0),
+      rtcp_ssrc(0),
+      num_rtcp_blocks(0) {
+  header.payload_type = 0;
+  header.seq_num = 0;
+  header.timestamp = 0;
+  header.ssrc = 0;
+}
+
+static bool ParseRtp(const uint8* data, size_t len, ParsedPacket* packet) {
+  if (len < kMinRtpPacketLen)
+    return false;
+  packet->marker = (data[kRtpPayloadTypeOffset] & 0x80) != 0;
+  packet->header.payload_type = data[kRtpPayloadTypeOffset] & 0x7F;
+  packet->header.seq_num = talk_base::GetBE16(data + kRtpSeqNumOffset);
+  packet->header.timestamp = talk_base::GetBE32(data + kRtpTimestampOffset);
+  packet->header.ssrc = talk_base::GetBE32(data + kRtpSsrcOffset);
+  if (!GetRtpHeaderLen(data, len, &packet->header_len))
+    return false;
+  if (data[kRtpFlagsOffset] & 0x10) {
+    packet->extension_offset =
+        kMinRtpPacketLen + (data[kRtpFlagsOffset] & 0xF) * sizeof(uint32);
+  }
+  return true;
+}
+
+static bool ParseRtcp(const uint8* data, size_t len, ParsedPacket* packet) {
+  if (len < kMinRtcpPacketLen)
+    return false;
+  packet->rtcp_type = data[kRtcpPayloadTypeOffset];
+  if (packet->rtcp_type != kRtcpTypeSDES && len >= kMinRtcpPacketLen + 4)
+    packet->rtcp_ssrc = talk_base::GetBE32(data + 4);
+  // Walk the blocks of a compound packet. Each one's length field counts
+  // 32-bit words, minus one.
+  size_t offset = 0;
+  while (offset + kMinRtcpPacketLen <= len) {
+    if (packet->num_rtcp_blocks < kMaxRtcpBlocks) {
+      packet->rtcp_block_offsets[packet->num_rtcp_blocks] = offset;
+      packet->rtcp_block_types[packet->num_rtcp_blocks] =
+          data[offset + kRtcpPayloadTypeOffset];
+      ++packet->num_rtcp_blocks;
+    }
+    offset += (talk_base::GetBE16(data + offset + 2) + 1) * sizeof(uint32);
+  }
+  return offset == len;
+}
+
+bool ParsePacket(const void* data, size_t len, bool rtcp,
+                 ParsedPacket* packet) {
+  *packet = ParsedPacket();
+  packet->rtcp = rtcp;
+  if (!data)
+    return false;
+  const uint8* bytes = static_cast<const uint8*>(data);
+  return rtcp ? ParseRtcp(bytes, len, packet) : ParseRtp(bytes, len, packet);
+}
+
 bool SetRtpHeaderFlags(
     void* data, size_t len,
     bool padding, bool extension, int csrc_count) {
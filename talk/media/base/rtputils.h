@@ -53,6 +53,40 @@ enum RtcpTypes {
   kRtcpTypePSFB = 206,    // Payload-specific Feedback message payload type.
 };
 
+// The most blocks of a compound RTCP packet that ParsePacket records.
+const int kMaxRtcpBlocks = 8;
+
+// The header fields of a received RTP or RTCP packet, parsed once so that the
+// demux filters and the rest of the receive path don't each re-read them.
+struct ParsedPacket {
+  ParsedPacket();
+
+  bool rtcp;
+  // RTP only.
+  RtpHeader header;
+  bool marker;
+  // Length of the fixed header, CSRCs and extension.
+  size_t header_len;
+  // Offset of the header extension, or 0 if there is none.
+  size_t extension_offset;
+  // RTCP only. The type and SSRC are those of the first block; the SSRC is
+  // 0 if that is an SDES block, which is not parsed. The offset and type of
+  // up to kMaxRtcpBlocks blocks of a compound packet are recorded.
+  int rtcp_type;
+  uint32 rtcp_ssrc;
+  int num_rtcp_blocks;
+  size_t rtcp_block_offsets[kMaxRtcpBlocks];
+  int rtcp_block_types[kMaxRtcpBlocks];
+};
+
+// Parses the header of an RTP (or, if |rtcp|, an RTCP) packet. Returns false
+// if the packet is too short for its fixed header, or if its CSRCs, extension
+// or compound blocks run past the end. The fixed header fields are filled in
+// whenever the packet is long enough for them, since that is all that SSRC
+// demuxing needs.
+bool ParsePacket(const void* data, size_t len, bool rtcp,
+                 ParsedPacket* packet);
+
 bool GetRtpPayloadType(const void* data, size_t len, int* value);
 bool GetRtpSeqNum(const void* data, size_t len, int* value);
 bool GetRtpTimestamp(const void* data, size_t len, uint32* value);
@@ -74,6 +74,13 @@ static const unsigned char kNonCompoundRtcpSDESPacket[] = {
     0x80, 0xCA, 0x00, 0x00
 };
 
+// RR (SSRC 0x1111) + SDES + BYE.
+static const unsigned char kCompoundRtcpPacket[] = {
+    0x80, 0xC9, 0x00, 0x01, 0x00, 0x00, 0x11, 0x11,
+    0x81, 0xCA, 0x00, 0x02, 0x00, 0x00, 0x11, 0x11, 0x01, 0x00, 0x00, 0x00,
+    0x81, 0xCB, 0x00, 0x01, 0x00, 0x00, 0x11, 0x11
+};
+
 TEST(RtpUtilsTest, GetRtp) {
   int pt;
   EXPECT_TRUE(GetRtpPayloadType(kPcmuFrame, sizeof(kPcmuFrame), &pt));
@@ -187,4 +194,65 @@ TEST(RtpUtilsTest, GetRtcp) {
                            &ssrc));
 }
 
+TEST(RtpUtilsTest, ParseRtpPacket) {
+  ParsedPacket packet;
+  EXPECT_TRUE(ParsePacket(kPcmuFrame, sizeof(kPcmuFrame), false, &packet));
+  EXPECT_FALSE(packet.rtcp);
+  EXPECT_FALSE(packet.marker);
+  EXPECT_EQ(0, packet.header.payload_type);
+  EXPECT_EQ(1, packet.header.seq_num);
+  EXPECT_EQ(0U, packet.header.timestamp);
+  EXPECT_EQ(1U, packet.header.ssrc);
+  EXPECT_EQ(12U, packet.header_len);
+  EXPECT_EQ(0U, packet.extension_offset);
+
+  EXPECT_TRUE(ParsePacket(kRtpPacketWithMarkerAndCsrcAndExtension,
+                          sizeof(kRtpPacketWithMarkerAndCsrcAndExtension),
+                          false, &packet));
+  EXPECT_TRUE(packet.marker);
+  EXPECT_EQ(sizeof(kRtpPacketWithMarkerAndCsrcAndExtension),
+            packet.header_len);
+  EXPECT_EQ(24U, packet.extension_offset);
+
+  // The fixed header is still filled in if the extension is truncated.
+  EXPECT_FALSE(ParsePacket(kInvalidPacketWithCsrcAndExtension2,
+                           sizeof(kInvalidPacketWithCsrcAndExtension2),
+                           false, &packet));
+  EXPECT_EQ(1U, packet.header.ssrc);
+  EXPECT_FALSE(ParsePacket(kInvalidPacket, sizeof(kInvalidPacket), false,
+                           &packet));
+  EXPECT_EQ(0U, packet.header.ssrc);
+}
+
+TEST(RtpUtilsTest, ParseRtcpPacket) {
+  ParsedPacket packet;
+  EXPECT_TRUE(ParsePacket(kCompoundRtcpPacket, sizeof(kCompoundRtcpPacket),
+                          true, &packet));
+  EXPECT_TRUE(packet.rtcp);
+  EXPECT_EQ(kRtcpTypeRR, packet.rtcp_type);
+  EXPECT_EQ(0x1111U, packet.rtcp_ssrc);
+  ASSERT_EQ(3, packet.num_rtcp_blocks);
+  EXPECT_EQ(0U, packet.rtcp_block_offsets[0]);
+  EXPECT_EQ(8U, packet.rtcp_block_offsets[1]);
+  EXPECT_EQ(kRtcpTypeSDES, packet.rtcp_block_types[1]);
+  EXPECT_EQ(20U, packet.rtcp_block_offsets[2]);
+  EXPECT_EQ(kRtcpTypeBye, packet.rtcp_block_types[2]);
+
+  // An SDES packet has no SSRC that we parse.
+  EXPECT_TRUE(ParsePacket(kNonCompoundRtcpSDESPacket,
+                          sizeof(kNonCompoundRtcpSDESPacket), true, &packet));
+  EXPECT_EQ(kRtcpTypeSDES, packet.rtcp_type);
+  EXPECT_EQ(0U, packet.rtcp_ssrc);
+
+  // A block running past the end fails, but the first header is kept.
+  EXPECT_FALSE(ParsePacket(kNonCompoundRtcpPliFeedbackPacket,
+                           sizeof(kNonCompoundRtcpPliFeedbackPacket), true,
+                           &packet));
+  EXPECT_EQ(kRtcpTypePSFB, packet.rtcp_type);
+  EXPECT_EQ(0x1111U, packet.rtcp_ssrc);
+  EXPECT_FALSE(ParsePacket(kInvalidPacket, sizeof(kInvalidPacket), true,
+                           &packet));
+  EXPECT_EQ(0, packet.num_rtcp_blocks);
+}
+
 }  // namespace cricket
@@ -179,4 +179,73 @@ bool RemoveStreamByIds(StreamParamsVec* streams,
   return RemoveStream(streams, StreamSelector(groupid, id));
 }
 
+// Returns every SSRC used by stream, primary and secondary, possibly with
+// duplicates.
+static void GetAllSsrcs(const StreamParams& stream,
+                        std::vector<uint32>* ssrcs) {
+  ssrcs->assign(stream.ssrcs.begin(), stream.ssrcs.end());
+  for (std::vector<SsrcGroup>::const_iterator group =
+           stream.ssrc_groups.begin();
+       group != stream.ssrc_groups.end(); ++group) {
+    ssrcs->insert(ssrcs->end(), group->ssrcs.begin(), group->ssrcs.end());
+  }
+}
+
+bool StreamParamsIndex::AddStream(const StreamParams& stream) {
+  std::vector<uint32> ssrcs;
+  GetAllSsrcs(stream, &ssrcs);
+  for (size_t i = 0; i < ssrcs.size(); ++i) {
+    if (HasSsrc(ssrcs[i])) {
+      return false;
+    }
+  }
+  streams_.push_back(stream);
+  IndexStream(streams_.size() - 1);
+  return true;
+}
+
+bool StreamParamsIndex::RemoveStreamBySsrc(uint32 ssrc) {
+  const size_t* found = ssrcs_.Find(ssrc);
+  if (!found) {
+    return false;
+  }
+  size_t index = *found;
+  std::vector<uint32> ssrcs;
+  GetAllSsrcs(streams_[index], &ssrcs);
+  for (size_t i = 0; i < ssrcs.size(); ++i) {
+    ssrcs_.Erase(ssrcs[i]);
+  }
+  // Fill the hole with the last stream so that removal stays O(1).
+  size_t last = streams_.size() - 1;
+  if (index != last) {
+    std::swap(streams_[index], streams_[last]);
+    IndexStream(index);
+  }
+  streams_.pop_back();
+  return true;
+}
+
+const StreamParams* StreamParamsIndex::GetStreamBySsrc(uint32 ssrc) const {
+  const size_t* found = ssrcs_.Find(ssrc);
+  return found ? &streams_[*found] : NULL;
+}
+
+void StreamParamsIndex::Clear() {
+  streams_.clear();
+  ssrcs_.Clear();
+}
+
+void StreamParamsIndex::IndexStream(size_t index) {
+  std::vector<uint32> ssrcs;
+  GetAllSsrcs(streams_[index], &ssrcs);
+  for (size_t i = 0; i < ssrcs.size(); ++i) {
+    size_t* existing = ssrcs_.Find(ssrcs[i]);
+    if (existing) {
+      *existing = index;
+    } else {
+      ssrcs_.Insert(ssrcs[i], index);
+    }
+  }
+}
+
 }  // namespace cricket
@@ -41,6 +41,8 @@
 #include <vector>
 
 #include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/flathashmap.h"
 
 namespace cricket {
 
@@ -204,6 +206,41 @@ bool RemoveStreamByIds(StreamParamsVec* streams,
                        const std::string& groupid,
                        const std::string& id);
 
+// Keeps a set of streams together with a hash index from every SSRC they
+// use, including the secondary SSRCs of their groups (FID, FEC, ...), to the
+// owning stream, so that per-packet lookups don't scan all streams. Each SSRC
+// may belong to at most one stream in the index.
+class StreamParamsIndex {
+ public:
+  StreamParamsIndex() {}
+
+  const StreamParamsVec& streams() const { return streams_; }
+  bool empty() const { return streams_.empty(); }
+  size_t size() const { return streams_.size(); }
+
+  // Adds the stream. Fails if any of its SSRCs is already in the index.
+  bool AddStream(const StreamParams& stream);
+  // Removes the stream owning ssrc. Returns true if one was found.
+  bool RemoveStreamBySsrc(uint32 ssrc);
+  // Returns the stream owning ssrc, or NULL. The pointer is valid until the
+  // next call to AddStream, RemoveStreamBySsrc or Clear.
+  const StreamParams* GetStreamBySsrc(uint32 ssrc) const;
+  bool HasSsrc(uint32 ssrc) const { return ssrcs_.Find(ssrc) != NULL; }
+  void Clear();
+
+ private:
+  typedef talk_base::FlatHashMap<uint32, size_t,
+                                 talk_base::HashInt<uint32> > SsrcMap;
+
+  // Points every SSRC of streams_[index] at index.
+  void IndexStream(size_t index);
+
+  StreamParamsVec streams_;
+  SsrcMap ssrcs_;
+
+  DISALLOW_COPY_AND_ASSIGN(StreamParamsIndex);
+};
+
 }  // namespace cricket
 
 #endif  // TALK_MEDIA_BASE_STREAMPARAMS_H_
@@ -163,3 +163,63 @@ TEST(StreamParams, ToString) {
   EXPECT_STREQ("{ssrcs:[1,2];ssrc_groups:{semantics:XYZ;ssrcs:[1,2]};}",
                sp.ToString().c_str());
 }
+
+TEST(StreamParamsIndex, AddAndFindStreams) {
+  cricket::StreamParamsIndex index;
+  EXPECT_TRUE(index.empty());
+  EXPECT_TRUE(index.AddStream(cricket::StreamParams::CreateLegacy(10)));
+  cricket::StreamParams stream;
+  stream.id = "video";
+  stream.add_ssrc(20);
+  EXPECT_TRUE(stream.AddFidSsrc(20, 21));
+  EXPECT_TRUE(index.AddStream(stream));
+  EXPECT_EQ(2u, index.size());
+
+  // Secondary SSRCs map to the same stream as their primary.
+  ASSERT_TRUE(index.GetStreamBySsrc(21) != NULL);
+  EXPECT_EQ("video", index.GetStreamBySsrc(21)->id);
+  EXPECT_EQ(index.GetStreamBySsrc(20), index.GetStreamBySsrc(21));
+  EXPECT_TRUE(index.HasSsrc(10));
+  EXPECT_FALSE(index.HasSsrc(11));
+  EXPECT_TRUE(index.GetStreamBySsrc(11) == NULL);
+
+  // A stream reusing any SSRC, even a secondary one, is rejected.
+  cricket::StreamParams dup;
+  dup.add_ssrc(30);
+  dup.add_ssrc(21);
+  EXPECT_FALSE(index.AddStream(dup));
+  EXPECT_FALSE(index.HasSsrc(30));
+  EXPECT_EQ(2u, index.size());
+}
+
+TEST(StreamParamsIndex, RemoveStreams) {
+  cricket::StreamParamsIndex index;
+  for (uint32 ssrc = 1; ssrc <= 5; ++ssrc) {
+    cricket::StreamParams stream;
+    stream.add_ssrc(ssrc);
+    stream.AddFidSsrc(ssrc, ssrc + 100);
+    EXPECT_TRUE(index.AddStream(stream));
+  }
+
+  // Removing by a secondary SSRC removes the whole stream.
+  EXPECT_TRUE(index.RemoveStreamBySsrc(102));
+  EXPECT_FALSE(index.HasSsrc(2));
+  EXPECT_FALSE(index.HasSsrc(102));
+  EXPECT_FALSE(index.RemoveStreamBySsrc(2));
+  EXPECT_EQ(4u, index.size());
+
+  // The streams that were moved around are still found.
+  EXPECT_TRUE(index.RemoveStreamBySsrc(1));
+  for (uint32 ssrc = 3; ssrc <= 5; ++ssrc) {
+    ASSERT_TRUE(index.GetStreamBySsrc(ssrc + 100) != NULL);
+    EXPECT_EQ(ssrc, index.GetStreamBySsrc(ssrc + 100)->first_ssrc());
+  }
+
+  // A removed SSRC can be added again.
+  EXPECT_TRUE(index.AddStream(cricket::StreamParams::CreateLegacy(102)));
+  EXPECT_TRUE(index.HasSsrc(102));
+
+  index.Clear();
+  EXPECT_TRUE(index.empty());
+  EXPECT_FALSE(index.HasSsrc(3));
+}
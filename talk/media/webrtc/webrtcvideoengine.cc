@@ -3228,7 +3228,8 @@ int WebRtcVideoMediaChannel::SendPacket(int channel, const void* data,
   if (!network_interface_) {
     return -1;
   }
-  talk_base::Buffer packet(data, len, kMaxRtpPacketLen);
+  talk_base::Buffer packet(data, len, kMaxRtpPacketLen,
+                           talk_base::Buffer::ALLOC_POOLED);
   return network_interface_->SendPacket(&packet) ? len : -1;
 }
 
@@ -3238,7 +3239,8 @@ int WebRtcVideoMediaChannel::SendRTCPPacket(int channel,
   if (!network_interface_) {
     return -1;
   }
-  talk_base::Buffer packet(data, len, kMaxRtpPacketLen);
+  talk_base::Buffer packet(data, len, kMaxRtpPacketLen,
+                           talk_base::Buffer::ALLOC_POOLED);
   return network_interface_->SendRtcp(&packet) ? len : -1;
 }
 
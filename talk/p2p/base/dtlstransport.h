@@ -32,6 +32,8 @@
 #include "talk/p2p/base/transport.h"
 
 namespace talk_base {
+class SSLHandshakePool;
+class SSLSessionCache;
 class SSLIdentity;
 }
 
@@ -49,13 +51,25 @@ class DtlsTransport : public Base {
                 PortAllocator* allocator,
                 talk_base::SSLIdentity* identity)
       : Base(signaling_thread, worker_thread, content_name, allocator),
-        identity_(identity) {
+        identity_(identity),
+        handshake_pool_(NULL),
+        session_cache_(NULL) {
   }
 
   ~DtlsTransport() {
     Base::DestroyAllChannels();
   }
 
+  // Offloads the DTLS handshakes of channels created from now on to |pool|.
+  void set_handshake_pool(talk_base::SSLHandshakePool* pool) {
+    handshake_pool_ = pool;
+  }
+
+  // Lets channels created from now on resume DTLS sessions from |cache|.
+  void set_session_cache(talk_base::SSLSessionCache* cache) {
+    session_cache_ = cache;
+  }
+
   virtual bool ApplyLocalTransportDescription_w(TransportChannelImpl*
                                                 channel) {
     talk_base::SSLFingerprint* local_fp =
@@ -111,8 +125,11 @@ class DtlsTransport : public Base {
   }
 
   virtual DtlsTransportChannelWrapper* CreateTransportChannel(int component) {
-    return new DtlsTransportChannelWrapper(
+    DtlsTransportChannelWrapper* channel = new DtlsTransportChannelWrapper(
         this, Base::CreateTransportChannel(component));
+    channel->SetHandshakePool(handshake_pool_);
+    channel->SetSessionCache(session_cache_);
+    return channel;
   }
 
   virtual void DestroyTransportChannel(TransportChannelImpl* channel) {
@@ -136,6 +153,8 @@ class DtlsTransport : public Base {
   }
 
   talk_base::SSLIdentity* identity_;
+  talk_base::SSLHandshakePool* handshake_pool_;
+  talk_base::SSLSessionCache* session_cache_;
   talk_base::scoped_ptr<talk_base::SSLFingerprint> remote_fingerprint_;
 };
 
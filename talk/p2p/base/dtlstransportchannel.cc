@@ -42,6 +42,13 @@ static const size_t kDtlsRecordHeaderLen = 13;
 static const size_t kMaxDtlsPacketLen = 2048;
 static const size_t kMinRtpPacketLen = 12;
 
+struct OutgoingPacketData : public talk_base::MessageData {
+  OutgoingPacketData(const void* data, size_t len)
+      : packet(data, len, len, talk_base::Buffer::ALLOC_POOLED) {
+  }
+  talk_base::Buffer packet;
+};
+
 static bool IsDtlsPacket(const char* data, size_t len) {
   const uint8* u = reinterpret_cast<const uint8*>(data);
   return (len >= kDtlsRecordHeaderLen && (u[0] > 19 && u[0] < 64));
@@ -69,7 +76,12 @@ talk_base::StreamResult StreamInterfaceChannel::Write(const void* data,
                                                       int* error) {
   // Always succeeds, since this is an unreliable transport anyway.
   // TODO: Should this block if channel_'s temporarily unwritable?
-  channel_->SendPacket(static_cast<const char*>(data), data_len);
+  if (owner_->IsCurrent()) {
+    channel_->SendPacket(static_cast<const char*>(data), data_len);
+  } else {
+    owner_->Post(this, MSG_SEND_PACKET,
+                 new OutgoingPacketData(data, data_len));
+  }
   if (written) {
     *written = data_len;
   }
@@ -92,6 +104,16 @@ void StreamInterfaceChannel::OnEvent(talk_base::StreamInterface* stream,
   SignalEvent(this, sig, err);
 }
 
+void StreamInterfaceChannel::OnMessage(talk_base::Message* msg) {
+  if (msg->message_id == MSG_SEND_PACKET) {
+    OutgoingPacketData* data = static_cast<OutgoingPacketData*>(msg->pdata);
+    channel_->SendPacket(data->packet.data(), data->packet.length());
+    delete data;
+  } else {
+    StreamInterface::OnMessage(msg);
+  }
+}
+
 DtlsTransportChannelWrapper::DtlsTransportChannelWrapper(
                                            Transport* transport,
                                            TransportChannelImpl* channel)
@@ -102,7 +124,9 @@ DtlsTransportChannelWrapper::DtlsTransportChannelWrapper(
       downward_(NULL),
       dtls_state_(STATE_NONE),
       local_identity_(NULL),
-      dtls_role_(talk_base::SSL_CLIENT) {
+      dtls_role_(talk_base::SSL_CLIENT),
+      handshake_pool_(NULL),
+      session_cache_(NULL) {
   channel_->SignalReadableState.connect(this,
       &DtlsTransportChannelWrapper::OnReadableState);
   channel_->SignalWritableState.connect(this,
@@ -165,6 +189,18 @@ bool DtlsTransportChannelWrapper::SetLocalIdentity(talk_base::SSLIdentity*
   return true;
 }
 
+void DtlsTransportChannelWrapper::SetHandshakePool(
+    talk_base::SSLHandshakePool* pool) {
+  ASSERT(dtls_state_ < STATE_ACCEPTED);
+  handshake_pool_ = pool;
+}
+
+void DtlsTransportChannelWrapper::SetSessionCache(
+    talk_base::SSLSessionCache* cache) {
+  ASSERT(dtls_state_ < STATE_ACCEPTED);
+  session_cache_ = cache;
+}
+
 void DtlsTransportChannelWrapper::SetRole(TransportRole role) {
   // TODO(ekr@rtfm.com): Forbid this if Connect() has been called.
   ASSERT(dtls_state_ < STATE_ACCEPTED);
@@ -227,6 +263,13 @@ bool DtlsTransportChannelWrapper::SetupDtls() {
   dtls_->SetMode(talk_base::SSL_MODE_DTLS);
   dtls_->SetServerRole(dtls_role_);
   dtls_->SignalEvent.connect(this, &DtlsTransportChannelWrapper::OnDtlsEvent);
+  if (handshake_pool_ && !dtls_->SetHandshakePool(handshake_pool_)) {
+    LOG_J(LS_WARNING, this) << "DTLS handshake pool not supported; "
+                            << "handshaking on the worker thread";
+  }
+  if (session_cache_ && !dtls_->SetSessionCache(session_cache_)) {
+    LOG_J(LS_WARNING, this) << "DTLS session resumption not supported";
+  }
   if (!dtls_->SetPeerCertificateDigest(
           remote_fingerprint_algorithm_,
           reinterpret_cast<unsigned char *>(remote_fingerprint_value_.data()),
@@ -38,15 +38,24 @@
 #include "talk/base/stream.h"
 #include "talk/p2p/base/transportchannelimpl.h"
 
+namespace talk_base {
+class SSLHandshakePool;
+class SSLSessionCache;
+}
+
 namespace cricket {
 
 // A bridge between a packet-oriented/channel-type interface on
 // the bottom and a StreamInterface on the top.
+// Read() and Write() may be called from other threads, which happens when
+// the DTLS handshake runs on a handshake pool; packets written there are
+// sent from |owner|.
 class StreamInterfaceChannel : public talk_base::StreamInterface,
                                public sigslot::has_slots<> {
  public:
   StreamInterfaceChannel(talk_base::Thread* owner, TransportChannel* channel)
-      : channel_(channel),
+      : owner_(owner),
+        channel_(channel),
         state_(talk_base::SS_OPEN),
         fifo_(kFifoSize, owner) {
     fifo_.SignalEvent.connect(this, &StreamInterfaceChannel::OnEvent);
@@ -66,9 +75,13 @@ class StreamInterfaceChannel : public talk_base::StreamInterface,
  private:
   static const size_t kFifoSize = 8192;
 
+  enum { MSG_SEND_PACKET = MSG_MAX + 1 };
+
   // Forward events
   virtual void OnEvent(talk_base::StreamInterface* stream, int sig, int err);
+  virtual void OnMessage(talk_base::Message* msg);
 
+  talk_base::Thread* owner_;
   TransportChannel* channel_;  // owned by DtlsTransportChannelWrapper
   talk_base::StreamState state_;
   talk_base::FifoBuffer fifo_;
@@ -131,6 +144,14 @@ class DtlsTransportChannelWrapper : public TransportChannelImpl {
   virtual bool SetRemoteFingerprint(const std::string& digest_alg,
                                     const uint8* digest,
                                     size_t digest_len);
+
+  // Runs the DTLS handshake on |pool| rather than on the worker thread. Must
+  // be called before the remote fingerprint is set; |pool| must outlive us.
+  void SetHandshakePool(talk_base::SSLHandshakePool* pool);
+  // Keeps the DTLS session in |cache|, and resumes it when reconnecting to
+  // the same remote fingerprint. Must be called before the remote
+  // fingerprint is set; |cache| must outlive us.
+  void SetSessionCache(talk_base::SSLSessionCache* cache);
   virtual bool IsDtlsActive() const { return dtls_state_ != STATE_NONE; }
 
   // Called to send a packet (via DTLS, if turned on).
@@ -239,6 +260,8 @@ class DtlsTransportChannelWrapper : public TransportChannelImpl {
   talk_base::SSLRole dtls_role_;
   talk_base::Buffer remote_fingerprint_value_;
   std::string remote_fingerprint_algorithm_;
+  talk_base::SSLHandshakePool* handshake_pool_;
+  talk_base::SSLSessionCache* session_cache_;
 
   DISALLOW_COPY_AND_ASSIGN(DtlsTransportChannelWrapper);
 };
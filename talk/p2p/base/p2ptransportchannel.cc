@@ -27,7 +27,9 @@
 
 #include "talk/p2p/base/p2ptransportchannel.h"
 
-#include <set>
+#include <algorithm>
+#include <iterator>
+#include <map>
 #include "talk/base/common.h"
 #include "talk/base/crc32.h"
 #include "talk/base/logging.h"
@@ -93,40 +95,6 @@ int CompareConnections(cricket::Connection *a, cricket::Connection *b) {
   return CompareConnectionCandidates(a, b);
 }
 
-// Wraps the comparison connection into a less than operator that puts higher
-// priority writable connections first.
-class ConnectionCompare {
- public:
-  bool operator()(const cricket::Connection *ca,
-                  const cricket::Connection *cb) {
-    cricket::Connection* a = const_cast<cricket::Connection*>(ca);
-    cricket::Connection* b = const_cast<cricket::Connection*>(cb);
-
-    ASSERT(a->port()->IceProtocol() == b->port()->IceProtocol());
-
-    // Compare first on writability and static preferences.
-    int cmp = CompareConnections(a, b);
-    if (cmp > 0)
-      return true;
-    if (cmp < 0)
-      return false;
-
-    // Otherwise, sort based on latency estimate.
-    return a->rtt() < b->rtt();
-
-    // Should we bother checking for the last connection that last received
-    // data? It would help rendezvous on the connection that is also receiving
-    // packets.
-    //
-    // TODO: Yes we should definitely do this.  The TCP protocol gains
-    // efficiency by being used bidirectionally, as opposed to two separate
-    // unidirectional streams.  This test should probably occur before
-    // comparison of local prefs (assuming combined prefs are the same).  We
-    // need to be careful though, not to bounce back and forth with both sides
-    // trying to rendevous with the other.
-  }
-};
-
 // Determines whether we should switch between two connections, based first on
 // static preferences and then (if those are equal) on latency estimates.
 bool ShouldSwitch(cricket::Connection* a_conn, cricket::Connection* b_conn) {
@@ -299,6 +267,7 @@ void P2PTransportChannel::Reset() {
   allocator_sessions_.clear();
   ports_.clear();
   connections_.clear();
+  ranks_.clear();
   best_connection_ = NULL;
 
   // Forget about all of the candidates we got before.
@@ -766,6 +735,50 @@ bool P2PTransportChannel::GetStats(ConnectionInfos *infos) {
   return true;
 }
 
+// Records the fields that connections are ranked by.
+void P2PTransportChannel::GetRank(Connection* conn, RankedConnection* rank) {
+  rank->connection = conn;
+  rank->write_state = conn->write_state();
+  rank->priority = conn->priority();
+  rank->generation =
+      conn->remote_candidate().generation() + conn->port()->generation();
+  rank->rtt = conn->rtt();
+}
+
+bool P2PTransportChannel::SameRank(const RankedConnection& a,
+                                   const RankedConnection& b) {
+  return a.connection == b.connection &&
+         a.write_state == b.write_state &&
+         a.priority == b.priority &&
+         a.generation == b.generation &&
+         a.rtt == b.rtt;
+}
+
+// Orders connections the same way as CompareConnections followed by the
+// latency estimate: better write states first, then higher priority, then a
+// younger generation, then lower RTT.
+bool P2PTransportChannel::RanksAhead(const RankedConnection& a,
+                                     const RankedConnection& b) {
+  if (a.write_state != b.write_state)
+    return a.write_state < b.write_state;
+  if (a.priority != b.priority)
+    return a.priority > b.priority;
+  if (a.generation != b.generation)
+    return static_cast<int>(a.generation - b.generation) > 0;
+  return a.rtt < b.rtt;
+
+  // Should we bother checking for the last connection that last received
+  // data? It would help rendezvous on the connection that is also receiving
+  // packets.
+  //
+  // TODO: Yes we should definitely do this.  The TCP protocol gains
+  // efficiency by being used bidirectionally, as opposed to two separate
+  // unidirectional streams.  This test should probably occur before
+  // comparison of local prefs (assuming combined prefs are the same).  We
+  // need to be careful though, not to bounce back and forth with both sides
+  // trying to rendevous with the other.
+}
+
 // Begin allocate (or immediately re-allocate, if MSG_ALLOCATE pending)
 void P2PTransportChannel::Allocate() {
   // Time for a new allocator, lets make sure we have a signalling channel
@@ -805,21 +818,38 @@ void P2PTransportChannel::SortConnections() {
   // Any changes after this point will require a re-sort.
   sort_dirty_ = false;
 
-  // Get a list of the networks that we are using.
-  std::set<talk_base::Network*> networks;
-  for (uint32 i = 0; i < connections_.size(); ++i)
-    networks.insert(connections_[i]->port()->Network());
-
-  // Find the best alternative connection by sorting.  It is important to note
-  // that amongst equal preference, writable connections, this will choose the
-  // one whose estimated latency is lowest.  So it is the only one that we
-  // need to consider switching to.
-
-  ConnectionCompare cmp;
-  std::stable_sort(connections_.begin(), connections_.end(), cmp);
-  LOG(LS_VERBOSE) << "Sorting available connections:";
+  // Re-rank the connections. Those whose ranking fields are unchanged since
+  // the last sort are still in order relative to each other, so only the
+  // changed and newly created ones need sorting before being merged back in.
+  // Amongst equal preference, writable connections, this puts the one whose
+  // estimated latency is lowest first, so it is the only one that we need to
+  // consider switching to.
+  std::vector<RankedConnection> unchanged;
+  std::vector<RankedConnection> changed;
+  unchanged.reserve(connections_.size());
   for (uint32 i = 0; i < connections_.size(); ++i) {
-    LOG(LS_VERBOSE) << connections_[i]->ToString();
+    RankedConnection rank;
+    GetRank(connections_[i], &rank);
+    if (i < ranks_.size() && SameRank(ranks_[i], rank)) {
+      unchanged.push_back(rank);
+    } else {
+      changed.push_back(rank);
+    }
+  }
+  if (!changed.empty()) {
+    std::stable_sort(changed.begin(), changed.end(), &RanksAhead);
+    ranks_.clear();
+    ranks_.reserve(connections_.size());
+    std::merge(unchanged.begin(), unchanged.end(),
+               changed.begin(), changed.end(),
+               std::back_inserter(ranks_), &RanksAhead);
+    for (uint32 i = 0; i < ranks_.size(); ++i)
+      connections_[i] = ranks_[i].connection;
+    LOG(LS_VERBOSE) << "Sorting available connections ("
+                    << changed.size() << " re-ranked):";
+    for (uint32 i = 0; i < connections_.size(); ++i) {
+      LOG(LS_VERBOSE) << connections_[i]->ToString();
+    }
   }
 
   Connection* top_connection = NULL;
@@ -836,18 +866,21 @@ void P2PTransportChannel::SortConnections() {
   // we would prune out the current best connection).  We leave connections on
   // other networks because they may not be using the same resources and they
   // may represent very distinct paths over which we can switch.
-  std::set<talk_base::Network*>::iterator network;
-  for (network = networks.begin(); network != networks.end(); ++network) {
-    Connection* primier = GetBestConnectionOnNetwork(*network);
-    if (!primier || (primier->write_state() != Connection::STATE_WRITABLE))
-      continue;
+  // Since the list is sorted, the best connection on each network is the
+  // first one seen on it, unless it is the current best connection.
+  std::map<talk_base::Network*, Connection*> primiers;
+  for (uint32 i = 0; i < connections_.size(); ++i)
+    primiers.insert(std::make_pair(connections_[i]->port()->Network(),
+                                   connections_[i]));
+  if (best_connection_)
+    primiers[best_connection_->port()->Network()] = best_connection_;
 
-    for (uint32 i = 0; i < connections_.size(); ++i) {
-      if ((connections_[i] != primier) &&
-          (connections_[i]->port()->Network() == *network) &&
-          (CompareConnectionCandidates(primier, connections_[i]) >= 0)) {
-        connections_[i]->Prune();
-      }
+  for (uint32 i = 0; i < connections_.size(); ++i) {
+    Connection* primier = primiers[connections_[i]->port()->Network()];
+    if ((primier->write_state() == Connection::STATE_WRITABLE) &&
+        (connections_[i] != primier) &&
+        (CompareConnectionCandidates(primier, connections_[i]) >= 0)) {
+      connections_[i]->Prune();
     }
   }
 
@@ -967,23 +1000,6 @@ void P2PTransportChannel::HandleAllTimedOut() {
   HandleNotWritable();
 }
 
-// If we have a best connection, return it, otherwise return top one in the
-// list (later we will mark it best).
-Connection* P2PTransportChannel::GetBestConnectionOnNetwork(
-    talk_base::Network* network) {
-  // If the best connection is on this network, then it wins.
-  if (best_connection_ && (best_connection_->port()->Network() == network))
-    return best_connection_;
-
-  // Otherwise, we return the top-most in sorted order.
-  for (uint32 i = 0; i < connections_.size(); ++i) {
-    if (connections_[i]->port()->Network() == network)
-      return connections_[i];
-  }
-
-  return NULL;
-}
-
 // Handle any queued up requests
 void P2PTransportChannel::OnMessage(talk_base::Message *pmsg) {
   switch (pmsg->message_id) {
@@ -1100,6 +1116,9 @@ void P2PTransportChannel::OnConnectionDestroyed(Connection *connection) {
   std::vector<Connection*>::iterator iter =
       std::find(connections_.begin(), connections_.end(), connection);
   ASSERT(iter != connections_.end());
+  size_t index = iter - connections_.begin();
+  if (index < ranks_.size())
+    ranks_.erase(ranks_.begin() + index);
   connections_.erase(iter);
 
   LOG_J(LS_INFO, this) << "Removed connection ("
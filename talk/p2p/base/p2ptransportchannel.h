@@ -112,6 +112,19 @@ class P2PTransportChannel : public TransportChannelImpl,
     return allocator_sessions_.back();
   }
 
+  // A connection together with the fields it was ranked by in the last sort.
+  struct RankedConnection {
+    Connection* connection;
+    int write_state;
+    uint64 priority;
+    uint32 generation;
+    int rtt;
+  };
+  static void GetRank(Connection* conn, RankedConnection* rank);
+  static bool SameRank(const RankedConnection& a, const RankedConnection& b);
+  static bool RanksAhead(const RankedConnection& a,
+                         const RankedConnection& b);
+
   void Allocate();
   void UpdateConnectionStates();
   void RequestSort();
@@ -121,7 +134,6 @@ class P2PTransportChannel : public TransportChannelImpl,
   void HandleWritable();
   void HandleNotWritable();
   void HandleAllTimedOut();
-  Connection* GetBestConnectionOnNetwork(talk_base::Network* network);
   bool CreateConnections(const Candidate &remote_candidate,
                          PortInterface* origin_port, bool readable);
   bool CreateConnection(PortInterface* port, const Candidate& remote_candidate,
@@ -168,6 +180,9 @@ class P2PTransportChannel : public TransportChannelImpl,
   std::vector<PortAllocatorSession*> allocator_sessions_;
   std::vector<PortInterface *> ports_;
   std::vector<Connection *> connections_;
+  // Ranks as of the last sort, in the same order as |connections_|.
+  // Connections created since then are past the end.
+  std::vector<RankedConnection> ranks_;
   Connection *best_connection_;
   std::vector<RemoteCandidate> remote_candidates_;
   bool sort_dirty_;  // indicates whether another sort is needed right now
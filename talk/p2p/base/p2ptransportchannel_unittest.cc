@@ -36,6 +36,7 @@
 #include "talk/base/proxyserver.h"
 #include "talk/base/socketaddress.h"
 #include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
 #include "talk/base/virtualsocketserver.h"
 #include "talk/p2p/base/p2ptransportchannel.h"
 #include "talk/p2p/base/testrelayserver.h"
@@ -1032,6 +1033,39 @@ TEST_F(P2PTransportChannelTest, GetStats) {
   DestroyChannels();
 }
 
+// Test that the best connection holds while many lower priority candidates
+// arrive, and log how the cost of each re-sort scales with the number of
+// connections.
+TEST_F(P2PTransportChannelTest, SortManyConnections) {
+  ConfigureEndpoints(OPEN, OPEN,
+                     kOnlyLocalPorts, kOnlyLocalPorts,
+                     cricket::ICEPROTO_GOOGLE);
+  CreateChannels(1);
+  EXPECT_TRUE_WAIT_MARGIN(ep1_ch1()->readable() && ep1_ch1()->writable() &&
+                          ep2_ch1()->readable() && ep2_ch1()->writable(),
+                          1000, 1000);
+  const cricket::Connection* best_connection = ep1_ch1()->best_connection();
+  ASSERT_TRUE(best_connection != NULL);
+
+  cricket::Candidate candidate = best_connection->remote_candidate();
+  candidate.set_priority(candidate.priority() / 2);
+  int count = 0;
+  for (int total = 10; total <= 1000; total *= 10) {
+    uint32 start = talk_base::Time();
+    for (; count < total; ++count) {
+      candidate.set_address(SocketAddress("33.33.33.33", 1000 + count));
+      ep1_ch1()->OnCandidate(candidate);
+    }
+    LOG(LS_INFO) << "Added candidates up to " << total << " connections in "
+                 << talk_base::TimeSince(start) << " ms";
+    EXPECT_EQ(best_connection, ep1_ch1()->best_connection());
+  }
+  cricket::ConnectionInfos infos;
+  ASSERT_TRUE(ep1_ch1()->GetStats(&infos));
+  EXPECT_EQ(1001U, infos.size());
+  DestroyChannels();
+}
+
 // Test that we properly handle getting a STUN error due to slow signaling.
 TEST_F(P2PTransportChannelTest, SlowSignaling) {
   ConfigureEndpoints(OPEN, NAT_SYMMETRIC,
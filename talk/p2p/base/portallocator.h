@@ -55,6 +55,15 @@ const uint32 PORTALLOCATOR_ENABLE_SHARED_UFRAG = 0x80;
 const uint32 PORTALLOCATOR_ENABLE_SHARED_SOCKET = 0x100;
 const uint32 PORTALLOCATOR_ENABLE_STUN_RETRANSMIT_ATTRIBUTE = 0x200;
 const uint32 PORTALLOCATOR_USE_LARGE_SOCKET_SEND_BUFFERS = 0x400;
+// With PORTALLOCATOR_ENABLE_SHARED_SOCKET, shares the UDP socket of each
+// network among all of the allocator's sessions rather than just the ports
+// of one session.
+const uint32 PORTALLOCATOR_ENABLE_SHARED_SOCKET_ACROSS_SESSIONS = 0x800;
+// Runs the allocation phases of each network (UDP, relay, TCP, SSLTCP) one
+// right after another instead of a step delay apart, so that relay
+// candidates aren't held up behind the UDP ones. BasicPortAllocator spaces
+// the phases by its phase pacing delay.
+const uint32 PORTALLOCATOR_ENABLE_PARALLEL_PHASES = 0x1000;
 
 enum {
   PORTALLOCATOR_FILTER_ALLOW_NONE = 0,
@@ -113,6 +113,11 @@ const uint32 DEFAULT_SND_BUF_SIZE = 90 * 1024;
 // 24 |                             data                              |
 //    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 //
+// A segment with FLAG_SACK set carries no data. Instead, its data is a list
+// of up to four selective acknowledgement blocks, each being the sequence
+// number of the first byte in a received range and that of the byte after
+// it, as 32-bit values.
+//
 //////////////////////////////////////////////////////////////////////
 
 #define PSEUDO_KEEPALIVE 0
@@ -128,6 +133,7 @@ const uint32 DEF_ACK_DELAY = 100; // 100 milliseconds
 
 const uint8 FLAG_CTL = 0x02;
 const uint8 FLAG_RST = 0x04;
+const uint8 FLAG_SACK = 0x08;
 
 const uint8 CTL_CONNECT = 0;
 //const uint8 CTL_REDIRECT = 1;
@@ -138,6 +144,7 @@ const uint8 TCP_OPT_EOL = 0;  // End of list.
 const uint8 TCP_OPT_NOOP = 1;  // No-op.
 const uint8 TCP_OPT_MSS = 2;  // Maximum segment size.
 const uint8 TCP_OPT_WND_SCALE = 3;  // Window scale factor.
+const uint8 TCP_OPT_SACK_PERMITTED = 4;  // Selective acknowledgements.
 
 /*
 const uint8 FLAG_FIN = 0x01;
@@ -147,6 +154,11 @@ const uint8 FLAG_ACK = 0x10;
 
 const uint32 CTRL_BOUND = 0x80000000;
 
+const uint32 SACK_BLOCK_SIZE = 8;
+// Number of segments selectively acknowledged above a segment that make it
+// count as lost (RFC 6675, DupThresh).
+const uint32 DUP_THRESH = 3;
+
 const long DEFAULT_TIMEOUT = 4000; // If there are no pending clocks, wake up every 4 seconds
 const long CLOSED_TIMEOUT = 60 * 1000; // If the connection is closed, once per minute
 
@@ -276,6 +288,19 @@ PseudoTcp::PseudoTcp(IPseudoTcpNotify* notify, uint32 conv)
   m_rx_rto = DEF_RTO;
   m_rx_srtt = m_rx_rttvar = 0;
 
+  m_congestion_type = CC_RENO;
+  m_congestion.reset(PseudoTcpCongestionControl::Create(m_congestion_type));
+
+  m_support_sack = true;
+  m_use_sack = false;
+  m_sacked = 0;
+  m_rto_high = 0;
+
+  m_max_buffer = 0;
+  m_rcv_space_seq = 0;
+  m_rcv_space_time = now;
+  m_rcv_rtt = 0;
+
   m_use_nagling = true;
   m_ack_delay = DEF_ACK_DELAY;
   m_support_wnd_scale = true;
@@ -330,10 +355,24 @@ void PseudoTcp::NotifyClock(uint32 now) {
       }
 
       uint32 nInFlight = m_snd_nxt - m_snd_una;
-      m_ssthresh = talk_base::_max(nInFlight / 2, 2 * m_mss);
+      m_ssthresh = m_congestion->OnLoss(now, m_cwnd, nInFlight, m_mss);
       //LOG(LS_INFO) << "m_ssthresh: " << m_ssthresh << "  nInFlight: " << nInFlight << "  m_mss: " << m_mss;
       m_cwnd = m_mss;
 
+      if (m_use_sack) {
+        // Take everything outstanding to be lost, and have the ACKs that
+        // follow resend whatever the peer doesn't selectively acknowledge,
+        // rather than waiting out a timeout for each segment in turn.
+        for (SList::iterator it = m_slist.begin(); it != m_slist.end();
+             ++it) {
+          it->bResent = false;
+        }
+        m_slist.front().bResent = true;
+        m_rto_high = m_snd_nxt;
+        m_recover = m_snd_nxt;
+        m_dup_acks = 3;
+      }
+
       // Back off retransmit timer.  Note: the limit is lower when connecting.
       uint32 rto_limit = (m_state < TCP_ESTABLISHED) ? DEF_RTO : MAX_RTO;
       m_rx_rto = talk_base::_min(rto_limit, m_rx_rto * 2);
@@ -397,6 +436,12 @@ void PseudoTcp::GetOption(Option opt, int* value) {
     *value = m_sbuf_len;
   } else if (opt == OPT_RCVBUF) {
     *value = m_rbuf_len;
+  } else if (opt == OPT_SACK) {
+    *value = m_support_sack ? 1 : 0;
+  } else if (opt == OPT_CONGESTION_CONTROL) {
+    *value = m_congestion_type;
+  } else if (opt == OPT_MAX_BUFFER) {
+    *value = m_max_buffer;
   } else {
     ASSERT(false);
   }
@@ -412,6 +457,22 @@ void PseudoTcp::SetOption(Option opt, int value) {
   } else if (opt == OPT_RCVBUF) {
     ASSERT(m_state == TCP_LISTEN);
     resizeReceiveBuffer(value);
+  } else if (opt == OPT_SACK) {
+    ASSERT(m_state == TCP_LISTEN);
+    m_support_sack = value != 0;
+  } else if (opt == OPT_CONGESTION_CONTROL) {
+    PseudoTcpCongestionControl* congestion = PseudoTcpCongestionControl::Create(
+        static_cast<CongestionControlType>(value));
+    ASSERT(congestion != NULL);
+    if (congestion) {
+      m_congestion_type = static_cast<CongestionControlType>(value);
+      m_congestion.reset(congestion);
+    }
+  } else if (opt == OPT_MAX_BUFFER) {
+    ASSERT(m_state == TCP_LISTEN);
+    m_max_buffer = value;
+    // Pick a window scale factor that will fit the largest buffer.
+    resizeReceiveBuffer(m_rbuf_len);
   } else {
     ASSERT(false);
   }
@@ -456,20 +517,29 @@ int PseudoTcp::Recv(char* buffer, size_t len) {
   }
   ASSERT(result == talk_base::SR_SUCCESS);
 
-  size_t available_space = 0;
-  m_rbuf.GetWriteRemaining(&available_space);
+  updateReceiveWindow();
+  return read;
+}
 
-  if (uint32(available_space) - m_rcv_wnd >=
-      talk_base::_min<uint32>(m_rbuf_len / 2, m_mss)) {
-    bool bWasClosed = (m_rcv_wnd == 0); // !?! Not sure about this was closed business
-    m_rcv_wnd = available_space;
+const char* PseudoTcp::GetReadData(size_t* len) {
+  if (m_state != TCP_ESTABLISHED) {
+    m_error = ENOTCONN;
+    return NULL;
+  }
 
-    if (bWasClosed) {
-      attemptSend(sfImmediateAck);
-    }
+  const char* data = static_cast<const char*>(m_rbuf.GetReadData(len));
+  if (*len == 0) {
+    m_bReadEnable = true;
+    m_error = EWOULDBLOCK;
+    return NULL;
   }
+  return data;
+}
 
-  return read;
+void PseudoTcp::ConsumeReadData(size_t len) {
+  ASSERT(m_state == TCP_ESTABLISHED);
+  m_rbuf.ConsumeReadData(len);
+  updateReceiveWindow();
 }
 
 int PseudoTcp::Send(const char* buffer, size_t len) {
@@ -492,6 +562,33 @@ int PseudoTcp::Send(const char* buffer, size_t len) {
   return written;
 }
 
+char* PseudoTcp::GetWriteBuffer(size_t* len) {
+  if (m_state != TCP_ESTABLISHED) {
+    m_error = ENOTCONN;
+    return NULL;
+  }
+
+  char* buffer = static_cast<char*>(m_sbuf.GetWriteBuffer(len));
+  if (!buffer || (*len == 0)) {
+    m_bWriteEnable = true;
+    m_error = EWOULDBLOCK;
+    return NULL;
+  }
+  return buffer;
+}
+
+int PseudoTcp::ConsumeWriteBuffer(size_t len) {
+  if (m_state != TCP_ESTABLISHED) {
+    m_error = ENOTCONN;
+    return SOCKET_ERROR;
+  }
+
+  queueSegment(uint32(len), false);
+  m_sbuf.ConsumeWriteBuffer(len);
+  attemptSend();
+  return static_cast<int>(len);
+}
+
 void PseudoTcp::Close(bool force) {
   LOG_F(LS_VERBOSE) << "(" << (force ? "true" : "false") << ")";
   m_shutdown = force ? SD_FORCEFUL : SD_GRACEFUL;
@@ -514,6 +611,14 @@ uint32 PseudoTcp::queue(const char* data, uint32 len, bool bCtrl) {
     len = static_cast<uint32>(available_space);
   }
 
+  queueSegment(len, bCtrl);
+
+  size_t written = 0;
+  m_sbuf.Write(data, len, &written, NULL);
+  return written;
+}
+
+void PseudoTcp::queueSegment(uint32 len, bool bCtrl) {
   // We can concatenate data if the last segment is the same type
   // (control v. regular data), and has not been transmitted yet
   if (!m_slist.empty() && (m_slist.back().bCtrl == bCtrl) && (m_slist.back().xmit == 0)) {
@@ -524,10 +629,6 @@ uint32 PseudoTcp::queue(const char* data, uint32 len, bool bCtrl) {
     SSegment sseg(m_snd_una + snd_buffered, len, bCtrl);
     m_slist.push_back(sseg);
   }
-
-  size_t written = 0;
-  m_sbuf.Write(data, len, &written, NULL);
-  return written;
 }
 
 IPseudoTcpNotify::WriteResult PseudoTcp::packet(uint32 seq, uint8 flags,
@@ -536,7 +637,15 @@ IPseudoTcpNotify::WriteResult PseudoTcp::packet(uint32 seq, uint8 flags,
 
   uint32 now = Now();
 
-  uint8 buffer[MAX_PACKET];
+  // Build the packet where the notifier wants it, if it says.
+  uint8 own_buffer[MAX_PACKET];
+  uint8* buffer = reinterpret_cast<uint8*>(m_notify->GetPacketBuffer(
+      this, HEADER_SIZE + talk_base::_max<uint32>(
+          len, MAX_SACK_BLOCKS * SACK_BLOCK_SIZE)));
+  if (!buffer) {
+    buffer = own_buffer;
+  }
+
   long_to_bytes(m_conv, buffer);
   long_to_bytes(seq, buffer + 4);
   long_to_bytes(m_rcv_nxt, buffer + 8);
@@ -549,6 +658,7 @@ IPseudoTcpNotify::WriteResult PseudoTcp::packet(uint32 seq, uint8 flags,
   long_to_bytes(m_ts_recent, buffer + 20);
   m_ts_lastack = m_rcv_nxt;
 
+  uint32 sack_len = 0;
   if (len) {
     size_t bytes_read = 0;
     talk_base::StreamResult result = m_sbuf.ReadOffset(buffer + HEADER_SIZE,
@@ -558,6 +668,16 @@ IPseudoTcpNotify::WriteResult PseudoTcp::packet(uint32 seq, uint8 flags,
     UNUSED(result);
     ASSERT(result == talk_base::SR_SUCCESS);
     ASSERT(static_cast<uint32>(bytes_read) == len);
+  } else if (m_use_sack) {
+    SackBlock blocks[MAX_SACK_BLOCKS];
+    uint32 count = getSackBlocks(blocks);
+    for (uint32 i = 0; i < count; ++i) {
+      long_to_bytes(blocks[i].left, buffer + HEADER_SIZE + sack_len);
+      long_to_bytes(blocks[i].right, buffer + HEADER_SIZE + sack_len + 4);
+      sack_len += SACK_BLOCK_SIZE;
+    }
+    if (sack_len)
+      buffer[13] |= FLAG_SACK;
   }
 
 #if _DEBUGMSG >= _DBG_VERBOSE
@@ -571,7 +691,7 @@ IPseudoTcpNotify::WriteResult PseudoTcp::packet(uint32 seq, uint8 flags,
                << "><LEN=" << len << ">";
 #endif // _DEBUGMSG
 
-  IPseudoTcpNotify::WriteResult wres = m_notify->TcpWritePacket(this, reinterpret_cast<char *>(buffer), len + HEADER_SIZE);
+  IPseudoTcpNotify::WriteResult wres = m_notify->TcpWritePacket(this, reinterpret_cast<char *>(buffer), len + sack_len + HEADER_SIZE);
   // Note: When len is 0, this is an ACK packet.  We don't read the return value for those,
   // and thus we won't retry.  So go ahead and treat the packet as a success (basically simulate
   // as if it were dropped), which will prevent our timers from being messed up.
@@ -605,6 +725,19 @@ bool PseudoTcp::parse(const uint8* buffer, uint32 size) {
   seg.data = reinterpret_cast<const char *>(buffer) + HEADER_SIZE;
   seg.len = size - HEADER_SIZE;
 
+  seg.sack_count = 0;
+  if (seg.flags & FLAG_SACK) {
+    for (uint32 offset = 0;
+         (offset + SACK_BLOCK_SIZE <= seg.len) &&
+             (seg.sack_count < MAX_SACK_BLOCKS);
+         offset += SACK_BLOCK_SIZE) {
+      seg.sack[seg.sack_count].left = bytes_to_long(seg.data + offset);
+      seg.sack[seg.sack_count].right = bytes_to_long(seg.data + offset + 4);
+      ++seg.sack_count;
+    }
+    seg.len = 0;
+  }
+
 #if _DEBUGMSG >= _DBG_VERBOSE
   LOG(LS_INFO) << "--> <CONV=" << seg.conv
                << "><FLG=" << static_cast<unsigned>(seg.flags)
@@ -721,12 +854,27 @@ bool PseudoTcp::process(Segment& seg) {
     m_ts_recent = seg.tsval;
   }
 
+  // Data segments echo our timestamps too, which gives the receiving side
+  // a round trip time to tune its buffer by.
+  if (m_max_buffer && seg.len && seg.tsecr) {
+    long rtt = talk_base::TimeDiff(now, seg.tsecr);
+    if ((rtt > 0) && (!m_rcv_rtt || (static_cast<uint32>(rtt) < m_rcv_rtt))) {
+      m_rcv_rtt = rtt;
+    }
+  }
+
+  if (seg.sack_count) {
+    applySackBlocks(seg);
+  }
+
   // Check if this is a valuable ack
   if ((seg.ack > m_snd_una) && (seg.ack <= m_snd_nxt)) {
     // Calculate round-trip time
+    uint32 rtt_sample = 0;
     if (seg.tsecr) {
       long rtt = talk_base::TimeDiff(now, seg.tsecr);
       if (rtt >= 0) {
+        rtt_sample = rtt;
         if (m_rx_srtt == 0) {
           m_rx_srtt = rtt;
           m_rx_rttvar = rtt / 2;
@@ -758,12 +906,21 @@ bool PseudoTcp::process(Segment& seg) {
     for (uint32 nFree = nAcked; nFree > 0; ) {
       ASSERT(!m_slist.empty());
       if (nFree < m_slist.front().len) {
+        // The peer took part of the segment, so a retransmission should
+        // start at the first byte it's missing.
+        m_slist.front().seq += nFree;
         m_slist.front().len -= nFree;
+        if (m_slist.front().bSacked) {
+          m_sacked -= nFree;
+        }
         nFree = 0;
       } else {
         if (m_slist.front().len > m_largest) {
           m_largest = m_slist.front().len;
         }
+        if (m_slist.front().bSacked) {
+          m_sacked -= m_slist.front().len;
+        }
         nFree -= m_slist.front().len;
         m_slist.pop_front();
       }
@@ -777,6 +934,16 @@ bool PseudoTcp::process(Segment& seg) {
         LOG(LS_INFO) << "exit recovery";
 #endif // _DEBUGMSG
         m_dup_acks = 0;
+        m_rto_high = 0;
+      } else if (m_use_sack) {
+        // Slow start applies after a retransmission timeout.
+        if (m_cwnd < m_ssthresh) {
+          m_cwnd += m_mss;
+        }
+        if (!sackRetransmit(now)) {
+          closedown(ECONNABORTED);
+          return false;
+        }
       } else {
 #if _DEBUGMSG >= _DBG_NORMAL
         LOG(LS_INFO) << "recovery retransmit";
@@ -789,12 +956,12 @@ bool PseudoTcp::process(Segment& seg) {
       }
     } else {
       m_dup_acks = 0;
-      // Slow start, congestion avoidance
-      if (m_cwnd < m_ssthresh) {
-        m_cwnd += m_mss;
-      } else {
-        m_cwnd += talk_base::_max<uint32>(1, m_mss * m_mss / m_cwnd);
-      }
+      m_congestion->OnAck(now, nAcked, rtt_sample, m_mss, &m_cwnd,
+                          &m_ssthresh);
+    }
+
+    if (m_max_buffer) {
+      autoTuneSendBuffer();
     }
   } else if (seg.ack == m_snd_una) {
     // !?! Note, tcp says don't do this... but otherwise how does a closed window become open?
@@ -804,23 +971,51 @@ bool PseudoTcp::process(Segment& seg) {
     if (seg.len > 0) {
       // it's a dup ack, but with a data payload, so don't modify m_dup_acks
     } else if (m_snd_una != m_snd_nxt) {
-      m_dup_acks += 1;
+      // Saturate rather than wrap, which would restart the recovery.
+      if (m_dup_acks < 0xFF) {
+        m_dup_acks += 1;
+      }
       if (m_dup_acks == 3) { // (Fast Retransmit)
 #if _DEBUGMSG >= _DBG_NORMAL
         LOG(LS_INFO) << "enter recovery";
         LOG(LS_INFO) << "recovery retransmit";
 #endif // _DEBUGMSG
+        if (m_use_sack) {
+          for (SList::iterator it = m_slist.begin(); it != m_slist.end();
+               ++it) {
+            it->bResent = false;
+          }
+        }
         if (!transmit(m_slist.begin(), now)) {
           closedown(ECONNABORTED);
           return false;
         }
         m_recover = m_snd_nxt;
         uint32 nInFlight = m_snd_nxt - m_snd_una;
-        m_ssthresh = talk_base::_max(nInFlight / 2, 2 * m_mss);
+        m_ssthresh = m_congestion->OnLoss(now, m_cwnd, nInFlight, m_mss);
         //LOG(LS_INFO) << "m_ssthresh: " << m_ssthresh << "  nInFlight: " << nInFlight << "  m_mss: " << m_mss;
-        m_cwnd = m_ssthresh + 3 * m_mss;
+        if (m_use_sack) {
+          // With the scoreboard, bytesInPipe() accounts for the segments
+          // that have left the network, so the window needn't be inflated
+          // to make up for them (RFC 6675).
+          m_slist.front().bResent = true;
+          m_cwnd = m_ssthresh;
+          if (!sackRetransmit(now)) {
+            closedown(ECONNABORTED);
+            return false;
+          }
+        } else {
+          m_cwnd = m_ssthresh + 3 * m_mss;
+        }
       } else if (m_dup_acks > 3) {
-        m_cwnd += m_mss;
+        if (m_use_sack) {
+          if (!sackRetransmit(now)) {
+            closedown(ECONNABORTED);
+            return false;
+          }
+        } else {
+          m_cwnd += m_mss;
+        }
       }
     } else {
       m_dup_acks = 0;
@@ -954,6 +1149,10 @@ bool PseudoTcp::process(Segment& seg) {
     }
   }
 
+  if (bNewData && m_max_buffer) {
+    autoTuneReceiveBuffer(now);
+  }
+
   attemptSend(sflags);
 
   // If we have new data, notify the user
@@ -1056,7 +1255,8 @@ void PseudoTcp::attemptSend(SendFlags sflags) {
     }
     uint32 nWindow = talk_base::_min(m_snd_wnd, cwnd);
     uint32 nInFlight = m_snd_nxt - m_snd_una;
-    uint32 nUseable = (nInFlight < nWindow) ? (nWindow - nInFlight) : 0;
+    uint32 nPipe = bytesInPipe();
+    uint32 nUseable = (nPipe < nWindow) ? (nWindow - nPipe) : 0;
 
     size_t snd_buffered = 0;
     m_sbuf.GetBuffered(&snd_buffered);
@@ -1162,6 +1362,124 @@ PseudoTcp::adjustMTU() {
   m_cwnd = talk_base::_max(m_cwnd, m_mss);
 }
 
+uint32
+PseudoTcp::getSackBlocks(SackBlock* blocks) const {
+  // Report the lowest ranges, which border the holes that the sender should
+  // fill first. m_rlist is sorted, but its ranges may overlap or abut.
+  uint32 count = 0;
+  for (RList::const_iterator it = m_rlist.begin(); it != m_rlist.end(); ++it) {
+    uint32 left = it->seq;
+    uint32 right = it->seq + it->len;
+    if (right <= m_rcv_nxt) {
+      continue;
+    }
+    if (count && (left <= blocks[count - 1].right)) {
+      blocks[count - 1].right = talk_base::_max(blocks[count - 1].right, right);
+      continue;
+    }
+    if (count == MAX_SACK_BLOCKS) {
+      break;
+    }
+    blocks[count].left = left;
+    blocks[count].right = right;
+    ++count;
+  }
+  return count;
+}
+
+void
+PseudoTcp::applySackBlocks(const Segment& seg) {
+  for (uint32 i = 0; i < seg.sack_count; ++i) {
+    const SackBlock& block = seg.sack[i];
+    if ((block.left >= block.right) || (block.left < m_snd_una)
+        || (block.right > m_snd_nxt)) {
+      continue;
+    }
+    for (SList::iterator it = m_slist.begin();
+         (it != m_slist.end()) && (it->xmit > 0) && (it->seq < block.right);
+         ++it) {
+      if (!it->bSacked && (it->seq >= block.left)
+          && (it->seq + it->len <= block.right)) {
+        it->bSacked = true;
+        m_sacked += it->len;
+      }
+    }
+  }
+}
+
+uint32
+PseudoTcp::lostHigh() const {
+  // Data that was outstanding at a retransmission timeout is lost, as is,
+  // following RFC 6675's IsLost, a segment with DUP_THRESH selectively
+  // acknowledged segments, or more than (DUP_THRESH - 1) * MSS such bytes,
+  // above it. Segments ending at or below the start of the selectively
+  // acknowledged segment where that first holds therefore are.
+  uint32 nLostHigh = m_rto_high;
+  uint32 nSackedSegs = 0;
+  uint32 nSackedBytes = 0;
+  for (SList::const_reverse_iterator it = m_slist.rbegin();
+       m_sacked && (it != m_slist.rend()); ++it) {
+    if (!it->bSacked) {
+      continue;
+    }
+    ++nSackedSegs;
+    nSackedBytes += it->len;
+    if ((nSackedSegs >= DUP_THRESH)
+        || (nSackedBytes > (DUP_THRESH - 1) * m_mss)) {
+      nLostHigh = talk_base::_max(nLostHigh, it->seq);
+      break;
+    }
+  }
+  return nLostHigh;
+}
+
+uint32
+PseudoTcp::bytesInPipe() const {
+  if (!m_sacked && !m_rto_high) {
+    return m_snd_nxt - m_snd_una;
+  }
+
+  // Segments that are taken to be lost, and not acknowledged since, only
+  // count once resent.
+  uint32 nLostHigh = lostHigh();
+  uint32 nPipe = 0;
+  for (SList::const_iterator it = m_slist.begin();
+       (it != m_slist.end()) && (it->xmit > 0); ++it) {
+    if (it->bSacked) {
+      continue;
+    }
+    if ((it->seq + it->len > nLostHigh) || it->bResent) {
+      nPipe += it->len;
+    }
+  }
+  return nPipe;
+}
+
+bool
+PseudoTcp::sackRetransmit(uint32 now) {
+  uint32 nLostHigh = lostHigh();
+  uint32 nPipe = bytesInPipe();
+  for (SList::iterator it = m_slist.begin();
+       (it != m_slist.end()) && (it->xmit > 0) && (it->seq < nLostHigh);
+       ++it) {
+    if (it->bSacked || it->bResent) {
+      continue;
+    }
+    if (nPipe >= m_cwnd) {
+      break;
+    }
+#if _DEBUGMSG >= _DBG_NORMAL
+    LOG(LS_INFO) << "sack retransmit " << it->seq;
+#endif // _DEBUGMSG
+    if (!transmit(it, now)) {
+      return false;
+    }
+    it->bResent = true;
+    nPipe += it->len;
+  }
+  return true;
+}
+
 bool
 PseudoTcp::isReceiveBufferFull() const {
   size_t available_space = 0;
@@ -1184,6 +1502,10 @@ PseudoTcp::queueConnectMessage() {
     buf.WriteUInt8(1);
     buf.WriteUInt8(m_rwnd_scale);
   }
+  if (m_support_sack) {
+    buf.WriteUInt8(TCP_OPT_SACK_PERMITTED);
+    buf.WriteUInt8(0);
+  }
   m_snd_wnd = buf.Length();
   queue(buf.Data(), buf.Length(), true);
 }
@@ -1229,7 +1551,8 @@ PseudoTcp::parseOptions(const char* data, uint32 len) {
 
     if (m_rwnd_scale > 0) {
       // Peer doesn't support TCP options and window scaling.
-      // Revert receive buffer size to default value.
+      // Revert receive buffer size to default value, which can't grow.
+      m_max_buffer = 0;
       resizeReceiveBuffer(DEFAULT_RCV_BUF_SIZE);
       m_swnd_scale = 0;
     }
@@ -1249,6 +1572,8 @@ PseudoTcp::applyOption(char kind, const char* data, uint32 len) {
       return;
     }
     applyWindowScaleOption(data[0]);
+  } else if (kind == TCP_OPT_SACK_PERMITTED) {
+    applySackPermittedOption();
   }
 }
 
@@ -1257,6 +1582,11 @@ PseudoTcp::applyWindowScaleOption(uint8 scale_factor) {
   m_swnd_scale = scale_factor;
 }
 
+void
+PseudoTcp::applySackPermittedOption() {
+  m_use_sack = m_support_sack;
+}
+
 void
 PseudoTcp::resizeSendBuffer(uint32 new_size) {
   m_sbuf_len = new_size;
@@ -1268,14 +1598,16 @@ PseudoTcp::resizeReceiveBuffer(uint32 new_size) {
   uint8 scale_factor = 0;
 
   // Determine the scale factor such that the scaled window size can fit
-  // in a 16-bit unsigned integer.
-  while (new_size > 0xFFFF) {
+  // in a 16-bit unsigned integer, even once the buffer has been tuned up to
+  // its largest size.
+  uint32 max_size = talk_base::_max(new_size, m_max_buffer);
+  while (max_size > 0xFFFF) {
     ++scale_factor;
-    new_size >>= 1;
+    max_size >>= 1;
   }
 
   // Determine the proper size of the buffer.
-  new_size <<= scale_factor;
+  new_size = (new_size >> scale_factor) << scale_factor;
   bool result = m_rbuf.SetCapacity(new_size);
 
   // Make sure the new buffer is large enough to contain data in the old
@@ -1286,11 +1618,63 @@ PseudoTcp::resizeReceiveBuffer(uint32 new_size) {
   UNUSED(result);
   m_rbuf_len = new_size;
   m_rwnd_scale = scale_factor;
-  m_ssthresh = new_size;
+  m_ssthresh = talk_base::_max(new_size, m_max_buffer);
 
   size_t available_space = 0;
   m_rbuf.GetWriteRemaining(&available_space);
   m_rcv_wnd = available_space;
 }
 
+void
+PseudoTcp::updateReceiveWindow() {
+  size_t available_space = 0;
+  m_rbuf.GetWriteRemaining(&available_space);
+
+  if (uint32(available_space) - m_rcv_wnd >=
+      talk_base::_min<uint32>(m_rbuf_len / 2, m_mss)) {
+    bool bWasClosed = (m_rcv_wnd == 0); // !?! Not sure about this was closed business
+    m_rcv_wnd = available_space;
+
+    if (bWasClosed) {
+      attemptSend(sfImmediateAck);
+    }
+  }
+}
+
+void
+PseudoTcp::autoTuneSendBuffer() {
+  uint32 nWindow = talk_base::_min(m_cwnd, m_snd_wnd);
+  uint32 new_size = talk_base::_min(2 * nWindow, m_max_buffer);
+  if (new_size > m_sbuf_len) {
+    resizeSendBuffer(new_size);
+  }
+}
+
+void
+PseudoTcp::autoTuneReceiveBuffer(uint32 now) {
+  uint32 rtt = m_rx_srtt ? m_rx_srtt : m_rcv_rtt;
+  if (!rtt || (talk_base::TimeDiff(now, m_rcv_space_time) <
+               static_cast<long>(rtt))) {
+    return;
+  }
+
+  uint32 received = m_rcv_nxt - m_rcv_space_seq;
+  m_rcv_space_seq = m_rcv_nxt;
+  m_rcv_space_time = now;
+
+  // Resizing |m_rbuf| keeps only the data up to |m_rcv_nxt|, so wait until
+  // any out-of-order data has been filled in.
+  if (!m_rlist.empty()) {
+    return;
+  }
+
+  uint32 new_size = talk_base::_min(2 * received, m_max_buffer);
+  new_size = (new_size >> m_rwnd_scale) << m_rwnd_scale;
+  if ((new_size <= m_rbuf_len) || !m_rbuf.SetCapacity(new_size)) {
+    return;
+  }
+  m_rcv_wnd += new_size - m_rbuf_len;
+  m_rbuf_len = new_size;
+}
+
 }  // namespace cricket
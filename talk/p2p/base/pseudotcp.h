@@ -31,7 +31,9 @@
 #include <list>
 
 #include "talk/base/basictypes.h"
+#include "talk/base/scoped_ptr.h"
 #include "talk/base/stream.h"
+#include "talk/p2p/base/pseudotcpcongestion.h"
 
 namespace cricket {
 
@@ -54,6 +56,13 @@ class IPseudoTcpNotify {
   virtual WriteResult TcpWritePacket(PseudoTcp* tcp,
                                      const char* buffer, size_t len) = 0;
 
+  // Optionally lends a buffer of at least |len| bytes in which the next
+  // packet is built, header and payload, before being passed to
+  // TcpWritePacket. Implementations that own their outgoing packets can use
+  // this to avoid copying them. The default, NULL, has PseudoTcp use a
+  // buffer of its own.
+  virtual char* GetPacketBuffer(PseudoTcp* tcp, size_t len) { return NULL; }
+
  protected:
   virtual ~IPseudoTcpNotify() {}
 };
@@ -72,6 +81,24 @@ class PseudoTcp {
   int Connect();
   int Recv(char* buffer, size_t len);
   int Send(const char* buffer, size_t len);
+
+  // Like Recv, but lends out received data in place rather than copying it.
+  // GetReadData returns the contiguous data at the head of the receive
+  // buffer, which may be less than all there is, or NULL if there is none;
+  // ConsumeReadData then releases the first |len| bytes of it. The data is
+  // only valid until the next call into this PseudoTcp.
+  const char* GetReadData(size_t* len);
+  void ConsumeReadData(size_t len);
+
+  // Like Send, but lends out free space in the send buffer to write into
+  // rather than copying from the caller. GetWriteBuffer returns the
+  // contiguous free space, or NULL if there is none; ConsumeWriteBuffer then
+  // queues the first |len| bytes written to it. As with GetReadData, the
+  // space is only valid until the next call into this PseudoTcp, since the
+  // buffers may be resized as they are auto-tuned.
+  char* GetWriteBuffer(size_t* len);
+  int ConsumeWriteBuffer(size_t len);
+
   void Close(bool force);
   int GetError();
 
@@ -99,13 +126,19 @@ class PseudoTcp {
   // instance's behaviour for the kind of data it will carry.
   // If an unrecognized option is set or got, an assertion will fire.
   //
-  // Setting options for OPT_RCVBUF or OPT_SNDBUF after Connect() is called
-  // will result in an assertion.
+  // Setting options for OPT_RCVBUF, OPT_SNDBUF, OPT_SACK or OPT_MAX_BUFFER
+  // after Connect() is called will result in an assertion.
   enum Option {
     OPT_NODELAY,      // Whether to enable Nagle's algorithm (0 == off)
     OPT_ACKDELAY,     // The Delayed ACK timeout (0 == off).
     OPT_RCVBUF,       // Set the receive buffer size, in bytes.
     OPT_SNDBUF,       // Set the send buffer size, in bytes.
+    OPT_SACK,         // Whether to offer selective acknowledgements (0 == off).
+                      // They are used if both sides offer them.
+    OPT_CONGESTION_CONTROL,  // A CongestionControlType; CC_RENO by default.
+    OPT_MAX_BUFFER,   // The size, in bytes, up to which the send and receive
+                      // buffers grow to fit the path's bandwidth-delay
+                      // product (0 == off, the default).
   };
   void GetOption(Option opt, int* value);
   void SetOption(Option opt, int value);
@@ -127,6 +160,12 @@ class PseudoTcp {
  protected:
   enum SendFlags { sfNone, sfDelayedAck, sfImmediateAck };
 
+  enum { MAX_SACK_BLOCKS = 4 };
+
+  struct SackBlock {
+    uint32 left, right;  // The range [left, right) has been received.
+  };
+
   struct Segment {
     uint32 conv, seq, ack;
     uint8 flags;
@@ -134,16 +173,22 @@ class PseudoTcp {
     const char * data;
     uint32 len;
     uint32 tsval, tsecr;
+    SackBlock sack[MAX_SACK_BLOCKS];
+    uint32 sack_count;
   };
 
   struct SSegment {
     SSegment(uint32 s, uint32 l, bool c)
-        : seq(s), len(l), /*tstamp(0),*/ xmit(0), bCtrl(c) {
+        : seq(s), len(l), /*tstamp(0),*/ xmit(0), bCtrl(c), bSacked(false),
+          bResent(false) {
     }
     uint32 seq, len;
     //uint32 tstamp;
     uint8 xmit;
     bool bCtrl;
+    // Whether the peer has selectively acknowledged this segment, and
+    // whether it has been resent during the current loss recovery.
+    bool bSacked, bResent;
   };
   typedef std::list<SSegment> SList;
 
@@ -152,6 +197,8 @@ class PseudoTcp {
   };
 
   uint32 queue(const char* data, uint32 len, bool bCtrl);
+  // Adds |len| bytes, about to be appended to |m_sbuf|, to the send list.
+  void queueSegment(uint32 len, bool bCtrl);
 
   // Creates a packet and submits it to the network. This method can either
   // send payload or just an ACK packet.
@@ -176,6 +223,22 @@ class PseudoTcp {
 
   void adjustMTU();
 
+  // Fills |blocks| with the ranges of out-of-order data we hold, returning
+  // how many there are.
+  uint32 getSackBlocks(SackBlock* blocks) const;
+  // Marks the segments that |seg| selectively acknowledges.
+  void applySackBlocks(const Segment& seg);
+  // Returns the sequence number below which the unacknowledged segments
+  // are taken to be lost.
+  uint32 lostHigh() const;
+  // Returns the number of bytes that are still in the network: those in
+  // flight, less those that the peer has selectively acknowledged or that
+  // we consider lost, plus those resent.
+  uint32 bytesInPipe() const;
+  // Resends, as far as the congestion window allows, the segments that we
+  // consider lost. Returns false if the connection should be aborted.
+  bool sackRetransmit(uint32 now);
+
  protected:
   // This method is used in test only to query receive buffer state.
   bool isReceiveBufferFull() const;
@@ -197,6 +260,9 @@ class PseudoTcp {
   // Apply window scale option.
   void applyWindowScaleOption(uint8 scale_factor);
 
+  // Apply the selective acknowledgement permitted option.
+  void applySackPermittedOption();
+
   // Resize the send buffer with |new_size| in bytes.
   void resizeSendBuffer(uint32 new_size);
 
@@ -204,6 +270,15 @@ class PseudoTcp {
   // window scale factor |m_swnd_scale| accordingly.
   void resizeReceiveBuffer(uint32 new_size);
 
+  // Opens the receive window after the application has read data.
+  void updateReceiveWindow();
+
+  // Grow the buffers, up to |m_max_buffer|, when they limit how much data
+  // can be in flight: the send buffer to twice the window we can use, and
+  // the receive buffer to twice what arrived in the last round trip.
+  void autoTuneSendBuffer();
+  void autoTuneReceiveBuffer(uint32 now);
+
   IPseudoTcpNotify* m_notify;
   enum Shutdown { SD_NONE, SD_GRACEFUL, SD_FORCEFUL } m_shutdown;
   int m_error;
@@ -243,6 +318,25 @@ class PseudoTcp {
   uint8 m_dup_acks;
   uint32 m_recover;
   uint32 m_t_ack;
+  talk_base::scoped_ptr<PseudoTcpCongestionControl> m_congestion;
+  CongestionControlType m_congestion_type;
+
+  // Selective acknowledgements: whether we offer them, whether both sides
+  // do, and how many bytes in m_slist have been selectively acknowledged.
+  // m_rto_high is the end of the data that was outstanding at a
+  // retransmission timeout, until it's all recovered.
+  bool m_support_sack;
+  bool m_use_sack;
+  uint32 m_sacked;
+  uint32 m_rto_high;
+
+  // Buffer auto-tuning: the largest size the buffers may grow to, and the
+  // receive sequence number and time at which the current measurement of
+  // the data arriving in a round trip started. m_rcv_rtt is the smallest
+  // round trip time measured from data segments echoing our timestamps.
+  uint32 m_max_buffer;
+  uint32 m_rcv_space_seq, m_rcv_space_time;
+  uint32 m_rcv_rtt;
 
   // Configuration options
   bool m_use_nagling;
@@ -27,12 +27,15 @@
 
 #include <vector>
 
+#include "talk/base/asyncudpsocket.h"
 #include "talk/base/gunit.h"
 #include "talk/base/helpers.h"
 #include "talk/base/messagehandler.h"
+#include "talk/base/scoped_ptr.h"
 #include "talk/base/stream.h"
 #include "talk/base/thread.h"
 #include "talk/base/timeutils.h"
+#include "talk/base/virtualsocketserver.h"
 #include "talk/p2p/base/pseudotcp.h"
 
 using cricket::PseudoTcp;
@@ -68,7 +71,8 @@ class PseudoTcpTestBase : public testing::Test,
         local_mtu_(65535),
         remote_mtu_(65535),
         delay_(0),
-        loss_(0) {
+        loss_(0),
+        lend_packet_buffers_(false) {
     // Set use of the test RNG to get predictable loss patterns.
     talk_base::SetRandomTestMode(true);
   }
@@ -102,6 +106,24 @@ class PseudoTcpTestBase : public testing::Test,
     local_.SetOption(PseudoTcp::OPT_SNDBUF, size);
     remote_.SetOption(PseudoTcp::OPT_SNDBUF, size);
   }
+  void SetOptSack(bool enable) {
+    local_.SetOption(PseudoTcp::OPT_SACK, enable);
+    remote_.SetOption(PseudoTcp::OPT_SACK, enable);
+  }
+  void SetRemoteOptSack(bool enable) {
+    remote_.SetOption(PseudoTcp::OPT_SACK, enable);
+  }
+  void SetOptCongestionControl(cricket::CongestionControlType type) {
+    local_.SetOption(PseudoTcp::OPT_CONGESTION_CONTROL, type);
+    remote_.SetOption(PseudoTcp::OPT_CONGESTION_CONTROL, type);
+  }
+  void SetOptMaxBuffer(int size) {
+    local_.SetOption(PseudoTcp::OPT_MAX_BUFFER, size);
+    remote_.SetOption(PseudoTcp::OPT_MAX_BUFFER, size);
+  }
+  void SetLendPacketBuffers(bool lend) {
+    lend_packet_buffers_ = lend;
+  }
   void SetRemoteOptRcvBuf(int size) {
     remote_.SetOption(PseudoTcp::OPT_RCVBUF, size);
   }
@@ -153,8 +175,18 @@ class PseudoTcpTestBase : public testing::Test,
       have_disconnected_ = true;
     }
   }
+  virtual char* GetPacketBuffer(PseudoTcp* tcp, size_t len) {
+    if (!lend_packet_buffers_) {
+      return NULL;
+    }
+    EXPECT_LE(len, sizeof(packet_buffer_));
+    return packet_buffer_;
+  }
   virtual WriteResult TcpWritePacket(PseudoTcp* tcp,
                                      const char* buffer, size_t len) {
+    if (lend_packet_buffers_) {
+      EXPECT_EQ(packet_buffer_, buffer);
+    }
     // Randomly drop the desired percentage of packets.
     // Also drop packets that are larger than the configured MTU.
     if (talk_base::CreateRandomId() % 100 < static_cast<uint32>(loss_)) {
@@ -221,10 +253,19 @@ class PseudoTcpTestBase : public testing::Test,
   int remote_mtu_;
   int delay_;
   int loss_;
+  bool lend_packet_buffers_;
+  char packet_buffer_[65536];
 };
 
 class PseudoTcpTest : public PseudoTcpTestBase {
  public:
+  PseudoTcpTest() : lend_buffers_(false) {
+  }
+  // Use GetReadData and GetWriteBuffer rather than Recv and Send.
+  void SetLendBuffers(bool lend) {
+    lend_buffers_ = lend;
+  }
+
   void TestTransfer(int size) {
     uint32 start, elapsed;
     size_t received;
@@ -289,6 +330,10 @@ class PseudoTcpTest : public PseudoTcpTestBase {
   }
 
   void ReadData() {
+    if (lend_buffers_) {
+      ReadDataInPlace();
+      return;
+    }
     char block[kBlockSize];
     size_t position;
     int rcvd;
@@ -301,7 +346,19 @@ class PseudoTcpTest : public PseudoTcpTestBase {
       }
     } while (rcvd > 0);
   }
+  void ReadDataInPlace() {
+    size_t len;
+    const char* data;
+    while ((data = remote_.GetReadData(&len)) != NULL) {
+      recv_stream_.Write(data, len, NULL, NULL);
+      remote_.ConsumeReadData(len);
+    }
+  }
   void WriteData(bool* done) {
+    if (lend_buffers_) {
+      WriteDataInPlace(done);
+      return;
+    }
     size_t position, tosend;
     int sent;
     char block[kBlockSize];
@@ -324,10 +381,27 @@ class PseudoTcpTest : public PseudoTcpTestBase {
     } while (sent > 0);
     *done = (tosend == 0);
   }
+  void WriteDataInPlace(bool* done) {
+    size_t len, tosend;
+    char* buffer;
+    while ((buffer = local_.GetWriteBuffer(&len)) != NULL) {
+      if (send_stream_.Read(buffer, len, &tosend, NULL) ==
+          talk_base::SR_EOS) {
+        break;
+      }
+      local_.ConsumeWriteBuffer(tosend);
+      UpdateLocalClock();
+    }
+    size_t position, size;
+    send_stream_.GetPosition(&position);
+    send_stream_.GetSize(&size);
+    *done = (position == size);
+  }
 
  private:
   talk_base::MemoryStream send_stream_;
   talk_base::MemoryStream recv_stream_;
+  bool lend_buffers_;
 };
 
 
@@ -602,6 +676,155 @@ class PseudoTcpTestReceiveWindow : public PseudoTcpTestBase {
   std::vector<size_t> recv_position_;
 };
 
+// Drives a PseudoTcp over a UDP socket, so that it can be run across a
+// VirtualSocketServer that delays and drops packets like a long-haul path.
+class PseudoTcpUdpEndpoint : public talk_base::MessageHandler,
+                             public cricket::IPseudoTcpNotify,
+                             public sigslot::has_slots<> {
+ public:
+  PseudoTcpUdpEndpoint(talk_base::AsyncPacketSocket* socket,
+                       const talk_base::SocketAddress& remote_addr)
+      : socket_(socket),
+        remote_addr_(remote_addr),
+        tcp_(this, 1),
+        to_send_(0),
+        sent_(0),
+        received_(0) {
+    socket_->SignalReadPacket.connect(this,
+                                      &PseudoTcpUdpEndpoint::OnReadPacket);
+  }
+  virtual ~PseudoTcpUdpEndpoint() {
+    talk_base::Thread::Current()->Clear(this);
+  }
+
+  PseudoTcp* tcp() { return &tcp_; }
+  size_t received() const { return received_; }
+
+  void Connect() {
+    EXPECT_EQ(0, tcp_.Connect());
+    UpdateClock();
+  }
+  // Sends |size| bytes once connected.
+  void SendBytes(size_t size) {
+    to_send_ = size;
+  }
+
+  virtual void OnTcpOpen(PseudoTcp* tcp) {
+    WriteData();
+  }
+  virtual void OnTcpReadable(PseudoTcp* tcp) {
+    char block[kBlockSize];
+    int rcvd;
+    while ((rcvd = tcp_.Recv(block, sizeof(block))) > 0) {
+      received_ += rcvd;
+    }
+  }
+  virtual void OnTcpWriteable(PseudoTcp* tcp) {
+    WriteData();
+  }
+  virtual void OnTcpClosed(PseudoTcp* tcp, uint32 error) {
+    EXPECT_EQ(0U, error);
+  }
+  virtual WriteResult TcpWritePacket(PseudoTcp* tcp,
+                                     const char* buffer, size_t len) {
+    if (socket_->SendTo(buffer, len, remote_addr_) < 0) {
+      return WR_FAIL;
+    }
+    return WR_SUCCESS;
+  }
+
+  virtual void OnMessage(talk_base::Message* message) {
+    tcp_.NotifyClock(PseudoTcp::Now());
+    UpdateClock();
+  }
+
+ private:
+  void OnReadPacket(talk_base::AsyncPacketSocket* socket, const char* data,
+                    size_t len, const talk_base::SocketAddress& addr) {
+    tcp_.NotifyPacket(data, len);
+    UpdateClock();
+  }
+  void WriteData() {
+    char block[kBlockSize] = { 0 };
+    while (sent_ < to_send_) {
+      int sent = tcp_.Send(block, talk_base::_min(sizeof(block),
+                                                  to_send_ - sent_));
+      if (sent <= 0) {
+        break;
+      }
+      sent_ += sent;
+    }
+    UpdateClock();
+  }
+  void UpdateClock() {
+    long interval;  // NOLINT
+    tcp_.GetNextClock(PseudoTcp::Now(), interval);
+    interval = talk_base::_max<int>(interval, 0L);
+    talk_base::Thread::Current()->Clear(this);
+    talk_base::Thread::Current()->PostDelayed(interval, this);
+  }
+
+  talk_base::AsyncPacketSocket* socket_;
+  talk_base::SocketAddress remote_addr_;
+  PseudoTcp tcp_;
+  size_t to_send_;
+  size_t sent_;
+  size_t received_;
+};
+
+// Measures how quickly PseudoTcp moves data across a VirtualSocketServer
+// with a given round trip time and packet loss.
+class PseudoTcpGoodputTest : public testing::Test {
+ public:
+  PseudoTcpGoodputTest()
+      : vss_(new talk_base::VirtualSocketServer(NULL)),
+        ss_scope_(vss_.get()) {
+  }
+
+  // Returns the goodput in Kbps of transferring |size| bytes, or 0 if the
+  // transfer doesn't complete in time. |max_buffer| sets OPT_MAX_BUFFER.
+  int MeasureGoodput(cricket::CongestionControlType type, bool sack,
+                     int rtt, double loss, size_t size, int max_buffer = 0) {
+    vss_->set_delay_mean(rtt / 2);
+    vss_->UpdateDelayDistribution();
+    vss_->set_drop_probability(loss);
+
+    talk_base::scoped_ptr<talk_base::AsyncPacketSocket> local_socket(
+        talk_base::AsyncUDPSocket::Create(
+            vss_.get(), talk_base::SocketAddress("1.1.1.1", 0)));
+    talk_base::scoped_ptr<talk_base::AsyncPacketSocket> remote_socket(
+        talk_base::AsyncUDPSocket::Create(
+            vss_.get(), talk_base::SocketAddress("2.2.2.2", 0)));
+    PseudoTcpUdpEndpoint local(local_socket.get(),
+                               remote_socket->GetLocalAddress());
+    PseudoTcpUdpEndpoint remote(remote_socket.get(),
+                                local_socket->GetLocalAddress());
+    local.tcp()->NotifyMTU(1500);
+    remote.tcp()->NotifyMTU(1500);
+    local.tcp()->SetOption(PseudoTcp::OPT_CONGESTION_CONTROL, type);
+    local.tcp()->SetOption(PseudoTcp::OPT_SACK, sack);
+    remote.tcp()->SetOption(PseudoTcp::OPT_SACK, sack);
+    local.tcp()->SetOption(PseudoTcp::OPT_MAX_BUFFER, max_buffer);
+    remote.tcp()->SetOption(PseudoTcp::OPT_MAX_BUFFER, max_buffer);
+
+    uint32 start = talk_base::Time();
+    local.SendBytes(size);
+    local.Connect();
+    EXPECT_TRUE_WAIT(remote.received() == size, kGoodputTimeoutMs);
+    uint32 elapsed = talk_base::TimeSince(start);
+    if (remote.received() != size) {
+      return 0;
+    }
+    return static_cast<int>(size * 8 / talk_base::_max<uint32>(elapsed, 1));
+  }
+
+ protected:
+  static const int kGoodputTimeoutMs = 60000;
+
+  talk_base::scoped_ptr<talk_base::VirtualSocketServer> vss_;
+  talk_base::SocketServerScope ss_scope_;
+};
+
 // Basic end-to-end data transfer tests
 
 // Test the normal case of sending data from one side to the other.
@@ -639,6 +862,74 @@ TEST_F(PseudoTcpTest, TestSendWithDelayAndLoss) {
   TestTransfer(100000);  // less data so test runs faster
 }
 
+// Test sending data with packet loss, recovering without selective
+// acknowledgements.
+TEST_F(PseudoTcpTest, TestSendWithLossNoSack) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetLoss(10);
+  SetOptSack(false);
+  TestTransfer(100000);  // less data so test runs faster
+}
+
+// Test sending data with a 50 ms RTT and 10% packet loss, recovering without
+// selective acknowledgements.
+TEST_F(PseudoTcpTest, TestSendWithDelayAndLossNoSack) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetDelay(50);
+  SetLoss(10);
+  SetOptSack(false);
+  TestTransfer(100000);  // less data so test runs faster
+}
+
+// Test sending data with packet loss to a receiver that doesn't support
+// selective acknowledgements.
+TEST_F(PseudoTcpTest, TestSendWithLossRemoteNoSack) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetLoss(10);
+  SetRemoteOptSack(false);
+  TestTransfer(100000);  // less data so test runs faster
+}
+
+// Test sending data with a 50 ms RTT and 10% packet loss using CUBIC.
+TEST_F(PseudoTcpTest, TestSendWithDelayAndLossCubic) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetDelay(50);
+  SetLoss(10);
+  SetOptCongestionControl(cricket::CC_CUBIC);
+  TestTransfer(100000);  // less data so test runs faster
+}
+
+// Test sending data with a 50 ms RTT and 10% packet loss using Vegas.
+TEST_F(PseudoTcpTest, TestSendWithDelayAndLossVegas) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetDelay(50);
+  SetLoss(10);
+  SetOptCongestionControl(cricket::CC_VEGAS);
+  TestTransfer(100000);  // less data so test runs faster
+}
+
+// Test sending data with a 50 ms RTT using CUBIC and Vegas.
+TEST_F(PseudoTcpTest, TestSendWithDelayCubic) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetDelay(50);
+  SetOptCongestionControl(cricket::CC_CUBIC);
+  TestTransfer(1000000);
+}
+
+TEST_F(PseudoTcpTest, TestSendWithDelayVegas) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetDelay(50);
+  SetOptCongestionControl(cricket::CC_VEGAS);
+  TestTransfer(1000000);
+}
+
 // Test sending data with 10% packet loss and Nagling disabled.  Transmission
 // should take about the same time as with Nagling enabled.
 TEST_F(PseudoTcpTest, TestSendWithLossAndOptNaglingOff) {
@@ -741,6 +1032,58 @@ TEST_F(PseudoTcpTest, TestSendVerySmallReceiveBuffer) {
   TestTransfer(100000);
 }
 
+// Test that the buffers grow to fit a path with a large bandwidth-delay
+// product.
+TEST_F(PseudoTcpTest, TestSendWithDelayAndMaxBuffer) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetDelay(50);
+  SetOptMaxBuffer(1024 * 1024);
+  TestTransfer(1000000);
+  int sbuf, rbuf;
+  local_.GetOption(PseudoTcp::OPT_SNDBUF, &sbuf);
+  remote_.GetOption(PseudoTcp::OPT_RCVBUF, &rbuf);
+  EXPECT_GT(sbuf, 90 * 1024);
+  EXPECT_GT(rbuf, 60 * 1024);
+  EXPECT_LE(sbuf, 1024 * 1024);
+  EXPECT_LE(rbuf, 1024 * 1024);
+}
+
+// Test that the buffers don't grow beyond the maximum.
+TEST_F(PseudoTcpTest, TestSendWithDelayAndSmallMaxBuffer) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetDelay(50);
+  SetOptMaxBuffer(100 * 1024);
+  TestTransfer(1000000);
+  int sbuf, rbuf;
+  local_.GetOption(PseudoTcp::OPT_SNDBUF, &sbuf);
+  remote_.GetOption(PseudoTcp::OPT_RCVBUF, &rbuf);
+  EXPECT_LE(sbuf, 100 * 1024);
+  EXPECT_LE(rbuf, 100 * 1024);
+}
+
+// Test sending and receiving in place, with PseudoTcp building its packets
+// in a buffer that we lend it.
+TEST_F(PseudoTcpTest, TestSendWithLentBuffers) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetLendBuffers(true);
+  SetLendPacketBuffers(true);
+  TestTransfer(1000000);
+}
+
+// Test sending and receiving in place with loss, so that the send list
+// is retransmitted from, and the receive buffer filled in out of order.
+TEST_F(PseudoTcpTest, TestSendWithLossAndLentBuffers) {
+  SetLocalMtu(1500);
+  SetRemoteMtu(1500);
+  SetLoss(10);
+  SetLendBuffers(true);
+  SetLendPacketBuffers(true);
+  TestTransfer(100000);
+}
+
 // Ping-pong (request/response) tests
 
 // Test sending <= 1x MTU of data in each ping/pong.  Should take <10ms.
@@ -845,6 +1188,45 @@ TEST_F(PseudoTcpTestReceiveWindow, TestSetReceiveWindowSize) {
   EXPECT_EQ(100000u, EstimateReceiveWindowSize());
 }
 
+// Goodput tests, across a VirtualSocketServer
+
+// Test that each congestion controller completes a transfer over a lossy,
+// long-haul path.
+TEST_F(PseudoTcpGoodputTest, TestTransferOverLossyPath) {
+  EXPECT_LT(0, MeasureGoodput(cricket::CC_RENO, true, 100, 0.02, 100000));
+  EXPECT_LT(0, MeasureGoodput(cricket::CC_CUBIC, true, 100, 0.02, 100000));
+  EXPECT_LT(0, MeasureGoodput(cricket::CC_VEGAS, true, 100, 0.02, 100000));
+}
+
+// Logs a table of goodput against loss and round trip time, for each
+// congestion controller, with and without SACK, and with CUBIC's buffers
+// tuned up to 4MB. Takes several minutes.
+TEST_F(PseudoTcpGoodputTest, DISABLED_TestGoodputTable) {
+  static const int kRtts[] = { 20, 100, 300 };
+  static const double kLosses[] = { 0, 0.01, 0.05 };
+  static const size_t kSize = 2000000;
+  static const int kMaxBuffer = 4 * 1024 * 1024;
+  LOG(LS_INFO) << "rtt(ms) loss(%)   reno(nosack)  reno  cubic  vegas"
+               << "  cubic(tuned) (Kbps)";
+  for (size_t i = 0; i < ARRAY_SIZE(kRtts); ++i) {
+    for (size_t j = 0; j < ARRAY_SIZE(kLosses); ++j) {
+      int rtt = kRtts[i];
+      double loss = kLosses[j];
+      LOG(LS_INFO) << rtt << " " << loss * 100 << "   "
+                   << MeasureGoodput(cricket::CC_RENO, false, rtt, loss, kSize)
+                   << "  "
+                   << MeasureGoodput(cricket::CC_RENO, true, rtt, loss, kSize)
+                   << "  "
+                   << MeasureGoodput(cricket::CC_CUBIC, true, rtt, loss, kSize)
+                   << "  "
+                   << MeasureGoodput(cricket::CC_VEGAS, true, rtt, loss, kSize)
+                   << "  "
+                   << MeasureGoodput(cricket::CC_CUBIC, true, rtt, loss, kSize,
+                                     kMaxBuffer);
+    }
+  }
+}
+
 /* Test sending data with mismatched MTUs. We should detect this and reduce
 // our packet size accordingly.
 // TODO: This doesn't actually work right now. The current code
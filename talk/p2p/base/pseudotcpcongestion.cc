@@ -0,0 +1,207 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/p2p/base/pseudotcpcongestion.h"
+
+#include <math.h>
+
+#include "talk/base/common.h"
+#include "talk/base/timeutils.h"
+
+namespace cricket {
+
+// CUBIC's scaling constant, and how far it reduces its window on a loss.
+static const double kCubicC = 0.4;
+static const double kCubicBeta = 0.7;
+
+// Vegas keeps between kVegasAlpha and kVegasBeta of its segments queued in
+// the network, and leaves slow start once more than kVegasGamma are.
+static const double kVegasAlpha = 2;
+static const double kVegasBeta = 4;
+static const double kVegasGamma = 1;
+
+PseudoTcpCongestionControl* PseudoTcpCongestionControl::Create(
+    CongestionControlType type) {
+  switch (type) {
+    case CC_RENO:
+      return new RenoCongestionControl();
+    case CC_CUBIC:
+      return new CubicCongestionControl();
+    case CC_VEGAS:
+      return new VegasCongestionControl();
+  }
+  return NULL;
+}
+
+//////////////////////////////////////////////////////////////////////
+// RenoCongestionControl
+//////////////////////////////////////////////////////////////////////
+
+void RenoCongestionControl::OnAck(uint32 now, uint32 acked, uint32 rtt,
+                                  uint32 mss, uint32* cwnd,
+                                  uint32* ssthresh) {
+  // Slow start, congestion avoidance
+  if (*cwnd < *ssthresh) {
+    *cwnd += mss;
+  } else {
+    *cwnd += talk_base::_max<uint32>(1, mss * mss / *cwnd);
+  }
+}
+
+uint32 RenoCongestionControl::OnLoss(uint32 now, uint32 cwnd,
+                                     uint32 in_flight, uint32 mss) {
+  return talk_base::_max(in_flight / 2, 2 * mss);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CubicCongestionControl
+//////////////////////////////////////////////////////////////////////
+
+CubicCongestionControl::CubicCongestionControl()
+    : epoch_start_(0),
+      w_max_(0),
+      origin_(0),
+      k_(0),
+      est_(0),
+      min_rtt_(0) {
+}
+
+void CubicCongestionControl::OnAck(uint32 now, uint32 acked, uint32 rtt,
+                                   uint32 mss, uint32* cwnd,
+                                   uint32* ssthresh) {
+  if (rtt && (!min_rtt_ || rtt < min_rtt_))
+    min_rtt_ = rtt;
+
+  if (*cwnd < *ssthresh) {
+    *cwnd += mss;
+    return;
+  }
+
+  double segments = static_cast<double>(*cwnd) / mss;
+  if (!epoch_start_) {
+    epoch_start_ = now ? now : 1;
+    if (segments < w_max_) {
+      k_ = pow((w_max_ - segments) / kCubicC, 1.0 / 3);
+      origin_ = w_max_;
+    } else {
+      k_ = 0;
+      origin_ = segments;
+    }
+    est_ = segments;
+  }
+
+  // Aim for where the cubic will be a round trip from now, but never grow
+  // faster than slow start would.
+  double t = (talk_base::TimeDiff(now, epoch_start_) + min_rtt_) / 1000.0;
+  double target = origin_ + kCubicC * (t - k_) * (t - k_) * (t - k_);
+  target = talk_base::_min(target, 1.5 * segments);
+
+  // Don't fall behind Reno where Reno does better, on short paths.
+  est_ += 3 * (1 - kCubicBeta) / (1 + kCubicBeta) *
+      (static_cast<double>(acked) / mss) / segments;
+  target = talk_base::_max(target, est_);
+
+  if (target > segments) {
+    double increase = (target - segments) / segments * acked;
+    *cwnd += talk_base::_max<uint32>(1, static_cast<uint32>(increase));
+  }
+}
+
+uint32 CubicCongestionControl::OnLoss(uint32 now, uint32 cwnd,
+                                      uint32 in_flight, uint32 mss) {
+  double segments = static_cast<double>(cwnd) / mss;
+  // If we lost before regaining the last maximum, the path's capacity has
+  // probably dropped; leave room for other flows to grow into.
+  if (segments < w_max_) {
+    w_max_ = segments * (1 + kCubicBeta) / 2;
+  } else {
+    w_max_ = segments;
+  }
+  epoch_start_ = 0;
+  return talk_base::_max(static_cast<uint32>(cwnd * kCubicBeta), 2 * mss);
+}
+
+//////////////////////////////////////////////////////////////////////
+// VegasCongestionControl
+//////////////////////////////////////////////////////////////////////
+
+VegasCongestionControl::VegasCongestionControl()
+    : base_rtt_(0),
+      epoch_start_(0),
+      epoch_rtt_(0) {
+}
+
+void VegasCongestionControl::OnAck(uint32 now, uint32 acked, uint32 rtt,
+                                   uint32 mss, uint32* cwnd,
+                                   uint32* ssthresh) {
+  if (rtt) {
+    if (!base_rtt_ || rtt < base_rtt_)
+      base_rtt_ = rtt;
+    if (!epoch_rtt_ || rtt < epoch_rtt_)
+      epoch_rtt_ = rtt;
+  }
+  if (!epoch_start_)
+    epoch_start_ = now ? now : 1;
+
+  bool slow_start = *cwnd < *ssthresh;
+  if (slow_start)
+    *cwnd += mss;
+
+  if (!epoch_rtt_ || talk_base::TimeDiff(now, epoch_start_) <
+      static_cast<int32>(epoch_rtt_)) {
+    return;
+  }
+
+  // A round trip has passed. The difference between the rate we expected
+  // and the one we got says how many of our segments sat in queues.
+  double segments = static_cast<double>(*cwnd) / mss;
+  double queued = segments * (epoch_rtt_ - base_rtt_) / epoch_rtt_;
+  if (slow_start) {
+    if (queued > kVegasGamma) {
+      uint32 target = static_cast<uint32>(
+          segments * base_rtt_ / epoch_rtt_ + 1) * mss;
+      *cwnd = talk_base::_max(talk_base::_min(*cwnd, target), 2 * mss);
+      *ssthresh = talk_base::_min(*ssthresh, *cwnd - mss);
+    }
+  } else if (queued > kVegasBeta) {
+    *cwnd = talk_base::_max(*cwnd - mss, 2 * mss);
+  } else if (queued < kVegasAlpha) {
+    *cwnd += mss;
+  }
+
+  epoch_start_ = now ? now : 1;
+  epoch_rtt_ = 0;
+}
+
+uint32 VegasCongestionControl::OnLoss(uint32 now, uint32 cwnd,
+                                      uint32 in_flight, uint32 mss) {
+  epoch_start_ = 0;
+  epoch_rtt_ = 0;
+  return talk_base::_max(in_flight / 2, 2 * mss);
+}
+
+}  // namespace cricket
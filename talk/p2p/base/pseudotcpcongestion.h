@@ -0,0 +1,129 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_P2P_BASE_PSEUDOTCPCONGESTION_H_
+#define TALK_P2P_BASE_PSEUDOTCPCONGESTION_H_
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+
+namespace cricket {
+
+// The congestion control algorithms that PseudoTcp can use; see
+// PseudoTcp::OPT_CONGESTION_CONTROL.
+enum CongestionControlType {
+  CC_RENO,   // Slow start and additive increase (RFC 5681). The default.
+  CC_CUBIC,  // CUBIC (draft-rhee-tcpm-cubic), which regrows to its previous
+             // window quickly on long fat paths.
+  CC_VEGAS,  // TCP Vegas, which backs off as queueing delay builds up,
+             // before the path starts dropping packets.
+};
+
+// Decides how PseudoTcp's congestion window grows, and how far its slow
+// start threshold drops after a loss. PseudoTcp does the rest: fast
+// retransmit and recovery, and collapsing the window on a retransmission
+// timeout. Windows and thresholds are in bytes, times in milliseconds.
+class PseudoTcpCongestionControl {
+ public:
+  static PseudoTcpCongestionControl* Create(CongestionControlType type);
+
+  virtual ~PseudoTcpCongestionControl() {}
+
+  // Called when an ACK outside of loss recovery acknowledges |acked| new
+  // bytes. |rtt| is the round trip time measured by the ACK, or 0 if it
+  // measured none. Updates |cwnd|, and |ssthresh| if the algorithm leaves
+  // slow start of its own accord.
+  virtual void OnAck(uint32 now, uint32 acked, uint32 rtt, uint32 mss,
+                     uint32* cwnd, uint32* ssthresh) = 0;
+
+  // Called when a loss is detected, with |in_flight| bytes outstanding.
+  // Returns the new slow start threshold.
+  virtual uint32 OnLoss(uint32 now, uint32 cwnd, uint32 in_flight,
+                        uint32 mss) = 0;
+};
+
+class RenoCongestionControl : public PseudoTcpCongestionControl {
+ public:
+  RenoCongestionControl() {}
+
+  virtual void OnAck(uint32 now, uint32 acked, uint32 rtt, uint32 mss,
+                     uint32* cwnd, uint32* ssthresh);
+  virtual uint32 OnLoss(uint32 now, uint32 cwnd, uint32 in_flight,
+                        uint32 mss);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RenoCongestionControl);
+};
+
+class CubicCongestionControl : public PseudoTcpCongestionControl {
+ public:
+  CubicCongestionControl();
+
+  virtual void OnAck(uint32 now, uint32 acked, uint32 rtt, uint32 mss,
+                     uint32* cwnd, uint32* ssthresh);
+  virtual uint32 OnLoss(uint32 now, uint32 cwnd, uint32 in_flight,
+                        uint32 mss);
+
+ private:
+  // The current congestion avoidance epoch started at epoch_start_ (0 if it
+  // hasn't started yet), and the window grows along a cubic that reaches
+  // origin_ (in segments) k_ seconds into it. est_ is the window that Reno
+  // would have reached in the same time.
+  uint32 epoch_start_;
+  double w_max_;
+  double origin_;
+  double k_;
+  double est_;
+  uint32 min_rtt_;
+
+  DISALLOW_COPY_AND_ASSIGN(CubicCongestionControl);
+};
+
+class VegasCongestionControl : public PseudoTcpCongestionControl {
+ public:
+  VegasCongestionControl();
+
+  virtual void OnAck(uint32 now, uint32 acked, uint32 rtt, uint32 mss,
+                     uint32* cwnd, uint32* ssthresh);
+  virtual uint32 OnLoss(uint32 now, uint32 cwnd, uint32 in_flight,
+                        uint32 mss);
+
+ private:
+  // base_rtt_ is the smallest RTT ever measured, taken to be the path's
+  // delay without queueing. Once per round trip, the window is adjusted by
+  // comparing it with the smallest RTT measured during that round trip,
+  // epoch_rtt_. Both are 0 until measured.
+  uint32 base_rtt_;
+  uint32 epoch_start_;
+  uint32 epoch_rtt_;
+
+  DISALLOW_COPY_AND_ASSIGN(VegasCongestionControl);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_P2P_BASE_PSEUDOTCPCONGESTION_H_
@@ -0,0 +1,136 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/base/gunit.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/p2p/base/pseudotcpcongestion.h"
+
+using cricket::PseudoTcpCongestionControl;
+
+static const uint32 kMss = 1000;
+static const uint32 kRtt = 100;
+
+// Acknowledges a window's worth of segments, one per ACK, spread over a
+// round trip starting at |*now|, with each ACK measuring |rtt|.
+static void AckWindow(PseudoTcpCongestionControl* cc, uint32* now,
+                      uint32 rtt, uint32* cwnd, uint32* ssthresh) {
+  uint32 segments = talk_base::_max<uint32>(*cwnd / kMss, 1);
+  for (uint32 i = 0; i < segments; ++i) {
+    cc->OnAck(*now + rtt * i / segments, kMss, rtt, kMss, cwnd, ssthresh);
+  }
+  *now += rtt;
+}
+
+TEST(PseudoTcpCongestionTest, TestCreate) {
+  talk_base::scoped_ptr<PseudoTcpCongestionControl> cc;
+  cc.reset(PseudoTcpCongestionControl::Create(cricket::CC_RENO));
+  EXPECT_TRUE(cc.get() != NULL);
+  cc.reset(PseudoTcpCongestionControl::Create(cricket::CC_CUBIC));
+  EXPECT_TRUE(cc.get() != NULL);
+  cc.reset(PseudoTcpCongestionControl::Create(cricket::CC_VEGAS));
+  EXPECT_TRUE(cc.get() != NULL);
+}
+
+// Reno doubles its window each round trip in slow start, then grows it by
+// a segment per round trip, and halves it on a loss.
+TEST(PseudoTcpCongestionTest, TestReno) {
+  cricket::RenoCongestionControl cc;
+  uint32 now = 1000, cwnd = 2 * kMss, ssthresh = 16 * kMss;
+  AckWindow(&cc, &now, kRtt, &cwnd, &ssthresh);
+  EXPECT_EQ(4 * kMss, cwnd);
+  AckWindow(&cc, &now, kRtt, &cwnd, &ssthresh);
+  AckWindow(&cc, &now, kRtt, &cwnd, &ssthresh);
+  EXPECT_EQ(16 * kMss, cwnd);
+  AckWindow(&cc, &now, kRtt, &cwnd, &ssthresh);
+  EXPECT_GE(cwnd, 16 * kMss + kMss * 9 / 10);
+  EXPECT_LE(cwnd, 17 * kMss);
+
+  EXPECT_EQ(10 * kMss, cc.OnLoss(now, cwnd, 20 * kMss, kMss));
+  EXPECT_EQ(2 * kMss, cc.OnLoss(now, cwnd, 2 * kMss, kMss));
+}
+
+// CUBIC reduces its window less than Reno on a loss, and regrows to where
+// the loss happened in a fixed time, then slowly around it.
+TEST(PseudoTcpCongestionTest, TestCubic) {
+  cricket::CubicCongestionControl cc;
+  uint32 now = 1000, cwnd = 100 * kMss, ssthresh = 100 * kMss;
+  AckWindow(&cc, &now, kRtt, &cwnd, &ssthresh);
+
+  uint32 w_max = cwnd;
+  ssthresh = cc.OnLoss(now, cwnd, cwnd, kMss);
+  EXPECT_EQ(static_cast<uint32>(w_max * 0.7), ssthresh);
+  cwnd = ssthresh;
+
+  // K, the time to regrow, is (100 * 0.3 / 0.4) ^ (1/3) = ~4.2 seconds,
+  // independent of the RTT; growth is fastest just after the loss.
+  int rounds = 0;
+  while (cwnd < w_max - kMss && rounds < 100) {
+    AckWindow(&cc, &now, kRtt, &cwnd, &ssthresh);
+    ++rounds;
+  }
+  EXPECT_GT(rounds, 20);
+  EXPECT_LT(rounds, 50);
+
+  // Around w_max, growth flattens out.
+  uint32 before = cwnd;
+  AckWindow(&cc, &now, kRtt, &cwnd, &ssthresh);
+  EXPECT_LE(cwnd, before + 2 * kMss);
+}
+
+// Vegas grows its window while the RTT stays at the path's base RTT, and
+// shrinks it once queueing delay builds up.
+TEST(PseudoTcpCongestionTest, TestVegas) {
+  cricket::VegasCongestionControl cc;
+  uint32 now = 1000, cwnd = 10 * kMss, ssthresh = 10 * kMss;
+  AckWindow(&cc, &now, kRtt, &cwnd, &ssthresh);
+  AckWindow(&cc, &now, kRtt, &cwnd, &ssthresh);
+  uint32 before = cwnd;
+  AckWindow(&cc, &now, kRtt, &cwnd, &ssthresh);
+  EXPECT_GT(cwnd, before);
+
+  // Half the RTT is queueing delay, so half the window is sitting in
+  // queues; back off.
+  before = cwnd;
+  for (int i = 0; i < 3; ++i) {
+    AckWindow(&cc, &now, 2 * kRtt, &cwnd, &ssthresh);
+  }
+  EXPECT_LT(cwnd, before);
+
+  EXPECT_EQ(5 * kMss, cc.OnLoss(now, cwnd, 10 * kMss, kMss));
+}
+
+// Vegas leaves slow start early once it sees segments queueing.
+TEST(PseudoTcpCongestionTest, TestVegasLeavesSlowStart) {
+  cricket::VegasCongestionControl cc;
+  uint32 now = 1000, cwnd = 2 * kMss, ssthresh = 1000 * kMss;
+  AckWindow(&cc, &now, kRtt, &cwnd, &ssthresh);
+  AckWindow(&cc, &now, kRtt, &cwnd, &ssthresh);
+  AckWindow(&cc, &now, 2 * kRtt, &cwnd, &ssthresh);
+  AckWindow(&cc, &now, 2 * kRtt, &cwnd, &ssthresh);
+  EXPECT_LT(ssthresh, 1000 * kMss);
+  EXPECT_LE(cwnd, ssthresh + kMss);
+}
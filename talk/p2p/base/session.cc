@@ -341,6 +341,8 @@ BaseSession::BaseSession(talk_base::Thread* signaling_thread,
       transport_type_(NS_GINGLE_P2P),
       initiator_(initiator),
       identity_(NULL),
+      dtls_handshake_pool_(NULL),
+      dtls_session_cache_(NULL),
       local_description_(NULL),
       remote_description_(NULL),
       ice_tiebreaker_(talk_base::CreateRandomId64()),
@@ -522,9 +524,13 @@ void BaseSession::DestroyTransportProxy(
 cricket::Transport* BaseSession::CreateTransport(
     const std::string& content_name) {
   ASSERT(transport_type_ == NS_GINGLE_P2P);
-  return new cricket::DtlsTransport<P2PTransport>(
-      signaling_thread(), worker_thread(), content_name,
-      port_allocator(), identity_);
+  cricket::DtlsTransport<P2PTransport>* transport =
+      new cricket::DtlsTransport<P2PTransport>(
+          signaling_thread(), worker_thread(), content_name,
+          port_allocator(), identity_);
+  transport->set_handshake_pool(dtls_handshake_pool_);
+  transport->set_session_cache(dtls_session_cache_);
+  return transport;
 }
 
 void BaseSession::SetState(State state) {
@@ -357,6 +357,18 @@ class BaseSession : public sigslot::has_slots<>,
   // Specifies the identity to use in this session.
   void set_identity(talk_base::SSLIdentity* identity) { identity_ = identity; }
 
+  // Specifies the pool that DTLS handshakes run on; NULL to run them on the
+  // worker thread.
+  void set_dtls_handshake_pool(talk_base::SSLHandshakePool* pool) {
+    dtls_handshake_pool_ = pool;
+  }
+
+  // Specifies where DTLS sessions are kept for resumption; NULL to always
+  // do full handshakes.
+  void set_dtls_session_cache(talk_base::SSLSessionCache* cache) {
+    dtls_session_cache_ = cache;
+  }
+
   const TransportMap& transport_proxies() const { return transports_; }
   // Get a TransportProxy by content_name or transport. NULL if not found.
   TransportProxy* GetTransportProxy(const std::string& content_name);
@@ -470,6 +482,8 @@ class BaseSession : public sigslot::has_slots<>,
   std::string transport_type_;
   bool initiator_;
   talk_base::SSLIdentity* identity_;
+  talk_base::SSLHandshakePool* dtls_handshake_pool_;
+  talk_base::SSLSessionCache* dtls_session_cache_;
   const SessionDescription* local_description_;
   SessionDescription* remote_description_;
   bool transport_muxed_;
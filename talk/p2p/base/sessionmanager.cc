@@ -45,7 +45,9 @@ SessionManager::SessionManager(PortAllocator *allocator,
                                talk_base::Thread *worker)
     : allocator_(allocator),
       timeout_(kSessionTimeoutWritable),
-      timeout_init_ack_(kSessionTimeoutInitAck) {
+      timeout_init_ack_(kSessionTimeoutInitAck),
+      dtls_handshake_pool_(NULL),
+      dtls_session_cache_(NULL) {
   signaling_thread_ = talk_base::Thread::Current();
   if (worker == NULL) {
     worker_thread_ = talk_base::Thread::Current();
@@ -96,6 +98,8 @@ Session* SessionManager::CreateSession(
   Session* session = new Session(this, local_name, initiator_name,
                                  sid, content_type, client);
   session->set_identity(transport_desc_factory_.identity());
+  session->set_dtls_handshake_pool(dtls_handshake_pool_);
+  session->set_dtls_session_cache(dtls_session_cache_);
   session_map_[session->id()] = session;
   session->SignalRequestSignaling.connect(
       this, &SessionManager::OnRequestSignaling);
@@ -43,6 +43,11 @@ class QName;
 class XmlElement;
 }
 
+namespace talk_base {
+class SSLHandshakePool;
+class SSLSessionCache;
+}
+
 namespace cricket {
 
 class Session;
@@ -78,6 +83,16 @@ class SessionManager : public sigslot::has_slots<> {
   void set_identity(talk_base::SSLIdentity* identity) {
     transport_desc_factory_.set_identity(identity);
   }
+  // Runs the DTLS handshakes of new sessions on |pool|, which must outlive
+  // them, rather than on the worker thread.
+  void set_dtls_handshake_pool(talk_base::SSLHandshakePool* pool) {
+    dtls_handshake_pool_ = pool;
+  }
+  // Lets new sessions resume DTLS sessions from |cache|, which must outlive
+  // them.
+  void set_dtls_session_cache(talk_base::SSLSessionCache* cache) {
+    dtls_session_cache_ = cache;
+  }
   const TransportDescriptionFactory* transport_desc_factory() const {
     return &transport_desc_factory_;
   }
@@ -202,6 +217,8 @@ class SessionManager : public sigslot::has_slots<> {
   int timeout_;
   int timeout_init_ack_;
   TransportDescriptionFactory transport_desc_factory_;
+  talk_base::SSLHandshakePool* dtls_handshake_pool_;
+  talk_base::SSLSessionCache* dtls_session_cache_;
   SessionMap session_map_;
   ClientMap client_map_;
 };
@@ -189,9 +189,12 @@ bool StunMessage::ValidateMessageIntegrity(const char* data, size_t size,
   }
 
   // Getting length of the message to calculate Message Integrity.
+  // The HMAC covers everything before the M-I attribute, as is, except for
+  // the length field in the header, so hash a patched copy of the header
+  // followed by the rest of the message in place.
   size_t mi_pos = current_pos;
-  talk_base::scoped_array<char> temp_data(new char[current_pos]);
-  memcpy(temp_data.get(), data, current_pos);
+  char header[kStunHeaderSize];
+  memcpy(header, data, sizeof(header));
   if (size > mi_pos + kStunAttributeHeaderSize + kStunMessageIntegritySize) {
     // Stun message has other attributes after message integrity.
     // Adjust the length parameter in stun message to calculate HMAC.
@@ -199,19 +202,27 @@ bool StunMessage::ValidateMessageIntegrity(const char* data, size_t size,
         (mi_pos + kStunAttributeHeaderSize + kStunMessageIntegritySize);
     size_t new_adjusted_len = size - extra_offset - kStunHeaderSize;
 
-    // Writing new length of the STUN message @ Message Length in temp buffer.
+    // Writing new length of the STUN message @ Message Length in the header.
     //      0                   1                   2                   3
     //      0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
     //     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
     //     |0 0|     STUN Message Type     |         Message Length        |
     //     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-    talk_base::SetBE16(temp_data.get() + 2, new_adjusted_len);
+    talk_base::SetBE16(header + 2, new_adjusted_len);
   }
 
+  talk_base::scoped_ptr<talk_base::MessageDigest> digest(
+      talk_base::MessageDigestFactory::Create(talk_base::DIGEST_SHA_1));
+  if (!digest)
+    return false;
+  talk_base::DigestSegment segments[] = {
+    { header, sizeof(header) },
+    { data + kStunHeaderSize, mi_pos - kStunHeaderSize },
+  };
   char hmac[kStunMessageIntegritySize];
-  size_t ret = talk_base::ComputeHmac(talk_base::DIGEST_SHA_1,
+  size_t ret = talk_base::ComputeHmac(digest.get(),
                                       password.c_str(), password.size(),
-                                      temp_data.get(), mi_pos,
+                                      segments, ARRAY_SIZE(segments),
                                       hmac, sizeof(hmac));
   ASSERT(ret == sizeof(hmac));
   if (ret != sizeof(hmac))
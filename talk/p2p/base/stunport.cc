@@ -33,6 +33,7 @@
 #include "talk/base/nethelpers.h"
 #include "talk/p2p/base/common.h"
 #include "talk/p2p/base/stun.h"
+#include "talk/p2p/base/udpportmux.h"
 
 namespace cricket {
 
@@ -51,6 +52,9 @@ class StunBindingRequest : public StunRequest {
   }
 
   virtual ~StunBindingRequest() {
+    if (port_->mux_) {
+      port_->mux_->RemoveStunRequest(id());
+    }
   }
 
   const talk_base::SocketAddress& server_addr() const { return server_addr_; }
@@ -135,7 +139,8 @@ UDPPort::UDPPort(talk_base::Thread* thread,
       error_(0),
       resolver_(NULL),
       ready_(false),
-      stun_keepalive_delay_(KEEPALIVE_DELAY) {
+      stun_keepalive_delay_(KEEPALIVE_DELAY),
+      mux_(NULL) {
 }
 
 UDPPort::UDPPort(talk_base::Thread* thread,
@@ -151,7 +156,8 @@ UDPPort::UDPPort(talk_base::Thread* thread,
       error_(0),
       resolver_(NULL),
       ready_(false),
-      stun_keepalive_delay_(KEEPALIVE_DELAY) {
+      stun_keepalive_delay_(KEEPALIVE_DELAY),
+      mux_(NULL) {
 }
 
 bool UDPPort::Init() {
@@ -171,6 +177,9 @@ bool UDPPort::Init() {
 }
 
 UDPPort::~UDPPort() {
+  if (mux_) {
+    mux_->RemovePort(this);
+  }
   if (resolver_) {
     resolver_->Destroy(false);
   }
@@ -342,6 +351,9 @@ void UDPPort::SetResult(bool success) {
 // TODO: merge this with SendTo above.
 void UDPPort::OnSendPacket(const void* data, size_t size, StunRequest* req) {
   StunBindingRequest* sreq = static_cast<StunBindingRequest*>(req);
+  if (mux_) {
+    mux_->AddStunRequest(this, req->id());
+  }
   if (socket_->SendTo(data, size, sreq->server_addr()) < 0)
     PLOG(LERROR, socket_->GetError()) << "sendto";
 }
@@ -42,6 +42,8 @@ class SignalThread;
 
 namespace cricket {
 
+class UDPPortMux;
+
 // Communicates using the address on the outside of a NAT.
 class UDPPort : public Port {
  public:
@@ -101,6 +103,12 @@ class UDPPort : public Port {
     return true;
   }
 
+  // Handles |data| if it is a response to one of this port's outstanding STUN
+  // requests, and returns whether it was.
+  bool HandleStunResponse(const char* data, size_t size) {
+    return requests_.CheckResponse(data, size);
+  }
+
   void set_stun_keepalive_delay(int delay) {
     stun_keepalive_delay_ = delay;
   }
@@ -158,8 +166,11 @@ class UDPPort : public Port {
   talk_base::AsyncResolver* resolver_;
   bool ready_;
   int stun_keepalive_delay_;
+  // Set while the port's packets come through a UDPPortMux.
+  UDPPortMux* mux_;
 
   friend class StunBindingRequest;
+  friend class UDPPortMux;
 };
 
 class StunPort : public UDPPort {
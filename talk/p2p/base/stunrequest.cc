@@ -60,7 +60,12 @@ void StunRequestManager::SendDelayed(StunRequest* request, int delay) {
   ASSERT(requests_.find(request->id()) == requests_.end());
   request->Construct();
   requests_[request->id()] = request;
-  thread_->PostDelayed(delay, request, MSG_STUN_SEND, NULL);
+  if (delay == 0) {
+    thread_->Post(request, MSG_STUN_SEND, NULL);
+  } else {
+    thread_->timer_wheel()->Schedule(&request->timer_, delay, request,
+                                     MSG_STUN_SEND);
+  }
 }
 
 void StunRequestManager::Remove(StunRequest* request) {
@@ -70,6 +75,8 @@ void StunRequestManager::Remove(StunRequest* request) {
     ASSERT(iter->second == request);
     requests_.erase(iter);
     thread_->Clear(request);
+    if (request->timer_.active())
+      thread_->timer_wheel()->Cancel(&request->timer_);
   }
 }
 
@@ -198,7 +205,8 @@ void StunRequest::OnMessage(talk_base::Message* pmsg) {
   manager_->SignalSendPacket(buf.Data(), buf.Length(), this);
 
   int delay = GetNextDelay();
-  manager_->thread_->PostDelayed(delay, this, MSG_STUN_SEND, NULL);
+  manager_->thread_->timer_wheel()->Schedule(&timer_, delay, this,
+                                             MSG_STUN_SEND);
 }
 
 uint32 StunRequest::Elapsed() const {
@@ -30,6 +30,7 @@
 
 #include "talk/base/sigslot.h"
 #include "talk/base/thread.h"
+#include "talk/base/timerwheel.h"
 #include "talk/p2p/base/stun.h"
 #include <map>
 #include <string>
@@ -124,6 +125,9 @@ private:
   StunRequestManager* manager_;
   StunMessage* msg_;
   uint32 tstamp_;
+  // Retransmissions run off the thread's timer wheel, since a busy process
+  // can have one pending per Connection.
+  talk_base::TimerWheel::Timer timer_;
 
   void set_manager(StunRequestManager* manager);
 
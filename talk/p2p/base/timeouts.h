@@ -70,6 +70,9 @@ enum BasicPortAllocatorTimeout {
     kAllocatorTimeoutAllocateDelay = 1000,//250
     //The ammount of time to spend on each step of the allocation sequence
     kAllocatorTimeoutAllocateStepDelay = 1000,
+    //The least amount of time between allocation phases, on any network, with
+    //PORTALLOCATOR_ENABLE_PARALLEL_PHASES
+    kAllocatorTimeoutPhasePacingDelay = 50,
 };
 } //namespace cricket
 #endif  // TALK_P2P_BASE_TIMEOUTS_H_
@@ -25,19 +25,26 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "talk/base/asyncudpsocket.h"
 #include "talk/base/basicpacketsocketfactory.h"
 #include "talk/base/buffer.h"
+#include "talk/base/bytebuffer.h"
+#include "talk/base/byteorder.h"
 #include "talk/base/logging.h"
 #include "talk/base/gunit.h"
 #include "talk/base/helpers.h"
 #include "talk/base/physicalsocketserver.h"
 #include "talk/base/scoped_ptr.h"
 #include "talk/base/socketaddress.h"
+#include "talk/base/testclient.h"
 #include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
 #include "talk/base/virtualsocketserver.h"
 #include "talk/p2p/base/constants.h"
+#include "talk/p2p/base/stun.h"
 #include "talk/p2p/base/testturnserver.h"
 #include "talk/p2p/base/turnport.h"
+#include "talk/p2p/base/turnserver.h"
 #include "talk/p2p/base/udpport.h"
 
 using talk_base::SocketAddress;
@@ -248,3 +255,133 @@ TEST_F(TurnPortTest, TestTurnSendData) {
     EXPECT_EQ(turn_packets_[i], udp_packets_[i]);
   }
 }
+
+// Measures ChannelData forwarding through the server in both directions
+// while it holds a population of other allocations, each with channels
+// bound to several peers, so that the per-packet lookups are exercised.
+TEST_F(TurnPortTest, TestChannelDataForwardingPerf) {
+  const int kNumAllocations = 100;
+  const int kNumPeers = 16;
+  const size_t kNumPackets = 5000;
+  const char kPayload[100] = { 0 };
+
+  CreateTurnPort(kTurnUdpIntAddr, kTurnUsername, kTurnPassword);
+  turn_port_->PrepareAddress();
+  ASSERT_TRUE_WAIT(turn_ready_, kTimeout);
+  CreateUdpPort();
+  udp_port_->PrepareAddress();
+  ASSERT_TRUE_WAIT(udp_ready_, kTimeout);
+
+  // Fill the server with other allocations and channels. The peers don't
+  // exist, but binding channels to them only needs the server to agree.
+  std::vector<TurnPort*> others;
+  cricket::RelayCredentials credentials(kTurnUsername, kTurnPassword);
+  for (int i = 0; i < kNumAllocations; ++i) {
+    TurnPort* port = TurnPort::Create(main_, &socket_factory_, &network_,
+                                      kLocalAddr1.ipaddr(), 0, 0,
+                                      kIceUfrag1, kIcePwd1,
+                                      kTurnUdpIntAddr, credentials);
+    port->PrepareAddress();
+    others.push_back(port);
+  }
+  for (int i = 0; i < kNumAllocations; ++i) {
+    ASSERT_TRUE_WAIT(!others[i]->Candidates().empty(), kTimeout);
+    for (int j = 0; j < kNumPeers; ++j) {
+      cricket::Candidate peer = udp_port_->Candidates()[0];
+      peer.set_address(SocketAddress("33.33.33.33", 1000 + j));
+      ASSERT_TRUE(others[i]->CreateConnection(peer, Port::ORIGIN_MESSAGE));
+      others[i]->SendTo(kPayload, sizeof(kPayload), peer.address(), true);
+    }
+  }
+
+  Connection* conn1 = turn_port_->CreateConnection(
+      udp_port_->Candidates()[0], Port::ORIGIN_MESSAGE);
+  Connection* conn2 = udp_port_->CreateConnection(
+      turn_port_->Candidates()[0], Port::ORIGIN_MESSAGE);
+  ASSERT_TRUE(conn1 != NULL);
+  ASSERT_TRUE(conn2 != NULL);
+  conn1->SignalReadPacket.connect(static_cast<TurnPortTest*>(this),
+                                  &TurnPortTest::OnTurnReadPacket);
+  conn2->SignalReadPacket.connect(static_cast<TurnPortTest*>(this),
+                                  &TurnPortTest::OnUdpReadPacket);
+  // The responses to the requests above are still being worked through, so
+  // allow extra time here.
+  conn1->Ping(0);
+  ASSERT_EQ_WAIT(Connection::STATE_WRITABLE, conn1->write_state(),
+                 kTimeout * 10);
+  conn2->Ping(0);
+  ASSERT_EQ_WAIT(Connection::STATE_WRITABLE, conn2->write_state(), kTimeout);
+
+  // The first packet requests the channel bind; give it time to complete,
+  // so that the timed packets all go as ChannelData.
+  conn1->Send(kPayload, sizeof(kPayload));
+  ASSERT_EQ_WAIT(1U, udp_packets_.size(), kTimeout);
+  main_->ProcessMessages(100);
+  udp_packets_.clear();
+
+  uint32 start = talk_base::Time();
+  for (size_t i = 0; i < kNumPackets; ++i) {
+    conn1->Send(kPayload, sizeof(kPayload));
+    conn2->Send(kPayload, sizeof(kPayload));
+    if (i % 100 == 0) {
+      main_->ProcessMessages(0);
+    }
+  }
+  EXPECT_EQ_WAIT(kNumPackets, udp_packets_.size(), kTimeout * 10);
+  EXPECT_EQ_WAIT(kNumPackets, turn_packets_.size(), kTimeout * 10);
+  uint32 elapsed = talk_base::TimeSince(start);
+  LOG(LS_INFO) << "Forwarded " << 2 * kNumPackets << " ChannelData packets"
+               << " with " << kNumAllocations << " other allocations in "
+               << elapsed << " ms ("
+               << elapsed * 1000 / (2 * kNumPackets) << " us/packet)";
+
+  for (size_t i = 0; i < others.size(); ++i) {
+    delete others[i];
+  }
+}
+
+// Start a sharded server and check that every shard binds the same port and
+// that binding requests from many source ports are all answered.
+TEST(ShardedTurnServerTest, TestShardsShareInternalAddress) {
+  const int kNumShards = 2;
+  const int kNumClients = 8;
+  talk_base::SocketServer* ss = talk_base::Thread::Current()->socketserver();
+
+  cricket::ShardedTurnServer server(kNumShards);
+  ASSERT_TRUE(server.Start(SocketAddress("127.0.0.1", 0),
+                           SocketAddress("127.0.0.1", 0)));
+  EXPECT_EQ(kNumShards, server.num_shards());
+  EXPECT_NE(0, server.internal_address().port());
+
+  cricket::StunMessage request;
+  request.SetType(cricket::STUN_BINDING_REQUEST);
+  request.SetTransactionID(
+      talk_base::CreateRandomString(cricket::kStunTransactionIdLength));
+  talk_base::ByteBuffer buf;
+  request.Write(&buf);
+  for (int i = 0; i < kNumClients; ++i) {
+    talk_base::TestClient client(talk_base::AsyncUDPSocket::Create(
+        ss, SocketAddress("127.0.0.1", 0)));
+    client.SendTo(buf.Data(), buf.Length(), server.internal_address());
+    talk_base::scoped_ptr<talk_base::TestClient::Packet> packet(
+        client.NextPacket());
+    ASSERT_TRUE(packet.get() != NULL);
+    EXPECT_EQ(cricket::STUN_BINDING_RESPONSE,
+              talk_base::GetBE16(packet->buf));
+  }
+
+  uint32 received = 0;
+  for (int i = 0; i < kNumShards; ++i) {
+    received += server.GetShardStats(i).packets_received;
+  }
+  EXPECT_EQ(static_cast<uint32>(kNumClients), received);
+  server.Stop();
+}
+
+// A shard that can't bind fails Start, and the server can still be torn down.
+TEST(ShardedTurnServerTest, TestStartFailure) {
+  cricket::ShardedTurnServer server(2);
+  // TEST-NET-1 is never assigned to a local interface.
+  EXPECT_FALSE(server.Start(SocketAddress("192.0.2.1", 0),
+                            SocketAddress("192.0.2.1", 0)));
+}
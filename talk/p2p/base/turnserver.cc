@@ -28,6 +28,8 @@
 #include "talk/p2p/base/turnserver.h"
 
 #include "talk/base/asyncpacketsocket.h"
+#include "talk/base/asyncudpsocket.h"
+#include "talk/base/basicpacketsocketfactory.h"
 #include "talk/base/bytebuffer.h"
 #include "talk/base/helpers.h"
 #include "talk/base/logging.h"
@@ -35,6 +37,7 @@
 #include "talk/base/packetsocketfactory.h"
 #include "talk/base/stringencode.h"
 #include "talk/base/thread.h"
+#include "talk/base/timerwheel.h"
 #include "talk/p2p/base/common.h"
 #include "talk/p2p/base/stun.h"
 
@@ -47,12 +50,20 @@ static const int kDefaultAllocationTimeout = 10 * 60 * 1000;  // 10 minutes
 static const int kPermissionTimeout = 5 * 60 * 1000;          //  5 minutes
 static const int kChannelTimeout = 10 * 60 * 1000;            // 10 minutes
 
+// Permissions and channels expire on a coarse timer wheel; one revolution
+// covers the longest of these timeouts.
+static const int kTimerWheelTickMs = 1000;
+static const int kTimerWheelSlots = 1024;
+
 static const int kMinChannelNumber = 0x4000;
 static const int kMaxChannelNumber = 0x7FFF;
 
 static const size_t kNonceKeySize = 16;
 static const size_t kNonceSize = 40;
 
+// Number of datagrams read from the server socket per read event.
+static const int kServerRecvBatch = 16;
+
 static const size_t TURN_CHANNEL_HEADER_SIZE = 4U;
 
 inline bool IsTurnChannelData(uint16 msg_type) {
@@ -60,9 +71,19 @@ inline bool IsTurnChannelData(uint16 msg_type) {
   return ((msg_type & 0xC000) == 0x4000);
 }
 
+// Hashes IP addresses for the permission table.
+struct IPAddressHash {
+  size_t operator()(const talk_base::IPAddress& ip) const {
+    return talk_base::HashIP(ip);
+  }
+};
+
 // IDs used for posted messages.
 enum {
   MSG_TIMEOUT,
+  MSG_SHARD_START,
+  MSG_SHARD_STOP,
+  MSG_SHARD_STATS,
 };
 
 // Encapsulates a TURN allocation.
@@ -74,7 +95,8 @@ class TurnServer::Allocation : public talk_base::MessageHandler,
                                public sigslot::has_slots<> {
  public:
   Allocation(TurnServer* server_,
-             talk_base::Thread* thread, const Connection& conn,
+             talk_base::Thread* thread, talk_base::TimerWheel* timer_wheel,
+             const Connection& conn,
              talk_base::AsyncPacketSocket* server_socket,
              const std::string& key);
   virtual ~Allocation();
@@ -92,8 +114,12 @@ class TurnServer::Allocation : public talk_base::MessageHandler,
   sigslot::signal1<Allocation*> SignalDestroyed;
 
  private:
-  typedef std::list<Permission*> PermissionList;
-  typedef std::list<Channel*> ChannelList;
+  typedef talk_base::FlatHashMap<talk_base::IPAddress, Permission*,
+                                 IPAddressHash> PermissionMap;
+  typedef talk_base::FlatHashMap<int, Channel*,
+                                 talk_base::HashInt<int> > ChannelIdMap;
+  typedef talk_base::FlatHashMap<talk_base::SocketAddress, Channel*>
+      ChannelAddressMap;
 
   void HandleAllocateRequest(const TurnMessage* msg);
   void HandleRefreshRequest(const TurnMessage* msg);
@@ -125,13 +151,15 @@ class TurnServer::Allocation : public talk_base::MessageHandler,
 
   TurnServer* server_;
   talk_base::Thread* thread_;
+  talk_base::TimerWheel* timer_wheel_;
   Connection conn_;
   talk_base::scoped_ptr<talk_base::AsyncPacketSocket> external_socket_;
   std::string key_;
   std::string transaction_id_;
   std::string username_;
-  PermissionList perms_;
-  ChannelList channels_;
+  PermissionMap perms_;
+  ChannelIdMap channels_;
+  ChannelAddressMap channels_by_peer_;
 };
 
 // Encapsulates a TURN permission.
@@ -139,8 +167,8 @@ class TurnServer::Allocation : public talk_base::MessageHandler,
 // allocation, and self-deletes when its lifetime timer expires.
 class TurnServer::Permission : public talk_base::MessageHandler {
  public:
-  Permission(talk_base::Thread* thread, const talk_base::IPAddress& peer);
-  ~Permission();
+  Permission(talk_base::TimerWheel* timer_wheel,
+             const talk_base::IPAddress& peer);
 
   const talk_base::IPAddress& peer() const { return peer_; }
   void Refresh();
@@ -150,7 +178,8 @@ class TurnServer::Permission : public talk_base::MessageHandler {
  private:
   virtual void OnMessage(talk_base::Message* msg);
 
-  talk_base::Thread* thread_;
+  talk_base::TimerWheel* timer_wheel_;
+  talk_base::TimerWheel::Timer timer_;
   talk_base::IPAddress peer_;
 };
 
@@ -159,9 +188,8 @@ class TurnServer::Permission : public talk_base::MessageHandler {
 // allocation, and self-deletes when its lifetime timer expires.
 class TurnServer::Channel : public talk_base::MessageHandler {
  public:
-  Channel(talk_base::Thread* thread, int id,
-                     const talk_base::SocketAddress& peer);
-  ~Channel();
+  Channel(talk_base::TimerWheel* timer_wheel, int id,
+          const talk_base::SocketAddress& peer);
 
   int id() const { return id_; }
   const talk_base::SocketAddress& peer() const { return peer_; }
@@ -172,7 +200,8 @@ class TurnServer::Channel : public talk_base::MessageHandler {
  private:
   virtual void OnMessage(talk_base::Message* msg);
 
-  talk_base::Thread* thread_;
+  talk_base::TimerWheel* timer_wheel_;
+  talk_base::TimerWheel::Timer timer_;
   int id_;
   talk_base::SocketAddress peer_;
 };
@@ -201,11 +230,15 @@ static bool InitErrorResponse(const StunMessage* req, int code,
 TurnServer::TurnServer(talk_base::Thread* thread)
     : thread_(thread),
       nonce_key_(talk_base::CreateRandomString(kNonceKeySize)),
-      auth_hook_(NULL) {
+      auth_hook_(NULL),
+      timer_wheel_(new talk_base::TimerWheel(thread, kTimerWheelTickMs,
+                                             kTimerWheelSlots)),
+      packets_received_(0),
+      packets_sent_(0) {
 }
 
 TurnServer::~TurnServer() {
-  for (AllocationMap::iterator it = allocations_.begin();
+  for (AllocationMap::const_iterator it = allocations_.begin();
        it != allocations_.end(); ++it) {
     delete it->second;
   }
@@ -214,6 +247,8 @@ TurnServer::~TurnServer() {
 void TurnServer::AddInternalServerSocket(talk_base::AsyncPacketSocket* socket) {
   ASSERT(server_socket_ == NULL);
   server_socket_.reset(socket);
+  // Drain several datagrams per wakeup; this fails harmlessly on TCP sockets.
+  socket->SetOption(talk_base::Socket::OPT_RECV_BATCH, kServerRecvBatch);
   socket->SignalReadPacket.connect(this, &TurnServer::OnInternalPacket);
 }
 
@@ -232,6 +267,7 @@ void TurnServer::OnInternalPacket(talk_base::AsyncPacketSocket* socket,
    return;
   }
 
+  ++packets_received_;
   Connection conn(addr, socket->GetLocalAddress(), TURNPROTO_UDP);
   uint16 msg_type = talk_base::GetBE16(data);
   if (!IsTurnChannelData(msg_type)) {
@@ -441,8 +477,8 @@ bool TurnServer::ValidateNonce(const std::string& nonce) const {
 }
 
 TurnServer::Allocation* TurnServer::FindAllocation(const Connection& conn) {
-  AllocationMap::const_iterator it = allocations_.find(conn);
-  return (it != allocations_.end()) ? it->second : NULL;
+  Allocation** allocation = allocations_.Find(conn);
+  return allocation ? *allocation : NULL;
 }
 
 TurnServer::Allocation* TurnServer::CreateAllocation(const Connection& conn,
@@ -456,9 +492,9 @@ TurnServer::Allocation* TurnServer::CreateAllocation(const Connection& conn,
 
   // The Allocation takes ownership of the socket.
   Allocation* allocation = new Allocation(this,
-      thread_, conn, external_socket, key);
+      thread_, timer_wheel_.get(), conn, external_socket, key);
   allocation->SignalDestroyed.connect(this, &TurnServer::OnAllocationDestroyed);
-  allocations_[conn] = allocation;
+  allocations_.Insert(conn, allocation);
   return allocation;
 }
 
@@ -499,13 +535,12 @@ void TurnServer::SendStun(const Connection& conn, StunMessage* msg) {
 void TurnServer::Send(const Connection& conn,
                       const talk_base::ByteBuffer& buf) {
   // TODO(juberti): Pick which socket to send on, once we have TCP support.
+  ++packets_sent_;
   server_socket_->SendTo(buf.Data(), buf.Length(), conn.src());
 }
 
 void TurnServer::OnAllocationDestroyed(Allocation* allocation) {
-  AllocationMap::iterator it = allocations_.find(allocation->conn());
-  if (it != allocations_.end())
-    allocations_.erase(it);
+  allocations_.Erase(allocation->conn());
 }
 
 TurnServer::Connection::Connection(const talk_base::SocketAddress& src,
@@ -518,8 +553,8 @@ bool TurnServer::Connection::operator==(const Connection& c) const {
   return src_ == c.src_ && dst_ == c.dst_ && proto_ == c.proto_;
 }
 
-bool TurnServer::Connection::operator<(const Connection& c) const {
-  return src_ < c.src_ || dst_ < c.dst_ || proto_ < c.proto_;
+size_t TurnServer::Connection::Hash() const {
+  return src_.Hash() ^ (dst_.Hash() * 31) ^ proto_;
 }
 
 std::string TurnServer::Connection::ToString() const {
@@ -533,11 +568,13 @@ std::string TurnServer::Connection::ToString() const {
 
 TurnServer::Allocation::Allocation(TurnServer* server,
                                    talk_base::Thread* thread,
+                                   talk_base::TimerWheel* timer_wheel,
                                    const Connection& conn,
                                    talk_base::AsyncPacketSocket* socket,
                                    const std::string& key)
     : server_(server),
       thread_(thread),
+      timer_wheel_(timer_wheel),
       conn_(conn),
       external_socket_(socket),
       key_(key) {
@@ -546,13 +583,13 @@ TurnServer::Allocation::Allocation(TurnServer* server,
 }
 
 TurnServer::Allocation::~Allocation() {
-  for (ChannelList::iterator it = channels_.begin();
+  for (ChannelIdMap::const_iterator it = channels_.begin();
        it != channels_.end(); ++it) {
-    delete *it;
+    delete it->second;
   }
-  for (PermissionList::iterator it = perms_.begin();
+  for (PermissionMap::const_iterator it = perms_.begin();
        it != perms_.end(); ++it) {
-    delete *it;
+    delete it->second;
   }
   thread_->Clear(this, MSG_TIMEOUT);
   LOG_J(LS_INFO, this) << "Allocation destroyed";
@@ -713,10 +750,11 @@ void TurnServer::Allocation::HandleChannelBindRequest(const TurnMessage* msg) {
 
   // Add or refresh this channel.
   if (!channel1) {
-    channel1 = new Channel(thread_, channel_id, peer_attr->GetAddress());
+    channel1 = new Channel(timer_wheel_, channel_id, peer_attr->GetAddress());
     channel1->SignalDestroyed.connect(this,
         &TurnServer::Allocation::OnChannelDestroyed);
-    channels_.push_back(channel1);
+    channels_.Insert(channel_id, channel1);
+    channels_by_peer_.Insert(channel1->peer(), channel1);
   } else {
     channel1->Refresh();
   }
@@ -794,7 +832,10 @@ bool TurnServer::Allocation::HasPermission(const talk_base::IPAddress& addr) {
 void TurnServer::Allocation::AddPermission(const talk_base::IPAddress& addr) {
   Permission* perm = FindPermission(addr);
   if (!perm) {
-    perms_.push_back(new Permission(thread_, addr));
+    perm = new Permission(timer_wheel_, addr);
+    perm->SignalDestroyed.connect(this,
+        &TurnServer::Allocation::OnPermissionDestroyed);
+    perms_.Insert(addr, perm);
   } else {
     perm->Refresh();
   }
@@ -802,31 +843,19 @@ void TurnServer::Allocation::AddPermission(const talk_base::IPAddress& addr) {
 
 TurnServer::Permission* TurnServer::Allocation::FindPermission(
     const talk_base::IPAddress& addr) const {
-  for (PermissionList::const_iterator it = perms_.begin();
-       it != perms_.end(); ++it) {
-    if ((*it)->peer() == addr)
-      return *it;
-  }
-  return NULL;
+  Permission* const* perm = perms_.Find(addr);
+  return perm ? *perm : NULL;
 }
 
 TurnServer::Channel* TurnServer::Allocation::FindChannel(int channel_id) const {
-  for (ChannelList::const_iterator it = channels_.begin();
-       it != channels_.end(); ++it) {
-    if ((*it)->id() == channel_id)
-      return *it;
-  }
-  return NULL;
+  Channel* const* channel = channels_.Find(channel_id);
+  return channel ? *channel : NULL;
 }
 
 TurnServer::Channel* TurnServer::Allocation::FindChannel(
     const talk_base::SocketAddress& addr) const {
-  for (ChannelList::const_iterator it = channels_.begin();
-       it != channels_.end(); ++it) {
-    if ((*it)->peer() == addr)
-      return *it;
-  }
-  return NULL;
+  Channel* const* channel = channels_by_peer_.Find(addr);
+  return channel ? *channel : NULL;
 }
 
 void TurnServer::Allocation::SendResponse(TurnMessage* msg) {
@@ -856,31 +885,22 @@ void TurnServer::Allocation::OnMessage(talk_base::Message* msg) {
 }
 
 void TurnServer::Allocation::OnPermissionDestroyed(Permission* perm) {
-  PermissionList::iterator it = std::find(perms_.begin(), perms_.end(), perm);
-  ASSERT(it != perms_.end());
-  perms_.erase(it);
+  VERIFY(perms_.Erase(perm->peer()));
 }
 
 void TurnServer::Allocation::OnChannelDestroyed(Channel* channel) {
-  ChannelList::iterator it =
-      std::find(channels_.begin(), channels_.end(), channel);
-  ASSERT(it != channels_.end());
-  channels_.erase(it);
+  VERIFY(channels_.Erase(channel->id()));
+  VERIFY(channels_by_peer_.Erase(channel->peer()));
 }
 
-TurnServer::Permission::Permission(talk_base::Thread* thread,
+TurnServer::Permission::Permission(talk_base::TimerWheel* timer_wheel,
                                    const talk_base::IPAddress& peer)
-    : thread_(thread), peer_(peer) {
+    : timer_wheel_(timer_wheel), peer_(peer) {
   Refresh();
 }
 
-TurnServer::Permission::~Permission() {
-  thread_->Clear(this, MSG_TIMEOUT);
-}
-
 void TurnServer::Permission::Refresh() {
-  thread_->Clear(this, MSG_TIMEOUT);
-  thread_->PostDelayed(kPermissionTimeout, this, MSG_TIMEOUT);
+  timer_wheel_->Schedule(&timer_, kPermissionTimeout, this, MSG_TIMEOUT);
 }
 
 void TurnServer::Permission::OnMessage(talk_base::Message* msg) {
@@ -889,19 +909,14 @@ void TurnServer::Permission::OnMessage(talk_base::Message* msg) {
   delete this;
 }
 
-TurnServer::Channel::Channel(talk_base::Thread* thread, int id,
+TurnServer::Channel::Channel(talk_base::TimerWheel* timer_wheel, int id,
                              const talk_base::SocketAddress& peer)
-    : thread_(thread), id_(id), peer_(peer) {
+    : timer_wheel_(timer_wheel), id_(id), peer_(peer) {
   Refresh();
 }
 
-TurnServer::Channel::~Channel() {
-  thread_->Clear(this, MSG_TIMEOUT);
-}
-
 void TurnServer::Channel::Refresh() {
-  thread_->Clear(this, MSG_TIMEOUT);
-  thread_->PostDelayed(kChannelTimeout, this, MSG_TIMEOUT);
+  timer_wheel_->Schedule(&timer_, kChannelTimeout, this, MSG_TIMEOUT);
 }
 
 void TurnServer::Channel::OnMessage(talk_base::Message* msg) {
@@ -910,4 +925,148 @@ void TurnServer::Channel::OnMessage(talk_base::Message* msg) {
   delete this;
 }
 
+// One worker of a ShardedTurnServer. The TurnServer and all of its sockets
+// are created, used and destroyed on the shard's own thread; the owner only
+// talks to it through synchronous Sends.
+class ShardedTurnServer::Shard : public talk_base::MessageHandler {
+ public:
+  Shard(ShardedTurnServer* owner, int index)
+      : owner_(owner), index_(index) {
+  }
+  virtual ~Shard() {
+    Stop();
+  }
+
+  // Binds this shard to |int_addr|. On success, |int_addr| is updated with
+  // the actual bound address.
+  bool Start(talk_base::SocketAddress* int_addr,
+             const talk_base::SocketAddress& ext_addr) {
+    int_addr_ = *int_addr;
+    ext_addr_ = ext_addr;
+    std::ostringstream name;
+    name << "TurnShard" << index_;
+    thread_.SetName(name.str(), this);
+    if (!thread_.Start()) {
+      return false;
+    }
+    thread_.Send(this, MSG_SHARD_START);
+    if (!server_) {
+      return false;
+    }
+    *int_addr = int_addr_;
+    return true;
+  }
+
+  void Stop() {
+    if (thread_.started()) {
+      thread_.Send(this, MSG_SHARD_STOP);
+      thread_.Stop();
+    }
+  }
+
+  ShardStats GetStats() {
+    thread_.Send(this, MSG_SHARD_STATS);
+    return stats_;
+  }
+
+ private:
+  virtual void OnMessage(talk_base::Message* msg) {
+    switch (msg->message_id) {
+      case MSG_SHARD_START:
+        OnStart();
+        break;
+      case MSG_SHARD_STOP:
+        server_.reset();
+        break;
+      case MSG_SHARD_STATS:
+        stats_ = ShardStats();
+        if (server_) {
+          stats_.packets_received = server_->packets_received();
+          stats_.packets_sent = server_->packets_sent();
+          stats_.allocations = server_->num_allocations();
+        }
+        break;
+      default:
+        ASSERT(false);
+    }
+  }
+
+  void OnStart() {
+    talk_base::AsyncSocket* socket = thread_.socketserver()->CreateAsyncSocket(
+        int_addr_.family(), SOCK_DGRAM);
+    if (!socket) {
+      return;
+    }
+    if (socket->SetOption(talk_base::Socket::OPT_REUSEPORT, 1) != 0) {
+      LOG(LS_ERROR) << "Shard " << index_ << " can't set SO_REUSEPORT";
+      delete socket;
+      return;
+    }
+    talk_base::AsyncUDPSocket* int_socket =
+        talk_base::AsyncUDPSocket::Create(socket, int_addr_);
+    if (!int_socket) {
+      LOG(LS_ERROR) << "Shard " << index_ << " failed to bind to "
+                    << int_addr_.ToString();
+      return;
+    }
+    int_addr_ = int_socket->GetLocalAddress();
+
+    server_.reset(new TurnServer(&thread_));
+    server_->set_realm(owner_->realm_);
+    server_->set_software(owner_->software_);
+    server_->set_auth_hook(owner_->auth_hook_);
+    server_->AddInternalServerSocket(int_socket);
+    server_->SetExternalSocketFactory(
+        new talk_base::BasicPacketSocketFactory(&thread_), ext_addr_);
+  }
+
+  ShardedTurnServer* owner_;
+  int index_;
+  talk_base::Thread thread_;
+  talk_base::scoped_ptr<TurnServer> server_;
+  talk_base::SocketAddress int_addr_;
+  talk_base::SocketAddress ext_addr_;
+  ShardStats stats_;
+};
+
+ShardedTurnServer::ShardedTurnServer(int num_shards)
+    : auth_hook_(NULL) {
+  ASSERT(num_shards > 0);
+  for (int i = 0; i < num_shards; ++i) {
+    shards_.push_back(new Shard(this, i));
+  }
+}
+
+ShardedTurnServer::~ShardedTurnServer() {
+  Stop();
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    delete shards_[i];
+  }
+}
+
+bool ShardedTurnServer::Start(const talk_base::SocketAddress& int_addr,
+                              const talk_base::SocketAddress& ext_addr) {
+  int_addr_ = int_addr;
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    if (!shards_[i]->Start(&int_addr_, ext_addr)) {
+      Stop();
+      return false;
+    }
+  }
+  LOG(LS_INFO) << "Started " << shards_.size() << " TURN shards on "
+               << int_addr_.ToString();
+  return true;
+}
+
+void ShardedTurnServer::Stop() {
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    shards_[i]->Stop();
+  }
+}
+
+ShardedTurnServer::ShardStats ShardedTurnServer::GetShardStats(int index) {
+  ASSERT(index >= 0 && index < num_shards());
+  return shards_[index]->GetStats();
+}
+
 }  // namespace cricket
@@ -28,12 +28,12 @@
 #ifndef TALK_P2P_BASE_TURNSERVER_H_
 #define TALK_P2P_BASE_TURNSERVER_H_
 
-#include <list>
-#include <map>
-#include <set>
 #include <string>
+#include <vector>
 
+#include "talk/base/flathashmap.h"
 #include "talk/base/messagequeue.h"
+#include "talk/base/scoped_ptr.h"
 #include "talk/base/sigslot.h"
 #include "talk/base/socketaddress.h"
 
@@ -42,6 +42,7 @@ class AsyncPacketSocket;
 class ByteBuffer;
 class PacketSocketFactory;
 class Thread;
+class TimerWheel;
 }
 
 namespace cricket {
@@ -88,6 +89,11 @@ class TurnServer : public sigslot::has_slots<> {
   void SetExternalSocketFactory(talk_base::PacketSocketFactory* factory,
                                 const talk_base::SocketAddress& address);
 
+  // Counters for the internal socket; must be read on the server's thread.
+  uint32 packets_received() const { return packets_received_; }
+  uint32 packets_sent() const { return packets_sent_; }
+  size_t num_allocations() const { return allocations_.size(); }
+
  private:
   // The protocol used by the client to connect to the server.
   enum ProtocolType {
@@ -105,7 +111,7 @@ class TurnServer : public sigslot::has_slots<> {
     const talk_base::SocketAddress& src() const { return src_; }
     const talk_base::SocketAddress& dst() const { return dst_; }
     bool operator==(const Connection& t) const;
-    bool operator<(const Connection& t) const;
+    size_t Hash() const;
     std::string ToString() const;
 
    private:
@@ -116,7 +122,7 @@ class TurnServer : public sigslot::has_slots<> {
   class Allocation;
   class Permission;
   class Channel;
-  typedef std::map<Connection, Allocation*> AllocationMap;
+  typedef talk_base::FlatHashMap<Connection, Allocation*> AllocationMap;
 
   void OnInternalPacket(talk_base::AsyncPacketSocket* socket, const char* data,
                         size_t size, const talk_base::SocketAddress& address);
@@ -156,6 +162,62 @@ class TurnServer : public sigslot::has_slots<> {
       external_socket_factory_;
   talk_base::SocketAddress external_addr_;
   AllocationMap allocations_;
+  // Drives permission and channel expiry for all allocations.
+  talk_base::scoped_ptr<talk_base::TimerWheel> timer_wheel_;
+  uint32 packets_received_;
+  uint32 packets_sent_;
+};
+
+// Runs one TurnServer per worker thread, so that relaying can use more than
+// one core. Each shard binds its own SO_REUSEPORT socket to the shared
+// internal address and keeps a private allocation table. The kernel picks the
+// receiving socket by hashing the client's 5-tuple, so all packets of an
+// allocation reach the same shard; that shard also creates the allocation's
+// relayed socket on its own thread, so peer traffic stays there as well.
+// Only UDP is supported, as with TurnServer itself.
+class ShardedTurnServer {
+ public:
+  struct ShardStats {
+    ShardStats() : packets_received(0), packets_sent(0), allocations(0) {}
+    uint32 packets_received;
+    uint32 packets_sent;
+    size_t allocations;
+  };
+
+  explicit ShardedTurnServer(int num_shards);
+  ~ShardedTurnServer();
+
+  // These must be set before Start(). The auth hook is called concurrently
+  // from all shards, so it must be thread-safe; it is not owned.
+  void set_realm(const std::string& realm) { realm_ = realm; }
+  void set_software(const std::string& software) { software_ = software; }
+  void set_auth_hook(TurnAuthInterface* auth_hook) { auth_hook_ = auth_hook; }
+
+  // Starts the worker threads and binds every shard to |int_addr|. If the
+  // port of |int_addr| is 0, the port picked by the first shard is shared by
+  // the others. Returns false if any shard fails to bind, e.g. because the
+  // platform lacks SO_REUSEPORT.
+  bool Start(const talk_base::SocketAddress& int_addr,
+             const talk_base::SocketAddress& ext_addr);
+  // Destroys all allocations and joins the worker threads.
+  void Stop();
+
+  int num_shards() const { return static_cast<int>(shards_.size()); }
+  // The address all shards are listening on; valid after Start().
+  const talk_base::SocketAddress& internal_address() const {
+    return int_addr_;
+  }
+  // Fetches the counters of shard |index| from its thread.
+  ShardStats GetShardStats(int index);
+
+ private:
+  class Shard;
+
+  std::vector<Shard*> shards_;
+  std::string realm_;
+  std::string software_;
+  TurnAuthInterface* auth_hook_;
+  talk_base::SocketAddress int_addr_;
 };
 
 }  // namespace cricket
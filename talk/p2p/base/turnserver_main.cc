@@ -25,17 +25,27 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cstdlib>
 #include <iostream>  // NOLINT
+#include <vector>
 
 #include "talk/base/asyncudpsocket.h"
 #include "talk/base/basicpacketsocketfactory.h"
+#include "talk/base/bytebuffer.h"
+#include "talk/base/helpers.h"
 #include "talk/base/optionsfile.h"
 #include "talk/base/thread.h"
 #include "talk/base/stringencode.h"
+#include "talk/base/timeutils.h"
+#include "talk/p2p/base/stun.h"
 #include "talk/p2p/base/turnserver.h"
 
 static const char kSoftware[] = "libjingle TurnServer";
 
+// Load test parameters.
+static const int kLoadWindow = 8;         // requests in flight per socket
+static const int kLoadCheckInterval = 50;  // ms between loss checks
+
 class TurnFileAuth : public cricket::TurnAuthInterface {
  public:
   explicit TurnFileAuth(const std::string& path) : file_(path) {}
@@ -56,10 +66,189 @@ class TurnFileAuth : public cricket::TurnAuthInterface {
   talk_base::OptionsFile file_;
 };
 
+// Drives a server with STUN binding requests from a set of UDP sockets on its
+// own thread. Each socket keeps kLoadWindow requests in flight and sends a new
+// one for every response, so the offered load follows what the server can
+// handle. Distinct source ports spread the sockets over the server's shards.
+class LoadClient : public talk_base::MessageHandler,
+                   public sigslot::has_slots<> {
+ public:
+  LoadClient(const talk_base::SocketAddress& server, int num_sockets)
+      : server_(server), num_sockets_(num_sockets), received_(0) {
+    cricket::StunMessage request;
+    request.SetType(cricket::STUN_BINDING_REQUEST);
+    request.SetTransactionID(
+        talk_base::CreateRandomString(cricket::kStunTransactionIdLength));
+    request.Write(&request_);
+  }
+  virtual ~LoadClient() {
+    thread_.Stop();
+    for (size_t i = 0; i < sockets_.size(); ++i) {
+      delete sockets_[i];
+    }
+  }
+
+  bool Start() {
+    if (!thread_.Start()) {
+      return false;
+    }
+    thread_.Send(this, MSG_START);
+    return static_cast<int>(sockets_.size()) == num_sockets_;
+  }
+  void Stop() {
+    thread_.Send(this, MSG_STOP);
+  }
+  uint32 received() {
+    thread_.Send(this, MSG_NOP);
+    return received_;
+  }
+
+ private:
+  enum { MSG_START, MSG_STOP, MSG_CHECK, MSG_NOP };
+
+  virtual void OnMessage(talk_base::Message* msg) {
+    if (msg->message_id == MSG_START) {
+      talk_base::SocketAddress local(server_.ipaddr(), 0);
+      for (int i = 0; i < num_sockets_; ++i) {
+        talk_base::AsyncUDPSocket* socket = talk_base::AsyncUDPSocket::Create(
+            thread_.socketserver(), local);
+        if (!socket) {
+          return;
+        }
+        socket->SignalReadPacket.connect(this, &LoadClient::OnReadPacket);
+        sockets_.push_back(socket);
+        last_received_.push_back(0);
+        socket_received_.push_back(0);
+      }
+      thread_.PostDelayed(kLoadCheckInterval, this, MSG_CHECK);
+    } else if (msg->message_id == MSG_STOP) {
+      thread_.Clear(this);
+      for (size_t i = 0; i < sockets_.size(); ++i) {
+        sockets_[i]->SignalReadPacket.disconnect(this);
+      }
+    } else if (msg->message_id == MSG_CHECK) {
+      // Refill the window of any socket that has stalled due to packet loss.
+      for (size_t i = 0; i < sockets_.size(); ++i) {
+        if (socket_received_[i] == last_received_[i]) {
+          for (int j = 0; j < kLoadWindow; ++j) {
+            SendRequest(sockets_[i]);
+          }
+        }
+        last_received_[i] = socket_received_[i];
+      }
+      thread_.PostDelayed(kLoadCheckInterval, this, MSG_CHECK);
+    }
+  }
+
+  void OnReadPacket(talk_base::AsyncPacketSocket* socket, const char* data,
+                    size_t size, const talk_base::SocketAddress& addr) {
+    ++received_;
+    for (size_t i = 0; i < sockets_.size(); ++i) {
+      if (sockets_[i] == socket) {
+        ++socket_received_[i];
+        break;
+      }
+    }
+    SendRequest(socket);
+  }
+
+  void SendRequest(talk_base::AsyncPacketSocket* socket) {
+    socket->SendTo(request_.Data(), request_.Length(), server_);
+  }
+
+  talk_base::Thread thread_;
+  talk_base::SocketAddress server_;
+  int num_sockets_;
+  talk_base::ByteBuffer request_;
+  std::vector<talk_base::AsyncPacketSocket*> sockets_;
+  std::vector<uint32> socket_received_;
+  std::vector<uint32> last_received_;
+  uint32 received_;
+};
+
+// Deletes the clients, joining their threads, and empties |clients|.
+static void DeleteLoadClients(std::vector<LoadClient*>* clients) {
+  for (size_t i = 0; i < clients->size(); ++i) {
+    delete (*clients)[i];
+  }
+  clients->clear();
+}
+
+// Runs a sharded server on |addr| against in-process load clients and prints
+// the packets handled per second by each shard. Run with one shard per core
+// to get the per-core figure.
+static int RunLoadTest(const talk_base::SocketAddress& addr, int num_shards,
+                       int seconds, int num_sockets) {
+  cricket::ShardedTurnServer server(num_shards);
+  server.set_software(kSoftware);
+  if (!server.Start(addr, talk_base::SocketAddress(addr.ipaddr(), 0))) {
+    std::cerr << "Failed to start " << num_shards << " shards at "
+              << addr.ToString() << std::endl;
+    return 1;
+  }
+
+  std::vector<LoadClient*> clients;
+  for (int i = 0; i < num_shards; ++i) {
+    clients.push_back(new LoadClient(server.internal_address(),
+        (num_sockets + num_shards - 1) / num_shards));
+    if (!clients.back()->Start()) {
+      std::cerr << "Failed to create load client sockets" << std::endl;
+      DeleteLoadClients(&clients);
+      return 1;
+    }
+  }
+
+  std::vector<cricket::ShardedTurnServer::ShardStats> start;
+  for (int i = 0; i < num_shards; ++i) {
+    start.push_back(server.GetShardStats(i));
+  }
+  uint32 start_time = talk_base::Time();
+  talk_base::Thread::Current()->SleepMs(seconds * 1000);
+  uint32 elapsed = talk_base::TimeSince(start_time);
+
+  uint32 total = 0;
+  for (int i = 0; i < num_shards; ++i) {
+    cricket::ShardedTurnServer::ShardStats stats = server.GetShardStats(i);
+    uint32 packets = (stats.packets_received - start[i].packets_received) +
+                     (stats.packets_sent - start[i].packets_sent);
+    total += packets;
+    std::cout << "shard " << i << ": "
+              << static_cast<uint64>(packets) * 1000 / elapsed
+              << " packets/sec" << std::endl;
+  }
+  std::cout << "total: " << static_cast<uint64>(total) * 1000 / elapsed
+            << " packets/sec, "
+            << static_cast<uint64>(total) * 1000 / elapsed / num_shards
+            << " per shard" << std::endl;
+
+  for (size_t i = 0; i < clients.size(); ++i) {
+    clients[i]->Stop();
+  }
+  DeleteLoadClients(&clients);
+  return 0;
+}
+
 int main(int argc, char **argv) {
-  if (argc != 5) {
-    std::cerr << "usage: turnserver int-addr ext-ip realm auth-file"
-              << std::endl;
+  if (argc == 6 && std::string(argv[1]) == "--load-test") {
+    talk_base::SocketAddress addr;
+    if (!addr.FromString(argv[2])) {
+      std::cerr << "Unable to parse IP address: " << argv[2] << std::endl;
+      return 1;
+    }
+    int shards = atoi(argv[3]), seconds = atoi(argv[4]);
+    int sockets = atoi(argv[5]);
+    if (shards <= 0 || seconds <= 0 || sockets <= 0) {
+      std::cerr << "Invalid load test parameters" << std::endl;
+      return 1;
+    }
+    return RunLoadTest(addr, shards, seconds, sockets);
+  }
+
+  if (argc != 5 && argc != 6) {
+    std::cerr << "usage: turnserver int-addr ext-ip realm auth-file [shards]"
+              << std::endl
+              << "       turnserver --load-test int-addr shards seconds "
+              << "sockets" << std::endl;
     return 1;
   }
 
@@ -75,7 +264,31 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  int shards = (argc == 6) ? atoi(argv[5]) : 1;
+  if (shards <= 0) {
+    std::cerr << "Invalid shard count: " << argv[5] << std::endl;
+    return 1;
+  }
+
   talk_base::Thread* main = talk_base::Thread::Current();
+  TurnFileAuth auth(argv[4]);
+  if (shards > 1) {
+    // Each shard runs on its own thread; the main thread just idles.
+    cricket::ShardedTurnServer server(shards);
+    server.set_realm(argv[3]);
+    server.set_software(kSoftware);
+    server.set_auth_hook(&auth);
+    if (!server.Start(int_addr, talk_base::SocketAddress(ext_addr, 0))) {
+      std::cerr << "Failed to start " << shards << " shards at "
+                << int_addr.ToString() << std::endl;
+      return 1;
+    }
+    std::cout << "Listening internally at " << int_addr.ToString()
+              << " with " << shards << " shards" << std::endl;
+    main->Run();
+    return 0;
+  }
+
   talk_base::AsyncUDPSocket* int_socket =
       talk_base::AsyncUDPSocket::Create(main->socketserver(), int_addr);
   if (!int_socket) {
@@ -85,7 +298,6 @@ int main(int argc, char **argv) {
   }
 
   cricket::TurnServer server(main);
-  TurnFileAuth auth(argv[4]);
   server.set_realm(argv[3]);
   server.set_software(kSoftware);
   server.set_auth_hook(&auth);
@@ -0,0 +1,231 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/p2p/base/udpportmux.h"
+
+#include <algorithm>
+
+#include "talk/base/bytebuffer.h"
+#include "talk/base/byteorder.h"
+#include "talk/base/common.h"
+#include "talk/base/logging.h"
+#include "talk/p2p/base/common.h"
+#include "talk/p2p/base/stun.h"
+#include "talk/p2p/base/stunport.h"
+
+namespace cricket {
+
+static std::string UfragKey(const std::string& ufrag) {
+  return ufrag.substr(0, ufrag.size() - 1);
+}
+
+UDPPortMux::UDPPortMux(talk_base::AsyncPacketSocket* socket)
+    : socket_(socket) {
+  socket_->SignalReadPacket.connect(this, &UDPPortMux::OnReadPacket);
+}
+
+UDPPortMux::~UDPPortMux() {
+  for (size_t i = 0; i < ports_.size(); ++i) {
+    ports_[i]->mux_ = NULL;
+  }
+}
+
+bool UDPPortMux::AddPort(UDPPort* port) {
+  ASSERT(port->SharedSocket());
+  ASSERT(port->mux_ == NULL);
+  const std::string ufrag = port->username_fragment();
+  if (ufrag.empty() || ufrags_.find(UfragKey(ufrag)) != ufrags_.end()) {
+    LOG_J(LS_WARNING, port) << "Can't share a socket with another port "
+                            << "that has a similar username fragment";
+    return false;
+  }
+  ufrags_[UfragKey(ufrag)] = port;
+  ufrag_lengths_.insert(ufrag.size());
+  ports_.push_back(port);
+  port->mux_ = this;
+  port->SignalConnectionCreated.connect(this,
+                                        &UDPPortMux::OnConnectionCreated);
+  return true;
+}
+
+void UDPPortMux::RemovePort(UDPPort* port) {
+  std::vector<UDPPort*>::iterator it =
+      std::find(ports_.begin(), ports_.end(), port);
+  if (it == ports_.end()) {
+    return;
+  }
+  ports_.erase(it);
+  for (RequestMap::iterator request = requests_.begin();
+       request != requests_.end(); ) {
+    if (request->second == port) {
+      requests_.erase(request++);
+    } else {
+      ++request;
+    }
+  }
+  UfragMap::iterator ufrag = ufrags_.find(UfragKey(port->username_fragment()));
+  if (ufrag != ufrags_.end() && ufrag->second == port) {
+    ufrags_.erase(ufrag);
+  }
+  // A port deletes the connections it still has without signaling, so forget
+  // them here.
+  const Port::AddressMap& connections = port->connections();
+  for (Port::AddressMap::const_iterator iter = connections.begin();
+       iter != connections.end(); ++iter) {
+    iter->second->SignalDestroyed.disconnect(this);
+    RemoveConnection(iter->second);
+  }
+  port->SignalConnectionCreated.disconnect(this);
+  port->mux_ = NULL;
+}
+
+void UDPPortMux::AddStunRequest(UDPPort* port, const std::string& id) {
+  requests_[id] = port;
+}
+
+void UDPPortMux::RemoveStunRequest(const std::string& id) {
+  requests_.erase(id);
+}
+
+void UDPPortMux::OnReadPacket(talk_base::AsyncPacketSocket* socket,
+                              const char* data, size_t size,
+                              const talk_base::SocketAddress& remote_addr) {
+  ASSERT(socket == socket_.get());
+  // A binding request goes to the port whose username fragment it carries,
+  // even if a connection on another port has the same remote address. That
+  // port hands it to its own connection, or turns it into a new one.
+  if (size >= kStunHeaderSize &&
+      talk_base::GetBE16(data) == STUN_BINDING_REQUEST) {
+    if (UDPPort* port = FindPortForRequest(data, size)) {
+      port->HandleIncomingPacket(socket, data, size, remote_addr);
+      return;
+    }
+  }
+
+  if (const ConnectionEntry* entry = connections_.Find(remote_addr)) {
+    entry->conn->OnReadPacket(data, size);
+    return;
+  }
+
+  // Responses from a STUN server go to the port that sent the request.
+  if (size >= kStunHeaderSize) {
+    RequestMap::iterator it = requests_.find(std::string(
+        data + kStunTransactionIdOffset, kStunTransactionIdLength));
+    if (it != requests_.end() && it->second->server_addr() == remote_addr) {
+      it->second->HandleStunResponse(data, size);
+    }
+  }
+}
+
+UDPPort* UDPPortMux::FindPortForRequest(const char* data, size_t size) {
+  IceMessage msg;
+  talk_base::ByteBuffer buf(data, size);
+  if (!msg.Read(&buf)) {
+    return NULL;
+  }
+  const StunByteStringAttribute* username_attr =
+      msg.GetByteString(STUN_ATTR_USERNAME);
+  if (!username_attr) {
+    return NULL;
+  }
+
+  const std::string username = username_attr->GetString();
+  size_t colon_pos = username.find(':');
+  if (colon_pos != std::string::npos) {  // LFRAG:RFRAG
+    return FindPortByUfrag(username.substr(0, colon_pos));
+  }
+  // GICE puts the fragments next to each other, ours first.
+  for (std::set<size_t>::const_iterator it = ufrag_lengths_.begin();
+       it != ufrag_lengths_.end(); ++it) {
+    if (*it <= username.size()) {
+      if (UDPPort* port = FindPortByUfrag(username.substr(0, *it))) {
+        return port;
+      }
+    }
+  }
+  return NULL;
+}
+
+UDPPort* UDPPortMux::FindPortByUfrag(const std::string& local_ufrag) {
+  if (local_ufrag.empty()) {
+    return NULL;
+  }
+  UfragMap::iterator it = ufrags_.find(UfragKey(local_ufrag));
+  if (it == ufrags_.end() ||
+      it->second->username_fragment() != local_ufrag) {
+    return NULL;
+  }
+  return it->second;
+}
+
+void UDPPortMux::OnConnectionCreated(Port* port, Connection* conn) {
+  const talk_base::SocketAddress& addr = conn->remote_candidate().address();
+  if (ConnectionEntry* entry = connections_.Find(addr)) {
+    LOG_J(LS_WARNING, port) << "Another port on the socket already has a "
+                            << "connection to " << addr.ToString();
+    entry->conn = conn;
+    ++entry->overlapping;
+  } else {
+    ConnectionEntry new_entry;
+    new_entry.conn = conn;
+    connections_.Insert(addr, new_entry);
+  }
+  conn->SignalDestroyed.connect(this, &UDPPortMux::OnConnectionDestroyed);
+}
+
+void UDPPortMux::OnConnectionDestroyed(Connection* conn) {
+  RemoveConnection(conn);
+}
+
+void UDPPortMux::RemoveConnection(Connection* conn) {
+  const talk_base::SocketAddress& addr = conn->remote_candidate().address();
+  ConnectionEntry* entry = connections_.Find(addr);
+  if (!entry) {
+    return;
+  }
+  if (entry->overlapping == 0) {
+    ASSERT(entry->conn == conn);
+    connections_.Erase(addr);
+    return;
+  }
+
+  --entry->overlapping;
+  if (entry->conn == conn) {
+    // Hand the address to one of the connections that overlapped it.
+    entry->conn = NULL;
+    for (size_t i = 0; i < ports_.size() && !entry->conn; ++i) {
+      if (ports_[i] != conn->port()) {
+        entry->conn = ports_[i]->GetConnection(addr);
+      }
+    }
+    if (!entry->conn) {
+      connections_.Erase(addr);
+    }
+  }
+}
+
+}  // namespace cricket
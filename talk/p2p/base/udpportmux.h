@@ -0,0 +1,120 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_P2P_BASE_UDPPORTMUX_H_
+#define TALK_P2P_BASE_UDPPORTMUX_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "talk/base/asyncpacketsocket.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/flathashmap.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/sigslot.h"
+#include "talk/base/socketaddress.h"
+
+namespace cricket {
+
+class Connection;
+class Port;
+class UDPPort;
+
+// Lets the UDPPorts of many PortAllocatorSessions share one UDP socket, so
+// that a server handling thousands of ICE sessions needs one socket per
+// interface rather than one per session. STUN binding requests go to the
+// port whose username fragment they carry. Other packets from an address
+// that one of the ports has a connection to go straight to that connection,
+// found with a single hash lookup, and responses from a STUN server go to
+// the port whose request they answer, found by transaction ID. Anything else
+// is dropped.
+//
+// If connections on two ports have the same remote address, the newer one
+// gets the packets. Must be used on the socket's thread.
+class UDPPortMux : public sigslot::has_slots<> {
+ public:
+  // Takes ownership of |socket|.
+  explicit UDPPortMux(talk_base::AsyncPacketSocket* socket);
+  virtual ~UDPPortMux();
+
+  talk_base::AsyncPacketSocket* socket() { return socket_.get(); }
+  size_t port_count() const { return ports_.size(); }
+  size_t connection_count() const { return connections_.size(); }
+
+  // Starts handing packets for |port|, which must use socket(), to it. Fails
+  // if the username fragment of |port| can't be told apart from that of a
+  // port already on the socket. |port| is removed when it is deleted.
+  bool AddPort(UDPPort* port);
+  void RemovePort(UDPPort* port);
+
+  // Called by the ports as they send STUN requests and drop them, so that
+  // responses can be told apart by transaction ID.
+  void AddStunRequest(UDPPort* port, const std::string& id);
+  void RemoveStunRequest(const std::string& id);
+
+ private:
+  // Keyed by all but the last character of a port's username fragment, which
+  // GICE changes for RTCP.
+  typedef std::map<std::string, UDPPort*> UfragMap;
+  // Ports keyed by the transaction IDs of their outstanding STUN requests.
+  typedef std::map<std::string, UDPPort*> RequestMap;
+  // The connection that gets the packets from an address, and how many
+  // connections on other ports have the same remote address.
+  struct ConnectionEntry {
+    ConnectionEntry() : conn(NULL), overlapping(0) {}
+    Connection* conn;
+    int overlapping;
+  };
+  typedef talk_base::FlatHashMap<talk_base::SocketAddress, ConnectionEntry>
+      ConnectionMap;
+
+  void OnReadPacket(talk_base::AsyncPacketSocket* socket,
+                    const char* data, size_t size,
+                    const talk_base::SocketAddress& remote_addr);
+  // Returns the port that a STUN binding request is addressed to, if any.
+  UDPPort* FindPortForRequest(const char* data, size_t size);
+  UDPPort* FindPortByUfrag(const std::string& local_ufrag);
+  void OnConnectionCreated(Port* port, Connection* conn);
+  void OnConnectionDestroyed(Connection* conn);
+  void RemoveConnection(Connection* conn);
+
+  talk_base::scoped_ptr<talk_base::AsyncPacketSocket> socket_;
+  std::vector<UDPPort*> ports_;
+  UfragMap ufrags_;
+  // Lengths of the username fragments in |ufrags_|.
+  std::set<size_t> ufrag_lengths_;
+  ConnectionMap connections_;
+  RequestMap requests_;
+
+  DISALLOW_COPY_AND_ASSIGN(UDPPortMux);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_P2P_BASE_UDPPORTMUX_H_
@@ -0,0 +1,298 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+
+#include "talk/base/basicpacketsocketfactory.h"
+#include "talk/base/bytebuffer.h"
+#include "talk/base/gunit.h"
+#include "talk/base/helpers.h"
+#include "talk/base/network.h"
+#include "talk/base/physicalsocketserver.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/socketaddress.h"
+#include "talk/base/thread.h"
+#include "talk/base/virtualsocketserver.h"
+#include "talk/p2p/base/stun.h"
+#include "talk/p2p/base/stunport.h"
+#include "talk/p2p/base/teststunserver.h"
+#include "talk/p2p/base/udpportmux.h"
+
+using talk_base::SocketAddress;
+using talk_base::Thread;
+using cricket::Connection;
+using cricket::UDPPort;
+using cricket::UDPPortMux;
+
+static const SocketAddress kLocalAddr("11.11.11.11", 0);
+static const SocketAddress kRemoteAddr("22.22.22.22", 0);
+static const SocketAddress kStunAddr("99.99.99.1", 3478);
+static const char kUfragA[] = "TESTICEUFRAGA000";
+static const char kUfragB[] = "TESTICEUFRAGB000";
+static const char kRemoteUfrag[] = "TESTICEUFRAGR000";
+static const char kIcePwd[] = "TESTICEPWD00000000000000";
+static const char kData[] = "not a STUN message";
+static const int kTimeoutMs = 1000;
+
+class UDPPortMuxTest : public testing::Test, public sigslot::has_slots<> {
+ public:
+  UDPPortMuxTest()
+      : pss_(new talk_base::PhysicalSocketServer),
+        vss_(new talk_base::VirtualSocketServer(pss_.get())),
+        ss_scope_(vss_.get()),
+        network_("unittest", "unittest", kLocalAddr.ipaddr(), 32),
+        socket_factory_(Thread::Current()),
+        mux_(new UDPPortMux(socket_factory_.CreateUdpSocket(kLocalAddr, 0, 0))),
+        remote_socket_(socket_factory_.CreateUdpSocket(kRemoteAddr, 0, 0)),
+        create_connections_(false),
+        last_port_(NULL),
+        last_conn_(NULL),
+        num_unknown_addresses_(0),
+        num_packets_(0),
+        num_ready_ports_(0) {
+  }
+
+  UDPPort* CreatePort(const std::string& ufrag,
+                      const SocketAddress& server_addr = SocketAddress()) {
+    UDPPort* port = UDPPort::Create(Thread::Current(), &network_,
+                                    mux_->socket(), ufrag, kIcePwd);
+    port->SignalUnknownAddress.connect(this,
+                                       &UDPPortMuxTest::OnUnknownAddress);
+    port->SignalAddressReady.connect(this, &UDPPortMuxTest::OnAddressReady);
+    port->set_server_addr(server_addr);
+    port->PrepareAddress();
+    return port;
+  }
+
+  Connection* CreateConnection(UDPPort* port) {
+    cricket::Candidate candidate;
+    candidate.set_address(remote_socket_->GetLocalAddress());
+    candidate.set_protocol("udp");
+    candidate.set_username(kRemoteUfrag);
+    candidate.set_password(kIcePwd);
+    Connection* conn = port->CreateConnection(
+        candidate, cricket::PortInterface::ORIGIN_MESSAGE);
+    conn->SignalReadPacket.connect(this, &UDPPortMuxTest::OnReadPacket);
+    return conn;
+  }
+
+  void SendRequest(const std::string& username) {
+    cricket::IceMessage msg;
+    msg.SetType(cricket::STUN_BINDING_REQUEST);
+    msg.SetTransactionID(
+        talk_base::CreateRandomString(cricket::kStunTransactionIdLength));
+    msg.AddAttribute(new cricket::StunByteStringAttribute(
+        cricket::STUN_ATTR_USERNAME, username));
+    msg.AddMessageIntegrity(kIcePwd);
+    msg.AddFingerprint();
+    talk_base::ByteBuffer buf;
+    msg.Write(&buf);
+    Send(buf.Data(), buf.Length());
+  }
+
+  void Send(const char* data, size_t size) {
+    remote_socket_->SendTo(data, size, mux_->socket()->GetLocalAddress());
+  }
+
+ protected:
+  // Answers the request the way P2PTransportChannel does, if asked to.
+  void OnUnknownAddress(cricket::PortInterface* port,
+                        const SocketAddress& addr,
+                        cricket::ProtocolType proto,
+                        cricket::IceMessage* msg,
+                        const std::string& remote_username,
+                        bool port_muxed) {
+    ++num_unknown_addresses_;
+    last_port_ = port;
+    if (create_connections_) {
+      last_conn_ = CreateConnection(static_cast<UDPPort*>(port));
+      port->SendBindingResponse(msg, addr);
+    }
+  }
+
+  void OnReadPacket(Connection* conn, const char* data, size_t size) {
+    ++num_packets_;
+  }
+
+  void OnAddressReady(cricket::Port* port) {
+    ++num_ready_ports_;
+  }
+
+  talk_base::scoped_ptr<talk_base::PhysicalSocketServer> pss_;
+  talk_base::scoped_ptr<talk_base::VirtualSocketServer> vss_;
+  talk_base::SocketServerScope ss_scope_;
+  talk_base::Network network_;
+  talk_base::BasicPacketSocketFactory socket_factory_;
+  talk_base::scoped_ptr<UDPPortMux> mux_;
+  talk_base::scoped_ptr<talk_base::AsyncPacketSocket> remote_socket_;
+  bool create_connections_;
+  cricket::PortInterface* last_port_;
+  Connection* last_conn_;
+  int num_unknown_addresses_;
+  int num_packets_;
+  int num_ready_ports_;
+};
+
+// Tests that binding requests from new addresses reach the port whose
+// username fragment they carry, in both GICE and RFC 5245 form.
+TEST_F(UDPPortMuxTest, RoutesRequestsByUfrag) {
+  talk_base::scoped_ptr<UDPPort> port_a(CreatePort(kUfragA));
+  talk_base::scoped_ptr<UDPPort> port_b(CreatePort(kUfragB));
+  ASSERT_TRUE(mux_->AddPort(port_a.get()));
+  ASSERT_TRUE(mux_->AddPort(port_b.get()));
+  EXPECT_EQ(2U, mux_->port_count());
+
+  SendRequest(std::string(kUfragB) + kRemoteUfrag);
+  EXPECT_EQ_WAIT(1, num_unknown_addresses_, kTimeoutMs);
+  EXPECT_EQ(port_b.get(), last_port_);
+
+  port_a->SetIceProtocolType(cricket::ICEPROTO_RFC5245);
+  port_a->SetRole(cricket::ROLE_CONTROLLING);
+  SendRequest(std::string(kUfragA) + ":" + kRemoteUfrag);
+  EXPECT_EQ_WAIT(2, num_unknown_addresses_, kTimeoutMs);
+  EXPECT_EQ(port_a.get(), last_port_);
+
+  // No port on the socket has this fragment.
+  SendRequest(std::string("TESTICEUFRAGC000") + kRemoteUfrag);
+  Thread::Current()->ProcessMessages(100);
+  EXPECT_EQ(2, num_unknown_addresses_);
+}
+
+// Tests that GICE RTCP ports, whose fragment differs in the last character,
+// are matched on their actual fragment.
+TEST_F(UDPPortMuxTest, RoutesRequestsForRtcpUfrag) {
+  talk_base::scoped_ptr<UDPPort> port(CreatePort(kUfragA));
+  ASSERT_TRUE(mux_->AddPort(port.get()));
+  port->set_component(cricket::ICE_CANDIDATE_COMPONENT_RTCP);
+  ASSERT_NE(std::string(kUfragA), port->username_fragment());
+
+  SendRequest(std::string(kUfragA) + kRemoteUfrag);
+  Thread::Current()->ProcessMessages(100);
+  EXPECT_EQ(0, num_unknown_addresses_);
+  SendRequest(port->username_fragment() + kRemoteUfrag);
+  EXPECT_EQ_WAIT(1, num_unknown_addresses_, kTimeoutMs);
+}
+
+// Tests that each port gets the responses to its own STUN requests, even
+// though they all come from the same server.
+TEST_F(UDPPortMuxTest, RoutesStunResponses) {
+  cricket::TestStunServer stun_server(Thread::Current(), kStunAddr);
+  talk_base::scoped_ptr<UDPPort> port_a(CreatePort(kUfragA, kStunAddr));
+  talk_base::scoped_ptr<UDPPort> port_b(CreatePort(kUfragB, kStunAddr));
+  ASSERT_TRUE(mux_->AddPort(port_a.get()));
+  ASSERT_TRUE(mux_->AddPort(port_b.get()));
+  EXPECT_EQ(0, num_ready_ports_);
+  EXPECT_EQ_WAIT(2, num_ready_ports_, kTimeoutMs);
+}
+
+TEST_F(UDPPortMuxTest, RejectsSimilarUfrag) {
+  talk_base::scoped_ptr<UDPPort> port_a(CreatePort(kUfragA));
+  talk_base::scoped_ptr<UDPPort> port_b(CreatePort(kUfragA));
+  talk_base::scoped_ptr<UDPPort> port_c(CreatePort("TESTICEUFRAGA001"));
+  EXPECT_TRUE(mux_->AddPort(port_a.get()));
+  EXPECT_FALSE(mux_->AddPort(port_b.get()));
+  EXPECT_FALSE(mux_->AddPort(port_c.get()));
+  EXPECT_EQ(1U, mux_->port_count());
+}
+
+// Tests that once a port has a connection, packets from its address go to the
+// connection, and that deleting the port forgets both.
+TEST_F(UDPPortMuxTest, DeliversPacketsToConnections) {
+  create_connections_ = true;
+  talk_base::scoped_ptr<UDPPort> port_a(CreatePort(kUfragA));
+  talk_base::scoped_ptr<UDPPort> port_b(CreatePort(kUfragB));
+  ASSERT_TRUE(mux_->AddPort(port_a.get()));
+  ASSERT_TRUE(mux_->AddPort(port_b.get()));
+
+  SendRequest(std::string(kUfragB) + kRemoteUfrag);
+  EXPECT_EQ_WAIT(1, num_unknown_addresses_, kTimeoutMs);
+  ASSERT_TRUE(last_conn_ != NULL);
+  EXPECT_EQ(port_b.get(), last_conn_->port());
+  EXPECT_EQ(1U, mux_->connection_count());
+
+  Send(kData, sizeof(kData));
+  EXPECT_EQ_WAIT(1, num_packets_, kTimeoutMs);
+  // Later requests from the address go to the connection too.
+  SendRequest(std::string(kUfragB) + kRemoteUfrag);
+  Send(kData, sizeof(kData));
+  EXPECT_EQ_WAIT(2, num_packets_, kTimeoutMs);
+  EXPECT_EQ(1, num_unknown_addresses_);
+
+  port_b.reset();
+  EXPECT_EQ(1U, mux_->port_count());
+  EXPECT_EQ(0U, mux_->connection_count());
+  Send(kData, sizeof(kData));
+  SendRequest(std::string(kUfragB) + kRemoteUfrag);
+  Thread::Current()->ProcessMessages(100);
+  EXPECT_EQ(2, num_packets_);
+  EXPECT_EQ(1, num_unknown_addresses_);
+}
+
+// Tests that when connections on two ports have the same remote address, the
+// newer one gets the packets for as long as it exists.
+TEST_F(UDPPortMuxTest, HandlesOverlappingConnections) {
+  create_connections_ = true;
+  talk_base::scoped_ptr<UDPPort> port_a(CreatePort(kUfragA));
+  talk_base::scoped_ptr<UDPPort> port_b(CreatePort(kUfragB));
+  ASSERT_TRUE(mux_->AddPort(port_a.get()));
+  ASSERT_TRUE(mux_->AddPort(port_b.get()));
+
+  SendRequest(std::string(kUfragA) + kRemoteUfrag);
+  EXPECT_EQ_WAIT(1, num_unknown_addresses_, kTimeoutMs);
+  Send(kData, sizeof(kData));
+  EXPECT_EQ_WAIT(1, num_packets_, kTimeoutMs);
+
+  // The new connection isn't readable yet, so it drops what it gets.
+  CreateConnection(port_b.get());
+  EXPECT_EQ(1U, mux_->connection_count());
+  Send(kData, sizeof(kData));
+  Thread::Current()->ProcessMessages(100);
+  EXPECT_EQ(1, num_packets_);
+
+  port_b.reset();
+  EXPECT_EQ(1U, mux_->connection_count());
+  Send(kData, sizeof(kData));
+  EXPECT_EQ_WAIT(2, num_packets_, kTimeoutMs);
+}
+
+// Tests that a binding request goes to the port it names even when a
+// connection on another port has the same remote address.
+TEST_F(UDPPortMuxTest, RoutesRequestsByUfragBeforeAddress) {
+  create_connections_ = true;
+  talk_base::scoped_ptr<UDPPort> port_a(CreatePort(kUfragA));
+  talk_base::scoped_ptr<UDPPort> port_b(CreatePort(kUfragB));
+  ASSERT_TRUE(mux_->AddPort(port_a.get()));
+  ASSERT_TRUE(mux_->AddPort(port_b.get()));
+
+  SendRequest(std::string(kUfragA) + kRemoteUfrag);
+  EXPECT_EQ_WAIT(1, num_unknown_addresses_, kTimeoutMs);
+  EXPECT_EQ(port_a.get(), last_port_);
+
+  SendRequest(std::string(kUfragB) + kRemoteUfrag);
+  EXPECT_EQ_WAIT(2, num_unknown_addresses_, kTimeoutMs);
+  EXPECT_EQ(port_b.get(), last_port_);
+}
@@ -27,6 +27,8 @@
 
 #include "talk/p2p/client/basicportallocator.h"
 
+#include <algorithm>
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -35,6 +37,7 @@
 #include "talk/base/helpers.h"
 #include "talk/base/host.h"
 #include "talk/base/logging.h"
+#include "talk/base/timeutils.h"
 #include "talk/p2p/base/common.h"
 #include "talk/p2p/base/port.h"
 #include "talk/p2p/base/relayport.h"
@@ -42,6 +45,7 @@
 #include "talk/p2p/base/tcpport.h"
 #include "talk/p2p/base/turnport.h"
 #include "talk/p2p/base/udpport.h"
+#include "talk/p2p/base/udpportmux.h"
 #include "talk/p2p/base/timeouts.h"
 
 using talk_base::CreateRandomId;
@@ -69,6 +73,10 @@ const int PHASE_SSLTCP = 3;
 
 const int kNumPhases = 4;
 
+const char* const PHASE_NAMES[kNumPhases] = {
+  "Udp", "Relay", "Tcp", "SslTcp"
+};
+
 // Both these values are in bytes.
 const int kLargeSocketSendBufferSize = 128 * 1024;
 const int kNormalSocketSendBufferSize = 64 * 1024;
@@ -158,12 +166,25 @@ class AllocationSequence : public talk_base::MessageHandler,
   void Start();
   void Stop();
 
+  // Returns false if the network is no longer in |networks| or no longer has
+  // the address this sequence allocated on.
+  bool HasNetwork(const std::vector<talk_base::Network*>& networks) const;
+  // Stops the sequence for good because its network went away. It no longer
+  // covers any phases, so they are allocated again if the network returns.
+  void OnNetworkLost();
+  bool network_lost() const { return network_lost_; }
+
   // MessageHandler
   void OnMessage(talk_base::Message* msg);
 
   void EnableProtocol(ProtocolType proto);
   bool ProtocolEnabled(ProtocolType proto) const;
 
+  // Notes the time of candidates that the session signals for this sequence.
+  void OnCandidatesSignaled(const std::vector<Candidate>& candidates);
+  // Adds the gathering times of the phases that have started.
+  void GetCandidateGatheringStats(CandidateGatheringInfos* infos) const;
+
   // Signal from AllocationSequence, when it's done with allocating ports.
   // This signal is useful, when port allocation fails which doesn't result
   // in any candidates. Using this signal BasicPortAllocatorSession can send
@@ -178,7 +199,10 @@ class AllocationSequence : public talk_base::MessageHandler,
   bool IsFlagSet(uint32 flag) {
     return ((flags_ & flag) != 0);
   }
+  // Time until the next step.
+  int StepDelay();
   void CreateUDPPorts();
+  UDPPort* CreateMuxedUDPPort();
   void CreateTCPPorts();
   void CreateStunPorts();
   void CreateRelayPorts();
@@ -196,7 +220,11 @@ class AllocationSequence : public talk_base::MessageHandler,
   PortConfiguration* config_;
   State state_;
   int step_;
+  // Whether step 0 has been posted and not run yet.
+  bool first_step_pending_;
   int step_of_phase_[kNumPhases];
+  CandidateGatheringInfo stats_[kNumPhases];
+  bool network_lost_;
   uint32 flags_;
   ProtocolList protocols_;
   talk_base::scoped_ptr<talk_base::AsyncPacketSocket> udp_socket_;
@@ -264,9 +292,34 @@ void BasicPortAllocator::Construct() {
   // For testing, also helps in sending OFFER Quicker 
   //best_writable_phase_ = PHASE_TURN;
   allow_tcp_listen_ = true;
+  phase_pacing_delay_ = kAllocatorTimeoutPhasePacingDelay;
 }
 
 BasicPortAllocator::~BasicPortAllocator() {
+  for (UDPPortMuxMap::iterator it = udp_port_muxes_.begin();
+       it != udp_port_muxes_.end(); ++it) {
+    delete it->second;
+  }
+}
+
+UDPPortMux* BasicPortAllocator::GetUDPPortMux(
+    const talk_base::IPAddress& ip, int component,
+    talk_base::PacketSocketFactory* factory) {
+  std::pair<talk_base::IPAddress, int> key(ip, component);
+  UDPPortMuxMap::iterator it = udp_port_muxes_.find(key);
+  if (it != udp_port_muxes_.end()) {
+    return it->second;
+  }
+  talk_base::AsyncPacketSocket* socket = factory->CreateUdpSocket(
+      talk_base::SocketAddress(ip, 0), min_port(), max_port());
+  if (!socket) {
+    LOG(LS_WARNING) << "Failed to create shared UDP socket on "
+                    << ip.ToString();
+    return NULL;
+  }
+  UDPPortMux* mux = new UDPPortMux(socket);
+  udp_port_muxes_[key] = mux;
+  return mux;
 }
 
 int BasicPortAllocator::best_writable_phase() const {
@@ -306,7 +359,10 @@ BasicPortAllocatorSession::BasicPortAllocatorSession(
       allocation_started_(false),
       network_manager_started_(false),
       running_(false),
-      allocation_sequences_created_(false) {
+      allocation_sequences_created_(false),
+      start_time_(0),
+      next_phase_time_(0),
+      done_time_(-1) {
   allocator_->network_manager()->SignalNetworksChanged.connect(
       this, &BasicPortAllocatorSession::OnNetworksChanged);
   allocator_->network_manager()->StartUpdating();
@@ -330,6 +386,7 @@ BasicPortAllocatorSession::~BasicPortAllocatorSession() {
 
 void BasicPortAllocatorSession::GetInitialPorts() {
   network_thread_ = talk_base::Thread::Current();
+  start_time_ = next_phase_time_ = talk_base::Time();
   if (!socket_factory_) {
     owned_socket_factory_.reset(
         new talk_base::BasicPacketSocketFactory(network_thread_));
@@ -533,10 +590,53 @@ void BasicPortAllocatorSession::DoAllocate() {
 
 void BasicPortAllocatorSession::OnNetworksChanged() {
   network_manager_started_ = true;
+  RemoveLostNetworks();
   if (allocation_started_)
     DoAllocate();
 }
 
+// Only the sequences and ports of networks that went away are touched here;
+// DoAllocate then creates sequences just for the networks that are new.
+void BasicPortAllocatorSession::RemoveLostNetworks() {
+  std::vector<talk_base::Network*> networks;
+  allocator_->network_manager()->GetNetworks(&networks);
+  bool send_signal = false;
+  for (uint32 i = 0; i < sequences_.size(); ++i) {
+    AllocationSequence* sequence = sequences_[i];
+    if (sequence->network_lost() || sequence->HasNetwork(networks))
+      continue;
+
+    if (sequence->state() == AllocationSequence::kRunning)
+      send_signal = true;
+    sequence->OnNetworkLost();
+    // Drop the connections on the lost network right away, so that the
+    // transport fails over instead of waiting for them to time out. The ports
+    // go away on their own once they have no connections left. The sequence
+    // stays around, since its ports may share its socket.
+    std::vector<Connection*> connections;
+    for (std::vector<PortData>::iterator it = ports_.begin();
+         it != ports_.end(); ++it) {
+      if (it->sequence() != sequence)
+        continue;
+      if (!it->complete()) {
+        it->set_error();
+        send_signal = true;
+      }
+      Port::AddressMap::const_iterator iter;
+      for (iter = it->port()->connections().begin();
+           iter != it->port()->connections().end(); ++iter) {
+        connections.push_back(iter->second);
+      }
+    }
+    LOG(LS_INFO) << "Network lost; destroying " << connections.size()
+                 << " connections";
+    for (size_t j = 0; j < connections.size(); ++j)
+      connections[j]->Destroy();
+  }
+  if (send_signal)
+    MaybeSignalCandidatesAllocationDone();
+}
+
 void BasicPortAllocatorSession::DisableEquivalentPhases(
     talk_base::Network* network, PortConfiguration* config, uint32* flags) {
   for (uint32 i = 0; i < sequences_.size() &&
@@ -616,6 +716,7 @@ void BasicPortAllocatorSession::OnCandidateReady(
   }
 
   if (!candidates.empty()) {
+    data->sequence()->OnCandidatesSignaled(candidates);
     SignalCandidatesReady(this, candidates);
   }
 }
@@ -667,6 +768,7 @@ void BasicPortAllocatorSession::OnProtocolEnabled(AllocationSequence* seq,
   }
 
   if (!candidates.empty()) {
+    seq->OnCandidatesSignaled(candidates);
     SignalCandidatesReady(this, candidates);
   }
 }
@@ -698,11 +800,44 @@ void BasicPortAllocatorSession::MaybeSignalCandidatesAllocationDone() {
     if (!it->complete())
       return;
   }
+  done_time_ = GatheringTime();
   LOG(LS_INFO) << "All candidates gathered for " << content_name_ << ":"
-               << component_ << ":" << generation();
+               << component_ << ":" << generation() << " in "
+               << done_time_ << " ms";
+  LogCandidateGatheringStats();
   SignalCandidatesAllocationDone(this);
 }
 
+void BasicPortAllocatorSession::GetCandidateGatheringStats(
+    CandidateGatheringInfos* infos) const {
+  for (size_t i = 0; i < sequences_.size(); ++i)
+    sequences_[i]->GetCandidateGatheringStats(infos);
+}
+
+void BasicPortAllocatorSession::LogCandidateGatheringStats() const {
+  CandidateGatheringInfos infos;
+  GetCandidateGatheringStats(&infos);
+  for (size_t i = 0; i < infos.size(); ++i) {
+    LOG(LS_INFO) << "Gathering on " << infos[i].network
+                 << " phase=" << infos[i].phase
+                 << " start=" << infos[i].start_time
+                 << " first=" << infos[i].first_candidate_time
+                 << " all=" << infos[i].last_candidate_time
+                 << " candidates=" << infos[i].candidates;
+  }
+}
+
+int BasicPortAllocatorSession::GatheringTime() const {
+  return talk_base::TimeSince(start_time_);
+}
+
+int BasicPortAllocatorSession::NextPhaseDelay() {
+  uint32 now = talk_base::Time();
+  uint32 start = talk_base::TimeMax(now, next_phase_time_);
+  next_phase_time_ = start + allocator_->phase_pacing_delay();
+  return talk_base::TimeDiff(start, now);
+}
+
 void BasicPortAllocatorSession::OnPortDestroyed(
     PortInterface* port) {
   LOG(INFO) << "LOGT BasicPortAllocatorSession::OnPortDestroyed";
@@ -785,15 +920,24 @@ AllocationSequence::AllocationSequence(BasicPortAllocatorSession* session,
       config_(config),
       state_(kInit),
       step_(0),
+      first_step_pending_(false),
+      network_lost_(false),
       flags_(flags),
       udp_socket_(NULL) {
   // All of the phases up until the best-writable phase so far run in step 0.
   // The other phases follow sequentially in the steps after that.  If there is
   // no best-writable so far, then only phase 0 occurs in step 0.
+  // With parallel phases, each phase has a step of its own, but the steps
+  // are only the pacing delay apart.
   int last_phase_in_step_zero =
       talk_base::_max(0, session->allocator()->best_writable_phase());
-  for (int phase = 0; phase < kNumPhases; ++phase)
+  if (IsFlagSet(PORTALLOCATOR_ENABLE_PARALLEL_PHASES))
+    last_phase_in_step_zero = 0;
+  for (int phase = 0; phase < kNumPhases; ++phase) {
     step_of_phase_[phase] = talk_base::_max(0, phase - last_phase_in_step_zero);
+    stats_[phase].network = network->name();
+    stats_[phase].phase = PHASE_NAMES[phase];
+  }
 }
 
 bool AllocationSequence::Init() {
@@ -805,7 +949,18 @@ bool AllocationSequence::Init() {
     return false;
   }
 
-  if (IsFlagSet(PORTALLOCATOR_ENABLE_SHARED_SOCKET)) {
+  if (IsFlagSet(PORTALLOCATOR_ENABLE_SHARED_SOCKET_ACROSS_SESSIONS) &&
+      !IsFlagSet(PORTALLOCATOR_ENABLE_SHARED_SOCKET)) {
+    LOG(LS_ERROR) << "Sharing sockets across sessions can't be set without "
+                  << "shared socket.";
+    ASSERT(false);
+    return false;
+  }
+
+  // With sharing across sessions, the UDP port gets its socket from the
+  // allocator instead.
+  if (IsFlagSet(PORTALLOCATOR_ENABLE_SHARED_SOCKET) &&
+      !IsFlagSet(PORTALLOCATOR_ENABLE_SHARED_SOCKET_ACROSS_SESSIONS)) {
     udp_socket_.reset(session_->socket_factory()->CreateUdpSocket(
         talk_base::SocketAddress(ip_, 0), session_->allocator()->min_port(),
         session_->allocator()->max_port()));
@@ -816,8 +971,16 @@ bool AllocationSequence::Init() {
     // Continuing if |udp_socket_| is NULL, as local TCP and RelayPort using TCP
     // are next available options to setup a communication channel.
   }
-  // Immediately perform phase 0.
-  OnMessage(NULL);
+  // Perform step 0 immediately, unless the phases are paced, in which case
+  // it waits its turn like the steps that follow.
+  if (IsFlagSet(PORTALLOCATOR_ENABLE_PARALLEL_PHASES)) {
+    first_step_pending_ = true;
+    session_->network_thread()->PostDelayed(session_->NextPhaseDelay(),
+                                            this,
+                                            MSG_ALLOCATION_PHASE);
+  } else {
+    OnMessage(NULL);
+  }
   return true;
 }
 
@@ -827,7 +990,7 @@ AllocationSequence::~AllocationSequence() {
 
 void AllocationSequence::DisableEquivalentPhases(talk_base::Network* network,
     PortConfiguration* config, uint32* flags) {
-  if (!((network == network_) && (ip_ == network->ip()))) {
+  if (network_lost_ || !((network == network_) && (ip_ == network->ip()))) {
     // Different network setup; nothing is equivalent.
     return;
   }
@@ -857,7 +1020,10 @@ void AllocationSequence::DisableEquivalentPhases(talk_base::Network* network,
 void AllocationSequence::Start() {
   LOG(INFO) << "LOGT AllocationSequence::Start";
   state_ = kRunning;
-  session_->network_thread()->PostDelayed(ALLOCATION_STEP_DELAY,
+  // A pending step 0 goes on to the next step by itself.
+  if (first_step_pending_)
+    return;
+  session_->network_thread()->PostDelayed(StepDelay(),
                                           this,
                                           MSG_ALLOCATION_PHASE);
 }
@@ -868,18 +1034,29 @@ void AllocationSequence::Stop() {
   if (state_ == kRunning) {
     state_ = kStopped;
     session_->network_thread()->Clear(this, MSG_ALLOCATION_PHASE);
+    first_step_pending_ = false;
   }
 }
 
+bool AllocationSequence::HasNetwork(
+    const std::vector<talk_base::Network*>& networks) const {
+  if (std::find(networks.begin(), networks.end(), network_) == networks.end())
+    return false;
+  const std::vector<talk_base::IPAddress>& ips = network_->GetIPs();
+  return std::find(ips.begin(), ips.end(), ip_) != ips.end();
+}
+
+void AllocationSequence::OnNetworkLost() {
+  Stop();
+  network_lost_ = true;
+}
+
 void AllocationSequence::OnMessage(talk_base::Message* msg) {
   LOG(INFO) << "LOGT AllocationSequence::OnMessage";
   ASSERT(talk_base::Thread::Current() == session_->network_thread());
   if (msg)
     ASSERT(msg->message_id == MSG_ALLOCATION_PHASE);
-
-  const char* const PHASE_NAMES[kNumPhases] = {
-    "Udp", "Relay", "Tcp", "SslTcp"
-  };
+  first_step_pending_ = false;
 
   // Perform all of the phases in the current step.
   for (int phase = 0; phase < kNumPhases; phase++) {
@@ -888,6 +1065,7 @@ void AllocationSequence::OnMessage(talk_base::Message* msg) {
       continue;
     LOG_J(LS_INFO, network_) << "Allocation Phase=" << PHASE_NAMES[phase]
                              << " (Step=" << step_ << ")";
+    stats_[phase].start_time = session_->GatheringTime();
 
     switch (phase) {
     case PHASE_UDP:
@@ -929,12 +1107,18 @@ void AllocationSequence::OnMessage(talk_base::Message* msg) {
 
   step_ += 1;
   if (state() == kRunning) {
-    session_->network_thread()->PostDelayed(ALLOCATION_STEP_DELAY,
+    session_->network_thread()->PostDelayed(StepDelay(),
                                             this,
                                             MSG_ALLOCATION_PHASE);
   }
 }
 
+int AllocationSequence::StepDelay() {
+  if (IsFlagSet(PORTALLOCATOR_ENABLE_PARALLEL_PHASES))
+    return session_->NextPhaseDelay();
+  return ALLOCATION_STEP_DELAY;
+}
+
 void AllocationSequence::EnableProtocol(ProtocolType proto) {
   LOG(INFO) << "LOGT AllocationSequence::EnableProtocol";
   switch(proto) { 
@@ -957,6 +1141,26 @@ void AllocationSequence::EnableProtocol(ProtocolType proto) {
   }
 }
 
+void AllocationSequence::OnCandidatesSignaled(
+    const std::vector<Candidate>& candidates) {
+  int now = session_->GatheringTime();
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    CandidateGatheringInfo& info = stats_[LocalCandidateToPhase(candidates[i])];
+    if (info.first_candidate_time < 0)
+      info.first_candidate_time = now;
+    info.last_candidate_time = now;
+    ++info.candidates;
+  }
+}
+
+void AllocationSequence::GetCandidateGatheringStats(
+    CandidateGatheringInfos* infos) const {
+  for (int phase = 0; phase < kNumPhases; ++phase) {
+    if (stats_[phase].start_time >= 0)
+      infos->push_back(stats_[phase]);
+  }
+}
+
 bool AllocationSequence::ProtocolEnabled(ProtocolType proto) const {
   for (ProtocolList::const_iterator it = protocols_.begin();
        it != protocols_.end(); ++it) {
@@ -975,11 +1179,16 @@ void AllocationSequence::CreateUDPPorts() {
   // TODO(mallinath) - Remove UDPPort creating socket after shared socket
   // is enabled completely.
   UDPPort* port = NULL;
-  if (IsFlagSet(PORTALLOCATOR_ENABLE_SHARED_SOCKET) && udp_socket_) {
+  if (IsFlagSet(PORTALLOCATOR_ENABLE_SHARED_SOCKET_ACROSS_SESSIONS)) {
+    port = CreateMuxedUDPPort();
+  } else if (IsFlagSet(PORTALLOCATOR_ENABLE_SHARED_SOCKET) && udp_socket_) {
     port = UDPPort::Create(session_->network_thread(), network_,
                            udp_socket_.get(),
                            session_->username(), session_->password());
-  } else {
+  }
+  // Without a shared socket, or if the allocator's can't be used, the port
+  // opens its own.
+  if (!port && !udp_socket_) {
     port = UDPPort::Create(session_->network_thread(),
                            session_->socket_factory(),
                            network_, ip_,
@@ -1008,6 +1217,23 @@ void AllocationSequence::CreateUDPPorts() {
   }
 }
 
+UDPPort* AllocationSequence::CreateMuxedUDPPort() {
+  UDPPortMux* mux = session_->allocator()->GetUDPPortMux(
+      ip_, session_->component(), session_->socket_factory());
+  if (!mux) {
+    return NULL;
+  }
+  UDPPort* port = UDPPort::Create(session_->network_thread(), network_,
+                                  mux->socket(),
+                                  session_->username(), session_->password());
+  if (port && !mux->AddPort(port)) {
+    // Falls back to a socket of the port's own.
+    delete port;
+    port = NULL;
+  }
+  return port;
+}
+
 void AllocationSequence::CreateTCPPorts() {
   if (IsFlagSet(PORTALLOCATOR_DISABLE_TCP)) {
     LOG(LS_VERBOSE) << "AllocationSequence: TCP ports disabled, skipping.";
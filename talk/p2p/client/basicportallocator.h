@@ -28,7 +28,9 @@
 #ifndef TALK_P2P_CLIENT_BASICPORTALLOCATOR_H_
 #define TALK_P2P_CLIENT_BASICPORTALLOCATOR_H_
 
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "talk/base/messagequeue.h"
@@ -52,6 +54,27 @@ struct RelayCredentials {
   std::string password;
 };
 
+class UDPPortMux;
+
+// Timing of candidate gathering for one allocation phase on one network.
+// Times are in milliseconds since the session's GetInitialPorts, or -1 if
+// they haven't happened.
+struct CandidateGatheringInfo {
+  CandidateGatheringInfo()
+      : start_time(-1), first_candidate_time(-1), last_candidate_time(-1),
+        candidates(0) {
+  }
+
+  std::string network;       // Name of the network.
+  std::string phase;         // "Udp", "Relay", "Tcp" or "SslTcp".
+  int start_time;            // When the phase started allocating ports.
+  int first_candidate_time;  // When its first candidate was signaled.
+  int last_candidate_time;   // When its latest candidate was signaled; the
+                             // time to all of them once allocation is done.
+  int candidates;            // How many candidates it has signaled.
+};
+typedef std::vector<CandidateGatheringInfo> CandidateGatheringInfos;
+
 typedef std::vector<ProtocolAddress> PortList;
 struct RelayServerConfig {
   RelayServerConfig(RelayType type) : type(type) {}
@@ -124,7 +147,30 @@ class BasicPortAllocator : public PortAllocator {
   void set_allow_tcp_listen(bool allow_tcp_listen) {
     allow_tcp_listen_ = allow_tcp_listen;
   }
+
+  // With PORTALLOCATOR_ENABLE_PARALLEL_PHASES, the least time in ms between
+  // the start of one allocation phase and the next within a session, so that
+  // many networks don't all send their STUN and relay requests at once.
+  int phase_pacing_delay() const {
+    return phase_pacing_delay_;
+  }
+  void set_phase_pacing_delay(int delay) {
+    phase_pacing_delay_ = delay;
+  }
+
+  // Returns the mux for the UDP socket that all sessions share on |ip| for
+  // |component|, creating the socket with |factory| if there is none yet.
+  // Returns NULL if the socket can't be created. Sockets stay open until the
+  // allocator is deleted, which must happen after all of its sessions are.
+  // Used with PORTALLOCATOR_ENABLE_SHARED_SOCKET_ACROSS_SESSIONS, on the
+  // network thread.
+  UDPPortMux* GetUDPPortMux(const talk_base::IPAddress& ip, int component,
+                            talk_base::PacketSocketFactory* factory);
+
  private:
+  typedef std::map<std::pair<talk_base::IPAddress, int>, UDPPortMux*>
+      UDPPortMuxMap;
+
   void Construct();
 
   talk_base::NetworkManager* network_manager_;
@@ -133,6 +179,8 @@ class BasicPortAllocator : public PortAllocator {
   std::vector<RelayServerConfig> relays_;
   int best_writable_phase_;
   bool allow_tcp_listen_;
+  int phase_pacing_delay_;
+  UDPPortMuxMap udp_port_muxes_;
 };
 
 struct PortConfiguration;
@@ -158,6 +206,12 @@ class BasicPortAllocatorSession : public PortAllocatorSession,
   virtual bool IsGettingAllPorts() { return running_; }
   virtual std::string GetClassname() const { return "BasicPortAllocatorSession"; }
 
+  // Gets how long each phase on each network has taken to gather candidates.
+  void GetCandidateGatheringStats(CandidateGatheringInfos* infos) const;
+  // Time in ms from GetInitialPorts to SignalCandidatesAllocationDone, or -1
+  // if allocation isn't done.
+  int candidates_allocation_done_time() const { return done_time_; }
+
  protected:
   // Starts the process of getting the port configurations.
   virtual void GetPortConfigurations();
@@ -205,6 +259,7 @@ class BasicPortAllocatorSession : public PortAllocatorSession,
   void OnAllocate();
   void DoAllocate();
   void OnNetworksChanged();
+  void RemoveLostNetworks();
   void OnAllocationSequenceObjectsCreated();
   void DisableEquivalentPhases(talk_base::Network* network,
                                PortConfiguration* config, uint32* flags);
@@ -221,6 +276,12 @@ class BasicPortAllocatorSession : public PortAllocatorSession,
   void MaybeSignalCandidatesAllocationDone();
   void OnPortAllocationComplete(AllocationSequence* seq);
   PortData* FindPort(Port* port);
+  // Milliseconds since GetInitialPorts.
+  int GatheringTime() const;
+  // Returns how long an allocation phase must wait before it starts, to keep
+  // it the pacing delay after the phase before.
+  int NextPhaseDelay();
+  void LogCandidateGatheringStats() const;
 
   BasicPortAllocator* allocator_;
   talk_base::Thread* network_thread_;
@@ -231,6 +292,9 @@ class BasicPortAllocatorSession : public PortAllocatorSession,
   bool network_manager_started_;
   bool running_;  // set when StartGetAllPorts is called
   bool allocation_sequences_created_;
+  uint32 start_time_;
+  uint32 next_phase_time_;
+  int done_time_;
   std::vector<PortConfiguration*> configs_;
   std::vector<AllocationSequence*> sequences_;
   std::vector<PortData> ports_;
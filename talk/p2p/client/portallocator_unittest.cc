@@ -47,6 +47,7 @@ using talk_base::SocketAddress;
 using talk_base::Thread;
 
 static const SocketAddress kClientAddr("11.11.11.11", 0);
+static const SocketAddress kClientAddr2("33.33.33.33", 0);
 static const SocketAddress kRemoteClientAddr("22.22.22.22", 0);
 static const SocketAddress kStunAddr("99.99.99.1", cricket::STUN_SERVER_PORT);
 static const SocketAddress kRelayUdpIntAddr("99.99.99.2", 5000);
@@ -62,6 +63,8 @@ static const int kMaxPort = 10099;
 
 // Based on ICE_UFRAG_LENGTH
 static const char kIceUfrag0[] = "TESTICEUFRAG0000";
+static const char kIceUfrag1[] = "TESTICEUFRAG0001";
+static const char kIceUfrag2[] = "TESTICEUFRAG0010";
 // Based on ICE_PWD_LENGTH
 static const char kIcePwd0[] = "TESTICEPWD00000000000000";
 
@@ -95,7 +98,8 @@ class PortAllocatorTest : public testing::Test, public sigslot::has_slots<> {
         allocator_(new cricket::BasicPortAllocator(
             &network_manager_, kStunAddr, kRelayUdpIntAddr, kRelayTcpIntAddr,
             kRelaySslTcpIntAddr)),
-        candidate_allocation_done_(false) {
+        candidate_allocation_done_(false),
+        connections_destroyed_(0) {
   }
 
   void AddInterface(const SocketAddress& addr) {
@@ -153,6 +157,14 @@ class PortAllocatorTest : public testing::Test, public sigslot::has_slots<> {
         ((addr.port() == 0 && (c.address().port() != 0)) ||
         (c.address().port() == addr.port())));
   }
+  int CountPorts(const talk_base::SocketAddress& addr) const {
+    int count = 0;
+    for (size_t i = 0; i < ports_.size(); ++i) {
+      if (ports_[i]->Network()->ip() == addr.ipaddr())
+        ++count;
+    }
+    return count;
+  }
   static bool CheckPort(const talk_base::SocketAddress& addr,
                         int min_port, int max_port) {
     return (addr.port() >= min_port && addr.port() <= max_port);
@@ -167,6 +179,10 @@ class PortAllocatorTest : public testing::Test, public sigslot::has_slots<> {
     }
   }
 
+  void OnConnectionDestroyed(cricket::Connection* conn) {
+    ++connections_destroyed_;
+  }
+
   // Check if all ports allocated have send-buffer size |expected|. If
   // |expected| == -1, check if GetOptions returns SOCKET_ERROR.
   void CheckSendBufferSizesOfAllPorts(int expected) {
@@ -229,6 +245,7 @@ class PortAllocatorTest : public testing::Test, public sigslot::has_slots<> {
   std::vector<cricket::PortInterface*> ports_;
   std::vector<cricket::Candidate> candidates_;
   bool candidate_allocation_done_;
+  int connections_destroyed_;
 };
 
 // Tests that we can init the port allocator and create a session.
@@ -292,6 +309,104 @@ TEST_F(PortAllocatorTest, TestGetAllPorts) {
   session_->StopGetAllPorts();
 }
 
+// Tests that with parallel phases all the candidates are gathered without
+// waiting a full step between the phases.
+TEST_F(PortAllocatorTest, TestGetAllPortsParallelPhases) {
+  AddInterface(kClientAddr);
+  allocator().set_flags(cricket::PORTALLOCATOR_ENABLE_PARALLEL_PHASES);
+  allocator().set_phase_pacing_delay(10);
+  EXPECT_TRUE(CreateSession(cricket::ICE_CANDIDATE_COMPONENT_RTP));
+  session_->GetInitialPorts();
+  session_->StartGetAllPorts();
+  ASSERT_EQ_WAIT(7U, candidates_.size(), 1000);
+  EXPECT_EQ(4U, ports_.size());
+  EXPECT_TRUE_WAIT(candidate_allocation_done_, 1000);
+  cricket::BasicPortAllocatorSession* session =
+      static_cast<cricket::BasicPortAllocatorSession*>(session_.get());
+  EXPECT_GE(session->candidates_allocation_done_time(), 0);
+  EXPECT_LT(session->candidates_allocation_done_time(), 1000);
+}
+
+// Tests that with parallel phases, the first phase on each network waits its
+// turn too, rather than all networks starting at once.
+TEST_F(PortAllocatorTest, TestParallelPhasesPaceFirstPhase) {
+  AddInterface(kClientAddr);
+  AddInterface(kClientAddr2);
+  allocator().set_flags(cricket::PORTALLOCATOR_ENABLE_PARALLEL_PHASES);
+  allocator().set_phase_pacing_delay(500);
+  EXPECT_TRUE(CreateSession(cricket::ICE_CANDIDATE_COMPONENT_RTP));
+  session_->GetInitialPorts();
+  session_->StartGetAllPorts();
+  ASSERT_TRUE_WAIT(!ports_.empty(), 1000);
+  EXPECT_EQ(0, CountPorts(kClientAddr2));
+  EXPECT_TRUE_WAIT(CountPorts(kClientAddr2) > 0, 1000);
+}
+
+// Tests that the time to gather each phase is recorded.
+TEST_F(PortAllocatorTest, TestCandidateGatheringStats) {
+  AddInterface(kClientAddr);
+  EXPECT_TRUE(CreateSession(cricket::ICE_CANDIDATE_COMPONENT_RTP));
+  cricket::BasicPortAllocatorSession* session =
+      static_cast<cricket::BasicPortAllocatorSession*>(session_.get());
+  EXPECT_EQ(-1, session->candidates_allocation_done_time());
+  session_->GetInitialPorts();
+  session_->StartGetAllPorts();
+  ASSERT_TRUE_WAIT(candidate_allocation_done_, 5000);
+  EXPECT_GE(session->candidates_allocation_done_time(), 0);
+
+  cricket::CandidateGatheringInfos infos;
+  session->GetCandidateGatheringStats(&infos);
+  ASSERT_EQ(4U, infos.size());
+  const char* const kPhases[] = { "Udp", "Relay", "Tcp", "SslTcp" };
+  const int kCandidates[] = { 2, 2, 2, 1 };
+  int candidates = 0;
+  for (size_t i = 0; i < infos.size(); ++i) {
+    EXPECT_EQ(kPhases[i], infos[i].phase);
+    EXPECT_EQ(kCandidates[i], infos[i].candidates);
+    EXPECT_GE(infos[i].start_time, 0);
+    EXPECT_GE(infos[i].first_candidate_time, infos[i].start_time);
+    EXPECT_GE(infos[i].last_candidate_time, infos[i].first_candidate_time);
+    EXPECT_LE(infos[i].last_candidate_time,
+              session->candidates_allocation_done_time());
+    candidates += infos[i].candidates;
+  }
+  EXPECT_EQ(static_cast<int>(candidates_.size()), candidates);
+}
+
+// Tests that when a network goes away, gathering on it stops without waiting
+// for the remaining phases, and its connections are dropped right away, while
+// the other networks are left alone.
+TEST_F(PortAllocatorTest, TestGetAllPortsNetworkLost) {
+  AddInterface(kClientAddr);
+  AddInterface(kClientAddr2);
+  EXPECT_TRUE(CreateSession(cricket::ICE_CANDIDATE_COMPONENT_RTP));
+  session_->GetInitialPorts();
+  session_->StartGetAllPorts();
+  ASSERT_EQ_WAIT(4U, candidates_.size(), 1000);
+  ASSERT_EQ(4U, ports_.size());
+
+  cricket::PortInterface* port = NULL;
+  for (size_t i = 0; i < ports_.size(); ++i) {
+    if (ports_[i]->Network()->ip() == kClientAddr.ipaddr())
+      port = ports_[i];
+  }
+  ASSERT_TRUE(port != NULL);
+  cricket::Candidate remote = port->Candidates()[0];
+  remote.set_address(kRemoteClientAddr);
+  cricket::Connection* conn = port->CreateConnection(
+      remote, cricket::PortInterface::ORIGIN_MESSAGE);
+  ASSERT_TRUE(conn != NULL);
+  conn->SignalDestroyed.connect(
+      static_cast<PortAllocatorTest*>(this),
+      &PortAllocatorTest::OnConnectionDestroyed);
+
+  network_manager_.RemoveInterface(kClientAddr);
+  EXPECT_EQ_WAIT(1, connections_destroyed_, 1000);
+  ASSERT_TRUE_WAIT(candidate_allocation_done_, 5000);
+  // Only the remaining network went through the relay and TCP phases.
+  EXPECT_EQ(9U, candidates_.size());
+}
+
 TEST_F(PortAllocatorTest, TestSetupVideoRtpPortsWithNormalSendBuffers) {
   AddInterface(kClientAddr);
   EXPECT_TRUE(CreateSession(cricket::ICE_CANDIDATE_COMPONENT_RTP,
@@ -734,6 +849,46 @@ TEST_F(PortAllocatorTest, TestEnableSharedSocketNoUdpAllowed) {
   EXPECT_EQ(1U, candidates_.size());
 }
 
+// Test that with PORTALLOCATOR_ENABLE_SHARED_SOCKET_ACROSS_SESSIONS the UDP
+// ports of different sessions share a socket, unless their ufrags are too
+// similar to be told apart.
+TEST_F(PortAllocatorTest, TestEnableSharedSocketAcrossSessions) {
+  allocator().set_flags(
+      allocator().flags() |
+      cricket::PORTALLOCATOR_DISABLE_STUN |
+      cricket::PORTALLOCATOR_DISABLE_RELAY |
+      cricket::PORTALLOCATOR_DISABLE_TCP |
+      cricket::PORTALLOCATOR_ENABLE_SHARED_UFRAG |
+      cricket::PORTALLOCATOR_ENABLE_SHARED_SOCKET |
+      cricket::PORTALLOCATOR_ENABLE_SHARED_SOCKET_ACROSS_SESSIONS);
+  AddInterface(kClientAddr);
+  talk_base::scoped_ptr<cricket::PortAllocatorSession> session1(
+      CreateSession("session1", kContentName,
+                    cricket::ICE_CANDIDATE_COMPONENT_RTP,
+                    kIceUfrag0, kIcePwd0));
+  talk_base::scoped_ptr<cricket::PortAllocatorSession> session2(
+      CreateSession("session2", kContentName,
+                    cricket::ICE_CANDIDATE_COMPONENT_RTP,
+                    kIceUfrag2, kIcePwd0));
+  talk_base::scoped_ptr<cricket::PortAllocatorSession> session3(
+      CreateSession("session3", kContentName,
+                    cricket::ICE_CANDIDATE_COMPONENT_RTP,
+                    kIceUfrag1, kIcePwd0));
+  session1->GetInitialPorts();
+  ASSERT_EQ_WAIT(1U, candidates_.size(), 1000);
+  session2->GetInitialPorts();
+  ASSERT_EQ_WAIT(2U, candidates_.size(), 1000);
+  session3->GetInitialPorts();
+  ASSERT_EQ_WAIT(3U, candidates_.size(), 1000);
+  for (size_t i = 0; i < candidates_.size(); ++i) {
+    EXPECT_PRED5(CheckCandidate, candidates_[i],
+        cricket::ICE_CANDIDATE_COMPONENT_RTP, "local", "udp", kClientAddr);
+  }
+  EXPECT_EQ(candidates_[0].address(), candidates_[1].address());
+  // Differs from session1's only in the last character.
+  EXPECT_NE(candidates_[0].address(), candidates_[2].address());
+}
+
 // Test that the httpportallocator correctly maintains its lists of stun and
 // relay servers, by never allowing an empty list.
 TEST(HttpPortAllocatorTest, TestHttpPortAllocatorHostLists) {
@@ -65,6 +65,7 @@ enum {
   MSG_SCREENCASTWINDOWEVENT,
   MSG_RTPPACKET,
   MSG_RTCPPACKET,
+  MSG_SENDQUEUE,
   MSG_CHANNEL_ERROR,
   MSG_SETCHANNELOPTIONS,
   MSG_SCALEVOLUME,
@@ -85,6 +86,9 @@ static const char kDtlsSrtpExporterLabel[] = "EXTRACTOR-dtls_srtp";
 
 static const int kAgcMinus10db = -10;
 
+// Number of packets from other threads that can wait for the worker.
+static const size_t kSendQueueSize = 256;
+
 // TODO(hellner): use the device manager for creation of screen capturers when
 // the cl enabling it has landed.
 class NullScreenCapturerFactory : public VideoChannel::ScreenCapturerFactory {
@@ -189,6 +193,11 @@ struct PacketMessageData : public talk_base::MessageData {
   talk_base::Buffer packet;
 };
 
+struct BaseChannel::QueuedPacket {
+  bool rtcp;
+  talk_base::Buffer packet;
+};
+
 struct RenderMessageData : public talk_base::MessageData {
   RenderMessageData(uint32 s, VideoRenderer* r) : ssrc(s), renderer(r) {}
   uint32 ssrc;
@@ -345,11 +354,14 @@ static const char* PacketType(bool rtcp) {
   return (!rtcp) ? "RTP" : "RTCP";
 }
 
-static bool ValidPacket(bool rtcp, const talk_base::Buffer* packet) {
+static bool ValidPacketLength(bool rtcp, size_t len) {
   // Check the packet size. We could check the header too if needed.
-  return (packet &&
-      packet->length() >= (!rtcp ? kMinRtpPacketLen : kMinRtcpPacketLen) &&
-      packet->length() <= kMaxRtpPacketLen);
+  return (len >= (!rtcp ? kMinRtpPacketLen : kMinRtcpPacketLen) &&
+      len <= kMaxRtpPacketLen);
+}
+
+static bool ValidPacket(bool rtcp, const talk_base::Buffer* packet) {
+  return (packet && ValidPacketLength(rtcp, packet->length()));
 }
 
 
@@ -418,6 +430,13 @@ BaseChannel::BaseChannel(talk_base::Thread* thread,
       rtcp_(rtcp),
       transport_channel_(NULL),
       rtcp_transport_channel_(NULL),
+      recv_buffer_pool_(kMaxRtpPacketLen),
+      send_queue_(kSendQueueSize),
+      free_queue_(kSendQueueSize),
+      send_queue_posted_(false),
+      send_queue_enabled_(true),
+      paced_sender_(thread),
+      paced_send_(false),
       enabled_(false),
       writable_(false),
       optimistic_data_send_(false),
@@ -428,6 +447,7 @@ BaseChannel::BaseChannel(talk_base::Thread* thread,
       dtls_keyed_(false),
       secure_required_(false) {
   ASSERT(worker_thread_ == talk_base::Thread::Current());
+  paced_sender_.SignalSendPacket.connect(this, &BaseChannel::OnPacedPacket);
   LOG(LS_INFO) << "Created channel for " << content_name;
 }
 
@@ -607,8 +627,35 @@ void BaseChannel::OnChannelRead(TransportChannel* channel,
   // When using RTCP multiplexing we might get RTCP packets on the RTP
   // transport. We feed RTP traffic into the demuxer to determine if it is RTCP.
   bool rtcp = PacketIsRtcp(channel, data, len);
-  talk_base::Buffer packet(data, len);
-  HandlePacket(rtcp, &packet);
+
+  if (!has_received_packet_) {
+    has_received_packet_ = true;
+    signaling_thread()->Post(this, MSG_FIRSTPACKETRECEIVED);
+  }
+
+  // Protect ourselvs against crazy data.
+  if (!ValidPacketLength(rtcp, len)) {
+    LOG(LS_ERROR) << "Dropping incoming " << content_name_ << " "
+                  << PacketType(rtcp) << " packet: wrong size=" << len;
+    return;
+  }
+
+  // Parse the header once for the rest of the receive path. If this channel
+  // is supposed to handle RTP data, that is determined by checking against
+  // the ssrc filter. This is necessary to do it here to avoid double
+  // decryption, and when bundling, before copying a packet that is meant
+  // for another channel on the same transport.
+  ParsedPacket parsed;
+  ParsePacket(data, len, rtcp, &parsed);
+  if (ssrc_filter_.IsActive() && !ssrc_filter_.DemuxPacket(parsed)) {
+    return;
+  }
+
+  // The transport's data is read-only, so copy it once into a recycled
+  // buffer that SRTP can unprotect in place and the media channel can read.
+  talk_base::Buffer* packet = recv_buffer_pool_.Acquire(data, len);
+  HandlePacket(parsed, packet);
+  recv_buffer_pool_.Release(packet);
 }
 
 bool BaseChannel::PacketIsRtcp(const TransportChannel* channel,
@@ -632,12 +679,7 @@ bool BaseChannel::SendPacket(bool rtcp, talk_base::Buffer* packet) {
   // The only downside is that we can't return a proper failure code if
   // needed. Since UDP is unreliable anyway, this should be a non-issue.
   if (talk_base::Thread::Current() != worker_thread_) {
-    // Avoid a copy by transferring the ownership of the packet data.
-    int message_id = (!rtcp) ? MSG_RTPPACKET : MSG_RTCPPACKET;
-    PacketMessageData* data = new PacketMessageData;
-    packet->TransferTo(&data->packet);
-    worker_thread_->Post(this, message_id, data);
-    return true;
+    return QueuePacket(rtcp, packet);
   }
 
   // Now that we are on the correct thread, ensure we have a place to send this
@@ -708,33 +750,82 @@ bool BaseChannel::SendPacket(bool rtcp, talk_base::Buffer* packet) {
     SignalSendPacketPostCrypto(packet->data(), packet->length(), rtcp);
   }
 
-  // Bon voyage.
+  // Bon voyage, possibly after a wait in the pacer.
+  if (paced_sender_.enabled()) {
+    return paced_sender_.SendPacket(rtcp, rtcp || HasSendPriority(), packet);
+  }
+  return SendToTransport(rtcp, packet);
+}
+
+void BaseChannel::OnPacedPacket(bool rtcp, talk_base::Buffer* packet) {
+  SendToTransport(rtcp, packet);
+}
+
+bool BaseChannel::SendToTransport(bool rtcp, talk_base::Buffer* packet) {
+  // The transport may have changed while the packet sat in the pacer.
+  TransportChannel* channel = (!rtcp || rtcp_mux_filter_.IsActive()) ?
+      transport_channel_ : rtcp_transport_channel_;
+  if (!channel) {
+    return false;
+  }
   return (channel->SendPacket(packet->data(), packet->length(),
       (secure() && secure_dtls()) ? PF_SRTP_BYPASS : 0)
       == static_cast<int>(packet->length()));
 }
 
-void BaseChannel::HandlePacket(bool rtcp, talk_base::Buffer* packet) {
-  if (!has_received_packet_) {
-    has_received_packet_ = true;
-    signaling_thread()->Post(this, MSG_FIRSTPACKETRECEIVED);
+bool BaseChannel::QueuePacket(bool rtcp, talk_base::Buffer* packet) {
+  {
+    talk_base::CritScope cs(&send_queue_cs_);
+    if (send_queue_enabled_ && !send_queue_.IsFull()) {
+      QueuedPacket* queued;
+      if (!free_queue_.PopFront(&queued)) {
+        queued = new QueuedPacket;
+      }
+      queued->rtcp = rtcp;
+      // Avoid a copy by transferring the ownership of the packet data.
+      packet->TransferTo(&queued->packet);
+      // Producers are serialized, so there is still room.
+      VERIFY(send_queue_.PushBack(queued));
+      // Only wake the worker if it isn't already due to drain the queue.
+      if (!send_queue_posted_) {
+        send_queue_posted_ = true;
+        worker_thread_->Post(this, MSG_SENDQUEUE);
+      }
+      return true;
+    }
   }
 
-  // Protect ourselvs against crazy data.
-  if (!ValidPacket(rtcp, packet)) {
-    LOG(LS_ERROR) << "Dropping incoming " << content_name_ << " "
-                  << PacketType(rtcp) << " packet: wrong size="
-                  << packet->length();
-    return;
-  }
+  // The worker has fallen behind; rather than drop the packet, post it on
+  // its own. It may overtake packets queued after it.
+  int message_id = (!rtcp) ? MSG_RTPPACKET : MSG_RTCPPACKET;
+  PacketMessageData* data = new PacketMessageData;
+  packet->TransferTo(&data->packet);
+  worker_thread_->Post(this, message_id, data);
+  return true;
+}
 
-  // If this channel is suppose to handle RTP data, that is determined by
-  // checking against ssrc filter. This is necessary to do it here to avoid
-  // double decryption.
-  if (ssrc_filter_.IsActive() &&
-      !ssrc_filter_.DemuxPacket(packet->data(), packet->length(), rtcp)) {
-    return;
+void BaseChannel::DrainSendQueue_w() {
+  {
+    // Rearm the wakeup before draining, so that a packet queued from here on
+    // either gets drained below or posts a new MSG_SENDQUEUE.
+    talk_base::CritScope cs(&send_queue_cs_);
+    send_queue_posted_ = false;
+  }
+  // Don't chase a producer that is outpacing us; anything queued after this
+  // point comes with its own wakeup.
+  size_t count = send_queue_.Size();
+  QueuedPacket* queued;
+  while (count-- > 0 && send_queue_.PopFront(&queued)) {
+    SendPacket(queued->rtcp, &queued->packet);
+    if (!free_queue_.PushBack(queued)) {
+      delete queued;
+    }
   }
+}
+
+void BaseChannel::HandlePacket(const ParsedPacket& parsed,
+                               talk_base::Buffer* packet) {
+  bool rtcp = parsed.rtcp;
 
   // Signal to the media sink before unprotecting the packet.
   {
@@ -750,22 +841,18 @@ void BaseChannel::HandlePacket(bool rtcp, talk_base::Buffer* packet) {
     if (!rtcp) {
       res = srtp_filter_.UnprotectRtp(data, len, &len);
       if (!res) {
-        int seq_num = -1;
-        uint32 ssrc = 0;
-        GetRtpSeqNum(data, len, &seq_num);
-        GetRtpSsrc(data, len, &ssrc);
         LOG(LS_ERROR) << "Failed to unprotect " << content_name_
                       << " RTP packet: size=" << len
-                      << ", seqnum=" << seq_num << ", SSRC=" << ssrc;
+                      << ", seqnum=" << parsed.header.seq_num
+                      << ", SSRC=" << parsed.header.ssrc;
         return;
       }
     } else {
       res = srtp_filter_.UnprotectRtcp(data, len, &len);
       if (!res) {
-        int type = -1;
-        GetRtcpType(data, len, &type);
         LOG(LS_ERROR) << "Failed to unprotect " << content_name_
-                      << " RTCP packet: size=" << len << ", type=" << type;
+                      << " RTCP packet: size=" << len
+                      << ", type=" << parsed.rtcp_type;
         return;
       }
     }
@@ -1014,6 +1101,7 @@ void BaseChannel::ChannelNotWritable_w() {
 
 // Sets the maximum video bandwidth for automatic bandwidth adjustment.
 bool BaseChannel::SetMaxSendBandwidth_w(int max_bandwidth) {
+  paced_sender_.SetRate(paced_send_ ? max_bandwidth : 0);
   return media_channel()->SetSendBandwidth(true, max_bandwidth);
 }
 
@@ -1329,6 +1417,9 @@ void BaseChannel::OnMessage(talk_base::Message *pmsg) {
       delete data;  // because it is Posted
       break;
     }
+    case MSG_SENDQUEUE:
+      DrainSendQueue_w();
+      break;
     case MSG_FIRSTPACKETRECEIVED: {
       SignalFirstPacketReceived(this);
       break;
@@ -1363,6 +1454,19 @@ void BaseChannel::FlushRtcpMessages() {
   // Flush all remaining RTCP messages. This should only be called in
   // destructor.
   ASSERT(talk_base::Thread::Current() == worker_thread_);
+  {
+    talk_base::CritScope cs(&send_queue_cs_);
+    QueuedPacket* queued;
+    while (send_queue_.PopFront(&queued)) {
+      if (queued->rtcp) {
+        SendPacket(true, &queued->packet);
+      }
+      delete queued;
+    }
+    while (free_queue_.PopFront(&queued)) {
+      delete queued;
+    }
+  }
   talk_base::MessageList rtcp_messages;
   Clear(MSG_RTCPPACKET, &rtcp_messages);
   for (talk_base::MessageList::iterator it = rtcp_messages.begin();
@@ -32,6 +32,7 @@
 #include <vector>
 
 #include "talk/base/asyncudpsocket.h"
+#include "talk/base/atomicops.h"
 #include "talk/base/criticalsection.h"
 #include "talk/base/network.h"
 #include "talk/base/sigslot.h"
@@ -46,6 +47,8 @@
 #include "talk/session/media/audiomonitor.h"
 #include "talk/session/media/mediamonitor.h"
 #include "talk/session/media/mediasession.h"
+#include "talk/session/media/pacedsender.h"
+#include "talk/session/media/packetbufferpool.h"
 #include "talk/session/media/rtcpmuxfilter.h"
 #include "talk/session/media/srtpfilter.h"
 #include "talk/session/media/ssrcmuxfilter.h"
@@ -91,6 +94,18 @@ class BaseChannel
   // when the channel isn't fully writable.
   void set_optimistic_data_send(bool value) { optimistic_data_send_ = value; }
   bool optimistic_data_send() const { return optimistic_data_send_; }
+  // Set to true to pace outgoing packets to the max send bandwidth instead
+  // of sending them as they come. Takes effect at the next
+  // SetMaxSendBandwidth.
+  void set_paced_send(bool value) { paced_send_ = value; }
+  bool paced_send() const { return paced_send_; }
+  // Set to false to post each packet sent from another thread to the worker
+  // on its own, as happens anyway when the send queue is full. For
+  // comparing the two in tests.
+  void set_send_queue_enabled(bool value) {
+    talk_base::CritScope cs(&send_queue_cs_);
+    send_queue_enabled_ = value;
+  }
 
   // This function returns true if we are using SRTP.
   bool secure() const { return srtp_filter_.IsActive(); }
@@ -123,6 +138,12 @@ class BaseChannel
   // Monitoring
   void StartConnectionMonitor(int cms);
   void StopConnectionMonitor();
+  // Buffers used for incoming packets; only touch on the worker thread.
+  const PacketBufferPool& recv_buffer_pool() const {
+    return recv_buffer_pool_;
+  }
+  // Pacer for outgoing packets; only touch on the worker thread.
+  const PacedSender& paced_sender() const { return paced_sender_; }
 
   void set_srtp_signal_silent_time(uint32 silent_time) {
     srtp_filter_.set_signal_silent_time(silent_time);
@@ -260,7 +281,14 @@ class BaseChannel
   bool PacketIsRtcp(const TransportChannel* channel, const char* data,
                     size_t len);
   bool SendPacket(bool rtcp, talk_base::Buffer* packet);
-  void HandlePacket(bool rtcp, talk_base::Buffer* packet);
+  bool QueuePacket(bool rtcp, talk_base::Buffer* packet);
+  void DrainSendQueue_w();
+  void OnPacedPacket(bool rtcp, talk_base::Buffer* packet);
+  bool SendToTransport(bool rtcp, talk_base::Buffer* packet);
+  // Whether the pacer should let our RTP packets skip the queue, as it
+  // always does for RTCP.
+  virtual bool HasSendPriority() const { return false; }
+  void HandlePacket(const ParsedPacket& parsed, talk_base::Buffer* packet);
 
   // Setting the send codec based on the remote description.
   void OnSessionState(BaseSession* session, BaseSession::State state);
@@ -335,6 +363,21 @@ class BaseChannel
   SrtpFilter srtp_filter_;
   RtcpMuxFilter rtcp_mux_filter_;
   SsrcMuxFilter ssrc_filter_;
+  PacketBufferPool recv_buffer_pool_;
+  // Packets sent from threads other than the worker wait in |send_queue_|,
+  // in order, until the worker drains them. Their holders are handed back
+  // through |free_queue_| for reuse. The rings are single-producer, so
+  // |send_queue_cs_| serializes the sending threads, which take it once per
+  // packet, and guards |send_queue_posted_|; the worker takes it once per
+  // drain. When the ring is full, packets are posted one by one instead.
+  struct QueuedPacket;
+  talk_base::CriticalSection send_queue_cs_;
+  talk_base::FixedSizeLockFreeQueue<QueuedPacket*> send_queue_;
+  talk_base::FixedSizeLockFreeQueue<QueuedPacket*> free_queue_;
+  bool send_queue_posted_;
+  bool send_queue_enabled_;
+  PacedSender paced_sender_;
+  bool paced_send_;
   talk_base::scoped_ptr<SocketMonitor> socket_monitor_;
   bool enabled_;
   bool writable_;
@@ -429,6 +472,8 @@ class VoiceChannel : public BaseChannel {
                                  ContentAction action);
   virtual bool SetRemoteContent_w(const MediaContentDescription* content,
                                   ContentAction action);
+  // Audio is small and delay-sensitive, so it is never held in the pacer.
+  virtual bool HasSendPriority() const { return true; }
   bool SetRingbackTone_w(const void* buf, int len);
   bool PlayRingbackTone_w(uint32 ssrc, bool play, bool loop);
   void HandleEarlyMediaTimeout();
@@ -31,6 +31,7 @@
 #include "talk/base/signalthread.h"
 #include "talk/base/ssladapter.h"
 #include "talk/base/sslidentity.h"
+#include "talk/base/timeutils.h"
 #include "talk/base/window.h"
 #include "talk/media/base/fakemediaengine.h"
 #include "talk/media/base/fakertp.h"
@@ -73,6 +74,8 @@ static const uint32 kSsrc1 = 0x1111;
 static const uint32 kSsrc2 = 0x2222;
 static const uint32 kSsrc3 = 0x3333;
 static const char kCName[] = "a@b.com";
+static const int kHandoffPackets = 20000;
+static const int kHandoffWindow = 64;
 
 template<class ChannelT,
          class MediaChannelT,
@@ -549,6 +552,44 @@ class ChannelTest : public testing::Test, public sigslot::has_slots<> {
     mute_callback_value_ = muted;
   }
 
+  // Sends kHandoffPackets stamped RTP packets, with an RTCP packet after
+  // every eighth, keeping at most kHandoffWindow of them in flight.
+  bool SendStampedPackets1() {
+    for (int i = 0; i < kHandoffPackets; ++i) {
+      while (i - handoffs_ >= kHandoffWindow) {
+        talk_base::Thread::SleepMs(0);
+      }
+      bool rtcp = (i % 8 == 7);
+      std::string data(rtcp ? rtcp_packet_ : rtp_packet_);
+      size_t offset = rtcp ? 8 : 12;
+      uint64 now = talk_base::TimeNanos();
+      memcpy(&data[offset], &i, sizeof(i));
+      memcpy(&data[offset + sizeof(i)], &now, sizeof(now));
+      bool sent = rtcp ?
+          media_channel1_->SendRtcp(data.c_str(), data.size()) :
+          media_channel1_->SendRtp(data.c_str(), data.size());
+      if (!sent) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void OnStampedPacket(const void* data, size_t len, bool rtcp) {
+    uint64 now = talk_base::TimeNanos();
+    const char* p = static_cast<const char*>(data) + (rtcp ? 8 : 12);
+    int index;
+    uint64 sent;
+    memcpy(&index, p, sizeof(index));
+    memcpy(&sent, p + sizeof(index), sizeof(sent));
+    if (index != handoffs_ || rtcp != (index % 8 == 7)) {
+      handoffs_in_order_ = false;
+    }
+    handoff_ns_ += now - sent;
+    max_handoff_ns_ = talk_base::_max(max_handoff_ns_, now - sent);
+    ++handoffs_;
+  }
+
   void AddLegacyStreamInContent(uint32 ssrc, int flags,
                         typename T::Content* content) {
     // Base implementation.
@@ -1119,6 +1160,92 @@ class ChannelTest : public testing::Test, public sigslot::has_slots<> {
     EXPECT_TRUE(CheckNoRtcp2());
   }
 
+  // Check that received packets are staged in recycled buffers, so that
+  // steady state reception does not touch the heap.
+  void RecvBuffersAreReused() {
+    CreateChannels(RTCP, RTCP);
+    EXPECT_TRUE(SendInitiate());
+    EXPECT_TRUE(SendAccept());
+    EXPECT_TRUE(SendRtp1());
+    EXPECT_TRUE(CheckRtp2());
+    size_t allocations = channel2_->recv_buffer_pool().allocations();
+    EXPECT_LT(0U, allocations);
+    for (int i = 0; i < 100; ++i) {
+      EXPECT_TRUE(SendRtp1());
+      EXPECT_TRUE(CheckRtp2());
+      EXPECT_TRUE(SendRtcp1());
+      EXPECT_TRUE(CheckRtcp2());
+    }
+    EXPECT_EQ(allocations, channel2_->recv_buffer_pool().allocations());
+    EXPECT_EQ(201U, channel2_->recv_buffer_pool().packets());
+  }
+
+  // Measure the rate at which packets sent on another thread reach the
+  // worker, and how long each one waits to be picked up, both through the
+  // send queue and posted one by one. Also checks that RTP and RTCP come out
+  // in the order they went in.
+  void SendRtpFromThreadPerf() {
+    CreateChannels(RTCP, RTCP);
+    EXPECT_TRUE(SendInitiate());
+    EXPECT_TRUE(SendAccept());
+    channel1_->RegisterSendSink(
+        this, &ChannelTest<T>::OnStampedPacket, cricket::SINK_PRE_CRYPTO);
+    channel1_->set_send_queue_enabled(false);
+    MeasureHandoff("posted");
+    channel1_->set_send_queue_enabled(true);
+    MeasureHandoff("queued");
+    channel1_->UnregisterSendSink(this, cricket::SINK_PRE_CRYPTO);
+  }
+
+  void MeasureHandoff(const char* path) {
+    handoffs_ = 0;
+    handoffs_in_order_ = true;
+    handoff_ns_ = 0;
+    max_handoff_ns_ = 0;
+    bool sent = false;
+    uint64 start = talk_base::TimeNanos();
+    CallOnThread(&ChannelTest<T>::SendStampedPackets1, &sent);
+    EXPECT_EQ_WAIT(kHandoffPackets, handoffs_, 30000);
+    uint64 elapsed = talk_base::TimeNanos() - start;
+    EXPECT_TRUE_WAIT(sent, 1000);
+    EXPECT_TRUE(handoffs_in_order_);
+    LOG(LS_INFO) << "Handed off " << handoffs_ << " " << path
+                 << " packets at "
+                 << handoffs_ * talk_base::kNumNanosecsPerSec /
+                        talk_base::_max<uint64>(elapsed, 1)
+                 << " packets/s, mean latency "
+                 << handoff_ns_ / talk_base::_max(handoffs_, 1)
+                 << " ns, max " << max_handoff_ns_ << " ns";
+  }
+
+  // Check that with pacing on, a burst of RTP is spread out (unless it has
+  // priority, as audio does) and still arrives in full, while RTCP skips the
+  // queue.
+  void SendRtpPaced(bool priority) {
+    CreateChannels(RTCP, RTCP);
+    channel1_->set_paced_send(true);
+    EXPECT_TRUE(channel1_->SetMaxSendBandwidth(64000));
+    EXPECT_TRUE(SendInitiate());
+    EXPECT_TRUE(SendAccept());
+    // More than a pacing interval's worth of budget at this rate.
+    const int num_packets =
+        2 * static_cast<int>(cricket::kMaxRtpPacketLen / rtp_packet_.size());
+    for (int i = 0; i < num_packets; ++i) {
+      EXPECT_TRUE(SendRtp1());
+    }
+    const cricket::PacedSender& pacer = channel1_->paced_sender();
+    EXPECT_EQ(priority, pacer.queue_size() == 0U);
+    EXPECT_TRUE(SendRtcp1());
+    EXPECT_TRUE(CheckRtcp2());
+    for (int i = 0; i < num_packets; ++i) {
+      EXPECT_TRUE_WAIT(CheckRtp2(), 2000);
+    }
+    EXPECT_TRUE(CheckNoRtp2());
+    EXPECT_EQ(static_cast<uint64>(num_packets + 1), pacer.stats().packets_sent);
+    EXPECT_EQ(priority, pacer.stats().packets_delayed == 0U);
+    EXPECT_EQ(0U, pacer.stats().packets_dropped);
+  }
+
   // Check that RTCP is transmitted if only the initiator supports mux.
   void SendRtcpMuxToRtcp() {
     CreateChannels(RTCP | RTCP_MUX, RTCP);
@@ -1801,6 +1928,11 @@ class ChannelTest : public testing::Test, public sigslot::has_slots<> {
 
   uint32 ssrc_;
   typename T::MediaChannel::Error error_;
+  // Written on the worker thread, polled by SendStampedPackets1.
+  volatile int handoffs_;
+  bool handoffs_in_order_;
+  uint64 handoff_ns_;
+  uint64 max_handoff_ns_;
 };
 
 
@@ -2046,6 +2178,10 @@ TEST_F(VoiceChannelTest, SendRtcpToRtcp) {
   Base::SendRtcpToRtcp();
 }
 
+TEST_F(VoiceChannelTest, RecvBuffersAreReused) {
+  Base::RecvBuffersAreReused();
+}
+
 TEST_F(VoiceChannelTest, SendRtcpMuxToRtcp) {
   Base::SendRtcpMuxToRtcp();
 }
@@ -2097,6 +2233,14 @@ TEST_F(VoiceChannelTest, SendRtpToRtpOnThread) {
   Base::SendRtpToRtpOnThread();
 }
 
+TEST_F(VoiceChannelTest, SendRtpFromThreadPerf) {
+  Base::SendRtpFromThreadPerf();
+}
+
+TEST_F(VoiceChannelTest, SendRtpPaced) {
+  Base::SendRtpPaced(true);
+}
+
 TEST_F(VoiceChannelTest, SendSrtpToSrtpOnThread) {
   Base::SendSrtpToSrtpOnThread();
 }
@@ -2453,6 +2597,10 @@ TEST_F(VideoChannelTest, SendRtcpToRtcp) {
   Base::SendRtcpToRtcp();
 }
 
+TEST_F(VideoChannelTest, RecvBuffersAreReused) {
+  Base::RecvBuffersAreReused();
+}
+
 TEST_F(VideoChannelTest, SendRtcpMuxToRtcp) {
   Base::SendRtcpMuxToRtcp();
 }
@@ -2504,6 +2652,14 @@ TEST_F(VideoChannelTest, SendRtpToRtpOnThread) {
   Base::SendRtpToRtpOnThread();
 }
 
+TEST_F(VideoChannelTest, SendRtpFromThreadPerf) {
+  Base::SendRtpFromThreadPerf();
+}
+
+TEST_F(VideoChannelTest, SendRtpPaced) {
+  Base::SendRtpPaced(false);
+}
+
 TEST_F(VideoChannelTest, SendSrtpToSrtpOnThread) {
   Base::SendSrtpToSrtpOnThread();
 }
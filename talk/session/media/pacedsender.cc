@@ -0,0 +1,175 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/session/media/pacedsender.h"
+
+#include <algorithm>
+
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+#include "talk/media/base/rtputils.h"
+
+namespace cricket {
+
+enum {
+  MSG_PROCESS = 1
+};
+
+// Keep a few packets worth of queue even at very low rates.
+static const size_t kMinQueuedBytes = 4 * kMaxRtpPacketLen;
+
+static double NowInSeconds() {
+  return static_cast<double>(talk_base::TimeNanos()) /
+      talk_base::kNumNanosecsPerSec;
+}
+
+PacedSender::PacedSender(talk_base::Thread* thread)
+    : thread_(thread),
+      queued_bytes_(0),
+      max_queued_bytes_(0),
+      process_posted_(false) {
+}
+
+PacedSender::~PacedSender() {
+  thread_->Clear(this);
+  Clear();
+  for (size_t i = 0; i < free_.size(); ++i) {
+    delete free_[i];
+  }
+}
+
+void PacedSender::SetRate(int bps) {
+  if (bps <= 0) {
+    limiter_.reset();
+    // Nothing holds packets back anymore.
+    Process();
+    return;
+  }
+  // The budget is handed out every kPacingIntervalMs, but must cover at least
+  // one full packet or large packets would never fit.
+  size_t bytes_per_interval = static_cast<size_t>(
+      static_cast<int64>(bps) * kPacingIntervalMs / 8 /
+      talk_base::kNumMillisecsPerSec);
+  bytes_per_interval = std::max(bytes_per_interval, kMaxRtpPacketLen);
+  double interval = static_cast<double>(bytes_per_interval) * 8 / bps;
+  limiter_.reset(new talk_base::RateLimiter(bytes_per_interval, interval));
+  max_queued_bytes_ = std::max(kMinQueuedBytes, static_cast<size_t>(
+      static_cast<int64>(bps) * kMaxQueueDelayMs / 8 /
+      talk_base::kNumMillisecsPerSec));
+  Process();
+}
+
+bool PacedSender::SendPacket(bool rtcp, bool priority,
+                             talk_base::Buffer* packet) {
+  if (priority || (queue_.empty() && CanSend(packet->length()))) {
+    SendNow(rtcp, packet);
+    return true;
+  }
+
+  if (queued_bytes_ + packet->length() > max_queued_bytes_) {
+    ++stats_.packets_dropped;
+    return false;
+  }
+  QueuedPacket* queued;
+  if (!free_.empty()) {
+    queued = free_.back();
+    free_.pop_back();
+  } else {
+    queued = new QueuedPacket;
+  }
+  queued->rtcp = rtcp;
+  queued->queued_time = talk_base::Time();
+  // Avoid a copy by transferring the ownership of the packet data.
+  packet->TransferTo(&queued->packet);
+  queued_bytes_ += queued->packet.length();
+  queue_.push_back(queued);
+  ScheduleProcess();
+  return true;
+}
+
+void PacedSender::Clear() {
+  while (!queue_.empty()) {
+    Recycle(queue_.front());
+    queue_.pop_front();
+  }
+  queued_bytes_ = 0;
+}
+
+void PacedSender::OnMessage(talk_base::Message* msg) {
+  ASSERT(msg->message_id == MSG_PROCESS);
+  process_posted_ = false;
+  Process();
+}
+
+void PacedSender::Process() {
+  while (!queue_.empty() && CanSend(queue_.front()->packet.length())) {
+    QueuedPacket* queued = queue_.front();
+    queue_.pop_front();
+    queued_bytes_ -= queued->packet.length();
+    int delay = talk_base::TimeSince(queued->queued_time);
+    ++stats_.packets_delayed;
+    stats_.total_queue_delay_ms += delay;
+    stats_.max_queue_delay_ms = std::max(stats_.max_queue_delay_ms, delay);
+    SendNow(queued->rtcp, &queued->packet);
+    Recycle(queued);
+  }
+  if (!queue_.empty()) {
+    ScheduleProcess();
+  }
+}
+
+void PacedSender::SendNow(bool rtcp, talk_base::Buffer* packet) {
+  if (limiter_) {
+    limiter_->Use(packet->length(), NowInSeconds());
+  }
+  ++stats_.packets_sent;
+  SignalSendPacket(rtcp, packet);
+}
+
+bool PacedSender::CanSend(size_t len) const {
+  if (!limiter_) {
+    return true;
+  }
+  // Packets larger than a whole interval's budget go out at the start of
+  // a fresh interval.
+  len = std::min(len, limiter_->max_per_period());
+  return limiter_->CanUse(len, NowInSeconds());
+}
+
+void PacedSender::ScheduleProcess() {
+  if (!process_posted_) {
+    process_posted_ = true;
+    thread_->PostDelayed(kPacingIntervalMs, this, MSG_PROCESS);
+  }
+}
+
+void PacedSender::Recycle(QueuedPacket* queued) {
+  queued->packet.SetLength(0);
+  free_.push_back(queued);
+}
+
+}  // namespace cricket
@@ -0,0 +1,135 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_SESSION_MEDIA_PACEDSENDER_H_
+#define TALK_SESSION_MEDIA_PACEDSENDER_H_
+
+#include <deque>
+#include <vector>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/buffer.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/messagehandler.h"
+#include "talk/base/ratelimiter.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/sigslot.h"
+
+namespace talk_base {
+class Thread;
+}
+
+namespace cricket {
+
+struct PacedSenderStats {
+  PacedSenderStats()
+      : packets_sent(0),
+        packets_delayed(0),
+        packets_dropped(0),
+        total_queue_delay_ms(0),
+        max_queue_delay_ms(0) {
+  }
+
+  // Average time a delayed packet waited before it was sent.
+  int avg_queue_delay_ms() const {
+    return packets_delayed ?
+        static_cast<int>(total_queue_delay_ms / packets_delayed) : 0;
+  }
+
+  uint64 packets_sent;  // Sent right away or after waiting.
+  uint64 packets_delayed;  // Sent after waiting in the queue.
+  uint64 packets_dropped;  // Dropped because the queue was full.
+  uint64 total_queue_delay_ms;
+  int max_queue_delay_ms;
+};
+
+// Spreads outgoing packets out to a given bitrate, so that a burst from the
+// encoder (say, a key frame) doesn't hit the network all at once and overflow
+// shallow router buffers. Packets that fit in the current budget go out right
+// away; the rest wait, in order, and are sent every few milliseconds as the
+// budget is replenished. Priority packets (RTCP, audio) are never held back,
+// but use up budget like everything else, so they effectively jump the queue.
+// Packets that would wait longer than kMaxQueueDelayMs are dropped.
+// Not thread-safe; use from the thread passed to the constructor.
+class PacedSender : public talk_base::MessageHandler {
+ public:
+  static const int kPacingIntervalMs = 5;
+  static const int kMaxQueueDelayMs = 1000;
+
+  explicit PacedSender(talk_base::Thread* thread);
+  virtual ~PacedSender();
+
+  // Paces to |bps| bits per second. A rate <= 0 turns pacing off; anything
+  // still queued is sent immediately.
+  void SetRate(int bps);
+  bool enabled() const { return limiter_.get() != NULL; }
+
+  // Sends |packet| through SignalSendPacket now if the budget allows (or it
+  // has |priority|), and otherwise queues it, taking its data. Returns false
+  // if the packet was dropped because the queue is full.
+  bool SendPacket(bool rtcp, bool priority, talk_base::Buffer* packet);
+
+  // Drops everything that is queued without counting it as dropped.
+  void Clear();
+
+  size_t queue_size() const { return queue_.size(); }
+  size_t queued_bytes() const { return queued_bytes_; }
+  const PacedSenderStats& stats() const { return stats_; }
+
+  // Fired for every packet that leaves the pacer, with its rtcp flag.
+  sigslot::signal2<bool, talk_base::Buffer*> SignalSendPacket;
+
+ private:
+  struct QueuedPacket {
+    bool rtcp;
+    uint32 queued_time;
+    talk_base::Buffer packet;
+  };
+
+  virtual void OnMessage(talk_base::Message* msg);
+  // Sends queued packets while the budget allows.
+  void Process();
+  void SendNow(bool rtcp, talk_base::Buffer* packet);
+  bool CanSend(size_t len) const;
+  void ScheduleProcess();
+  void Recycle(QueuedPacket* queued);
+
+  talk_base::Thread* thread_;
+  talk_base::scoped_ptr<talk_base::RateLimiter> limiter_;
+  std::deque<QueuedPacket*> queue_;
+  std::vector<QueuedPacket*> free_;
+  size_t queued_bytes_;
+  size_t max_queued_bytes_;
+  bool process_posted_;
+  PacedSenderStats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(PacedSender);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_SESSION_MEDIA_PACEDSENDER_H_
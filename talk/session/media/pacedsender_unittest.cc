@@ -0,0 +1,149 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+
+#include "talk/base/gunit.h"
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+#include "talk/session/media/pacedsender.h"
+
+using cricket::PacedSender;
+
+static const size_t kPacketSize = 1000;
+
+class PacedSenderTest : public testing::Test, public sigslot::has_slots<> {
+ public:
+  PacedSenderTest() : pacer_(talk_base::Thread::Current()), next_id_(0) {
+    pacer_.SignalSendPacket.connect(this, &PacedSenderTest::OnSendPacket);
+  }
+
+ protected:
+  // Sends a packet whose first byte identifies it.
+  bool Send(bool rtcp, bool priority) {
+    talk_base::Buffer packet(NULL, 0, kPacketSize);
+    packet.SetLength(kPacketSize);
+    packet.data()[0] = static_cast<char>(next_id_++);
+    return pacer_.SendPacket(rtcp, priority, &packet);
+  }
+
+  void OnSendPacket(bool rtcp, talk_base::Buffer* packet) {
+    EXPECT_EQ(kPacketSize, packet->length());
+    sent_ids_.push_back(packet->data()[0]);
+    sent_rtcp_.push_back(rtcp);
+  }
+
+  PacedSender pacer_;
+  int next_id_;
+  std::vector<int> sent_ids_;
+  std::vector<bool> sent_rtcp_;
+};
+
+TEST_F(PacedSenderTest, PassesThroughWhenDisabled) {
+  EXPECT_FALSE(pacer_.enabled());
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(Send(false, false));
+  }
+  EXPECT_EQ(100U, sent_ids_.size());
+  EXPECT_EQ(0U, pacer_.queue_size());
+  EXPECT_EQ(100U, pacer_.stats().packets_sent);
+  EXPECT_EQ(0U, pacer_.stats().packets_delayed);
+}
+
+// 800 kbps is 100 bytes per millisecond, so a burst of 20 packets should take
+// about 200 ms to drain, in order.
+TEST_F(PacedSenderTest, SpreadsOutBurst) {
+  pacer_.SetRate(800000);
+  EXPECT_TRUE(pacer_.enabled());
+  uint32 start = talk_base::Time();
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_TRUE(Send(false, false));
+  }
+  EXPECT_LT(0U, sent_ids_.size());
+  EXPECT_LT(10U, pacer_.queue_size());
+  EXPECT_EQ(pacer_.queue_size() * kPacketSize, pacer_.queued_bytes());
+  EXPECT_EQ_WAIT(20U, sent_ids_.size(), 2000);
+  EXPECT_LE(150, talk_base::TimeSince(start));
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ(i, sent_ids_[i]);
+  }
+  EXPECT_EQ(0U, pacer_.queued_bytes());
+  const cricket::PacedSenderStats& stats = pacer_.stats();
+  EXPECT_EQ(20U, stats.packets_sent);
+  EXPECT_LT(10U, stats.packets_delayed);
+  EXPECT_EQ(0U, stats.packets_dropped);
+  EXPECT_LE(100, stats.max_queue_delay_ms);
+  EXPECT_LT(0, stats.avg_queue_delay_ms());
+  EXPECT_GE(stats.max_queue_delay_ms, stats.avg_queue_delay_ms());
+}
+
+TEST_F(PacedSenderTest, PriorityAndRtcpSkipQueue) {
+  pacer_.SetRate(800000);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(Send(false, false));
+  }
+  size_t sent = sent_ids_.size();
+  ASSERT_LT(0U, pacer_.queue_size());
+  EXPECT_TRUE(Send(true, true));
+  EXPECT_TRUE(Send(false, true));
+  ASSERT_EQ(sent + 2, sent_ids_.size());
+  EXPECT_EQ(10, sent_ids_[sent]);
+  EXPECT_TRUE(sent_rtcp_[sent]);
+  EXPECT_EQ(11, sent_ids_[sent + 1]);
+  EXPECT_FALSE(sent_rtcp_[sent + 1]);
+  EXPECT_EQ_WAIT(12U, sent_ids_.size(), 2000);
+}
+
+// At 64 kbps, only about a second's worth of data (8000 bytes) may wait.
+TEST_F(PacedSenderTest, DropsWhenQueueIsFull) {
+  pacer_.SetRate(64000);
+  int dropped = 0;
+  for (int i = 0; i < 30; ++i) {
+    if (!Send(false, false)) {
+      ++dropped;
+    }
+  }
+  EXPECT_LT(0, dropped);
+  EXPECT_EQ(static_cast<uint64>(dropped), pacer_.stats().packets_dropped);
+  EXPECT_GT(10 * kPacketSize, pacer_.queued_bytes());
+  EXPECT_EQ(30U, sent_ids_.size() + pacer_.queue_size() + dropped);
+}
+
+TEST_F(PacedSenderTest, DisablingFlushesQueue) {
+  pacer_.SetRate(64000);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_TRUE(Send(false, false));
+  }
+  EXPECT_LT(0U, pacer_.queue_size());
+  pacer_.SetRate(0);
+  EXPECT_FALSE(pacer_.enabled());
+  EXPECT_EQ(0U, pacer_.queue_size());
+  ASSERT_EQ(5U, sent_ids_.size());
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(i, sent_ids_[i]);
+  }
+}
@@ -0,0 +1,95 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_SESSION_MEDIA_PACKETBUFFERPOOL_H_
+#define TALK_SESSION_MEDIA_PACKETBUFFERPOOL_H_
+
+#include <vector>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/buffer.h"
+#include "talk/base/constructormagic.h"
+
+namespace cricket {
+
+// Recycles the buffers that incoming packets are unprotected and delivered
+// in. Each buffer is created with room for |buffer_size| bytes, so once the
+// pool has as many buffers as there are packets in flight at once (normally
+// one), Acquire and Release never touch the heap. allocations() counts every
+// heap allocation made on behalf of the pool, including buffers that had to
+// grow or that a consumer took ownership of via Buffer::TransferTo, so a
+// constant value across packets shows that the path is allocation-free.
+// Not thread-safe; use from a single thread.
+class PacketBufferPool {
+ public:
+  explicit PacketBufferPool(size_t buffer_size)
+      : buffer_size_(buffer_size), allocations_(0), packets_(0) {
+  }
+  ~PacketBufferPool() {
+    for (size_t i = 0; i < free_.size(); ++i) {
+      delete free_[i];
+    }
+  }
+
+  // Returns a buffer holding a copy of |data|. Give it back with Release.
+  talk_base::Buffer* Acquire(const char* data, size_t len) {
+    talk_base::Buffer* buffer;
+    if (!free_.empty()) {
+      buffer = free_.back();
+      free_.pop_back();
+    } else {
+      buffer = new talk_base::Buffer(NULL, 0, buffer_size_);
+      // One for the Buffer, one for its storage.
+      allocations_ += 2;
+    }
+    if (len > buffer->capacity()) {
+      ++allocations_;
+    }
+    buffer->SetData(data, len);
+    ++packets_;
+    return buffer;
+  }
+
+  void Release(talk_base::Buffer* buffer) {
+    free_.push_back(buffer);
+  }
+
+  size_t allocations() const { return allocations_; }
+  uint64 packets() const { return packets_; }
+
+ private:
+  size_t buffer_size_;
+  std::vector<talk_base::Buffer*> free_;
+  size_t allocations_;
+  uint64 packets_;
+
+  DISALLOW_COPY_AND_ASSIGN(PacketBufferPool);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_SESSION_MEDIA_PACKETBUFFERPOOL_H_
@@ -231,6 +231,26 @@ bool SrtpFilter::UnprotectRtcp(void* p, int in_len, int* out_len) {
   }
 }
 
+int SrtpFilter::ProtectRtp(std::vector<SrtpPacket>* packets) {
+  if (!IsActive()) {
+    LOG(LS_WARNING) << "Failed to ProtectRtp: SRTP not active";
+    for (size_t i = 0; i < packets->size(); ++i)
+      (*packets)[i].ok = false;
+    return 0;
+  }
+  return send_session_->ProtectRtp(packets);
+}
+
+int SrtpFilter::UnprotectRtp(std::vector<SrtpPacket>* packets) {
+  if (!IsActive()) {
+    LOG(LS_WARNING) << "Failed to UnprotectRtp: SRTP not active";
+    for (size_t i = 0; i < packets->size(); ++i)
+      (*packets)[i].ok = false;
+    return 0;
+  }
+  return recv_session_->UnprotectRtp(packets);
+}
+
 void SrtpFilter::set_signal_silent_time(uint32 signal_silent_time_in_ms) {
   signal_silent_time_in_ms_ = signal_silent_time_in_ms;
   if (state_ == ST_ACTIVE) {
@@ -512,6 +532,83 @@ bool SrtpSession::UnprotectRtp(void* p, int in_len, int* out_len) {
   return true;
 }
 
+// Successful results are not passed to |srtp_stat_|, since it ignores them.
+int SrtpSession::ProtectRtp(std::vector<SrtpPacket>* packets) {
+  int num_ok = 0;
+  int num_failed = 0;
+  int first_err = err_status_ok;
+  SrtpPacket* last_ok = NULL;
+  for (size_t i = 0; i < packets->size(); ++i) {
+    SrtpPacket& packet = (*packets)[i];
+    packet.ok = false;
+    if (!session_ || packet.max_len < packet.len + rtp_auth_tag_len_) {
+      ++num_failed;
+      continue;
+    }
+    int in_len = packet.len;
+    int err = srtp_protect(session_, packet.data, &packet.len);
+    if (err != err_status_ok) {
+      uint32 ssrc;
+      if (GetRtpSsrc(packet.data, in_len, &ssrc)) {
+        srtp_stat_->AddProtectRtpResult(ssrc, err);
+      }
+      if (first_err == err_status_ok)
+        first_err = err;
+      ++num_failed;
+      continue;
+    }
+    packet.ok = true;
+    last_ok = &packet;
+    ++num_ok;
+  }
+  if (last_ok) {
+    GetRtpSeqNum(last_ok->data, last_ok->len, &last_send_seq_num_);
+  }
+  if (num_failed > 0) {
+    LOG(LS_WARNING) << "Failed to protect " << num_failed << " of "
+                    << packets->size() << " SRTP packets"
+                    << (session_ ? "" : ": no SRTP Session")
+                    << ", first err=" << first_err << ", last seqnum="
+                    << last_send_seq_num_;
+  }
+  return num_ok;
+}
+
+int SrtpSession::UnprotectRtp(std::vector<SrtpPacket>* packets) {
+  int num_ok = 0;
+  int num_failed = 0;
+  int first_err = err_status_ok;
+  for (size_t i = 0; i < packets->size(); ++i) {
+    SrtpPacket& packet = (*packets)[i];
+    packet.ok = false;
+    if (!session_) {
+      ++num_failed;
+      continue;
+    }
+    int in_len = packet.len;
+    int err = srtp_unprotect(session_, packet.data, &packet.len);
+    if (err != err_status_ok) {
+      uint32 ssrc;
+      if (GetRtpSsrc(packet.data, in_len, &ssrc)) {
+        srtp_stat_->AddUnprotectRtpResult(ssrc, err);
+      }
+      if (first_err == err_status_ok)
+        first_err = err;
+      ++num_failed;
+      continue;
+    }
+    packet.ok = true;
+    ++num_ok;
+  }
+  if (num_failed > 0) {
+    LOG(LS_WARNING) << "Failed to unprotect " << num_failed << " of "
+                    << packets->size() << " SRTP packets"
+                    << (session_ ? "" : ": no SRTP Session")
+                    << ", first err=" << first_err;
+  }
+  return num_ok;
+}
+
 bool SrtpSession::UnprotectRtcp(void* p, int in_len, int* out_len) {
   if (!session_) {
     LOG(LS_WARNING) << "Failed to unprotect SRTCP packet: no SRTP Session";
@@ -676,6 +773,20 @@ bool SrtpSession::UnprotectRtcp(void* data, int in_len, int* out_len) {
   return SrtpNotAvailable(__FUNCTION__);
 }
 
+int SrtpSession::ProtectRtp(std::vector<SrtpPacket>* packets) {
+  SrtpNotAvailable(__FUNCTION__);
+  for (size_t i = 0; i < packets->size(); ++i)
+    (*packets)[i].ok = false;
+  return 0;
+}
+
+int SrtpSession::UnprotectRtp(std::vector<SrtpPacket>* packets) {
+  SrtpNotAvailable(__FUNCTION__);
+  for (size_t i = 0; i < packets->size(); ++i)
+    (*packets)[i].ok = false;
+  return 0;
+}
+
 void SrtpSession::set_signal_silent_time(uint32 signal_silent_time) {
   // Do nothing.
 }
@@ -66,6 +66,17 @@ class SrtpStat;
 
 void EnableSrtpDebugging();
 
+// A packet for the batch Protect/Unprotect calls. The packet is transformed
+// in place; |len| is updated to the output length and |ok| to the result.
+struct SrtpPacket {
+  SrtpPacket() : data(NULL), len(0), max_len(0), ok(false) {}
+  SrtpPacket(void* d, int l, int m) : data(d), len(l), max_len(m), ok(false) {}
+  void* data;
+  int len;
+  int max_len;  // Only used when protecting.
+  bool ok;
+};
+
 // Class to transform SRTP to/from RTP.
 // Initialize by calling SetSend with the local security params, then call
 // SetRecv once the remote security params are received. At that point
@@ -126,6 +137,12 @@ class SrtpFilter {
   // If an HMAC is used, this will decrease the packet size.
   bool UnprotectRtp(void* data, int in_len, int* out_len);
   bool UnprotectRtcp(void* data, int in_len, int* out_len);
+  // Protects/unprotects each of |packets| as the calls above would, and
+  // returns the number that succeeded. Going through a batch in one call
+  // keeps the session's key schedule hot, and failures are logged once per
+  // batch rather than once per packet.
+  int ProtectRtp(std::vector<SrtpPacket>* packets);
+  int UnprotectRtp(std::vector<SrtpPacket>* packets);
 
   // Update the silent threshold (in ms) for signaling errors.
   void set_signal_silent_time(uint32 signal_silent_time_in_ms);
@@ -202,6 +219,10 @@ class SrtpSession {
   // If an HMAC is used, this will decrease the packet size.
   bool UnprotectRtp(void* data, int in_len, int* out_len);
   bool UnprotectRtcp(void* data, int in_len, int* out_len);
+  // Protects/unprotects each of |packets| in turn, as above. Returns the
+  // number that succeeded.
+  int ProtectRtp(std::vector<SrtpPacket>* packets);
+  int UnprotectRtp(std::vector<SrtpPacket>* packets);
 
   // Update the silent threshold (in ms) for signaling errors.
   void set_signal_silent_time(uint32 signal_silent_time_in_ms);
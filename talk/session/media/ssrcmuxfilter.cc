@@ -47,18 +47,24 @@ bool SsrcMuxFilter::IsActive() const {
 }
 
 bool SsrcMuxFilter::DemuxPacket(const char* data, size_t len, bool rtcp) {
+  ParsedPacket packet;
+  ParsePacket(data, len, rtcp, &packet);
+  return DemuxPacket(packet);
+}
+
+bool SsrcMuxFilter::DemuxPacket(const ParsedPacket& packet) {
   uint32 ssrc = 0;
-  if (!rtcp) {
-    GetRtpSsrc(data, len, &ssrc);
+  if (!packet.rtcp) {
+    ssrc = packet.header.ssrc;
   } else {
-    int pl_type = 0;
-    if (!GetRtcpType(data, len, &pl_type)) return false;
-    if (pl_type == kRtcpTypeSDES) {
+    if (packet.num_rtcp_blocks == 0) return false;
+    if (packet.rtcp_type == kRtcpTypeSDES) {
       // SDES packet parsing not supported.
       LOG(LS_INFO) << "SDES packet received for demux.";
       return true;
     } else {
-      if (!GetRtcpSsrc(data, len, &ssrc)) return false;
+      ssrc = packet.rtcp_ssrc;
+      if (ssrc == 0) return false;
       if (ssrc == kSsrc01) {
         // SSRC 1 has a special meaning and indicates generic feedback on
         // some systems and should never be dropped.  If it is forwarded
@@ -71,23 +77,22 @@ bool SsrcMuxFilter::DemuxPacket(const char* data, size_t len, bool rtcp) {
 }
 
 bool SsrcMuxFilter::AddStream(const StreamParams& stream) {
-  if (GetStreamBySsrc(streams_, stream.first_ssrc(), NULL)) {
+  if (!streams_.AddStream(stream)) {
       LOG(LS_WARNING) << "Stream already added to filter";
       return false;
   }
-  streams_.push_back(stream);
   return true;
 }
 
 bool SsrcMuxFilter::RemoveStream(uint32 ssrc) {
-  return RemoveStreamBySsrc(&streams_, ssrc);
+  return streams_.RemoveStreamBySsrc(ssrc);
 }
 
 bool SsrcMuxFilter::FindStream(uint32 ssrc) const {
   if (ssrc == 0) {
     return false;
   }
-  return (GetStreamBySsrc(streams_, ssrc, NULL));
+  return streams_.HasSsrc(ssrc);
 }
 
 }  // namespace cricket
@@ -28,9 +28,8 @@
 #ifndef TALK_SESSION_MEDIA_SSRCMUXFILTER_H_
 #define TALK_SESSION_MEDIA_SSRCMUXFILTER_H_
 
-#include <vector>
-
 #include "talk/base/basictypes.h"
+#include "talk/media/base/rtputils.h"
 #include "talk/media/base/streamparams.h"
 
 namespace cricket {
@@ -51,6 +50,8 @@ class SsrcMuxFilter {
   bool IsActive() const;
   // Determines packet belongs to valid cricket::BaseChannel.
   bool DemuxPacket(const char* data, size_t len, bool rtcp);
+  // Same, for a packet whose header has already been parsed.
+  bool DemuxPacket(const ParsedPacket& packet);
   // Adding a valid source to the filter.
   bool AddStream(const StreamParams& stream);
   // Removes source from the filter.
@@ -59,7 +60,9 @@ class SsrcMuxFilter {
   bool FindStream(uint32 ssrc) const;
 
  private:
-  std::vector<StreamParams> streams_;
+  // Indexed by every SSRC of each stream, so that demuxing a bundle with
+  // many streams stays a single hash lookup per packet.
+  StreamParamsIndex streams_;
 };
 
 }  // namespace cricket
@@ -26,7 +26,10 @@
  */
 
 
+#include "talk/base/byteorder.h"
 #include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/timeutils.h"
 #include "talk/session/media/ssrcmuxfilter.h"
 
 static const int kSsrc1 = 0x1111;
@@ -125,6 +128,21 @@ TEST(SsrcMuxFilterTest, AddRemoveStreamTest) {
   EXPECT_FALSE(ssrc_filter.IsActive());
 }
 
+TEST(SsrcMuxFilterTest, AddRemoveStreamWithFidTest) {
+  cricket::SsrcMuxFilter ssrc_filter;
+  StreamParams stream;
+  stream.ssrcs.push_back(kSsrc1);
+  EXPECT_TRUE(stream.AddFidSsrc(kSsrc1, kSsrc2));
+  EXPECT_TRUE(ssrc_filter.AddStream(stream));
+  // The RTX SSRC is demuxed to the stream, and can't be claimed twice.
+  EXPECT_TRUE(ssrc_filter.FindStream(kSsrc2));
+  EXPECT_FALSE(ssrc_filter.AddStream(StreamParams::CreateLegacy(kSsrc2)));
+  EXPECT_FALSE(ssrc_filter.FindStream(0));
+  EXPECT_TRUE(ssrc_filter.RemoveStream(kSsrc2));
+  EXPECT_FALSE(ssrc_filter.FindStream(kSsrc1));
+  EXPECT_FALSE(ssrc_filter.IsActive());
+}
+
 TEST(SsrcMuxFilterTest, RtpPacketTest) {
   cricket::SsrcMuxFilter ssrc_filter;
   EXPECT_TRUE(ssrc_filter.AddStream(StreamParams::CreateLegacy(kSsrc1)));
@@ -182,3 +200,76 @@ TEST(SsrcMuxFilterTest, RtcpPacketTest) {
       reinterpret_cast<const char*>(kRtcpPacketNonCompoundRtcpPliFeedback),
       sizeof(kRtcpPacketNonCompoundRtcpPliFeedback), true));
 }
+
+// Simulates bundling, where every channel on a transport sees every packet,
+// and logs the demux cost per packet when each channel's filter parses the
+// packet itself and when the header is parsed once and shared.
+TEST(SsrcMuxFilterTest, BundleDemuxPerformance) {
+  static const int kNumChannels = 16;
+  static const int kStreamsPerChannel = 4;
+  static const int kNumPackets = 20000;
+  cricket::SsrcMuxFilter filters[kNumChannels];
+  for (int i = 0; i < kNumChannels; ++i) {
+    for (int j = 0; j < kStreamsPerChannel; ++j) {
+      EXPECT_TRUE(filters[i].AddStream(StreamParams::CreateLegacy(
+          1000 + i * kStreamsPerChannel + j)));
+    }
+  }
+  char packet[sizeof(kRtpPacketSsrc1)];
+  memcpy(packet, kRtpPacketSsrc1, sizeof(packet));
+
+  for (int mode = 0; mode < 2; ++mode) {
+    bool shared = (mode == 1);
+    int accepted = 0;
+    uint32 start = talk_base::Time();
+    for (int i = 0; i < kNumPackets; ++i) {
+      talk_base::SetBE32(packet + 8,
+                         1000 + i % (kNumChannels * kStreamsPerChannel));
+      if (shared) {
+        cricket::ParsedPacket parsed;
+        cricket::ParsePacket(packet, sizeof(packet), false, &parsed);
+        for (int j = 0; j < kNumChannels; ++j)
+          accepted += filters[j].DemuxPacket(parsed) ? 1 : 0;
+      } else {
+        for (int j = 0; j < kNumChannels; ++j)
+          accepted += filters[j].DemuxPacket(packet, sizeof(packet), false) ?
+              1 : 0;
+      }
+    }
+    uint32 elapsed = talk_base::TimeSince(start);
+    EXPECT_EQ(kNumPackets, accepted);
+    LOG(LS_INFO) << (shared ? "Shared parse: " : "Parse per filter: ")
+                 << kNumPackets << " packets demuxed across " << kNumChannels
+                 << " channels in " << elapsed << " ms";
+  }
+}
+
+// Logs the demux cost for a single filter holding many streams, each with an
+// RTX SSRC, as in a large conference bundled on one transport.
+TEST(SsrcMuxFilterTest, ManyStreamsDemuxPerformance) {
+  static const uint32 kNumStreams = 100;
+  static const int kNumPackets = 200000;
+  cricket::SsrcMuxFilter ssrc_filter;
+  for (uint32 i = 0; i < kNumStreams; ++i) {
+    StreamParams stream;
+    stream.ssrcs.push_back(1000 + i);
+    stream.AddFidSsrc(1000 + i, 2000 + i);
+    EXPECT_TRUE(ssrc_filter.AddStream(stream));
+  }
+  char packet[sizeof(kRtpPacketSsrc1)];
+  memcpy(packet, kRtpPacketSsrc1, sizeof(packet));
+  cricket::ParsedPacket parsed;
+  cricket::ParsePacket(packet, sizeof(packet), false, &parsed);
+
+  int accepted = 0;
+  uint32 start = talk_base::Time();
+  for (int i = 0; i < kNumPackets; ++i) {
+    // Alternate between primary and RTX SSRCs, spread over all streams.
+    parsed.header.ssrc = ((i & 1) ? 2000 : 1000) + (i / 2) % kNumStreams;
+    accepted += ssrc_filter.DemuxPacket(parsed) ? 1 : 0;
+  }
+  uint32 elapsed = talk_base::TimeSince(start);
+  EXPECT_EQ(kNumPackets, accepted);
+  LOG(LS_INFO) << kNumPackets << " packets demuxed across " << kNumStreams
+               << " streams in " << elapsed << " ms";
+}
@@ -53,6 +53,11 @@ enum {
   MSG_SI_DESTROY,
 };
 
+// The size up to which PseudoTcp may grow its buffers to fill the path;
+// tunnels are often bulk transfers over high bandwidth-delay paths, which the
+// default fixed windows would throttle.
+const int kMaxTcpBufferSize = 1024 * 1024;
+
 struct EventData : public MessageData {
   int event, error;
   EventData(int ev, int err = 0) : event(ev), error(err) { }
@@ -147,6 +152,7 @@ bool PseudoTcpChannel::Connect(const std::string& content_name,
 
   ASSERT(tcp_ == NULL);
   tcp_ = new PseudoTcp(this, 0);
+  tcp_->SetOption(PseudoTcp::OPT_MAX_BUFFER, kMaxTcpBufferSize);
   if (session_->initiator()) {
     // Since we may try several protocols and network adapters that won't work,
     // waiting until we get our first writable notification before initiating
@@ -198,8 +204,13 @@ void PseudoTcpChannel::OnSessionTerminate(Session* session) {
     ASSERT(tcp_ == NULL);
     LOG(LS_INFO) << "Destroying unconnected PseudoTcpChannel";
     session_ = NULL;
-    if (stream_ != NULL)
+    if (stream_ != NULL) {
       stream_thread_->Post(this, MSG_ST_EVENT, new EventData(SE_CLOSE, -1));
+    } else {
+      // Nobody took the stream (the tunnel was declined), so nobody will
+      // close it.
+      CheckDestroy();
+    }
   }
 
   // Even though session_ is being destroyed, we mustn't clear the pointer,
@@ -255,6 +266,8 @@ StreamResult PseudoTcpChannel::Read(void* buffer, size_t buffer_len,
     return SR_BLOCK;
 
   stream_readable_ = false;
+  // Recv rather than GetReadData: the worker thread may grow the receive
+  // buffer as soon as cs_ is released, so nothing can be lent past here.
   int result = tcp_->Recv(static_cast<char*>(buffer), buffer_len);
   //LOG_F(LS_VERBOSE) << "Recv returned: " << result;
   if (result > 0) {
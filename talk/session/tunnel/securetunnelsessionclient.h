@@ -95,6 +95,9 @@ class SecureTunnelSessionClient : public TunnelSessionClient {
       const SessionDescription* offer);
 
  protected:
+  // The SSL stream is established end to end over the channel, so each
+  // secure tunnel keeps a session of its own.
+  virtual bool SupportsMultiplexing() const { return false; }
   virtual TunnelSession* MakeTunnelSession(
       Session* session, talk_base::Thread* stream_thread,
       TunnelSessionRole role);
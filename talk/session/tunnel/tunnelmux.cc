@@ -0,0 +1,646 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "talk/session/tunnel/tunnelmux.h"
+
+#include <algorithm>
+
+#include "talk/base/byteorder.h"
+#include "talk/base/common.h"
+#include "talk/base/logging.h"
+#include "talk/base/socket.h"
+#include "talk/base/thread.h"
+
+using talk_base::SE_CLOSE;
+using talk_base::SE_OPEN;
+using talk_base::SE_READ;
+using talk_base::SE_WRITE;
+using talk_base::SR_BLOCK;
+using talk_base::SR_EOS;
+using talk_base::SR_ERROR;
+using talk_base::SR_SUCCESS;
+using talk_base::SS_CLOSED;
+using talk_base::SS_OPEN;
+using talk_base::SS_OPENING;
+using talk_base::StreamInterface;
+using talk_base::StreamResult;
+using talk_base::StreamState;
+
+namespace cricket {
+
+// Size of the frame header.
+const size_t kHeaderSize = 8;
+// Largest payload that a frame can carry.
+const size_t kMaxPayloadSize = 0xFFFF;
+// Largest amount of data sent from one stream before the next stream with
+// data gets its turn.
+const size_t kMaxDataSize = 16 * 1024;
+// How much each side may send on a stream before the reader catches up, and
+// how much it may have buffered for sending.
+const uint32 kStreamWindow = 64 * 1024;
+// Stream that both sides have from the start.
+const uint32 kInitialStreamId = 1;
+// Amount read from the underlying stream at a time.
+const size_t kReadSize = 16 * 1024;
+
+enum {
+  MSG_DESTROY = 1,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// TunnelMux::Stream
+///////////////////////////////////////////////////////////////////////////////
+
+class TunnelMux::Stream : public StreamInterface {
+ public:
+  Stream(TunnelMux* mux, uint32 id) : mux_(mux), id_(id) { }
+  virtual ~Stream() {
+    Close();
+  }
+
+  virtual StreamState GetState() const {
+    if (!mux_)
+      return SS_CLOSED;
+    return mux_->GetStreamState(id_);
+  }
+  virtual StreamResult Read(void* buffer, size_t buffer_len,
+                            size_t* read, int* error) {
+    if (!mux_) {
+      if (error)
+        *error = ENOTCONN;
+      return SR_ERROR;
+    }
+    return mux_->ReadStream(id_, buffer, buffer_len, read, error);
+  }
+  virtual StreamResult Write(const void* data, size_t data_len,
+                             size_t* written, int* error) {
+    if (!mux_) {
+      if (error)
+        *error = ENOTCONN;
+      return SR_ERROR;
+    }
+    return mux_->WriteStream(id_, data, data_len, written, error);
+  }
+  virtual void Close() {
+    if (!mux_)
+      return;
+    TunnelMux* mux = mux_;
+    mux_ = NULL;
+    mux->CloseStream(id_);
+  }
+
+ private:
+  // The mux stays around until every stream it has handed out is closed.
+  TunnelMux* mux_;
+  uint32 id_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// TunnelMux
+///////////////////////////////////////////////////////////////////////////////
+
+TunnelMux::StreamInfo::StreamInfo()
+    : stream(NULL), status(ST_REQUESTED), send_buffer(kStreamWindow),
+      recv_buffer(kStreamWindow), send_window(kStreamWindow),
+      recv_consumed(0), scheduled(false), read_blocked(true),
+      write_blocked(false), close_sent(false), close_error(0) {
+}
+
+TunnelMux::TunnelMux(StreamInterface* stream, bool initiator)
+    : thread_(talk_base::Thread::Current()), stream_(stream),
+      initiator_(initiator), stream_open_(false), closing_(false),
+      closed_(false), next_id_(kInitialStreamId + (initiator ? 2 : 1)),
+      initial_stream_(NULL) {
+  stream_->SignalEvent.connect(this, &TunnelMux::OnStreamEvent);
+  initial_stream_ = AddStream(kInitialStreamId, ST_OPEN);
+  if (stream_->GetState() == SS_OPEN)
+    OnStreamEvent(stream_.get(), SE_OPEN | SE_READ | SE_WRITE, 0);
+}
+
+TunnelMux::~TunnelMux() {
+  ASSERT(streams_.empty());
+  for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+    delete it->second;
+}
+
+StreamInterface* TunnelMux::GetInitialStream() {
+  ASSERT(thread_->IsCurrent());
+  ASSERT(initial_stream_ != NULL);
+  StreamInterface* stream = initial_stream_;
+  initial_stream_ = NULL;
+  return stream;
+}
+
+StreamInterface* TunnelMux::OpenStream(const std::string& description) {
+  ASSERT(thread_->IsCurrent());
+  if (closing_ || description.size() > kMaxPayloadSize)
+    return NULL;
+  uint32 id = next_id_;
+  next_id_ += 2;
+  StreamInterface* stream = AddStream(id, ST_OPENING);
+  QueueFrame(MUX_OPEN, id, description.data(), description.size());
+  Flush();
+  return stream;
+}
+
+StreamInterface* TunnelMux::AcceptStream(uint32 id) {
+  ASSERT(thread_->IsCurrent());
+  StreamMap::iterator it = streams_.find(id);
+  if (it == streams_.end() || it->second->status != ST_REQUESTED)
+    return NULL;
+  StreamInfo* info = it->second;
+  info->status = ST_OPEN;
+  info->stream = new Stream(this, id);
+  PostStreamEvent(info, SE_OPEN | SE_READ | SE_WRITE, 0);
+  QueueFrame(MUX_ACCEPT, id, NULL, 0);
+  Flush();
+  return info->stream;
+}
+
+void TunnelMux::DeclineStream(uint32 id) {
+  ASSERT(thread_->IsCurrent());
+  StreamMap::iterator it = streams_.find(id);
+  if (it == streams_.end() || it->second->status != ST_REQUESTED)
+    return;
+  // The peer's stream goes away once it answers our close with its own.
+  it->second->status = ST_OPEN;
+  MaybeSendClose(it);
+  Flush();
+}
+
+//
+// Stream methods
+//
+
+StreamState TunnelMux::GetStreamState(uint32 id) const {
+  StreamMap::const_iterator it = streams_.find(id);
+  ASSERT(it != streams_.end());
+  const StreamInfo* info = it->second;
+  switch (info->status) {
+  case ST_OPEN:
+    return stream_open_ ? SS_OPEN : SS_OPENING;
+  case ST_CLOSED: {
+    size_t buffered = 0;
+    info->recv_buffer.GetBuffered(&buffered);
+    return (buffered > 0) ? SS_OPEN : SS_CLOSED;
+  }
+  default:
+    return SS_OPENING;
+  }
+}
+
+StreamResult TunnelMux::ReadStream(uint32 id, void* buffer, size_t buffer_len,
+                                   size_t* read, int* error) {
+  ASSERT(thread_->IsCurrent());
+  StreamMap::iterator it = streams_.find(id);
+  ASSERT(it != streams_.end());
+  StreamInfo* info = it->second;
+  size_t count = 0;
+  if (info->recv_buffer.Read(buffer, buffer_len, &count, NULL) != SR_SUCCESS) {
+    if (info->status == ST_CLOSED)
+      return SR_EOS;
+    info->read_blocked = true;
+    return SR_BLOCK;
+  }
+  if (read)
+    *read = count;
+
+  size_t buffered = 0;
+  info->recv_buffer.GetBuffered(&buffered);
+  if (info->status == ST_CLOSED) {
+    if (buffered == 0)
+      PostStreamEvent(info, SE_CLOSE, info->close_error);
+  } else {
+    // Open the peer's window once the reader has made a dent in it, rather
+    // than a frame per read.
+    info->recv_consumed += count;
+    if (info->recv_consumed >= kStreamWindow / 2) {
+      QueueWindow(id, info->recv_consumed);
+      info->recv_consumed = 0;
+      Flush();
+    }
+  }
+  return SR_SUCCESS;
+}
+
+StreamResult TunnelMux::WriteStream(uint32 id, const void* data,
+                                    size_t data_len, size_t* written,
+                                    int* error) {
+  ASSERT(thread_->IsCurrent());
+  StreamMap::iterator it = streams_.find(id);
+  ASSERT(it != streams_.end());
+  StreamInfo* info = it->second;
+  if (info->status == ST_CLOSED)
+    return SR_EOS;
+  if (info->status != ST_OPEN) {
+    info->write_blocked = true;
+    return SR_BLOCK;
+  }
+  size_t count = 0;
+  if (info->send_buffer.Write(data, data_len, &count, NULL) != SR_SUCCESS) {
+    info->write_blocked = true;
+    return SR_BLOCK;
+  }
+  if (written)
+    *written = count;
+  Schedule(id, info);
+  Flush();
+  return SR_SUCCESS;
+}
+
+void TunnelMux::CloseStream(uint32 id) {
+  ASSERT(thread_->IsCurrent());
+  StreamMap::iterator it = streams_.find(id);
+  ASSERT(it != streams_.end());
+  StreamInfo* info = it->second;
+  info->stream = NULL;
+  if (closed_) {
+    RemoveStream(it);
+    CheckDestroy();
+    return;
+  }
+  // Nobody will read what's left, so give the peer its window back.
+  size_t buffered = 0;
+  info->recv_buffer.GetBuffered(&buffered);
+  info->recv_buffer.ConsumeReadData(buffered);
+  if (info->status == ST_OPEN && info->recv_consumed + buffered > 0) {
+    QueueWindow(id, info->recv_consumed + buffered);
+    info->recv_consumed = 0;
+  }
+  // Anything already written still goes out before the close.
+  MaybeSendClose(it);
+  Flush();
+}
+
+talk_base::StreamInterface* TunnelMux::AddStream(uint32 id,
+                                                 StreamStatus status) {
+  ASSERT(streams_.find(id) == streams_.end());
+  StreamInfo* info = new StreamInfo;
+  info->status = status;
+  if (status != ST_REQUESTED)
+    info->stream = new Stream(this, id);
+  streams_[id] = info;
+  return info->stream;
+}
+
+void TunnelMux::RemoveStream(StreamMap::iterator it) {
+  ASSERT(it->second->stream == NULL);
+  delete it->second;
+  streams_.erase(it);
+  if (streams_.empty())
+    closing_ = true;
+}
+
+void TunnelMux::MaybeSendClose(StreamMap::iterator it) {
+  StreamInfo* info = it->second;
+  if (info->stream || info->close_sent)
+    return;
+  size_t buffered = 0;
+  info->send_buffer.GetBuffered(&buffered);
+  if (buffered > 0)
+    return;
+  if (info->status == ST_REQUESTED) {
+    // The peer gave up before we answered; there's nothing left to wait for.
+    QueueFrame(MUX_CLOSE, it->first, NULL, 0);
+    RemoveStream(it);
+    return;
+  }
+  QueueFrame(MUX_CLOSE, it->first, NULL, 0);
+  info->close_sent = true;
+  if (info->status == ST_CLOSED)
+    RemoveStream(it);
+}
+
+void TunnelMux::Schedule(uint32 id, StreamInfo* info) {
+  if (info->scheduled || info->send_window == 0)
+    return;
+  info->scheduled = true;
+  ready_.push_back(id);
+}
+
+void TunnelMux::PostStreamEvent(StreamInfo* info, int events, int error) {
+  if (info->stream)
+    info->stream->PostEvent(thread_, events, error);
+}
+
+//
+// Frames out
+//
+
+void TunnelMux::QueueFrame(FrameType type, uint32 id, const char* payload,
+                           size_t len) {
+  ASSERT(len <= kMaxPayloadSize);
+  control_.push_back(std::string(kHeaderSize, '\0'));
+  std::string& frame = control_.back();
+  frame[0] = static_cast<char>(type);
+  talk_base::SetBE16(&frame[2], static_cast<uint16>(len));
+  talk_base::SetBE32(&frame[4], id);
+  frame.append(payload, len);
+}
+
+void TunnelMux::QueueWindow(uint32 id, uint32 increment) {
+  char payload[4];
+  talk_base::SetBE32(payload, increment);
+  QueueFrame(MUX_WINDOW, id, payload, sizeof(payload));
+}
+
+bool TunnelMux::NextFrame() {
+  ASSERT(output_.empty());
+  if (!control_.empty()) {
+    output_.swap(control_.front());
+    control_.pop_front();
+    return true;
+  }
+  while (!ready_.empty()) {
+    uint32 id = ready_.front();
+    ready_.pop_front();
+    StreamMap::iterator it = streams_.find(id);
+    if (it == streams_.end())
+      continue;
+    StreamInfo* info = it->second;
+    info->scheduled = false;
+    size_t buffered = 0;
+    info->send_buffer.GetBuffered(&buffered);
+    size_t len = std::min(std::min(buffered, kMaxDataSize),
+                          static_cast<size_t>(info->send_window));
+    if (len == 0)
+      continue;
+
+    output_.resize(kHeaderSize + len);
+    output_[0] = static_cast<char>(MUX_DATA);
+    talk_base::SetBE16(&output_[2], static_cast<uint16>(len));
+    talk_base::SetBE32(&output_[4], id);
+    VERIFY(info->send_buffer.Read(&output_[kHeaderSize], len, NULL, NULL) ==
+           SR_SUCCESS);
+    info->send_window -= len;
+
+    // Go to the back of the line if there's more to send.
+    if (buffered > len)
+      Schedule(id, info);
+    if (info->write_blocked) {
+      info->write_blocked = false;
+      PostStreamEvent(info, SE_WRITE, 0);
+    }
+    MaybeSendClose(it);
+    return true;
+  }
+  return false;
+}
+
+void TunnelMux::Flush() {
+  while (stream_open_) {
+    if (output_.empty() && !NextFrame())
+      break;
+    size_t written = 0;
+    int error = 0;
+    StreamResult result = stream_->Write(output_.data(), output_.size(),
+                                         &written, &error);
+    if (result == SR_BLOCK)
+      return;
+    if (result != SR_SUCCESS) {
+      LOG(LS_WARNING) << "TunnelMux: write failed: " << error;
+      OnClosed(error);
+      return;
+    }
+    output_.erase(0, written);
+  }
+
+  // Once every stream is gone and the peer has heard about it, the
+  // underlying stream goes too.
+  if (stream_open_ && streams_.empty() && output_.empty()) {
+    LOG(LS_INFO) << "TunnelMux: all streams closed";
+    OnClosed(0);
+  }
+}
+
+//
+// Frames in
+//
+
+void TunnelMux::OnStreamEvent(StreamInterface* stream, int events,
+                              int error) {
+  ASSERT(stream == stream_.get());
+  if (closed_)
+    return;
+  if (events & SE_OPEN) {
+    stream_open_ = true;
+    for (StreamMap::iterator it = streams_.begin(); it != streams_.end();
+         ++it) {
+      if (it->second->status == ST_OPEN)
+        PostStreamEvent(it->second, SE_OPEN | SE_READ | SE_WRITE, 0);
+    }
+  }
+  if (events & SE_READ) {
+    ReadFrames();
+    if (closed_)
+      return;
+  }
+  if (events & (SE_OPEN | SE_WRITE)) {
+    Flush();
+    if (closed_)
+      return;
+  }
+  if (events & SE_CLOSE) {
+    LOG(LS_INFO) << "TunnelMux: underlying stream closed: " << error;
+    OnClosed(error);
+  }
+}
+
+void TunnelMux::ReadFrames() {
+  char buffer[kReadSize];
+  size_t read = 0;
+  int error = 0;
+  StreamResult result;
+  while ((result = stream_->Read(buffer, sizeof(buffer), &read, &error)) ==
+         SR_SUCCESS) {
+    input_.append(buffer, read);
+  }
+
+  size_t pos = 0;
+  while (input_.size() - pos >= kHeaderSize) {
+    const char* header = input_.data() + pos;
+    FrameType type = static_cast<FrameType>(
+        static_cast<unsigned char>(header[0]));
+    size_t len = talk_base::GetBE16(header + 2);
+    uint32 id = talk_base::GetBE32(header + 4);
+    if (input_.size() - pos < kHeaderSize + len)
+      break;
+    if (!HandleFrame(type, id, header + kHeaderSize, len)) {
+      LOG(LS_ERROR) << "TunnelMux: bad frame of type " << type
+                    << " for stream " << id;
+      OnClosed(ECONNABORTED);
+      return;
+    }
+    if (closed_)
+      return;
+    pos += kHeaderSize + len;
+  }
+  input_.erase(0, pos);
+  if (result != SR_BLOCK) {
+    OnClosed((result == SR_EOS) ? 0 : error);
+    return;
+  }
+  Flush();
+}
+
+bool TunnelMux::HandleFrame(FrameType type, uint32 id, const char* payload,
+                            size_t len) {
+  StreamMap::iterator it = streams_.find(id);
+  if (type == MUX_OPEN) {
+    if (((id % 2) == 1) == initiator_ || it != streams_.end())
+      return false;
+    if (closing_) {
+      QueueFrame(MUX_CLOSE, id, NULL, 0);
+      return true;
+    }
+    AddStream(id, ST_REQUESTED);
+    SignalStreamRequest(this, id, std::string(payload, len));
+    return true;
+  }
+
+  if (it == streams_.end()) {
+    // We may have already forgotten a stream we declined while closing, or
+    // one that both sides closed while the peer was still answering data.
+    return (type == MUX_CLOSE) || (type == MUX_WINDOW && len == 4);
+  }
+  StreamInfo* info = it->second;
+  switch (type) {
+  case MUX_ACCEPT:
+    if (info->status != ST_OPENING)
+      return false;
+    info->status = ST_OPEN;
+    PostStreamEvent(info, SE_OPEN | SE_READ | SE_WRITE, 0);
+    return true;
+
+  case MUX_DATA: {
+    if (info->status != ST_OPEN)
+      return false;
+    if (!info->stream) {
+      // We've closed our end; let the peer carry on until it hears. Once
+      // our close is on its way, the peer will drop what it has left anyway.
+      if (!info->close_sent)
+        QueueWindow(id, static_cast<uint32>(len));
+      return true;
+    }
+    size_t written = 0;
+    if (info->recv_buffer.Write(payload, len, &written, NULL) != SR_SUCCESS ||
+        written != len) {
+      // The peer has overrun the window.
+      return false;
+    }
+    if (info->read_blocked) {
+      info->read_blocked = false;
+      PostStreamEvent(info, SE_READ, 0);
+    }
+    return true;
+  }
+
+  case MUX_WINDOW:
+    if (len != 4)
+      return false;
+    if (info->status == ST_CLOSED)
+      return true;
+    info->send_window += talk_base::GetBE32(payload);
+    Schedule(id, info);
+    return true;
+
+  case MUX_CLOSE: {
+    if (info->status == ST_CLOSED)
+      return false;
+    if (info->status == ST_REQUESTED) {
+      ASSERT(info->stream == NULL);
+      MaybeSendClose(it);
+      return true;
+    }
+    if (info->status == ST_OPENING)
+      info->close_error = ECONNREFUSED;
+    info->status = ST_CLOSED;
+    // Anything we still had for the peer would go nowhere.
+    size_t buffered = 0;
+    info->send_buffer.GetBuffered(&buffered);
+    info->send_buffer.ConsumeReadData(buffered);
+    if (!info->stream) {
+      if (info->close_sent)
+        RemoveStream(it);
+      else
+        MaybeSendClose(it);
+      return true;
+    }
+    info->recv_buffer.GetBuffered(&buffered);
+    if (buffered == 0)
+      PostStreamEvent(info, SE_CLOSE, info->close_error);
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
+
+void TunnelMux::OnClosed(int error) {
+  if (closed_)
+    return;
+  stream_open_ = false;
+  closing_ = closed_ = true;
+  stream_->Close();
+  output_.clear();
+  control_.clear();
+  ready_.clear();
+  input_.clear();
+
+  StreamMap::iterator it = streams_.begin();
+  while (it != streams_.end()) {
+    StreamMap::iterator next = it;
+    ++next;
+    StreamInfo* info = it->second;
+    if (!info->stream) {
+      RemoveStream(it);
+    } else if (info->status != ST_CLOSED) {
+      info->status = ST_CLOSED;
+      info->close_error = error;
+      size_t buffered = 0;
+      info->recv_buffer.GetBuffered(&buffered);
+      if (buffered == 0)
+        PostStreamEvent(info, SE_CLOSE, error);
+    }
+    it = next;
+  }
+  SignalClosed(this);
+  CheckDestroy();
+}
+
+void TunnelMux::CheckDestroy() {
+  if (closed_ && streams_.empty())
+    thread_->Post(this, MSG_DESTROY);
+}
+
+void TunnelMux::OnMessage(talk_base::Message* pmsg) {
+  ASSERT(pmsg->message_id == MSG_DESTROY);
+  delete this;
+}
+
+}  // namespace cricket
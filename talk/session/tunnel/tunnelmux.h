@@ -0,0 +1,211 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TALK_SESSION_TUNNEL_TUNNELMUX_H_
+#define TALK_SESSION_TUNNEL_TUNNELMUX_H_
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/messagehandler.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/sigslot.h"
+#include "talk/base/stream.h"
+
+namespace talk_base {
+class Thread;
+}
+
+namespace cricket {
+
+///////////////////////////////////////////////////////////////////////////////
+// TunnelMux
+// Carries any number of streams over a single underlying stream, typically
+// that of a PseudoTcpChannel, so that opening another tunnel to the same peer
+// costs one round trip rather than a new session. Each stream has its own
+// flow control window, so a stream whose reader falls behind doesn't hold up
+// the others, and streams with data to send take turns.
+//
+// Everything happens on the thread that creates the TunnelMux, including
+// the events of the streams it hands out.
+//
+// Note: The TunnelMux must persist until both of:
+// 1) All of the streams it has handed out have been closed.
+// 2) The underlying stream has closed.
+// It then deletes itself.
+///////////////////////////////////////////////////////////////////////////////
+// Wire format
+// Each frame starts with an 8 byte header, followed by |length| bytes of
+// payload:
+//
+//    0               1               2               3
+//   +-------+-------+-------+-------+-------+-------+-------+-------+
+//   |     type      |   reserved    |            length             |
+//   +-------+-------+-------+-------+-------+-------+-------+-------+
+//   |                           stream id                           |
+//   +-------+-------+-------+-------+-------+-------+-------+-------+
+//
+// MUX_OPEN asks to open a stream; its payload is the stream's description.
+// MUX_ACCEPT accepts it. MUX_DATA carries data, no more than the receiver's
+// window allows. MUX_WINDOW's payload is a 32-bit count by which to open the
+// window once the receiver has read that much. MUX_CLOSE says that the sender
+// will send no more on the stream, or that it declines to open it.
+//
+// The side that initiated the underlying stream numbers its streams with odd
+// ids, and the other side with even ones. Stream 1 is open from the start.
+///////////////////////////////////////////////////////////////////////////////
+
+class TunnelMux : public talk_base::MessageHandler,
+                  public sigslot::has_slots<> {
+ public:
+  // Takes ownership of |stream|.
+  TunnelMux(talk_base::StreamInterface* stream, bool initiator);
+
+  // Returns stream 1, which both sides have without asking. Call this once.
+  talk_base::StreamInterface* GetInitialStream();
+
+  // Asks the peer to open a stream. The stream signals SE_OPEN once the peer
+  // accepts it, or SE_CLOSE if it declines. Returns NULL if the underlying
+  // stream is closing.
+  talk_base::StreamInterface* OpenStream(const std::string& description);
+
+  // Answers a SignalStreamRequest.
+  talk_base::StreamInterface* AcceptStream(uint32 id);
+  void DeclineStream(uint32 id);
+
+  // Whether new streams can still be opened.
+  bool is_open() const { return !closing_; }
+
+  // Signal arguments are this, the stream id and its description. The
+  // handler must accept or decline the stream, now or later.
+  sigslot::signal3<TunnelMux*, uint32, const std::string&> SignalStreamRequest;
+  // Fired once the underlying stream has closed. Streams that are still open
+  // signal SE_CLOSE after their data has been read.
+  sigslot::signal1<TunnelMux*> SignalClosed;
+
+ private:
+  class Stream;
+  friend class Stream;
+
+  enum FrameType {
+    MUX_OPEN = 1,
+    MUX_ACCEPT,
+    MUX_DATA,
+    MUX_WINDOW,
+    MUX_CLOSE
+  };
+
+  enum StreamStatus {
+    ST_REQUESTED,  // We've been asked to open it.
+    ST_OPENING,    // We've asked to open it.
+    ST_OPEN,
+    ST_CLOSED,     // The peer has closed it.
+  };
+
+  struct StreamInfo {
+    StreamInfo();
+    Stream* stream;  // NULL once the owner has closed it.
+    StreamStatus status;
+    talk_base::FifoBuffer send_buffer;
+    talk_base::FifoBuffer recv_buffer;
+    // How much more we may send, and how much the reader has read since we
+    // last opened the peer's window.
+    uint32 send_window;
+    uint32 recv_consumed;
+    bool scheduled;      // In |ready_|.
+    bool read_blocked;   // Owed SE_READ.
+    bool write_blocked;  // Owed SE_WRITE.
+    bool close_sent;
+    int close_error;
+  };
+  typedef std::map<uint32, StreamInfo*> StreamMap;
+
+  virtual ~TunnelMux();
+
+  // Stream methods
+  talk_base::StreamState GetStreamState(uint32 id) const;
+  talk_base::StreamResult ReadStream(uint32 id, void* buffer,
+                                     size_t buffer_len, size_t* read,
+                                     int* error);
+  talk_base::StreamResult WriteStream(uint32 id, const void* data,
+                                      size_t data_len, size_t* written,
+                                      int* error);
+  void CloseStream(uint32 id);
+
+  talk_base::StreamInterface* AddStream(uint32 id, StreamStatus status);
+  void RemoveStream(StreamMap::iterator it);
+  // Sends MUX_CLOSE for a stream its owner has closed, once the data written
+  // before the close has gone out.
+  void MaybeSendClose(StreamMap::iterator it);
+  void Schedule(uint32 id, StreamInfo* info);
+  void PostStreamEvent(StreamInfo* info, int events, int error);
+
+  // Frames out
+  void QueueFrame(FrameType type, uint32 id, const char* payload,
+                  size_t len);
+  void QueueWindow(uint32 id, uint32 increment);
+  // Moves the next frame into |output_|: control frames first, then data
+  // from each ready stream in turn.
+  bool NextFrame();
+  // Writes as much as the underlying stream will take.
+  void Flush();
+
+  // Frames in
+  void OnStreamEvent(talk_base::StreamInterface* stream, int events,
+                     int error);
+  void ReadFrames();
+  bool HandleFrame(FrameType type, uint32 id, const char* payload,
+                   size_t len);
+  void OnClosed(int error);
+
+  void CheckDestroy();
+  virtual void OnMessage(talk_base::Message* pmsg);
+
+  talk_base::Thread* thread_;
+  talk_base::scoped_ptr<talk_base::StreamInterface> stream_;
+  bool initiator_;
+  bool stream_open_, closing_, closed_;
+  uint32 next_id_;
+  talk_base::StreamInterface* initial_stream_;
+  StreamMap streams_;
+  // Streams with data to send, in the order they get their next turn.
+  std::list<uint32> ready_;
+  // |output_| holds what's left of the frame being written, and |control_|
+  // the control frames queued behind it.
+  std::string output_;
+  std::list<std::string> control_;
+  // Received bytes that don't make up a whole frame yet.
+  std::string input_;
+
+  DISALLOW_COPY_AND_ASSIGN(TunnelMux);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_SESSION_TUNNEL_TUNNELMUX_H_
@@ -0,0 +1,513 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "talk/base/gunit.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/socket.h"
+#include "talk/base/stream.h"
+#include "talk/base/testutils.h"
+#include "talk/base/thread.h"
+#include "talk/session/tunnel/tunnelmux.h"
+
+using talk_base::SE_CLOSE;
+using talk_base::SE_OPEN;
+using talk_base::SE_READ;
+using talk_base::SE_WRITE;
+using talk_base::SR_BLOCK;
+using talk_base::SR_EOS;
+using talk_base::SR_ERROR;
+using talk_base::SR_SUCCESS;
+using talk_base::SS_CLOSED;
+using talk_base::SS_OPEN;
+using talk_base::SS_OPENING;
+using talk_base::StreamInterface;
+using talk_base::StreamResult;
+using talk_base::StreamState;
+using testing::StreamSink;
+using cricket::TunnelMux;
+
+static const int kTimeoutMs = 5000;
+static const size_t kPipeSize = 16 * 1024;
+static const size_t kBlockSize = 4096;
+
+// One end of an in-memory connection. Each end buffers what the other end
+// writes, so a writer blocks until the reader catches up.
+class PipeStream : public StreamInterface {
+ public:
+  explicit PipeStream(bool* destroyed)
+      : peer_(NULL), state_(talk_base::SS_OPENING), buffer_(kPipeSize),
+        write_blocked_(false), destroyed_(destroyed) {
+  }
+  virtual ~PipeStream() {
+    Close();
+    *destroyed_ = true;
+  }
+
+  static void Connect(PipeStream* a, PipeStream* b) {
+    a->peer_ = b;
+    b->peer_ = a;
+    a->state_ = b->state_ = SS_OPEN;
+    a->PostEvent(SE_OPEN | SE_READ | SE_WRITE, 0);
+    b->PostEvent(SE_OPEN | SE_READ | SE_WRITE, 0);
+  }
+
+  virtual StreamState GetState() const { return state_; }
+  virtual StreamResult Read(void* buffer, size_t buffer_len,
+                            size_t* read, int* error) {
+    if (state_ == SS_OPENING)
+      return SR_BLOCK;
+    if (buffer_.Read(buffer, buffer_len, read, error) != SR_SUCCESS)
+      return (state_ == SS_CLOSED) ? SR_EOS : SR_BLOCK;
+    if (peer_ && peer_->write_blocked_) {
+      peer_->write_blocked_ = false;
+      peer_->PostEvent(SE_WRITE, 0);
+    }
+    return SR_SUCCESS;
+  }
+  virtual StreamResult Write(const void* data, size_t data_len,
+                             size_t* written, int* error) {
+    if (state_ == SS_OPENING) {
+      write_blocked_ = true;
+      return SR_BLOCK;
+    }
+    if (!peer_) {
+      if (error)
+        *error = ENOTCONN;
+      return SR_ERROR;
+    }
+    if (peer_->buffer_.Write(data, data_len, written, error) != SR_SUCCESS) {
+      write_blocked_ = true;
+      return SR_BLOCK;
+    }
+    peer_->PostEvent(SE_READ, 0);
+    return SR_SUCCESS;
+  }
+  virtual void Close() {
+    state_ = SS_CLOSED;
+    if (!peer_)
+      return;
+    // The peer can still read what we sent before seeing the end.
+    peer_->peer_ = NULL;
+    peer_->state_ = SS_CLOSED;
+    peer_->PostEvent(SE_CLOSE, 0);
+    peer_ = NULL;
+  }
+
+ private:
+  PipeStream* peer_;
+  StreamState state_;
+  talk_base::FifoBuffer buffer_;
+  bool write_blocked_;
+  bool* destroyed_;
+};
+
+// Moves a known pattern of bytes from one stream to another.
+struct Transfer {
+  Transfer(StreamInterface* from, StreamInterface* to, size_t size)
+      : from(from), to(to), size(size), sent(0), received(0), ok(true) {
+  }
+  bool done() const { return received == size || !ok; }
+
+  // Writes and reads as much as the streams allow.
+  void Step() {
+    char block[kBlockSize];
+    size_t count = 0;
+    while (sent < size) {
+      size_t len = std::min(size - sent, sizeof(block));
+      for (size_t i = 0; i < len; ++i)
+        block[i] = Pattern(sent + i);
+      if (from->Write(block, len, &count, NULL) != SR_SUCCESS)
+        break;
+      sent += count;
+    }
+    while (to->Read(block, sizeof(block), &count, NULL) == SR_SUCCESS) {
+      for (size_t i = 0; i < count; ++i)
+        ok = ok && (block[i] == Pattern(received + i));
+      received += count;
+    }
+  }
+  static char Pattern(size_t i) { return static_cast<char>(i % 251); }
+
+  StreamInterface* from;
+  StreamInterface* to;
+  size_t size, sent, received;
+  bool ok;
+};
+
+class TunnelMuxTest : public testing::Test, public sigslot::has_slots<> {
+ public:
+  TunnelMuxTest()
+      : local_destroyed_(false), remote_destroyed_(false),
+        local_closed_(false), remote_closed_(false) {
+    local_pipe_ = new PipeStream(&local_destroyed_);
+    remote_pipe_ = new PipeStream(&remote_destroyed_);
+    local_ = new TunnelMux(local_pipe_, true);
+    remote_ = new TunnelMux(remote_pipe_, false);
+    local_->SignalClosed.connect(this, &TunnelMuxTest::OnMuxClosed);
+    remote_->SignalClosed.connect(this, &TunnelMuxTest::OnMuxClosed);
+    local_->SignalStreamRequest.connect(this,
+        &TunnelMuxTest::OnStreamRequest);
+    remote_->SignalStreamRequest.connect(this,
+        &TunnelMuxTest::OnStreamRequest);
+    local_stream_.reset(local_->GetInitialStream());
+    remote_stream_.reset(remote_->GetInitialStream());
+    sink_.Monitor(local_stream_.get());
+    sink_.Monitor(remote_stream_.get());
+  }
+
+  virtual void TearDown() {
+    // Once every stream is closed, the muxes shut down on their own.
+    local_stream_.reset();
+    remote_stream_.reset();
+    CloseStreams(&local_streams_);
+    CloseStreams(&remote_streams_);
+    EXPECT_TRUE_WAIT(local_destroyed_ && remote_destroyed_, kTimeoutMs);
+  }
+
+  void CloseStreams(std::vector<StreamInterface*>* streams) {
+    for (size_t i = 0; i < streams->size(); ++i)
+      delete (*streams)[i];
+    streams->clear();
+  }
+
+  void Connect() {
+    PipeStream::Connect(local_pipe_, remote_pipe_);
+    EXPECT_TRUE_WAIT(sink_.Check(local_stream_.get(), testing::SSE_OPEN),
+                     kTimeoutMs);
+    EXPECT_TRUE_WAIT(sink_.Check(remote_stream_.get(), testing::SSE_OPEN),
+                     kTimeoutMs);
+  }
+
+  // Opens a stream from the local side and accepts it on the remote side.
+  void OpenStream(const std::string& description) {
+    size_t requests = requests_.size();
+    StreamInterface* stream = local_->OpenStream(description);
+    ASSERT_TRUE(stream != NULL);
+    local_streams_.push_back(stream);
+    sink_.Monitor(stream);
+    EXPECT_EQ(SS_OPENING, stream->GetState());
+    ASSERT_TRUE_WAIT(requests_.size() > requests, kTimeoutMs);
+    EXPECT_EQ(description, requests_.back().second);
+    StreamInterface* accepted = remote_->AcceptStream(requests_.back().first);
+    ASSERT_TRUE(accepted != NULL);
+    remote_streams_.push_back(accepted);
+    sink_.Monitor(accepted);
+    EXPECT_TRUE_WAIT(sink_.Check(stream, testing::SSE_OPEN), kTimeoutMs);
+    EXPECT_TRUE_WAIT(sink_.Check(accepted, testing::SSE_OPEN), kTimeoutMs);
+    EXPECT_EQ(SS_OPEN, stream->GetState());
+    EXPECT_EQ(SS_OPEN, accepted->GetState());
+    // Start afresh with the events that the tests look for.
+    sink_.Events(stream);
+    sink_.Events(accepted);
+  }
+
+  // Runs the transfers side by side until they have all finished.
+  bool RunTransfers(std::vector<Transfer>* transfers) {
+    uint32 start = talk_base::Time();
+    while (talk_base::TimeSince(start) < kTimeoutMs) {
+      bool done = true;
+      for (size_t i = 0; i < transfers->size(); ++i) {
+        (*transfers)[i].Step();
+        done = done && (*transfers)[i].done();
+      }
+      if (done)
+        break;
+      talk_base::Thread::Current()->ProcessMessages(1);
+    }
+    for (size_t i = 0; i < transfers->size(); ++i) {
+      if (!(*transfers)[i].ok || !(*transfers)[i].done())
+        return false;
+    }
+    return true;
+  }
+
+ protected:
+  void OnMuxClosed(TunnelMux* mux) {
+    if (mux == local_)
+      local_closed_ = true;
+    else if (mux == remote_)
+      remote_closed_ = true;
+  }
+  void OnStreamRequest(TunnelMux* mux, uint32 id,
+                       const std::string& description) {
+    requests_.push_back(std::make_pair(id, description));
+  }
+
+  bool local_destroyed_, remote_destroyed_;
+  bool local_closed_, remote_closed_;
+  PipeStream* local_pipe_;
+  PipeStream* remote_pipe_;
+  TunnelMux* local_;
+  TunnelMux* remote_;
+  talk_base::scoped_ptr<StreamInterface> local_stream_;
+  talk_base::scoped_ptr<StreamInterface> remote_stream_;
+  std::vector<StreamInterface*> local_streams_;
+  std::vector<StreamInterface*> remote_streams_;
+  std::vector<std::pair<uint32, std::string> > requests_;
+  StreamSink sink_;
+};
+
+// Test that the initial stream carries data both ways, and that what is
+// written before the underlying stream opens goes out once it does.
+TEST_F(TunnelMuxTest, TestInitialStream) {
+  EXPECT_EQ(SS_OPENING, local_stream_->GetState());
+  size_t written = 0;
+  EXPECT_EQ(SR_SUCCESS, local_stream_->Write("early", 5, &written, NULL));
+  Connect();
+  EXPECT_EQ(SS_OPEN, local_stream_->GetState());
+  EXPECT_EQ(SS_OPEN, remote_stream_->GetState());
+
+  char buffer[16];
+  size_t read = 0;
+  EXPECT_TRUE_WAIT(remote_stream_->Read(buffer, sizeof(buffer), &read,
+                                        NULL) == SR_SUCCESS, kTimeoutMs);
+  EXPECT_EQ("early", std::string(buffer, read));
+
+  std::vector<Transfer> transfers;
+  transfers.push_back(Transfer(local_stream_.get(), remote_stream_.get(),
+                               500000));
+  transfers.push_back(Transfer(remote_stream_.get(), local_stream_.get(),
+                               500000));
+  EXPECT_TRUE(RunTransfers(&transfers));
+}
+
+// Test opening further streams, and that they are independent of each
+// other and of the initial stream.
+TEST_F(TunnelMuxTest, TestOpenStreams) {
+  Connect();
+  OpenStream("one");
+  OpenStream("two");
+  EXPECT_EQ(2U, requests_.size());
+  EXPECT_NE(requests_[0].first, requests_[1].first);
+
+  std::vector<Transfer> transfers;
+  transfers.push_back(Transfer(local_stream_.get(), remote_stream_.get(),
+                               200000));
+  transfers.push_back(Transfer(local_streams_[0],
+                               remote_streams_[0], 300000));
+  transfers.push_back(Transfer(remote_streams_[1],
+                               local_streams_[1], 400000));
+  EXPECT_TRUE(RunTransfers(&transfers));
+}
+
+// Test that the remote side can open streams too.
+TEST_F(TunnelMuxTest, TestOpenStreamFromResponder) {
+  Connect();
+  talk_base::scoped_ptr<StreamInterface> stream(remote_->OpenStream("back"));
+  ASSERT_TRUE(stream.get() != NULL);
+  EXPECT_TRUE_WAIT(!requests_.empty(), kTimeoutMs);
+  EXPECT_EQ(0U, requests_.back().first % 2);
+  talk_base::scoped_ptr<StreamInterface> accepted(
+      local_->AcceptStream(requests_.back().first));
+  ASSERT_TRUE(accepted.get() != NULL);
+
+  std::vector<Transfer> transfers;
+  transfers.push_back(Transfer(stream.get(), accepted.get(), 100000));
+  EXPECT_TRUE(RunTransfers(&transfers));
+}
+
+// Test that a declined stream is closed with an error, and can't be used.
+TEST_F(TunnelMuxTest, TestDeclineStream) {
+  Connect();
+  StreamInterface* stream = local_->OpenStream("nope");
+  ASSERT_TRUE(stream != NULL);
+  local_streams_.push_back(stream);
+  sink_.Monitor(stream);
+  ASSERT_TRUE_WAIT(!requests_.empty(), kTimeoutMs);
+  remote_->DeclineStream(requests_.back().first);
+  EXPECT_TRUE(remote_->AcceptStream(requests_.back().first) == NULL);
+  EXPECT_TRUE_WAIT(sink_.Check(stream, testing::SSE_ERROR), kTimeoutMs);
+  EXPECT_EQ(SS_CLOSED, stream->GetState());
+  size_t written = 0;
+  EXPECT_EQ(SR_EOS, stream->Write("x", 1, &written, NULL));
+}
+
+// Test that a stream whose reader has stopped reading fills its window and
+// then blocks, without holding up the other streams.
+TEST_F(TunnelMuxTest, TestFlowControl) {
+  Connect();
+  OpenStream("stalled");
+  StreamInterface* stalled = local_streams_[0];
+
+  // Fill the stalled stream's window and send buffer.
+  char block[kBlockSize] = { 0 };
+  size_t written = 0, total = 0;
+  uint32 start = talk_base::Time();
+  while (talk_base::TimeSince(start) < kTimeoutMs) {
+    StreamResult result = stalled->Write(block, sizeof(block), &written,
+                                         NULL);
+    if (result == SR_SUCCESS) {
+      total += written;
+    } else {
+      ASSERT_EQ(SR_BLOCK, result);
+      talk_base::Thread::Current()->ProcessMessages(10);
+      if (stalled->Write(block, sizeof(block), &written, NULL) == SR_BLOCK)
+        break;
+      total += written;
+    }
+  }
+  // A window's worth in flight or buffered remotely, and as much again
+  // buffered locally.
+  EXPECT_EQ(2U * 64 * 1024, total);
+
+  std::vector<Transfer> transfers;
+  transfers.push_back(Transfer(local_stream_.get(), remote_stream_.get(),
+                               500000));
+  EXPECT_TRUE(RunTransfers(&transfers));
+
+  // Reading from the stalled stream lets the writer carry on.
+  sink_.Check(stalled, testing::SSE_WRITE);
+  StreamInterface* reader = remote_streams_[0];
+  size_t read = 0;
+  while (reader->Read(block, sizeof(block), &read, NULL) == SR_SUCCESS) { }
+  EXPECT_TRUE_WAIT(sink_.Check(stalled, testing::SSE_WRITE), kTimeoutMs);
+}
+
+// Test that streams with data to send take turns, so a stream that starts
+// later isn't stuck behind one with a lot to send.
+TEST_F(TunnelMuxTest, TestFairness) {
+  Connect();
+  OpenStream("bulk");
+  OpenStream("late");
+  std::vector<Transfer> transfers;
+  transfers.push_back(Transfer(local_streams_[0],
+                               remote_streams_[0], 2000000));
+  transfers.push_back(Transfer(local_streams_[1],
+                               remote_streams_[1], 100000));
+  // Run until the smaller transfer finishes; the bigger one shouldn't be
+  // anywhere near done by then.
+  uint32 start = talk_base::Time();
+  while (!transfers[1].done() && talk_base::TimeSince(start) < kTimeoutMs) {
+    transfers[0].Step();
+    transfers[1].Step();
+    talk_base::Thread::Current()->ProcessMessages(1);
+  }
+  EXPECT_TRUE(transfers[1].done());
+  EXPECT_TRUE(transfers[1].ok);
+  EXPECT_LT(transfers[0].received, transfers[0].size / 2);
+  EXPECT_TRUE(RunTransfers(&transfers));
+}
+
+// Test that closing a stream delivers its data and then SE_CLOSE, without
+// affecting the others.
+TEST_F(TunnelMuxTest, TestCloseStream) {
+  Connect();
+  OpenStream("closing");
+  StreamInterface* stream = local_streams_[0];
+  StreamInterface* accepted = remote_streams_[0];
+  size_t written = 0;
+  EXPECT_EQ(SR_SUCCESS, stream->Write("last words", 10, &written, NULL));
+  stream->Close();
+
+  EXPECT_TRUE_WAIT(sink_.Check(accepted, testing::SSE_READ), kTimeoutMs);
+  EXPECT_FALSE(sink_.Check(accepted, testing::SSE_CLOSE));
+  EXPECT_EQ(SS_OPEN, accepted->GetState());
+  char buffer[16];
+  size_t read = 0;
+  EXPECT_EQ(SR_SUCCESS, accepted->Read(buffer, sizeof(buffer), &read, NULL));
+  EXPECT_EQ("last words", std::string(buffer, read));
+  EXPECT_TRUE_WAIT(sink_.Check(accepted, testing::SSE_CLOSE), kTimeoutMs);
+  EXPECT_EQ(SS_CLOSED, accepted->GetState());
+  EXPECT_EQ(SR_EOS, accepted->Read(buffer, sizeof(buffer), &read, NULL));
+
+  std::vector<Transfer> transfers;
+  transfers.push_back(Transfer(local_stream_.get(), remote_stream_.get(),
+                               100000));
+  EXPECT_TRUE(RunTransfers(&transfers));
+  EXPECT_FALSE(local_closed_);
+  EXPECT_FALSE(remote_closed_);
+}
+
+// Test that the underlying stream closes once both sides have closed all
+// of their streams, and that no more streams can be opened then.
+TEST_F(TunnelMuxTest, TestCloseAll) {
+  Connect();
+  OpenStream("extra");
+  local_stream_.reset();
+  CloseStreams(&local_streams_);
+  EXPECT_TRUE_WAIT(sink_.Check(remote_stream_.get(), testing::SSE_CLOSE),
+                   kTimeoutMs);
+  EXPECT_FALSE(local_closed_);
+  EXPECT_TRUE(local_->is_open());
+  remote_stream_.reset();
+  CloseStreams(&remote_streams_);
+  EXPECT_TRUE_WAIT(local_closed_ && remote_closed_, kTimeoutMs);
+  EXPECT_TRUE_WAIT(local_destroyed_ && remote_destroyed_, kTimeoutMs);
+}
+
+// Test that both sides closing a stream at once, with data in flight, leaves
+// the other streams alone.
+TEST_F(TunnelMuxTest, TestSimultaneousClose) {
+  Connect();
+  OpenStream("closing");
+  char data[1000] = {0};
+  size_t written = 0;
+  EXPECT_EQ(SR_SUCCESS,
+            local_streams_[0]->Write(data, sizeof(data), &written, NULL));
+  CloseStreams(&local_streams_);
+  CloseStreams(&remote_streams_);
+  talk_base::Thread::Current()->ProcessMessages(100);
+
+  EXPECT_FALSE(local_closed_);
+  EXPECT_FALSE(remote_closed_);
+  EXPECT_EQ(SS_OPEN, local_stream_->GetState());
+  EXPECT_EQ(SS_OPEN, remote_stream_->GetState());
+  std::vector<Transfer> transfers;
+  transfers.push_back(Transfer(local_stream_.get(), remote_stream_.get(),
+                               1000));
+  EXPECT_TRUE(RunTransfers(&transfers));
+}
+
+// Test that losing the underlying stream closes every stream, after their
+// data has been read.
+TEST_F(TunnelMuxTest, TestUnderlyingStreamClosed) {
+  Connect();
+  OpenStream("extra");
+  StreamInterface* accepted = remote_streams_[0];
+  size_t written = 0;
+  EXPECT_EQ(SR_SUCCESS, local_streams_[0]->Write(
+      "data", 4, &written, NULL));
+  EXPECT_TRUE_WAIT(sink_.Check(accepted, testing::SSE_READ), kTimeoutMs);
+  local_pipe_->Close();
+
+  EXPECT_TRUE_WAIT(remote_closed_, kTimeoutMs);
+  EXPECT_FALSE(remote_->is_open());
+  EXPECT_TRUE(remote_->OpenStream("too late") == NULL);
+  EXPECT_TRUE_WAIT(sink_.Check(remote_stream_.get(), testing::SSE_CLOSE),
+                   kTimeoutMs);
+  EXPECT_FALSE(sink_.Check(accepted, testing::SSE_CLOSE));
+  char buffer[16];
+  size_t read = 0;
+  EXPECT_EQ(SR_SUCCESS, accepted->Read(buffer, sizeof(buffer), &read, NULL));
+  EXPECT_EQ("data", std::string(buffer, read));
+  EXPECT_TRUE_WAIT(sink_.Check(accepted, testing::SSE_CLOSE), kTimeoutMs);
+  EXPECT_EQ(SS_CLOSED, accepted->GetState());
+}
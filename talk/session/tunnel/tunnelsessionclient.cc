@@ -35,6 +35,7 @@
 #include "talk/p2p/base/transportchannel.h"
 #include "talk/xmllite/xmlelement.h"
 #include "pseudotcpchannel.h"
+#include "tunnelmux.h"
 #include "tunnelsessionclient.h"
 
 namespace cricket {
@@ -42,6 +43,7 @@ namespace cricket {
 const char NS_TUNNEL[] = "http://www.google.com/talk/tunnel";
 const buzz::StaticQName QN_TUNNEL_DESCRIPTION = { NS_TUNNEL, "description" };
 const buzz::StaticQName QN_TUNNEL_TYPE = { NS_TUNNEL, "type" };
+const buzz::StaticQName QN_TUNNEL_MUX = { NS_TUNNEL, "mux" };
 const char CN_TUNNEL[] = "tunnel";
 
 enum {
@@ -92,8 +94,11 @@ const talk_base::ConstantLabel SESSION_STATES[] = {
 
 struct TunnelContentDescription : public ContentDescription {
   std::string description;
+  // Whether the channel carries a TunnelMux rather than a single stream.
+  bool multiplexed;
 
-  TunnelContentDescription(const std::string& desc) : description(desc) { }
+  TunnelContentDescription(const std::string& desc, bool mux = false)
+      : description(desc), multiplexed(mux) { }
   virtual ContentDescription* Copy() const {
     return new TunnelContentDescription(*this);
   }
@@ -175,6 +180,10 @@ talk_base::StreamInterface* TunnelSessionClientBase::AcceptTunnel(
   if (answer == NULL)
     return NULL;
 
+  // Only now does anyone hold the mux's initial stream; a declined tunnel
+  // never gets a mux.
+  if (IsMultiplexed(session->remote_description()))
+    tunnel->EnableMux(false);
   session->Accept(answer);
   return tunnel->GetStream();
 }
@@ -193,15 +202,28 @@ void TunnelSessionClientBase::OnMessage(talk_base::Message* pmsg) {
       return;
     }
 
-    Session* session = session_manager_->CreateSession(jid_.Str(), namespace_);
-    TunnelSession* tunnel = MakeTunnelSession(session, data->thread,
-                                              INITIATOR);
-    sessions_.push_back(tunnel);
-    session->Initiate(data->jid.Str(), offer);
+    TunnelSession* tunnel = InitiateTunnel(data->jid, offer, data->thread);
     data->stream = tunnel->GetStream();
   }
 }
 
+TunnelSession* TunnelSessionClientBase::InitiateTunnel(
+    const buzz::Jid& to, SessionDescription* offer,
+    talk_base::Thread* stream_thread) {
+  ASSERT(session_manager_->signaling_thread()->IsCurrent());
+  Session* session = session_manager_->CreateSession(jid_.Str(), namespace_);
+  TunnelSession* tunnel = MakeTunnelSession(session, stream_thread, INITIATOR);
+  sessions_.push_back(tunnel);
+  session->Initiate(to.Str(), offer);
+  return tunnel;
+}
+
+void TunnelSessionClientBase::OnIncomingStream(const buzz::Jid &jid,
+                                               TunnelMux* mux, uint32 id,
+                                               const std::string& description) {
+  mux->DeclineStream(id);
+}
+
 TunnelSession* TunnelSessionClientBase::MakeTunnelSession(
     Session* session, talk_base::Thread* stream_thread,
     TunnelSessionRole /*role*/) {
@@ -226,13 +248,38 @@ TunnelSessionClient::TunnelSessionClient(const buzz::Jid& jid,
 TunnelSessionClient::~TunnelSessionClient() {
 }
 
+talk_base::StreamInterface* TunnelSessionClient::CreateMultiplexedTunnel(
+    const buzz::Jid& to, const std::string& description) {
+  ASSERT(session_manager_->signaling_thread()->IsCurrent());
+  if (!SupportsMultiplexing())
+    return NULL;
+
+  // Either side may open streams on the session, whoever started it.
+  for (std::vector<TunnelSession*>::iterator it = sessions_.begin();
+       it != sessions_.end();
+       ++it) {
+    TunnelMux* mux = (*it)->mux();
+    if (mux && mux->is_open() && buzz::Jid((*it)->remote_name()) == to)
+      return mux->OpenStream(description);
+  }
+
+  SessionDescription* offer = CreateTunnelOffer(description, true);
+  if (offer == NULL)
+    return NULL;
+  TunnelSession* tunnel = InitiateTunnel(to, offer,
+                                         talk_base::Thread::Current());
+  tunnel->EnableMux(true);
+  return tunnel->GetStream();
+}
+
 
 bool TunnelSessionClient::ParseContent(SignalingProtocol protocol,
                                        const buzz::XmlElement* elem,
                                        ContentDescription** content,
                                        ParseError* error) {
   if (const buzz::XmlElement* type_elem = elem->FirstNamed(QN_TUNNEL_TYPE)) {
-    *content = new TunnelContentDescription(type_elem->BodyText());
+    *content = new TunnelContentDescription(
+        type_elem->BodyText(), elem->FirstNamed(QN_TUNNEL_MUX) != NULL);
     return true;
   }
   return false;
@@ -249,6 +296,8 @@ bool TunnelSessionClient::WriteContent(
   buzz::XmlElement* type_elem = new buzz::XmlElement(QN_TUNNEL_TYPE);
   type_elem->SetBodyText(content->description);
   root->AddElement(type_elem);
+  if (content->multiplexed)
+    root->AddElement(new buzz::XmlElement(QN_TUNNEL_MUX));
   *elem = root;
   return true;
 }
@@ -286,10 +335,30 @@ void TunnelSessionClient::OnIncomingTunnel(const buzz::Jid &jid,
   SignalIncomingTunnel(this, jid, content->description, session);
 }
 
+void TunnelSessionClient::OnIncomingStream(const buzz::Jid &jid,
+                                           TunnelMux* mux, uint32 id,
+                                           const std::string& description) {
+  SignalIncomingStream(this, jid, description, mux, id);
+}
+
+bool TunnelSessionClient::IsMultiplexed(
+    const SessionDescription* sdesc) const {
+  std::string content_name;
+  const TunnelContentDescription* content = NULL;
+  return SupportsMultiplexing() &&
+      FindTunnelContent(sdesc, &content_name, &content) &&
+      content->multiplexed;
+}
+
 SessionDescription* TunnelSessionClient::CreateOffer(
     const buzz::Jid &jid, const std::string &description) {
+  return CreateTunnelOffer(description, false);
+}
+
+SessionDescription* TunnelSessionClient::CreateTunnelOffer(
+    const std::string &description, bool multiplexed) {
   SessionDescription* offer = NewTunnelSessionDescription(
-      CN_TUNNEL, new TunnelContentDescription(description));
+      CN_TUNNEL, new TunnelContentDescription(description, multiplexed));
   talk_base::scoped_ptr<TransportDescription> tdesc(
       session_manager_->transport_desc_factory()->CreateOffer(
           TransportOptions(), NULL));
@@ -309,8 +378,12 @@ SessionDescription* TunnelSessionClient::CreateAnswer(
   if (!FindTunnelContent(offer, &content_name, &offer_tunnel))
     return NULL;
 
+  // Agreeing to multiplex is what tells the initiator we can.
   SessionDescription* answer = NewTunnelSessionDescription(
-      content_name, new TunnelContentDescription(offer_tunnel->description));
+      content_name,
+      new TunnelContentDescription(offer_tunnel->description,
+                                   offer_tunnel->multiplexed &&
+                                   SupportsMultiplexing()));
   const TransportInfo* tinfo = offer->GetTransportInfoByName(content_name);
   if (tinfo) {
     const TransportDescription* offer_tdesc = &tinfo->description;
@@ -337,7 +410,7 @@ SessionDescription* TunnelSessionClient::CreateAnswer(
 
 TunnelSession::TunnelSession(TunnelSessionClientBase* client, Session* session,
                              talk_base::Thread* stream_thread)
-    : client_(client), session_(session), channel_(NULL) {
+    : client_(client), session_(session), channel_(NULL), mux_(NULL) {
   ASSERT(client_ != NULL);
   ASSERT(session_ != NULL);
   session_->SignalState.connect(this, &TunnelSession::OnSessionState);
@@ -353,9 +426,25 @@ TunnelSession::~TunnelSession() {
 
 talk_base::StreamInterface* TunnelSession::GetStream() {
   ASSERT(channel_ != NULL);
+  if (mux_)
+    return mux_->GetInitialStream();
   return channel_->GetStream();
 }
 
+void TunnelSession::EnableMux(bool initiator) {
+  ASSERT(channel_ != NULL);
+  ASSERT(mux_ == NULL);
+  // The mux looks after its own lifetime, as the channel's stream does.
+  mux_ = new TunnelMux(channel_->GetStream(), initiator);
+  mux_->SignalStreamRequest.connect(this, &TunnelSession::OnStreamRequest);
+  mux_->SignalClosed.connect(this, &TunnelSession::OnMuxClosed);
+}
+
+std::string TunnelSession::remote_name() const {
+  ASSERT(session_ != NULL);
+  return session_->remote_name();
+}
+
 bool TunnelSession::HasSession(Session* session) {
   ASSERT(NULL != session_);
   return (session_ == session);
@@ -390,6 +479,7 @@ void TunnelSession::OnSessionState(BaseSession* session,
   case Session::STATE_RECEIVEDACCEPT:
     OnAccept();
     break;
+  case Session::STATE_SENTREJECT:
   case Session::STATE_SENTTERMINATE:
   case Session::STATE_RECEIVEDTERMINATE:
     OnTerminate();
@@ -414,6 +504,12 @@ void TunnelSession::OnAccept() {
   const ContentInfo* content =
       session_->remote_description()->FirstContentByType(NS_TUNNEL);
   ASSERT(content != NULL);
+  if (mux_ && !client_->IsMultiplexed(session_->remote_description())) {
+    // The peer would take our frames for tunnel data.
+    LOG(LS_WARNING) << "Peer doesn't support multiplexed tunnels";
+    session_->Terminate();
+    return;
+  }
   VERIFY(channel_->Connect(
       content->name, "tcp", ICE_CANDIDATE_COMPONENT_DEFAULT));
 }
@@ -429,6 +525,19 @@ void TunnelSession::OnChannelClosed(PseudoTcpChannel* channel) {
   session_->Terminate();
 }
 
+void TunnelSession::OnStreamRequest(TunnelMux* mux, uint32 id,
+                                    const std::string& description) {
+  ASSERT(mux == mux_);
+  ASSERT(session_ != NULL);
+  client_->OnIncomingStream(buzz::Jid(session_->remote_name()), mux, id,
+                            description);
+}
+
+void TunnelSession::OnMuxClosed(TunnelMux* mux) {
+  ASSERT(mux == mux_);
+  mux_ = NULL;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 } // namespace cricket
@@ -43,6 +43,7 @@
 
 namespace cricket {
 
+class TunnelMux;
 class TunnelSession;
 class TunnelStream;
 
@@ -78,6 +79,16 @@ public:
   // Invoked on an incoming tunnel
   virtual void OnIncomingTunnel(const buzz::Jid &jid, Session *session) = 0;
 
+  // Invoked when the peer opens another stream on a multiplexed tunnel.
+  // The default declines it.
+  virtual void OnIncomingStream(const buzz::Jid &jid, TunnelMux* mux,
+                                uint32 id, const std::string& description);
+
+  // Whether the session description asks for a multiplexed tunnel.
+  virtual bool IsMultiplexed(const SessionDescription* sdesc) const {
+    return false;
+  }
+
   // Invoked on an outgoing session request
   virtual SessionDescription* CreateOffer(
       const buzz::Jid &jid, const std::string &description) = 0;
@@ -90,6 +101,10 @@ protected:
 
   void OnMessage(talk_base::Message* pmsg);
 
+  // Starts a session to |to| with |offer|, and returns the new TunnelSession.
+  TunnelSession* InitiateTunnel(const buzz::Jid& to, SessionDescription* offer,
+                                talk_base::Thread* stream_thread);
+
   // helper method to instantiate TunnelSession. By overriding this,
   // subclasses of TunnelSessionClient are able to instantiate
   // subclasses of TunnelSession instead.
@@ -121,16 +136,41 @@ public:
                             buzz::XmlElement** elem,
                             WriteError* error);
 
+  // Opens a tunnel to |to| over a session that is shared with other
+  // multiplexed tunnels to the same peer. The first such tunnel starts the
+  // session; later ones take a single round trip to open, and signal
+  // SE_OPEN once the peer accepts them. Must be called on the signaling
+  // thread, which is also the thread the stream signals events on.
+  talk_base::StreamInterface* CreateMultiplexedTunnel(
+      const buzz::Jid& to, const std::string& description);
+
   // Signal arguments are this, initiator, description, session
   sigslot::signal4<TunnelSessionClient*, buzz::Jid, std::string, Session*>
     SignalIncomingTunnel;
+  // Fired when the peer opens another tunnel over a multiplexed session.
+  // The handler must answer with mux->AcceptStream(id), which returns the
+  // tunnel's stream, or mux->DeclineStream(id).
+  // Signal arguments are this, initiator, description, mux, stream id
+  sigslot::signal5<TunnelSessionClient*, buzz::Jid, std::string, TunnelMux*,
+                   uint32> SignalIncomingStream;
 
   virtual void OnIncomingTunnel(const buzz::Jid &jid,
                                 Session *session);
+  virtual void OnIncomingStream(const buzz::Jid &jid, TunnelMux* mux,
+                                uint32 id, const std::string& description);
+  virtual bool IsMultiplexed(const SessionDescription* sdesc) const;
   virtual SessionDescription* CreateOffer(
       const buzz::Jid &jid, const std::string &description);
   virtual SessionDescription* CreateAnswer(
       const SessionDescription* offer);
+
+protected:
+  // Subclasses that wrap the tunnel stream can't share it between tunnels.
+  virtual bool SupportsMultiplexing() const { return true; }
+
+private:
+  SessionDescription* CreateTunnelOffer(const std::string &description,
+                                        bool multiplexed);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -161,6 +201,13 @@ class TunnelSession : public sigslot::has_slots<> {
   bool HasSession(Session* session);
   Session* ReleaseSession(bool channel_exists);
 
+  // Carries the streams of several tunnels over this session's channel.
+  // GetStream then returns the first of them.
+  void EnableMux(bool initiator);
+  // NULL unless multiplexed, or once the channel has closed.
+  TunnelMux* mux() const { return mux_; }
+  std::string remote_name() const;
+
  protected:
   virtual ~TunnelSession();
 
@@ -169,10 +216,14 @@ class TunnelSession : public sigslot::has_slots<> {
   virtual void OnAccept();
   virtual void OnTerminate();
   virtual void OnChannelClosed(PseudoTcpChannel* channel);
+  void OnStreamRequest(TunnelMux* mux, uint32 id,
+                       const std::string& description);
+  void OnMuxClosed(TunnelMux* mux);
 
   TunnelSessionClientBase* client_;
   Session* session_;
   PseudoTcpChannel* channel_;
+  TunnelMux* mux_;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -25,7 +25,9 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
 #include <string>
+#include <vector>
 #include "talk/base/gunit.h"
 #include "talk/base/messagehandler.h"
 #include "talk/base/scoped_ptr.h"
@@ -35,6 +37,7 @@
 #include "talk/p2p/base/sessionmanager.h"
 #include "talk/p2p/base/transport.h"
 #include "talk/p2p/client/fakeportallocator.h"
+#include "talk/session/tunnel/tunnelmux.h"
 #include "talk/session/tunnel/tunnelsessionclient.h"
 
 static const int kTimeoutMs = 10000;
@@ -55,7 +58,12 @@ class TunnelSessionClientTest : public testing::Test,
         remote_sm_(&remote_pa_, talk_base::Thread::Current()),
         local_client_(kLocalJid, &local_sm_),
         remote_client_(kRemoteJid, &remote_sm_),
-        done_(false) {
+        done_(false),
+        multiplexed_(false),
+        decline_streams_(false),
+        decline_tunnels_(false),
+        incoming_tunnels_(0),
+        sessions_(0) {
     local_sm_.SignalRequestSignaling.connect(this,
         &TunnelSessionClientTest::OnLocalRequestSignaling);
     local_sm_.SignalOutgoingMessage.connect(this,
@@ -66,6 +74,16 @@ class TunnelSessionClientTest : public testing::Test,
         &TunnelSessionClientTest::OnOutgoingMessage);
     remote_client_.SignalIncomingTunnel.connect(this,
         &TunnelSessionClientTest::OnIncomingTunnel);
+    remote_client_.SignalIncomingStream.connect(this,
+        &TunnelSessionClientTest::OnIncomingStream);
+    local_sm_.SignalSessionCreate.connect(this,
+        &TunnelSessionClientTest::OnSessionCreate);
+    local_sm_.SignalSessionDestroy.connect(this,
+        &TunnelSessionClientTest::OnSessionDestroy);
+  }
+  ~TunnelSessionClientTest() {
+    CloseStreams(&local_streams_);
+    CloseStreams(&remote_streams_);
   }
 
   // Transfer the desired amount of data from the local to the remote client.
@@ -89,6 +107,75 @@ class TunnelSessionClientTest : public testing::Test,
                         recv_stream_.GetBuffer(), size));
   }
 
+  // Open |count| multiplexed tunnels from the local to the remote client,
+  // and transfer the desired amount of data over each at the same time.
+  void TestMultiplexedTransfer(int count, int size) {
+    multiplexed_ = true;
+    for (int i = 0; i < count; ++i) {
+      talk_base::StreamInterface* stream =
+          local_client_.CreateMultiplexedTunnel(kRemoteJid, "test");
+      ASSERT_TRUE(stream != NULL);
+      local_streams_.push_back(stream);
+      EXPECT_TRUE_WAIT(remote_streams_.size() == local_streams_.size(),
+                       kTimeoutMs);
+    }
+    // All of the tunnels share the one session.
+    EXPECT_EQ(1, sessions_);
+    EXPECT_EQ(1, incoming_tunnels_);
+
+    std::vector<size_t> sent(count), received(count);
+    bool done = false, ok = true;
+    uint32 start = talk_base::Time();
+    while (!done && ok && talk_base::TimeSince(start) < kTimeoutMs) {
+      done = true;
+      for (int i = 0; i < count; ++i) {
+        ok = ok && Pump(local_streams_[i], remote_streams_[i], size,
+                        &sent[i], &received[i]);
+        done = done && (received[i] == static_cast<size_t>(size));
+      }
+      talk_base::Thread::Current()->ProcessMessages(1);
+    }
+    EXPECT_TRUE(ok);
+    EXPECT_TRUE(done);
+
+    // Once every tunnel has closed, so does the session.
+    CloseStreams(&local_streams_);
+    CloseStreams(&remote_streams_);
+    EXPECT_TRUE_WAIT(sessions_ == 0, kTimeoutMs);
+  }
+
+  // Open a multiplexed tunnel for the remote client to decline, after the
+  // first one.
+  void TestMultiplexedDecline() {
+    multiplexed_ = true;
+    local_streams_.push_back(
+        local_client_.CreateMultiplexedTunnel(kRemoteJid, "test"));
+    EXPECT_TRUE_WAIT(remote_streams_.size() == 1, kTimeoutMs);
+    decline_streams_ = true;
+    talk_base::StreamInterface* stream =
+        local_client_.CreateMultiplexedTunnel(kRemoteJid, "test");
+    ASSERT_TRUE(stream != NULL);
+    local_streams_.push_back(stream);
+    EXPECT_EQ_WAIT(talk_base::SS_CLOSED, stream->GetState(), kTimeoutMs);
+    EXPECT_EQ(1U, remote_streams_.size());
+    EXPECT_EQ(1, sessions_);
+  }
+
+  // Open a multiplexed tunnel for the remote client to decline as a whole,
+  // which must not leave anything behind on either side.
+  void TestMultiplexedDeclineTunnel() {
+    multiplexed_ = true;
+    decline_tunnels_ = true;
+    talk_base::StreamInterface* stream =
+        local_client_.CreateMultiplexedTunnel(kRemoteJid, "test");
+    ASSERT_TRUE(stream != NULL);
+    local_streams_.push_back(stream);
+    EXPECT_EQ_WAIT(talk_base::SS_CLOSED, stream->GetState(), kTimeoutMs);
+    EXPECT_EQ(1, incoming_tunnels_);
+    EXPECT_TRUE(remote_streams_.empty());
+    EXPECT_EQ_WAIT(0, sessions_, kTimeoutMs);
+  }
+
  private:
   enum { MSG_LSIGNAL, MSG_RSIGNAL };
 
@@ -137,15 +224,74 @@ class TunnelSessionClientTest : public testing::Test,
     delete data;
   }
 
+  void OnSessionCreate(cricket::Session* session, bool initiate) {
+    ++sessions_;
+  }
+  void OnSessionDestroy(cricket::Session* session) {
+    --sessions_;
+  }
+
   // Accept the tunnel when it arrives and wire up the stream.
   void OnIncomingTunnel(cricket::TunnelSessionClient* client,
                         buzz::Jid jid, std::string description,
                         cricket::Session* session) {
+    ++incoming_tunnels_;
+    if (decline_tunnels_) {
+      remote_client_.DeclineTunnel(session);
+      return;
+    }
+    if (multiplexed_) {
+      remote_streams_.push_back(remote_client_.AcceptTunnel(session));
+      return;
+    }
     remote_tunnel_.reset(remote_client_.AcceptTunnel(session));
     remote_tunnel_->SignalEvent.connect(this,
         &TunnelSessionClientTest::OnStreamEvent);
   }
 
+  // Accept or decline the further tunnels that share the session.
+  void OnIncomingStream(cricket::TunnelSessionClient* client,
+                        buzz::Jid jid, std::string description,
+                        cricket::TunnelMux* mux, uint32 id) {
+    EXPECT_EQ(kLocalJid, jid);
+    if (decline_streams_) {
+      mux->DeclineStream(id);
+    } else {
+      remote_streams_.push_back(mux->AcceptStream(id));
+    }
+  }
+
+  // Writes and reads as much of a multiplexed transfer as the tunnel allows,
+  // checking the data that arrives. Returns false if it's wrong.
+  bool Pump(talk_base::StreamInterface* from, talk_base::StreamInterface* to,
+            size_t size, size_t* sent, size_t* received) {
+    char block[kBlockSize];
+    size_t count;
+    while (*sent < size) {
+      count = std::min(size - *sent, sizeof(block));
+      for (size_t i = 0; i < count; ++i)
+        block[i] = static_cast<char>(*sent + i);
+      if (from->Write(block, count, &count, NULL) != talk_base::SR_SUCCESS)
+        break;
+      *sent += count;
+    }
+    while (to->Read(block, sizeof(block), &count, NULL) ==
+           talk_base::SR_SUCCESS) {
+      for (size_t i = 0; i < count; ++i) {
+        if (block[i] != static_cast<char>(*received + i))
+          return false;
+      }
+      *received += count;
+    }
+    return true;
+  }
+
+  void CloseStreams(std::vector<talk_base::StreamInterface*>* streams) {
+    for (size_t i = 0; i < streams->size(); ++i)
+      delete (*streams)[i];
+    streams->clear();
+  }
+
   // Send from send_stream_ as long as we're not flow-controlled.
   // Read bytes out into recv_stream_ as they arrive.
   // End the test when we are notified that the local side has closed the
@@ -218,9 +364,33 @@ class TunnelSessionClientTest : public testing::Test,
   talk_base::MemoryStream send_stream_;
   talk_base::MemoryStream recv_stream_;
   bool done_;
+  // Multiplexed tunnels, in the order they were opened.
+  std::vector<talk_base::StreamInterface*> local_streams_;
+  std::vector<talk_base::StreamInterface*> remote_streams_;
+  bool multiplexed_;
+  bool decline_streams_;
+  bool decline_tunnels_;
+  int incoming_tunnels_;
+  // Local sessions that exist.
+  int sessions_;
 };
 
 // Test the normal case of sending data from one side to the other.
 TEST_F(TunnelSessionClientTest, TestTransfer) {
   TestTransfer(1000000);
 }
+
+// Test that several tunnels to the same peer share a session, and carry
+// their data side by side.
+TEST_F(TunnelSessionClientTest, TestMultiplexedTransfer) {
+  TestMultiplexedTransfer(3, 300000);
+}
+
+// Test declining one of several tunnels that share a session.
+TEST_F(TunnelSessionClientTest, TestMultiplexedDecline) {
+  TestMultiplexedDecline();
+}
+
+TEST_F(TunnelSessionClientTest, TestMultiplexedDeclineTunnel) {
+  TestMultiplexedDeclineTunnel();
+}
@@ -41,11 +41,13 @@ LOCAL_BASE_SRC_FILES := \
 	talk/base/base64_unittest.cc \
 	talk/base/basictypes_unittest.cc \
 	talk/base/buffer_unittest.cc \
+	talk/base/bufferpool_unittest.cc \
 	talk/base/bytebuffer_unittest.cc \
 	talk/base/byteorder_unittest.cc \
 	talk/base/crc32_unittest.cc \
 	talk/base/event_unittest.cc \
 	talk/base/fileutils_unittest.cc \
+	talk/base/flathashmap_unittest.cc \
 	talk/base/helpers_unittest.cc \
 	talk/base/host_unittest.cc \
 	talk/base/httpbase_unittest.cc \
@@ -75,12 +77,15 @@ LOCAL_BASE_SRC_FILES := \
 	talk/base/sigslot_unittest.cc \
 	talk/base/socket_unittest.cc \
 	talk/base/socketaddress_unittest.cc \
+	talk/base/sslhandshakepool_unittest.cc \
+	talk/base/sslsessioncache_unittest.cc \
 	talk/base/stream_unittest.cc \
 	talk/base/stringencode_unittest.cc \
 	talk/base/stringutils_unittest.cc \
 	talk/base/task_unittest.cc \
 	talk/base/testclient_unittest.cc \
 	talk/base/thread_unittest.cc \
+	talk/base/timerwheel_unittest.cc \
 	talk/base/timeutils_unittest.cc \
 	talk/base/urlencode_unittest.cc \
 	talk/base/versionparsing_unittest.cc \
@@ -107,10 +112,12 @@ LOCAL_BASE_SRC_FILES := \
 
 # disabled: talk/base/latebindingsymboltable_unittest.cc
 LOCAL_LINUX_SRC_FILES := \
-	talk/base/linuxfdwalk_unittest.cc
+	talk/base/linuxfdwalk_unittest.cc \
+	talk/base/linuxnetworkmonitor_unittest.cc
 
 LOCAL_POSIX_SRC_FILES := \
 	talk/base/sslidentity_unittest.cc \
+	talk/base/sslidentitypool_unittest.cc \
 	talk/base/sslstreamadapter_unittest.cc
 
 LOCAL_SRC_FILES := \
@@ -188,6 +195,7 @@ LOCAL_SRC_FILES := \
 	talk/p2p/base/port_unittest.cc \
 	talk/p2p/base/portallocatorsessionproxy_unittest.cc \
 	talk/p2p/base/pseudotcp_unittest.cc \
+	talk/p2p/base/pseudotcpcongestion_unittest.cc \
 	talk/p2p/base/relayport_unittest.cc \
 	talk/p2p/base/relayserver_unittest.cc \
 	talk/p2p/base/session_unittest.cc \
@@ -197,6 +205,7 @@ LOCAL_SRC_FILES := \
 	talk/p2p/base/stunserver_unittest.cc \
 	talk/p2p/base/transport_unittest.cc \
 	talk/p2p/base/transportdescriptionfactory_unittest.cc \
+	talk/p2p/base/udpportmux_unittest.cc \
 	talk/p2p/client/connectivitychecker_unittest.cc \
 	talk/p2p/client/portallocator_unittest.cc \
 	talk/session/media/channel_unittest.cc \
@@ -206,6 +215,7 @@ LOCAL_SRC_FILES := \
 	talk/session/media/mediamessages_unittest.cc \
 	talk/session/media/mediasession_unittest.cc \
 	talk/session/media/mediasessionclient_unittest.cc \
+	talk/session/media/pacedsender_unittest.cc \
 	talk/session/media/rtcpmuxfilter_unittest.cc \
 	talk/session/media/srtpfilter_unittest.cc \
 	talk/session/media/ssrcmuxfilter_unittest.cc